@@ -90,6 +90,8 @@ public:
   virtual void on_backward_prop_end(model* m) {}
   /** Called when a layer ends backward propagation. */
   virtual void on_backward_prop_end(model* m, Layer* l) {}
+  /** Called just before a layer applies its update. */
+  virtual void on_update_begin(model* m, Layer* l) {}
 
   /** Called at the beginning of a (mini-)batch evaluation (validation / testing). */
   virtual void on_batch_evaluate_begin(model* m) {}
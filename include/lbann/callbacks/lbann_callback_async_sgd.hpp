@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_callback_async_sgd .hpp .cpp - Asynchronous parameter-server SGD
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_CALLBACKS_CALLBACK_ASYNC_SGD_HPP_INCLUDED
+#define LBANN_CALLBACKS_CALLBACK_ASYNC_SGD_HPP_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "lbann/callbacks/lbann_callback.hpp"
+
+namespace lbann {
+
+/**
+ * One slice of a parameter server, run on a thread in the process of model
+ * 0 with the same rank in model as the workers it serves.
+ * Workers push the change their local optimizer made to their weights and
+ * pull the server's weights back. Model 0's own worker (and the only worker
+ * when there is one model, which makes this a single-process stand-in) uses
+ * an in-process queue; other models use lbann_comm send/recv.
+ * Every push advances the pushing worker's clock; pulls report the clock of
+ * the slowest active worker so workers can bound their staleness.
+ */
+class parameter_server {
+public:
+  parameter_server(lbann_comm* comm, const std::vector<DataType>& weights);
+  ~parameter_server();
+  /** Queue a push from the local worker; it is applied asynchronously. */
+  void push(const std::vector<DataType>& delta);
+  /** Copy out the current weights; return the slowest worker's clock. */
+  int64_t pull(std::vector<DataType>& weights);
+  /** Block until every active worker's clock is at least clock. */
+  void wait_for_clock(int64_t clock);
+  /** Note that the local worker has finished training. */
+  void finish_local();
+
+  /** Message types sent by remote workers. */
+  enum message_type { PUSH_PULL, PULL, DONE };
+
+private:
+  /** Serve queued local pushes and remote requests until all workers finish. */
+  void serve();
+  /** Add delta to the weights and advance worker's clock. Hold m_mutex. */
+  void apply(int worker, const DataType* delta);
+  /** Return the clock of the slowest unfinished worker. Hold m_mutex. */
+  int64_t min_clock() const;
+
+  lbann_comm* m_comm;
+  std::vector<DataType> m_weights;
+  /** Number of pushes applied from each worker (model). */
+  std::vector<int64_t> m_clocks;
+  /** Which workers have finished. */
+  std::vector<bool> m_done;
+  std::deque<std::vector<DataType>> m_local_pushes;
+  /** Buffers for remote requests. */
+  std::vector<DataType> m_recv_buf;
+  std::vector<DataType> m_send_buf;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::thread m_thread;
+};
+
+/**
+ * Asynchronous SGD against a parameter server, as an alternative to
+ * lbann_callback_imcomm. Each model steps with its own optimizer, then pushes
+ * the resulting weight change to the server and continues from the server's
+ * current weights, without waiting for other models. A model may run at most
+ * staleness steps ahead of the slowest model before it blocks.
+ * Because every model's step is applied in full, the learning rate usually
+ * needs to be lowered relative to synchronous training.
+ * With more than one model, model 0's processes need MPI_THREAD_MULTIPLE.
+ */
+class lbann_callback_async_sgd : public lbann_callback {
+public:
+  lbann_callback_async_sgd(int staleness, lbann_summary* _summarizer = nullptr);
+  ~lbann_callback_async_sgd();
+  /** Set up the server (on model 0) and the layers to exchange. */
+  void setup(model* m);
+  /** Start every model from the server's weights. */
+  void on_train_begin(model* m);
+  /** Push this step's update and pull the server's weights. */
+  void on_batch_end(model* m);
+  /** Pull the server's weights for evaluation and report throughput. */
+  void on_epoch_end(model* m);
+  /** Tell the server this model is done. */
+  void on_train_end(model* m);
+private:
+  /** Copy the local weights of the layers into buf. */
+  void pack_weights(std::vector<DataType>& buf);
+  /** Copy buf into the local weights of the layers. */
+  void unpack_weights(const std::vector<DataType>& buf);
+  /** Exchange with the server; push the delta if push is set. */
+  int64_t exchange(lbann_comm* comm, bool push);
+  /** Send the server a header for a request of the given type. */
+  void send_header(lbann_comm* comm, parameter_server::message_type type);
+
+  /** Maximum number of steps ahead of the slowest model. */
+  int m_staleness;
+  /** Server slice (model 0 only). */
+  parameter_server* m_server = nullptr;
+  /** Layers whose weights are exchanged. */
+  std::vector<Layer*> m_layers;
+  /** Number of local weight entries exchanged. */
+  El::Int m_count = 0;
+  /** Weights as of the last pull. */
+  std::vector<DataType> m_base;
+  /** Scratch for the current weights / deltas. */
+  std::vector<DataType> m_buf;
+  /** Pushes made by this model. */
+  int64_t m_clock = 0;
+  /** Epoch statistics. */
+  double m_epoch_start = 0.0;
+  int64_t m_epoch_steps = 0;
+  double m_epoch_wait_time = 0.0;
+  int64_t m_epoch_max_staleness = 0;
+};
+
+}  // namespace lbann
+
+#endif  // LBANN_CALLBACKS_CALLBACK_ASYNC_SGD_HPP_INCLUDED
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_callback_gossip .hpp .cpp - Decentralized gossip averaging
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_CALLBACKS_CALLBACK_GOSSIP_HPP_INCLUDED
+#define LBANN_CALLBACKS_CALLBACK_GOSSIP_HPP_INCLUDED
+
+#include <vector>
+#include "lbann/callbacks/lbann_callback.hpp"
+
+namespace lbann {
+
+/**
+ * Decentralized gossip training, as an alternative to
+ * lbann_callback_imcomm. Instead of a global sum, each model averages its
+ * weights with one or two neighbours per step, so per-step communication
+ * does not grow with the number of models.
+ * The exchange overlaps with compute. At the end of step t each model
+ * snapshots its weights and starts non-blocking sends and receives of the
+ * snapshots. At the end of step t+1 it waits and moves its weights by the
+ * difference between the neighbourhood average of the snapshots and its own
+ * snapshot, which keeps the local update made during step t+1.
+ */
+class lbann_callback_gossip : public lbann_callback {
+public:
+  enum topology {
+    RING,  /** Average with both ring neighbours every step. */
+    RANDOM  /** Average with one peer from a random matching that changes every step. */
+  };
+  lbann_callback_gossip(topology topo = RING, int seed = 42,
+                        lbann_summary* _summarizer = nullptr);
+  /** Set up the layers to exchange. */
+  void setup(model* m);
+  /** Finish the previous exchange and start the next one. */
+  void on_batch_end(model* m);
+  /** Finish the outstanding exchange. */
+  void on_epoch_end(model* m);
+private:
+  /** Return the models to exchange with at step. */
+  std::vector<int> get_peers(lbann_comm* comm, int64_t step) const;
+  /** Start exchanging the current weights with the peers. */
+  void start_exchange(model* m);
+  /** Wait for the exchange in flight and apply it. */
+  void finish_exchange(model* m);
+
+  topology m_topology;
+  int m_seed;
+  /** Layers whose weights are exchanged. */
+  std::vector<Layer*> m_layers;
+  /** Number of local weight entries exchanged. */
+  El::Int m_count = 0;
+  /** Snapshot of the weights being sent. */
+  std::vector<DataType> m_snapshot;
+  /** Peers and their snapshots for the exchange in flight. */
+  std::vector<int> m_peers;
+  std::vector<std::vector<DataType>> m_recv_bufs;
+  std::vector<mpi::Request<DataType>> m_send_reqs;
+  std::vector<mpi::Request<DataType>> m_recv_reqs;
+  /** Whether an exchange is in flight. */
+  bool m_in_flight = false;
+};
+
+}  // namespace lbann
+
+#endif  // LBANN_CALLBACKS_CALLBACK_GOSSIP_HPP_INCLUDED
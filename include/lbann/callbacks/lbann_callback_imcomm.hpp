@@ -30,10 +30,15 @@
 #define LBANN_CALLBACKS_CALLBACK_IMCOMM_HPP_INCLUDED
 
 #include <vector>
+#include <deque>
 #include <unordered_set>
 #include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "lbann/callbacks/lbann_callback.hpp"
 #include "lbann/utils/lbann_quantizer.hpp"
+#include "lbann/utils/lbann_gradient_buckets.hpp"
 
 namespace lbann {
 
@@ -53,7 +58,9 @@ public:
     COMPRESSED_THRESH_QUANTIZATION,  /** Do compressed thresholded one-bit quantization. */
     ADAPTIVE_THRESH_QUANTIZATION,  /** Do adaptive thresholded one-bit quantization. */
     COMPRESSED_ADAPTIVE_THRESH_QUANTIZATION,  /** Do compressed adaptive thresholded one-bit quantization. */
-    NORMAL_AR  /** Sum gradient updates but use the custom allreduce. */
+    NORMAL_AR,  /** Sum gradient updates but use the custom allreduce. */
+    TOPK_SPARSIFICATION,  /** Send only the top-k entries, with error feedback. */
+    QSGD_QUANTIZATION  /** Do multi-level stochastic (QSGD) quantization. */
   };
   /** Do inter-model gradient updates of the given type. */
   lbann_callback_imcomm(comm_type ct = NONE, lbann_summary* _summarizer = nullptr);
@@ -63,16 +70,129 @@ public:
    */
   lbann_callback_imcomm(comm_type ct, std::unordered_set<uint> _layers,
                         lbann_summary* _summarizer = nullptr);
+  ~lbann_callback_imcomm();
+  /**
+   * Overlap inter-model communication with backpropagation.
+   * Each layer's gradient reduction starts as soon as the layer finishes
+   * backprop and is only waited on right before the layer updates. Must be
+   * set before setup.
+   */
+  void set_overlap(bool overlap) { m_overlap = overlap; }
+  /**
+   * Fuse plain gradient sums (NORMAL) into buckets of at most bucket_bytes,
+   * one collective per bucket. 0 disables bucketing. Must be set before setup.
+   */
+  void set_bucket_size(size_t bucket_bytes) { m_bucket_bytes = bucket_bytes; }
+  /**
+   * Choose the custom allreduce algorithm (NORMAL_AR). With autotune, time
+   * the algorithms at setup over sizes up to the largest gradient and let
+   * AUTO use the measured crossover points. Must be set before setup.
+   */
+  void set_allreduce_algorithm(lbann_quantizer::allreduce_algorithm alg,
+                               bool autotune = false) {
+    m_allreduce_alg = alg;
+    m_autotune_allreduce = autotune;
+  }
+  /**
+   * Pipeline the quantized reduce-scatter (one-bit and adaptive) in segments
+   * of about segment_bytes; 0 disables it.
+   */
+  void set_ring_segment_size(size_t segment_bytes) {
+    quantizer.set_ring_segment_size(segment_bytes);
+  }
+  /** Send the values of the custom ring allreduce in precision p. */
+  void set_ring_precision(payload_precision p) {
+    quantizer.set_ring_precision(p);
+  }
+  /**
+   * Keep one in proportion of each layer's gradient entries (the largest in
+   * magnitude) with TOPK_SPARSIFICATION.
+   */
+  void set_topk_proportion(int proportion) { m_topk_proportion = proportion; }
+  /** Use bits bits per entry (2, 4 or 8) with QSGD_QUANTIZATION. */
+  void set_qsgd_bits(int bits) { m_qsgd_bits = bits; }
   /** Do initialization for this model. */
   void setup(model* m);
   /** Clear out remaining error if needed. */
   void on_epoch_end(model* m);
   /** Do inter-model gradient updates. */
   void on_backward_prop_end(model* m);
+  /** Start the inter-model gradient update for a layer when overlapping. */
+  void on_backward_prop_end(model* m, Layer* l);
+  /** Complete the inter-model gradient update for a layer when overlapping. */
+  void on_update_begin(model* m, Layer* l);
+  /** Report overlap and bucketing statistics for the mini-batch. */
+  void on_batch_end(model* m);
 private:
+  /** Communication statistics for one layer's reduction. */
+  struct reduction_stats {
+    size_t bytes_sent = 0;
+    size_t bytes_received = 0;
+    size_t rs_bytes_sent = 0;
+    size_t ag_bytes_sent = 0;
+    size_t rs_bytes_received = 0;
+    size_t ag_bytes_received = 0;
+    double rs_send_trans_time = 0.0;
+    double rs_recv_trans_time = 0.0;
+    double ag_recv_trans_time = 0.0;
+    size_t quantized_count = 0;
+  };
+  /** An in-flight (overlapped) reduction of one layer's gradient. */
+  struct pending_reduction {
+    /** Request for non-blocking sums. */
+    mpi::Request<DataType> req;
+    /** Whether the reduction is done with req (otherwise the comm thread). */
+    bool uses_request = false;
+    /** Whether a reduction has been started and not yet waited on. */
+    bool in_flight = false;
+    /** Set by the comm thread when it finishes the reduction. */
+    bool done = false;
+    /** Time the reduction was started. */
+    double start_time = 0.0;
+    /** Time the comm thread finished the reduction. */
+    double end_time = 0.0;
+    /** Statistics captured when the reduction finished. */
+    reduction_stats stats;
+  };
+
   /** Communication type. */
   comm_type ct;
-  /** Quantizer for quantization of updates, if needed. */
+  /** Whether to overlap communication with backprop. */
+  bool m_overlap = false;
+  /** Custom allreduce algorithm, and whether to autotune it at setup. */
+  lbann_quantizer::allreduce_algorithm m_allreduce_alg =
+    lbann_quantizer::allreduce_algorithm::AUTO;
+  bool m_autotune_allreduce = false;
+  /** Proportion of entries kept by top-k sparsification. */
+  int m_topk_proportion = 64;
+  /** Bits per entry for QSGD quantization. */
+  int m_qsgd_bits = 4;
+  /** Whether quantized reductions are run on the communication thread. */
+  bool m_use_comm_thread = false;
+  /** In-flight reductions, by layer position. */
+  std::unordered_map<uint, pending_reduction> m_pending;
+  /** Communication thread and its work queue (layer positions). */
+  std::thread m_comm_thread;
+  std::deque<uint> m_comm_queue;
+  std::mutex m_comm_mutex;
+  std::condition_variable m_comm_cv;
+  bool m_comm_thread_stop = false;
+  /** Layers in the model (for the communication thread). */
+  std::vector<Layer*>* m_layers = nullptr;
+  /** Communicator (for the communication thread). */
+  lbann_comm* m_comm = nullptr;
+  /** Maximum bucket size in bytes (0 for no bucketing). */
+  size_t m_bucket_bytes = 0;
+  /** Gradient buckets, when bucketing. */
+  gradient_buckets* m_buckets = nullptr;
+  /** Per-mini-batch overlap timers. */
+  double m_comm_time = 0.0;
+  double m_exposed_time = 0.0;
+  /**
+   * Quantizer for quantization of updates, if needed. When the
+   * communication thread runs, only it uses the quantizer (reductions and
+   * their statistics), so the quantizer's counters are never shared.
+   */
   lbann_quantizer quantizer;
   /** Per-layer quantization errors. */
   std::unordered_map<uint, Mat> quantization_errors;
@@ -83,13 +203,31 @@ private:
   /** Layers indicies to quantize. */
   std::unordered_set<uint> layer_indices;
 
+  /** Reduce the gradient of the layer at position l (blocking). */
+  void reduce_layer(lbann_comm* comm, Layer* layer, uint l);
+  /** Gather (and reset) the statistics of the last reduction. */
+  reduction_stats collect_stats(const DistMat& weights_gradient);
+  /** Write per-layer statistics to the summarizer. */
+  void summarize_layer(model* m, Layer* layer, double im_time,
+                       const reduction_stats& stats);
+  /** Main loop of the communication thread. */
+  void comm_thread_loop();
+  /** Return true if the layer at position l is reduced per layer. */
+  bool reduces_layer(model* m, Layer* layer) const;
+
   /** Return true if the comm type does quantization. */
   inline bool ct_does_quantization() const {
     return (ct == ONEBIT_QUANTIZATION ||
             ct == THRESH_QUANTIZATION ||
             ct == COMPRESSED_THRESH_QUANTIZATION ||
             ct == ADAPTIVE_THRESH_QUANTIZATION ||
-            ct == COMPRESSED_ADAPTIVE_THRESH_QUANTIZATION);
+            ct == COMPRESSED_ADAPTIVE_THRESH_QUANTIZATION ||
+            ct == TOPK_SPARSIFICATION ||
+            ct == QSGD_QUANTIZATION);
+  }
+  /** Return true if the comm type keeps quantization error feedback. */
+  inline bool ct_has_error_feedback() const {
+    return ct_does_quantization() && ct != QSGD_QUANTIZATION;
   }
 };
 
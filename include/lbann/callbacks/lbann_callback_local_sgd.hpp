@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_callback_local_sgd .hpp .cpp - Periodic model averaging (local SGD)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_CALLBACKS_CALLBACK_LOCAL_SGD_HPP_INCLUDED
+#define LBANN_CALLBACKS_CALLBACK_LOCAL_SGD_HPP_INCLUDED
+
+#include <vector>
+#include <unordered_set>
+#include "lbann/callbacks/lbann_callback.hpp"
+
+namespace lbann {
+
+/**
+ * Local SGD: an alternative to lbann_callback_imcomm for multi-model
+ * training where models do not sum gradients every step. Each model takes k
+ * local optimizer steps, then the weights (and optionally the optimizer
+ * state) are averaged over the inter-model communicator. This cuts
+ * inter-model communication per epoch by a factor of k.
+ * Weights are also averaged at the end of every epoch so evaluation sees one
+ * model.
+ * With adaptive averaging, k is halved when the models drifted apart by more
+ * than a threshold since the last average and doubled (up to a maximum) when
+ * they stayed well within it. The drift is the relative variance of the
+ * weights across models, sum_i ||w_i - w_avg||^2 / (M ||w_avg||^2).
+ */
+class lbann_callback_local_sgd : public lbann_callback {
+public:
+  /**
+   * Average every k steps.
+   * @param average_optimizer_state Also average optimizer state matrices.
+   */
+  lbann_callback_local_sgd(int k, bool average_optimizer_state = false,
+                           lbann_summary* _summarizer = nullptr);
+  /** Average every k steps, only for the layers in the layers set. */
+  lbann_callback_local_sgd(int k, std::unordered_set<uint> _layers,
+                           bool average_optimizer_state = false,
+                           lbann_summary* _summarizer = nullptr);
+  /**
+   * Adapt k between 1 and max_k, aiming to keep the drift between averages
+   * below drift_threshold. The k given to the constructor is the initial k.
+   */
+  void set_adaptive(int max_k, double drift_threshold = 1e-3) {
+    m_adaptive = true;
+    m_max_k = max_k;
+    m_drift_threshold = drift_threshold;
+  }
+  /** Return the current number of local steps between averages. */
+  int get_k() const { return m_k; }
+  /** Do initialization for this model. */
+  void setup(model* m);
+  /** Average weights if k steps have passed. */
+  void on_batch_end(model* m);
+  /** Average weights so every model ends the epoch identical. */
+  void on_epoch_end(model* m);
+private:
+  /** Average the weights (and optimizer state) over the models. */
+  void average(model* m);
+  /** Sum a matrix over the models and divide by the number of models. */
+  void average_matrix(lbann_comm* comm, ElMat& mat);
+  /** Return the sum of squares of the local entries of mat. */
+  static double local_sqsum(ElMat& mat);
+
+  /** Current number of local steps between averages. */
+  int m_k;
+  /** Whether k is adapted. */
+  bool m_adaptive = false;
+  /** Largest k when adapting. */
+  int m_max_k;
+  /** Drift to stay below when adapting. */
+  double m_drift_threshold;
+  /** Whether to also average optimizer state. */
+  bool m_average_optimizer_state;
+  /** Local steps since the last average. */
+  int m_steps = 0;
+  /** Layers indicies to average (all if empty at setup). */
+  std::unordered_set<uint> layer_indices;
+  /** Layers averaged with their own collective. */
+  std::vector<Layer*> m_layers;
+  /** Bytes sent for averaging since the start of the epoch. */
+  size_t m_epoch_bytes = 0;
+  /** Number of averages since the start of the epoch. */
+  int m_epoch_averages = 0;
+};
+
+}  // namespace lbann
+
+#endif  // LBANN_CALLBACKS_CALLBACK_LOCAL_SGD_HPP_INCLUDED
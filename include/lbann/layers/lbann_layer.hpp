@@ -38,6 +38,8 @@
 #include "lbann/optimizers/lbann_optimizer_adagrad.hpp"
 #include "lbann/optimizers/lbann_optimizer_rmsprop.hpp"
 #include "lbann/optimizers/lbann_optimizer_adam.hpp"
+#include "lbann/optimizers/lbann_optimizer_lars.hpp"
+#include "lbann/optimizers/lbann_optimizer_lamb.hpp"
 #include "lbann/utils/lbann_exception.hpp"
 #include "lbann/io/lbann_persist.hpp"
 #include <string>
@@ -88,6 +90,11 @@ namespace lbann
     };
 
     virtual void setup(int);
+    /**
+     * Re-establish any views into the weights/biases and gradient matrices.
+     * Called when the storage backing those matrices changes after setup.
+     */
+    virtual void setup_weight_views() {}
 
     /** Return the index of this layer. */
     inline uint get_index() const { return Index; }
@@ -52,6 +52,7 @@ namespace lbann
                           std::vector<regularizer*> regs={});
       ~FullyConnectedLayer();
       void setup(int numPrevNeurons);
+      void setup_weight_views();
       void fp_set_std_matrix_view();
       bool update();
       DataType checkGradient(Layer& PrevLayer, const DataType Epsilon=1e-4);
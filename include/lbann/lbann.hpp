@@ -63,6 +63,9 @@
 #include "lbann/callbacks/lbann_callback_learning_rate.hpp"
 #include "lbann/callbacks/lbann_callback_debug.hpp"
 #include "lbann/callbacks/lbann_callback_imcomm.hpp"
+#include "lbann/callbacks/lbann_callback_local_sgd.hpp"
+#include "lbann/callbacks/lbann_callback_async_sgd.hpp"
+#include "lbann/callbacks/lbann_callback_gossip.hpp"
 #include "lbann/callbacks/lbann_callback_dump_weights.hpp"
 #include "lbann/callbacks/lbann_callback_early_stopping.hpp"
 
@@ -30,12 +30,35 @@
 #define LBANN_COMM_HPP_INCLUDED
 
 #include <vector>
+#include <atomic>
+#include <ostream>
+#include <thread>
 #include "lbann_base.hpp"
+#include "lbann/utils/lbann_shared_memory.hpp"
+#include "lbann/utils/lbann_intramodel_compression.hpp"
+#include "lbann/utils/lbann_lossless_compression.hpp"
+#include "lbann/utils/lbann_comm_trace.hpp"
+#include "lbann/utils/lbann_rma_window.hpp"
 using namespace El;
 
 namespace lbann
 {
 
+  /**
+   * How processes are assigned to models.
+   * CONTIGUOUS: model m gets world ranks m*procs_per_model onwards, however
+   * they are laid out on nodes.
+   * PACKED: processes are ordered by compute node before being split into
+   * consecutive models, so a model spans as few nodes as the launch allows
+   * (intra-model traffic stays on the node).
+   * STRIPED: processes ordered by node are dealt out to models in turn, so
+   * each node holds the same rank of several models and inter-model rings
+   * stay on the node.
+   */
+  enum class rank_placement {CONTIGUOUS, PACKED, STRIPED};
+  /** Return a printable name for p. */
+  const char* rank_placement_name(rank_placement p);
+
   /**
    * Manage communication.
    * This supports separate models, each of which are split over potentially
@@ -50,9 +73,12 @@ namespace lbann
   public:
     /**
      * Init communicators for models each with procs_per_model processes,
-     * defaulting to every process in one model.
+     * defaulting to every process in one model, with processes assigned to
+     * models by placement. The model and inter-model communicators and the
+     * grid follow the placement.
      */
-    lbann_comm(int procs_per_model = 0);
+    lbann_comm(int procs_per_model = 0,
+               rank_placement placement = rank_placement::CONTIGUOUS);
     ~lbann_comm();
 
     /** Get which model this process is in. */
@@ -63,8 +89,21 @@ namespace lbann
     inline int get_rank_in_world() const { return mpi::Rank(mpi::COMM_WORLD); }
     /** Return the COMM_WORLD rank of the rank'th processor in model. */
     inline int get_world_rank(int model, int rank) const {
-      return procs_per_model * model + rank;
+      return placed_world_ranks[procs_per_model * model + rank];
+    }
+    /** Return the placement policy. */
+    inline rank_placement get_rank_placement() const { return placement; }
+    /** Return the compute node (numbered from 0) holding a world rank. */
+    inline int get_node_of_world_rank(int world_rank) const {
+      return world_rank_nodes[world_rank];
     }
+    /**
+     * Print how models are laid out on compute nodes: how many nodes the
+     * model and inter-model communicators span, and how many of their ring
+     * neighbours share a node, i.e. the share of ring allreduce traffic that
+     * stays within a node. Needs no communication; call on one process.
+     */
+    void print_placement_report(std::ostream& os) const;
     /** Return the rank of the master process in this model. */
     inline int get_model_master() const { return 0; }
     /** Return the rank of the inter-model master process. */
@@ -90,25 +129,184 @@ namespace lbann
     /** Return the rank of this process within its compute node. */
     inline int get_rank_in_node() const { return rank_in_node; }
 
-    /** Perform a sum reduction of mat over the inter-model communicator. */
+    /**
+     * Perform a sum reduction of mat over the inter-model communicator,
+     * sending payloads of the precision set by set_payload_precision.
+     */
     void intermodel_sum_matrix(Mat& mat);
     void intermodel_sum_matrix(DistMat& mat);
-    /** Non-blocking intermodel_sum_matrix. */
-    //void nb_intermodel_sum_matrix(Mat& mat, mpi::Request& req);
-    //void nb_intermodel_sum_matrix(DistMat& mat, mpi::Request& req);
-    /** Broadcast mat over the inter-model communicator starting from root. */
+    /**
+     * Sum reduction of mat sending payloads of precision p. For FP16/BF16
+     * each reduction step of the allreduce widens both operands to fp32,
+     * adds, and rounds the result once; mat is left holding the rounded sum
+     * (identical on every model).
+     */
+    void intermodel_sum_matrix(Mat& mat, payload_precision p);
+    void intermodel_sum_matrix(DistMat& mat, payload_precision p);
+    /**
+     * Non-blocking intermodel_sum_matrix. mat must not be accessed until req
+     * has been completed with wait (or test has returned true). mat must be
+     * contiguous (LDim equal to its local height).
+     */
+    void nb_intermodel_sum_matrix(Mat& mat, mpi::Request<DataType>& req);
+    void nb_intermodel_sum_matrix(DistMat& mat, mpi::Request<DataType>& req);
+    /** In-place sum reduction of count entries over the inter-model communicator. */
+    void intermodel_sum(DataType* data, int count);
+    /** Non-blocking intermodel_sum. */
+    void nb_intermodel_sum(DataType* data, int count,
+                           mpi::Request<DataType>& req);
+    /**
+     * Node-aware in-place sum of count entries over the inter-model
+     * communicator. Inter-model peers on the same node reduce first, only
+     * node-level partial sums cross the network, and the result is spread
+     * back within the node. When every node holds the same number of peers
+     * this is done in lanes (reduce-scatter in the node, one inter-node
+     * allreduce per lane, allgather in the node); otherwise node leaders do
+     * the inter-node allreduce.
+     * With MPI-3, the steps within the node are direct loads and stores on a
+     * shared-memory window instead of MPI collectives.
+     */
+    void hierarchical_intermodel_sum(DataType* data, int count);
+    /**
+     * Use hierarchical_intermodel_sum for intermodel_sum_matrix and
+     * intermodel_sum.
+     */
+    void set_hierarchical_allreduce(bool hierarchical) {
+      use_hierarchical_allreduce = hierarchical;
+    }
+    /** Return the number of compute nodes spanned by the inter-model communicator. */
+    inline int get_num_intermodel_nodes() const { return num_intermodel_nodes; }
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+    /**
+     * Allocate bytes once per compute node in shared memory, e.g. for a
+     * read-only dataset. Collective over the processes of the node; the
+     * memory is segment 0 of the returned window, and every process on the
+     * node can read it directly. The caller owns the window.
+     */
+    shared_memory_window* allocate_node_shared(size_t bytes);
+    /**
+     * Whether hierarchical_intermodel_sum does its steps within the node
+     * through a shared-memory window (the default) or MPI collectives.
+     */
+    void set_shared_memory_allreduce(bool shm) { use_shm_allreduce = shm; }
+#endif
+    /** Return the number of inter-model peers on this compute node. */
+    inline int get_intermodel_procs_per_node() const {
+      return mpi::Size(intermodel_node_comm);
+    }
+    /**
+     * Broadcast mat over the inter-model communicator starting from root,
+     * sending payloads of the precision set by set_payload_precision.
+     */
     void intermodel_broadcast_matrix(Mat& mat, int root);
     void intermodel_broadcast_matrix(DistMat& mat, int root);
-    /** Non-blocking intermodel_broadcast_matrix. */
-    //void nb_intermodel_broadcast_matrix(Mat& mat, int root, mpi::Request& req);
-    //void nb_intermodel_broadcast_matrix(DistMat& mat, int root,
-    //                                    mpi::Request& req);
+    /**
+     * Broadcast mat sending payloads of precision p. mat must already have
+     * its final size on every model; for FP16/BF16 the root's copy is also
+     * rounded so that every model ends up with the same values.
+     */
+    void intermodel_broadcast_matrix(Mat& mat, int root, payload_precision p);
+    void intermodel_broadcast_matrix(DistMat& mat, int root,
+                                     payload_precision p);
+    /**
+     * Set the wire precision of intermodel_sum_matrix and
+     * intermodel_broadcast_matrix (default FP32). A reduced precision takes
+     * precedence over the hierarchical allreduce.
+     */
+    void set_payload_precision(payload_precision p) { payload_prec = p; }
+    inline payload_precision get_payload_precision() const {
+      return payload_prec;
+    }
+    /**
+     * Non-blocking intermodel_broadcast_matrix. mat must already have its
+     * final size on every model, must be contiguous, and must not be accessed
+     * until req has been completed.
+     */
+    void nb_intermodel_broadcast_matrix(Mat& mat, int root,
+                                        mpi::Request<DataType>& req);
+    void nb_intermodel_broadcast_matrix(DistMat& mat, int root,
+                                        mpi::Request<DataType>& req);
+    /**
+     * Broadcast count entries from root over the inter-model communicator,
+     * for large one-off transfers such as a whole model's weights. The data
+     * is split into chunks of chunk_count entries that the root compresses
+     * losslessly (see lossless_compress) and sends down a binary tree of
+     * models; each model forwards a chunk's compressed bytes to its children
+     * while it receives the next one, so the tree depth costs one chunk
+     * rather than the whole message. Chunks are shrunk if needed so their
+     * compressed bytes fit in an MPI count. Returns the compressed size of the
+     * data in bytes (0 with a single model). Collective; every model must
+     * pass the same count and chunk_count.
+     */
+    size_t intermodel_broadcast_compressed(
+      DataType* data, size_t count, int root,
+      size_t chunk_count = DEFAULT_BROADCAST_CHUNK);
+    /** Default chunk size of intermodel_broadcast_compressed, in entries. */
+    static const size_t DEFAULT_BROADCAST_CHUNK = 1 << 18;
+#if LBANN_HAS_RMA_WINDOWS
+    /**
+     * In-place sum of count entries over the inter-model communicator with
+     * one-sided communication: each model owns a chunk, the others
+     * MPI_Accumulate their part of it into the owner's window, and owners
+     * MPI_Put the summed chunk back into everyone's window. Nobody waits on
+     * a matching receive; the only synchronization is the three window
+     * fences (seeded, accumulated, gathered). Collective; every model must
+     * pass the same count.
+     */
+    void rma_intermodel_sum(DataType* data, int count);
+    /** rma_intermodel_sum of a contiguous matrix. */
+    void rma_intermodel_sum_matrix(Mat& mat);
+    void rma_intermodel_sum_matrix(DistMat& mat);
+    /**
+     * Broadcast count entries from root over the inter-model communicator
+     * by root putting them straight into every model's window (one fence).
+     * Collective; every model must pass the same count.
+     */
+    void rma_intermodel_broadcast(DataType* data, int count, int root);
+    /** rma_intermodel_broadcast of a contiguous matrix. */
+    void rma_intermodel_broadcast_matrix(Mat& mat, int root);
+    void rma_intermodel_broadcast_matrix(DistMat& mat, int root);
+    /**
+     * Collectively make every model's inter-model window hold count zeroed
+     * entries, for the asynchronous calls below. Those need no matching
+     * call on the target: e.g. workers rma_accumulate gradients into a
+     * server model's window whenever they are ready, and the server
+     * rma_drains them when it wants; the server rma_puts weights into its
+     * own window and workers rma_get them. Updates are atomic per entry
+     * (not per message).
+     */
+    void rma_setup(int count);
+    /** Start adding count entries of data to model's window at offset. */
+    void rma_accumulate(const DataType* data, int count, int model,
+                        int offset = 0);
+    /** Start replacing count entries of model's window at offset by data. */
+    void rma_put(const DataType* data, int count, int model, int offset = 0);
+    /** Start reading count entries of model's window at offset into data. */
+    void rma_get(DataType* data, int count, int model, int offset = 0);
+    /**
+     * Complete this process's outstanding rma_accumulate/put/get calls
+     * (their buffers can then be reused or read).
+     */
+    void rma_flush();
+    /**
+     * Take the first count entries of this process's own window, replacing
+     * them with zeros, e.g. the gradients accumulated since the last drain.
+     */
+    void rma_drain(DataType* data, int count);
+    /**
+     * End an epoch: collectively complete every model's outstanding RMA
+     * calls, e.g. to run the asynchronous calls in bounded-staleness rounds.
+     */
+    void rma_fence();
+#endif
     /**
      * Inter-model broadcast, returns the broadcast value.
      * Root process specifies root and val, other processes just root.
      */
     template <typename T>
     T intermodel_broadcast(int root, T val = {}) {
+      comm_trace_scope trace(tracer, "intermodel_broadcast", "intermodel",
+                             sizeof(T));
       mpi::Broadcast(&val, 1, root, intermodel_comm);
       if (get_rank_in_model() == root) {
         bytes_sent += sizeof(T);
@@ -123,6 +321,7 @@ namespace lbann
      */
     template <typename T>
     T model_broadcast(int root, T val = {}) {
+      comm_trace_scope trace(tracer, "model_broadcast", "model", sizeof(T));
       mpi::Broadcast(&val, 1, root, model_comm);
       if (get_rank_in_model() == root) {
         bytes_sent += sizeof(T);
@@ -134,12 +333,16 @@ namespace lbann
     /** Inter-model gather (for non-root processes). */
     template <typename T>
     void intermodel_gather(T send, int root) {
+      comm_trace_scope trace(tracer, "intermodel_gather", "intermodel",
+                             sizeof(T));
       bytes_sent += sizeof(T);
       mpi::Gather(&send, 1, (T*) NULL, 0, root, intermodel_comm);
     }
     /** Inter-model gather (for root processes). */
     template <typename T>
     void intermodel_gather(T send, std::vector<T>& recv) {
+      comm_trace_scope trace(tracer, "intermodel_gather", "intermodel",
+                             sizeof(T) * get_num_models());
       mpi::Gather(&send, 1, recv.data(), 1, get_model_rank(),
                   intermodel_comm);
       bytes_received += sizeof(T) * (get_num_models() - 1);
@@ -147,24 +350,59 @@ namespace lbann
     /** Inter-model scalar-array gather (for non-root processes). */
     template <typename T>
     void intermodel_gather(T* send, int count, int root) {
+      comm_trace_scope trace(tracer, "intermodel_gather", "intermodel",
+                             sizeof(T) * count);
       bytes_sent += sizeof(T) * count;
       mpi::Gather(send, count, (T*) NULL, 0, root, intermodel_comm);
     }
     /** Inter-model scalar-array gather (for root processes). */
     template <typename T>
     void intermodel_gather(T* send, int count, T* recv) {
+      comm_trace_scope trace(tracer, "intermodel_gather", "intermodel",
+                             sizeof(T) * count * get_num_models());
       mpi::Gather(send, count, recv, count, get_model_rank(), intermodel_comm);
       bytes_received += sizeof(T) * count * (get_num_models() - 1);
     }
+    /**
+     * Inter-model reduce-scatter.
+     * send holds count entries for each model, in model order; each model
+     * receives the reduction of its count entries in recv.
+     */
+    template <typename T>
+    void intermodel_reduce_scatter(const T* send, T* recv, int count,
+                                   mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "intermodel_reduce_scatter", "intermodel",
+                             sizeof(T) * count * get_num_models());
+      bytes_sent += sizeof(T) * count * (get_num_models() - 1);
+      mpi::ReduceScatter(send, recv, count, op, intermodel_comm);
+      bytes_received += sizeof(T) * count * (get_num_models() - 1);
+    }
+    /**
+     * Inter-model allgather.
+     * Each model contributes count entries from send; recv receives
+     * count entries from every model, in model order.
+     */
+    template <typename T>
+    void intermodel_allgather(const T* send, T* recv, int count) {
+      comm_trace_scope trace(tracer, "intermodel_allgather", "intermodel",
+                             sizeof(T) * count * get_num_models());
+      bytes_sent += sizeof(T) * count * (get_num_models() - 1);
+      mpi::AllGather(send, count, recv, count, intermodel_comm);
+      bytes_received += sizeof(T) * count * (get_num_models() - 1);
+    }
     /** Inter-model reduce (for non-root processes). */
     template <typename T>
     void intermodel_reduce(T send, int root, mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "intermodel_reduce", "intermodel",
+                             sizeof(T));
       bytes_sent += sizeof(T);
       mpi::Reduce(&send, (T*) NULL, 0, op, root, intermodel_comm);
     }
     /** Inter-model reduce (for root processes). */
     template <typename T>
     T intermodel_reduce(T send, mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "intermodel_reduce", "intermodel",
+                             sizeof(T));
       T val;
       mpi::Reduce(&send, &val, 1, op, get_model_rank(),
                   intermodel_comm);
@@ -174,6 +412,8 @@ namespace lbann
     /** Inter-model all-reduce. */
     template <typename T>
     T intermodel_allreduce(T send, mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "intermodel_allreduce", "intermodel",
+                             sizeof(T));
       T val;
       bytes_sent += sizeof(T);
       mpi::AllReduce(&send, &val, 1, op, intermodel_comm);
@@ -183,12 +423,14 @@ namespace lbann
     /** Within-model reduce (for non-root processes). */
     template <typename T>
     void model_reduce(T send, int root, mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "model_reduce", "model", sizeof(T));
       bytes_sent += sizeof(T);
       mpi::Reduce(&send, (T*) NULL, 1, op, root, model_comm);
     }
     /** Within-model reduce (for root processes). */
     template <typename T>
     T model_reduce(T send, mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "model_reduce", "model", sizeof(T));
       T val;
       mpi::Reduce(&send, &val, 1, op, get_rank_in_model(), model_comm);
       bytes_received += sizeof(T) * (get_procs_per_model() - 1);
@@ -197,18 +439,23 @@ namespace lbann
     /** Within-model scalar array reduce (for non-root processes). */
     template <typename T>
     void model_reduce(T* send, int count, int root, mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "model_reduce", "model",
+                             sizeof(T) * count);
       bytes_sent += sizeof(T) * count;
       mpi::Reduce(send, (T*) NULL, count, op, root, model_comm);
     }
     /** Within-model scalar array reduce (for root processes). */
     template <typename T>
     void model_reduce(T* send, int count, T* recv, mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "model_reduce", "model",
+                             sizeof(T) * count);
       mpi::Reduce(send, recv, count, op, get_rank_in_model(), model_comm);
       bytes_received += sizeof(T) * count * (get_procs_per_model() - 1);
     }
     /** Within-model all-reduce. */
     template <typename T>
     T model_allreduce(T send, mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "model_allreduce", "model", sizeof(T));
       T val;
       bytes_sent += sizeof(T);
       mpi::AllReduce(&send, &val, 1, op, model_comm);
@@ -218,16 +465,75 @@ namespace lbann
     /** Scalar array within-model all-reduce. */
     template <typename T>
     void model_allreduce(T* send, int count, T* recv, mpi::Op op = mpi::SUM) {
+      comm_trace_scope trace(tracer, "model_allreduce", "model",
+                             sizeof(T) * count);
       bytes_sent += count * sizeof(T);
       mpi::AllReduce(send, recv, count, op, model_comm);
       bytes_received += count * sizeof(T) * (get_procs_per_model() - 1);
     }
+    /**
+     * Lossy in-place sum of count entries over the processes in this model:
+     * a ring reduce-scatter and allgather where every message is compressed
+     * with c. Every process ends with the same values. With NONE this is an
+     * ordinary allreduce.
+     */
+    void model_sum_compressed(DataType* data, int count,
+                              intramodel_compression c);
+    /**
+     * Copy src into dst, which is distributed differently on the model grid,
+     * compressing every entry that moves to another process with c. This
+     * handles [MC,MR], [STAR,VC] and [VC,STAR]. Returns false, without
+     * touching dst, when c is NONE, there is one process per model, the
+     * distributions match or are not handled; the caller should then assign
+     * dst = src.
+     */
+    bool model_redistribute_compressed(const ElMat& src, ElMat& dst,
+                                       intramodel_compression c);
+    /** Compress error signals redistributed between layers with c. */
+    void set_error_signal_compression(intramodel_compression c) {
+      error_signal_compression = c;
+    }
+    inline intramodel_compression get_error_signal_compression() const {
+      return error_signal_compression;
+    }
+    /** Compress gradient sums over the processes of a model with c. */
+    void set_gradient_compression(intramodel_compression c) {
+      gradient_compression = c;
+    }
+    inline intramodel_compression get_gradient_compression() const {
+      return gradient_compression;
+    }
 
     /** Wait for a non-blocking request to complete. */
     template <typename T>
     void wait(mpi::Request<T>& req) {
+      comm_trace_scope trace(tracer, "wait", "request");
       mpi::Wait(req);
     }
+    /**
+     * Check, without blocking, whether a non-blocking request has completed.
+     * Calling this also lets MPI make progress on the request.
+     */
+    template <typename T>
+    bool test(mpi::Request<T>& req) {
+      return mpi::Test(req);
+    }
+    /**
+     * Start a helper thread that keeps driving MPI's progress engine, so
+     * non-blocking collectives advance while this process computes instead
+     * of only inside wait/test. The thread polls every interval_us
+     * microseconds. This requires MPI_THREAD_MULTIPLE; returns false (and
+     * does nothing) otherwise, in which case callers should call test
+     * periodically or use their MPI's own asynchronous progress (e.g.
+     * MPICH_ASYNC_PROGRESS=1).
+     */
+    bool start_progress_thread(int interval_us = 50);
+    /** Stop the progress thread, if running. */
+    void stop_progress_thread();
+    /** Return true if the progress thread is running. */
+    inline bool has_progress_thread() const {
+      return progress_thread.joinable();
+    }
 
     /** Barrier among the inter-model processes. */
     void intermodel_barrier();
@@ -239,6 +545,8 @@ namespace lbann
     /** Send a buffer to rank in model. */
     template <typename T>
     void send(const T* data, int count, int model, int rank) {
+      comm_trace_scope trace(tracer, "send", "world", sizeof(T) * count,
+                             get_world_rank(model, rank));
       bytes_sent += sizeof(T) * count;
       mpi::Send(data, count, get_world_rank(model, rank), mpi::COMM_WORLD);
     }
@@ -254,6 +562,8 @@ namespace lbann
     template <typename T>
     void nb_send(const T* data, int count, int model, int rank,
                  mpi::Request<T>& req) {
+      comm_trace_scope trace(tracer, "nb_send", "world", sizeof(T) * count,
+                             get_world_rank(model, rank));
       bytes_sent += sizeof(T) * count;
       mpi::ISend(data, count, get_world_rank(model, rank), mpi::COMM_WORLD, req);
     }
@@ -272,6 +582,8 @@ namespace lbann
 
     /** Corresponding receive to send. */
     template <typename T> void recv(T* data, int count, int model, int rank) {
+      comm_trace_scope trace(tracer, "recv", "world", sizeof(T) * count,
+                             get_world_rank(model, rank));
       mpi::Recv(data, count, get_world_rank(model, rank), mpi::COMM_WORLD);
       bytes_received += sizeof(T) * count;
     }
@@ -284,22 +596,58 @@ namespace lbann
     void recv(DistMat& mat, int model) { recv(mat, model, rank_in_model); }
     /** As above, but receive from anyone. */
     template <typename T> void recv(T* data, int count) {
+      comm_trace_scope trace(tracer, "recv", "world", sizeof(T) * count);
       mpi::Recv(data, count, mpi::ANY_SOURCE, mpi::COMM_WORLD);
       bytes_received += sizeof(T) * count;
     }
     void recv(Mat& mat);
     void recv(DistMat& mat);
 
+    /**
+     * Point-to-point messages for a parameter server. These use their own
+     * communicator, so a server thread probing for any incoming message
+     * never matches (and steals) other traffic on the world communicator.
+     */
+    template <typename T>
+    void ps_send(const T* data, int count, int model, int rank) {
+      comm_trace_scope trace(tracer, "ps_send", "ps", sizeof(T) * count,
+                             get_world_rank(model, rank));
+      bytes_sent += sizeof(T) * count;
+      MPI_Send(data, count, mpi::TypeMap<T>(), get_world_rank(model, rank),
+               PS_TAG, ps_comm.comm);
+    }
+    template <typename T> void ps_send(const T* data, int count, int model) {
+      ps_send(data, count, model, rank_in_model);
+    }
+    template <typename T> void ps_recv(T* data, int count, int model, int rank) {
+      comm_trace_scope trace(tracer, "ps_recv", "ps", sizeof(T) * count,
+                             get_world_rank(model, rank));
+      MPI_Recv(data, count, mpi::TypeMap<T>(), get_world_rank(model, rank),
+               PS_TAG, ps_comm.comm, MPI_STATUS_IGNORE);
+      bytes_received += sizeof(T) * count;
+    }
+    template <typename T> void ps_recv(T* data, int count, int model) {
+      ps_recv(data, count, model, rank_in_model);
+    }
+    /**
+     * Check, without blocking, for a parameter-server message from any
+     * process. If there is one, return true and set the model and rank it
+     * came from.
+     */
+    bool ps_probe_any(int& model, int& rank);
+
     /** Corresponding non-blocking receives. */
     template <typename T> void nb_recv(T* data, int count, int model, int rank,
                                        mpi::Request<T>& req) {
+      comm_trace_scope trace(tracer, "nb_recv", "world", sizeof(T) * count,
+                             get_world_rank(model, rank));
       mpi::IRecv(data, count, get_world_rank(model, rank), mpi::COMM_WORLD,
                  req);
       bytes_received += sizeof(T) * count;
     }
     template <typename T> void nb_recv(T* data, int count, int model,
                                        mpi::Request<T>& req) {
-      recv(data, count, model, rank_in_model, req);
+      nb_recv(data, count, model, rank_in_model, req);
     }
     void nb_recv(Mat& mat, int model, int rank, mpi::Request<DataType>& req);
     void nb_recv(DistMat& mat, int model, int rank, mpi::Request<DataType>& req);
@@ -310,12 +658,74 @@ namespace lbann
       nb_recv(mat, model, rank_in_model, req);
     }
     template <typename T> void nb_recv(T* data, int count, mpi::Request<T>& req) {
+      comm_trace_scope trace(tracer, "nb_recv", "world", sizeof(T) * count);
       mpi::IRecv(data, count, mpi::ANY_SOURCE, mpi::COMM_WORLD, req);
       bytes_received += sizeof(T) * count;
     }
     void nb_recv(Mat& mat, mpi::Request<DataType>& req);
     void nb_recv(DistMat& mat, mpi::Request<DataType>& req);
 
+    /**
+     * A persistent point-to-point request (MPI_Send_init/MPI_Recv_init).
+     * It stays bound to one buffer, count, type and peer, and restarting it
+     * skips the per-message request setup of nb_send/nb_recv. Callers keep
+     * one per recurring message (e.g. per ring step and layer).
+     */
+    struct persistent_request {
+      MPI_Request req = MPI_REQUEST_NULL;
+      const void* buf = nullptr;
+      int count = -1;
+      int peer = -1;
+      MPI_Datatype type = MPI_DATATYPE_NULL;
+    };
+    /**
+     * Start a persistent send of data to model, (re)binding preq first if
+     * the buffer, count, or destination changed since its last use.
+     */
+    template <typename T>
+    void persistent_send(const T* data, int count, int model,
+                         persistent_request& preq) {
+      const int peer = get_world_rank(model, rank_in_model);
+      comm_trace_scope trace(tracer, "persistent_send", "world",
+                             sizeof(T) * count, peer);
+      if (!persistent_matches(preq, data, count, peer, mpi::TypeMap<T>())) {
+        free_persistent(preq);
+        MPI_Send_init(data, count, mpi::TypeMap<T>(), peer, PERSISTENT_TAG,
+                      mpi::COMM_WORLD.comm, &(preq.req));
+        bind_persistent(preq, data, count, peer, mpi::TypeMap<T>());
+      }
+      bytes_sent += sizeof(T) * count;
+      MPI_Start(&(preq.req));
+    }
+    /** Corresponding persistent receive from model. */
+    template <typename T>
+    void persistent_recv(T* data, int count, int model,
+                         persistent_request& preq) {
+      const int peer = get_world_rank(model, rank_in_model);
+      comm_trace_scope trace(tracer, "persistent_recv", "world",
+                             sizeof(T) * count, peer);
+      if (!persistent_matches(preq, data, count, peer, mpi::TypeMap<T>())) {
+        free_persistent(preq);
+        MPI_Recv_init(data, count, mpi::TypeMap<T>(), peer, PERSISTENT_TAG,
+                      mpi::COMM_WORLD.comm, &(preq.req));
+        bind_persistent(preq, data, count, peer, mpi::TypeMap<T>());
+      }
+      MPI_Start(&(preq.req));
+      bytes_received += sizeof(T) * count;
+    }
+    /** Wait for a started persistent request; it can then be restarted. */
+    void wait(persistent_request& preq) {
+      comm_trace_scope trace(tracer, "wait", "world", 0, preq.peer);
+      MPI_Wait(&(preq.req), MPI_STATUS_IGNORE);
+    }
+    /** Release a persistent request (it must not be active). */
+    static void free_persistent(persistent_request& preq) {
+      if (preq.req != MPI_REQUEST_NULL) {
+        MPI_Request_free(&(preq.req));
+      }
+      bind_persistent(preq, nullptr, -1, -1, MPI_DATATYPE_NULL);
+    }
+
     /** Determine the size (count) of an incoming message. */
     template <typename T> int get_count(int model, int rank) {
       MPI_Status status;
@@ -331,6 +741,7 @@ namespace lbann
      */
     template <typename T>
     void broadcast(T* data, int count, std::vector<int>& dests, int root) {
+      comm_trace_scope trace(tracer, "broadcast", "group", sizeof(T) * count);
       mpi::Group bcast_group;
       mpi::Comm bcast_comm;
       std::vector<int> ranks;
@@ -361,6 +772,22 @@ namespace lbann
     inline size_t get_bytes_sent() const { return bytes_sent; }
     /** Return the number of bytes received. */
     inline size_t get_bytes_received() const { return bytes_received; }
+    /**
+     * Start tracing the communication calls made through this communicator
+     * (including the quantizer's algorithms), keeping up to max_events per
+     * process. Collective over all processes, so that every trace starts
+     * from (nearly) the same time.
+     */
+    void enable_tracing(size_t max_events = 1 << 20);
+    /** Stop tracing; recorded calls are kept. */
+    void disable_tracing() { tracer.disable(); }
+    /** Return the tracer, e.g. to trace algorithms built on this. */
+    inline comm_tracer& get_tracer() { return tracer; }
+    /**
+     * Write this process's trace as Chrome trace JSON to
+     * prefix.<world rank>.json.
+     */
+    void write_trace(const std::string& prefix) const;
     inline void reset_stats_counters() {
       num_model_barriers = 0;
       num_intermodel_barriers = 0;
@@ -375,6 +802,70 @@ namespace lbann
     mpi::Comm intermodel_comm;
     /** Communicator for every process in the same compute node. */
     mpi::Comm node_comm;
+    /** Inter-model peers in the same compute node. */
+    mpi::Comm intermodel_node_comm;
+    /**
+     * Inter-model peers with the same rank in intermodel_node_comm on every
+     * node; lane 0 holds the node leaders.
+     */
+    mpi::Comm intermodel_lane_comm;
+    /** Duplicate of the world communicator for parameter-server messages. */
+    mpi::Comm ps_comm;
+    /** Number of compute nodes spanned by the inter-model communicator. */
+    int num_intermodel_nodes;
+    /** Whether every node holds the same number of inter-model peers. */
+    bool uniform_intermodel_nodes;
+    /** Whether intermodel sums use the hierarchical allreduce. */
+    bool use_hierarchical_allreduce;
+    /** Scratch space for the hierarchical allreduce. */
+    std::vector<DataType> hierarchical_send_buf;
+    std::vector<DataType> hierarchical_recv_buf;
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+    /** Whether the hierarchical allreduce uses intermodel_node_window. */
+    bool use_shm_allreduce;
+    /** Shared-memory window over intermodel_node_comm (grown on demand). */
+    shared_memory_window* intermodel_node_window;
+    /** hierarchical_intermodel_sum through intermodel_node_window. */
+    void shm_hierarchical_intermodel_sum(DataType* data, int count);
+#endif
+#if LBANN_HAS_RMA_WINDOWS
+    /** Window over intermodel_comm for the one-sided calls (grown on demand). */
+    rma_window* intermodel_rma_window;
+    /** Zeros for rma_drain. */
+    std::vector<DataType> rma_zeros;
+    /** Collectively (re)allocate intermodel_rma_window for count entries. */
+    void setup_rma_window(int count);
+#endif
+    /** Wire precision of the inter-model matrix collectives. */
+    payload_precision payload_prec;
+    /** MPI datatype (one 16-bit value) and sum ops for FP16/BF16 payloads. */
+    MPI_Datatype payload_type;
+    MPI_Op half_sum_op;
+    MPI_Op bfloat16_sum_op;
+    /** Scratch space for reduced-precision payloads. */
+    std::vector<uint16_t> payload_buf;
+    /** Reduced-precision sum of a height x width block with leading dim ldim. */
+    void reduced_precision_sum(DataType* data, Int height, Int width,
+                               Int ldim, payload_precision p);
+    /** Reduced-precision broadcast of a block from root. */
+    void reduced_precision_broadcast(DataType* data, Int height, Int width,
+                                     Int ldim, int root, payload_precision p);
+    /** Opt-in compression of intra-model transfers (default NONE). */
+    intramodel_compression error_signal_compression;
+    intramodel_compression gradient_compression;
+    /** Scratch space for the compressed intra-model transfers. */
+    std::vector<unsigned char> compressed_send_buf;
+    std::vector<unsigned char> compressed_recv_buf;
+    std::vector<DataType> redistribute_send_buf;
+    std::vector<DataType> redistribute_recv_buf;
+    /** In-flight chunks of intermodel_broadcast_compressed. */
+    static const int BROADCAST_SLOTS = 4;
+    /** Scratch space for intermodel_broadcast_compressed's chunks. */
+    std::vector<unsigned char> broadcast_buf;
+    /** Helper thread for asynchronous MPI progress. */
+    std::thread progress_thread;
+    /** Set to stop the progress thread. */
+    std::atomic<bool> progress_thread_stop;
     /** Grid for this model. */
     Grid* grid;
     /** Number of models. */
@@ -385,20 +876,56 @@ namespace lbann
     int model_rank;
     /** Rank of this process within its model. */
     int rank_in_model;
+    /** Placement policy of processes into models. */
+    rank_placement placement;
+    /** World rank of each (model, rank in model), at model*ppm + rank. */
+    std::vector<int> placed_world_ranks;
+    /** Index into placed_world_ranks of each world rank. */
+    std::vector<int> world_rank_slots;
+    /** Compute node of each world rank. */
+    std::vector<int> world_rank_nodes;
+    /** Number of compute nodes. */
+    int num_nodes;
     /** Number of processers per compute node. */
     int procs_per_node;
     /** Rank of this process within its compute node. */
     int rank_in_node;
     
-    // Various statistics counters.
-    size_t num_model_barriers;
-    size_t num_intermodel_barriers;
-    size_t num_global_barriers;
-    size_t bytes_sent;
-    size_t bytes_received;
+    // Various statistics counters. These are atomic since communication
+    // may also be done from helper threads (e.g. overlapped reductions).
+    std::atomic<size_t> num_model_barriers;
+    std::atomic<size_t> num_intermodel_barriers;
+    std::atomic<size_t> num_global_barriers;
+    std::atomic<size_t> bytes_sent;
+    std::atomic<size_t> bytes_received;
+    /** Communication trace (disabled by default). */
+    comm_tracer tracer;
 
     /** MPI tag for point-to-point communication. (Unused) */
     static const int PT2PT_TAG = 42;
+    /**
+     * MPI tag for persistent point-to-point requests. Elemental's sends use
+     * tag 0, so both sides of a message must agree on using persistent
+     * requests.
+     */
+    static const int PERSISTENT_TAG = 43;
+    /** MPI tag for intermodel_broadcast_compressed's chunks. */
+    static const int BROADCAST_TAG = 44;
+    /** MPI tag for parameter-server messages (on ps_comm). */
+    static const int PS_TAG = 45;
+    static bool persistent_matches(const persistent_request& preq,
+                                   const void* buf, int count, int peer,
+                                   MPI_Datatype type) {
+      return preq.req != MPI_REQUEST_NULL && preq.buf == buf &&
+        preq.count == count && preq.peer == peer && preq.type == type;
+    }
+    static void bind_persistent(persistent_request& preq, const void* buf,
+                                int count, int peer, MPI_Datatype type) {
+      preq.buf = buf;
+      preq.count = count;
+      preq.peer = peer;
+      preq.type = type;
+    }
     /** Create a new group from a list of ranks. (Needs to be freed.) */
     inline void create_group(std::vector<int>& ranks, mpi::Group& g) {
       mpi::Group world_group;
@@ -407,11 +934,16 @@ namespace lbann
     }
 
     /** Setup communicator for processes in the same compute node.
-     *  We obtain a string specifying the compute node. The string is
+     *  With MPI-3 this is the shared-memory split (MPI_COMM_TYPE_SHARED).
+     *  Otherwise we obtain a string specifying the compute node. The string is
      *  hashed (with salt) and used to split the communicators. To
      *  avoid hash collisions, the splitting procedure is repeated
      *  with a different salt. */
     void setup_node_comm();
+    /** Number the compute nodes and assign processes to models. */
+    void setup_placement();
+    /** Split the inter-model communicator by compute node and into lanes. */
+    void setup_intermodel_node_comms();
     
   };
 }
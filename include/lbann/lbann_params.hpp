@@ -71,7 +71,7 @@ namespace lbann
     /// Learning rate
     float LearnRate;
     /// Learning method
-    /** 1 - Adagrad, 2 - RMSprop, 3 - Adam */
+    /** 1 - Adagrad, 2 - RMSprop, 3 - Adam, 5 - LARS, 6 - LAMB, else SGD */
     int LearnRateMethod;
     /// How much does the learning rate decay
     float LrDecayRate;
@@ -129,6 +129,50 @@ namespace lbann
     int IntermodelCommMethod;
     /// Number of processes to use in each model (if using multiple).
     int ProcsPerModel;
+    /// Placement of processes into models (0 = contiguous, 1 = packed by node, 2 = striped across models).
+    int RankPlacement;
+    /// Pack layer parameters into one contiguous buffer per model.
+    bool FlatParams;
+    /// Shard the (flat) optimizer state across models.
+    bool ShardOptimizer;
+    /// Bits per optimizer state entry (32 = full precision; 8 or 16 = block-quantized).
+    int OptimizerStateBits;
+    /// Overlap per-layer inter-model gradient reduction with backprop.
+    bool OverlapImcomm;
+    /// Maximum bytes per fused gradient bucket (0 = no bucketing).
+    int ImcommBucketSize;
+    /// Use the node-aware hierarchical allreduce for inter-model sums.
+    bool HierarchicalAllreduce;
+    /// Custom allreduce algorithm (0 = auto, 1 = ring, 2 = recursive doubling, 3 = Rabenseifner).
+    int AllreduceAlgorithm;
+    /// Time the custom allreduce algorithms at startup to pick crossover points.
+    bool AutotuneAllreduce;
+    /// Run a helper thread that drives MPI progress for non-blocking operations.
+    bool AsyncProgress;
+    /// Segment size in bytes for the pipelined quantized reduce-scatter (0 = off).
+    int RingSegmentSize;
+    /// Keep one in this many gradient entries with top-k sparsification.
+    int TopKProportion;
+    /// Bits per entry for QSGD quantization (2, 4 or 8).
+    int QSGDBits;
+    /// Compress error signals moved within a model (0 = none, 1 = fp16, 2 = 8-bit block-scaled).
+    int ErrorSignalCompression;
+    /// Compress gradient sums within a model (0 = none, 1 = fp16, 2 = 8-bit block-scaled).
+    int GradientCompression;
+    /// Wire precision of inter-model sums and broadcasts (0 = fp32, 1 = fp16, 2 = bf16).
+    int PayloadPrecision;
+    /// Local optimizer steps between model averages (0 = sum gradients every step).
+    int LocalSGDSteps;
+    /// Largest number of local steps when adapting it (0 = fixed).
+    int LocalSGDMaxSteps;
+    /// Staleness bound for asynchronous parameter-server SGD (-1 = synchronous).
+    int AsyncStaleness;
+    /// Gossip topology for decentralized averaging (-1 = off, 0 = ring, 1 = random).
+    int GossipTopology;
+    /// Write per-rank Chrome traces of communication to <prefix>.<rank>.json ("" = off).
+    std::string CommTrace;
+    /// Broadcast model 0's weights to the other models after setup.
+    bool BroadcastModel;
   };
 
   /// Performance parameters
@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_flat_params .hpp .cpp - Contiguous per-model parameter buffers
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_FLAT_PARAMS_HPP_INCLUDED
+#define LBANN_FLAT_PARAMS_HPP_INCLUDED
+
+#include "lbann/lbann_base.hpp"
+#include "lbann/lbann_comm.hpp"
+#include "lbann/layers/lbann_layer.hpp"
+#include "lbann/optimizers/lbann_optimizer.hpp"
+#include "lbann/io/lbann_persist.hpp"
+#include <vector>
+#include <unordered_set>
+
+namespace lbann {
+
+/**
+ * Pack the weights and gradients of a model's layers into one contiguous
+ * buffer each.
+ * The local part of every flattened layer's weight (and gradient) matrix is
+ * re-attached to a slice of the flat buffer, so the layers keep working on
+ * their usual DistMats while the model can operate on all parameters at once.
+ * The flat buffers are exposed as [STAR,VC] matrices with one column per
+ * process in the model: each process's column is exactly its local slice
+ * (padded to the longest slice in the model). A single optimizer created with
+ * matrix_format::STAR_VC holds the optimizer state for all of them, so that
+ * is contiguous as well.
+ * This lets the optimizer step, the inter-model gradient allreduce, and
+ * checkpoint I/O each be a single operation instead of one per layer.
+ * Only layers whose update is a plain optimizer step on [MC,MR] weights
+ * (fully-connected and softmax) are flattened; others are left alone.
+ * Flattened layers keep their optimizers only for the learning rate: their
+ * state is freed, so they must be stepped through update() alone.
+ *
+ * In sharded mode, the optimizer state is additionally split across models
+ * (as in ZeRO): each process's slice is divided into one shard per model, the
+ * gradients are reduce-scattered over the inter-model communicator so that
+ * each model gets the summed gradient of its shard, each model updates only
+ * its shard, and the updated weights are allgathered. This divides optimizer
+ * memory by the number of models and replaces the gradient allreduce, so
+ * inter-model gradient summation must not also be done elsewhere.
+ */
+class flat_params {
+public:
+  flat_params(lbann_comm* comm, Optimizer_factory* optimizer_fac,
+              bool sharded = false);
+  ~flat_params();
+
+  /**
+   * Flatten the parameters of the eligible layers.
+   * This must be called after the layers have been set up. The current
+   * weights and gradients are preserved.
+   */
+  void setup(std::vector<Layer*>& layers);
+  /** Return true if layer is part of the flat buffers. */
+  bool is_flattened(const Layer* layer) const {
+    return m_flattened.find(layer) != m_flattened.end();
+  }
+  /** Return the flattened layers, in the order they are packed. */
+  const std::vector<Layer*>& get_layers() const { return m_layers; }
+
+  /** Return the flat weights ([STAR,VC], one column per process). */
+  StarVCMat& get_weights() { return m_weights; }
+  /** Return the flat gradients ([STAR,VC], one column per process). */
+  StarVCMat& get_gradients() { return m_gradients; }
+  /** Return this process's slice of the flat weights. */
+  Mat& get_local_weights() { return m_local_weights; }
+  /** Return this process's slice of the flat gradients. */
+  Mat& get_local_gradients() { return m_local_gradients; }
+  /** Return the number of locally-owned parameters (excluding padding). */
+  El::Int get_local_size() const { return m_local_size; }
+  /** Return the flat optimizer. */
+  Optimizer* get_optimizer() const { return m_optimizer; }
+  /** Return true if the optimizer state is sharded across models. */
+  bool is_sharded() const { return m_sharded; }
+  /** Return the number of entries in each model's shard. */
+  El::Int get_shard_size() const { return m_shard_size; }
+
+  /**
+   * Apply one optimizer step to every flattened layer.
+   * All flattened layers are stepped with one learning rate, taken from
+   * their optimizers so that learning rate schedules applied to the layers
+   * still take effect; it is an error for them to disagree.
+   * In sharded mode this also sums the gradients across models.
+   */
+  void update();
+
+  /**
+   * Write the flat weights and optimizer state to a checkpoint.
+   * The optimizer state is stored under layer index -1, or -1-k for model
+   * k's shard in sharded mode.
+   */
+  bool save_to_checkpoint_shared(persist& p);
+  /** Read the flat weights and optimizer state from a checkpoint. */
+  bool load_from_checkpoint_shared(persist& p);
+
+private:
+  lbann_comm* comm;
+  /** Factory used to create the flat optimizer. */
+  Optimizer_factory* m_optimizer_fac;
+  /** Optimizer for the flat buffers. */
+  Optimizer* m_optimizer;
+  /** Flattened layers, in packing order. */
+  std::vector<Layer*> m_layers;
+  /** Set of flattened layers, for fast lookup. */
+  std::unordered_set<const Layer*> m_flattened;
+  /** Storage for the local slice of the weights. */
+  Mat m_local_weights;
+  /** Storage for the local slice of the gradients. */
+  Mat m_local_gradients;
+  /** Distributed view of the flat weights. */
+  StarVCMat m_weights;
+  /** Distributed view of the flat gradients. */
+  StarVCMat m_gradients;
+  /** Number of locally-owned parameters. */
+  El::Int m_local_size;
+  /** Whether the optimizer state is sharded across models. */
+  bool m_sharded;
+  /** Entries per shard (equal to the padded slice when not sharded). */
+  El::Int m_shard_size;
+  /** Storage for this model's shard of the summed gradients. */
+  Mat m_local_shard_gradients;
+  /** Distributed view of this model's shard of the weights. */
+  StarVCMat m_shard_weights;
+  /** Distributed view of this model's shard of the gradients. */
+  StarVCMat m_shard_gradients;
+
+  /** Return true if layer can be flattened. */
+  bool can_flatten(Layer* layer) const;
+  /**
+   * Copy the local data of mat into buf and re-attach mat to it.
+   * Returns the number of entries used.
+   */
+  El::Int attach_to_buffer(ElMat& mat, DataType* buf);
+  /** Return the layer index the optimizer state is checkpointed under. */
+  int checkpoint_index() const {
+    return m_sharded ? -1 - comm->get_model_rank() : -1;
+  }
+};
+
+}  // namespace lbann
+
+#endif  // LBANN_FLAT_PARAMS_HPP_INCLUDED
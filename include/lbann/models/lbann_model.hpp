@@ -44,6 +44,7 @@ namespace lbann {
 
 // Forward-declare this.
 class lbann_callback;
+class flat_params;
 
 /**
  * Base class for LBANN models.
@@ -64,6 +65,11 @@ public:
 
   /** Return the model's layers. */
   virtual std::vector<Layer*>& get_layers() = 0;
+  /**
+   * Return the model's flattened parameter buffers, or nullptr if the model
+   * does not use them.
+   */
+  virtual flat_params* get_flat_params() { return nullptr; }
 
   /** Get the model's comm. */
   inline lbann_comm* get_comm() const { return comm; }
@@ -185,6 +191,7 @@ protected:
   void do_layer_backward_prop_begin_cbs(Layer* l);
   void do_model_backward_prop_end_cbs();
   void do_layer_backward_prop_end_cbs(Layer* l);
+  void do_layer_update_begin_cbs(Layer* l);
   /// Evaluation phases (validation / testing)
   void do_batch_evaluate_begin_cbs();
   void do_batch_evaluate_end_cbs();
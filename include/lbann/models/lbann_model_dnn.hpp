@@ -71,6 +71,9 @@ namespace lbann
     /// Evaluation step on one mini-batch
     bool evaluate_mini_batch();
 
+    /// Flattened layers are stepped together in train_mini_batch
+    bool supports_flat_params() const { return true; }
+
     /// Returns the model's name
     const string & name() { return m_name; }
 
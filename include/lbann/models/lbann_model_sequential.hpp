@@ -35,6 +35,7 @@
 #include "lbann/data_readers/lbann_data_reader.hpp"
 #include "lbann/layers/lbann_layer_factory.hpp"
 #include "lbann/io/lbann_persist.hpp"
+#include "lbann/models/lbann_flat_params.hpp"
 #include <vector>
 #include <string>
 
@@ -81,6 +82,25 @@ class sequential_model : public model
     /// Set layers
     virtual void set_layers(vector<Layer*>& layers) {m_layers = layers;}
 
+    /// Pack parameters into contiguous buffers on setup (see flat_params)
+    /** If sharded, also shard the optimizer state across models. */
+    void set_use_flat_params(bool use, bool sharded=false) {
+      m_use_flat_params = use;
+      m_shard_optimizer = sharded;
+    }
+    /// Get the flattened parameter buffers, if any
+    virtual flat_params* get_flat_params() { return m_flat_params; }
+    /// Whether training steps flattened layers through flat_params
+    virtual bool supports_flat_params() const { return false; }
+
+    /// Broadcast every layer's weights from model root to the other models
+    /** The local weights are packed into one buffer and sent with
+     *  lbann_comm::intermodel_broadcast_compressed, and the world master
+     *  reports the time taken and the compression achieved. Use this to
+     *  start all models from the same initial or restored weights; the
+     *  optimizer state is not sent. Collective over all models. */
+    void broadcast_weights(int root=0);
+
     /// Add layer to sequential model
     virtual uint add(const std::string layer_name,
                      int layer_dim,
@@ -146,6 +166,12 @@ class sequential_model : public model
     layer_factory* layer_fac;
     /// Optimizer factory
     Optimizer_factory* optimizer_fac;
+    /// Whether to flatten parameters on setup
+    bool m_use_flat_params;
+    /// Whether to shard the flat optimizer state across models
+    bool m_shard_optimizer;
+    /// Flattened parameter buffers (nullptr when not in use)
+    flat_params* m_flat_params;
 
   };
 }
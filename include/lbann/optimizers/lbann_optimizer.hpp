@@ -52,6 +52,17 @@ namespace lbann
     virtual float get_learning_rate() const { return 0.0f; }
     /** Set the optimizer's learning rate. */
     virtual void set_learning_rate(float _lr) {}
+    /**
+     * Return the optimizer's full-precision state matrices (e.g. moment
+     * estimates), if any. These have the same shape as the weights.
+     */
+    virtual std::vector<ElMat*> get_state_matrices() { return {}; }
+    /**
+     * Release the optimizer's state and scratch matrices, when another
+     * optimizer steps these weights instead. setup() must be called again
+     * before the next update.
+     */
+    virtual void free_state() {}
     virtual bool saveToCheckpoint(int fd, const char* filename, uint64_t* bytes) {
       return false;
     }
@@ -74,6 +85,14 @@ namespace lbann
 
   };
 
+  /**
+   * Compute the 2-norms of a and b in one pass over the local data and a
+   * single allreduce. a and b must have the same size and distribution.
+   * This is used for the per-layer trust ratios of LARS and LAMB.
+   */
+  void fused_two_norms(const ElMat& a, const ElMat& b,
+                       DataType& norm_a, DataType& norm_b);
+
   class Optimizer_factory {
   public:
     Optimizer_factory() {}
@@ -36,6 +36,7 @@
 #define LBANN_OPTIMIZER_ADAGRAD_HPP
 
 #include "lbann/optimizers/lbann_optimizer.hpp"
+#include "lbann/optimizers/lbann_optimizer_state.hpp"
 #include <sys/stat.h>
 
 namespace lbann
@@ -52,6 +53,8 @@ namespace lbann
     _DistMat     WB_D_Cache;     // Cache of Weights and Bias Gradient (current time t - 1)
     _DistMat     WB_D_Temp;      // Temporary for Weights and Bias Gradient computation
     _DistMat     WB_D_Temp2;     // Temporary for Weights and Bias Gradient computation
+    int          state_bits;     // Bits per cache entry (32 for unquantized)
+    block_quantized_state WB_D_Cache_q; // Block-quantized cache (when state_bits < 32)
 
   private:
     static inline DataType _sq(const DataType& x) { return (x * x); }
@@ -60,14 +63,16 @@ namespace lbann
   public:
 
     /// Constructor
-    Adagrad(lbann_comm* comm, float lr, float epsilon)
+    Adagrad(lbann_comm* comm, float lr, float epsilon, int state_bits = 32)
       : lr(lr), epsilon(epsilon), comm(comm),
         WB_D_Cache(comm->get_model_grid()),
         WB_D_Temp(comm->get_model_grid()),
-        WB_D_Temp2(comm->get_model_grid()) {
+        WB_D_Temp2(comm->get_model_grid()),
+        state_bits(state_bits),
+        WB_D_Cache_q(std::min(state_bits, 16)) {
       set_name("adagrad");
       if (comm->am_model_master()) {
-        printf("Initializing Adagrad optimizer with lr=%f and epsilon=%f\n", lr, epsilon);
+        printf("Initializing Adagrad optimizer with lr=%f, epsilon=%f, and state_bits=%d\n", lr, epsilon, state_bits);
       }
     }
 
@@ -83,6 +88,11 @@ namespace lbann
       if (comm->am_model_master()) {
         printf("Setting up Adagrad optimizer with cache size %d x %d\n", num_neurons, input_dim);
       }
+      if (state_bits < 32) {
+        // Sized on the first update; the temporaries are not needed.
+        WB_D_Cache_q.setup(0);
+        return;
+      }
       Zeros(WB_D_Cache, num_neurons, input_dim);
       Zeros(WB_D_Temp, num_neurons, input_dim);
       Zeros(WB_D_Temp2, num_neurons, input_dim);  
@@ -92,6 +102,21 @@ namespace lbann
     }
     
     void update_weight_bias_matrix(ElMat& WB_D, ElMat& WB) {
+      if (state_bits < 32) {
+        // Fused update on the dequantized cache, one block at a time.
+        const El::Int local_size = WB_D.LocalHeight() * WB_D.LocalWidth();
+        if (WB_D_Cache_q.get_num_entries() != local_size) {
+          WB_D_Cache_q.setup(local_size);
+        }
+        const DataType _lr = lr;
+        apply_blockwise(WB_D, WB, WB_D_Cache_q, nullptr,
+                        [_lr] (DataType& g, DataType& w,
+                               DataType& cache, DataType&) {
+                          cache += g * g;
+                          w -= _lr * g * _sqrt(cache);
+                        });
+        return;
+      }
       Copy(WB_D, WB_D_Temp);
       // Square each entry of the WB_D matrix
       EntrywiseMap(WB_D_Temp, std::function<DataType(const DataType&)>(_sq));
@@ -122,6 +147,19 @@ namespace lbann
       return true;
     }
 
+    void free_state() {
+      WB_D_Cache.Empty();
+      WB_D_Temp.Empty();
+      WB_D_Temp2.Empty();
+    }
+
+    std::vector<ElMat*> get_state_matrices() {
+      if (state_bits < 32) {
+        return {};
+      }
+      return {&WB_D_Cache};
+    }
+
     bool saveToCheckpointShared(persist& p, int Index) {
       char name[512];
     
@@ -131,6 +169,12 @@ namespace lbann
         p.write_float(persist_type::train, name, lr);
       }
     
+      // quantized cache is written in compressed form
+      if (state_bits < 32) {
+        sprintf(name, "L%d_adagrad_q%d", Index, state_bits);
+        return WB_D_Cache_q.save_to_checkpoint_shared(p, name);
+      }
+
       // build the name of the checkpoint file
       sprintf(name, "L%d_adagrad_%dx%d", Index, WB_D_Cache.Height(), WB_D_Cache.Width());
       p.write_distmat(persist_type::train, name, (DistMat*)&WB_D_Cache);
@@ -148,6 +192,12 @@ namespace lbann
       }
       MPI_Bcast(&lr, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
     
+      // quantized cache is read in compressed form
+      if (state_bits < 32) {
+        sprintf(name, "L%d_adagrad_q%d", Index, state_bits);
+        return WB_D_Cache_q.load_from_checkpoint_shared(p, name);
+      }
+
       // build the name of the checkpoint file
       sprintf(name, "L%d_adagrad_%dx%d.bin", Index, WB_D_Cache.Height(), WB_D_Cache.Width());
       p.read_distmat(persist_type::train, name, (DistMat*)&WB_D_Cache);
@@ -159,7 +209,7 @@ namespace lbann
 
   class Adagrad_factory : public Optimizer_factory {
   public:
-    Adagrad_factory(lbann_comm* comm, float lr=0.01, float epsilon=1e-6);
+    Adagrad_factory(lbann_comm* comm, float lr=0.01, float epsilon=1e-6, int state_bits=32);
     ~Adagrad_factory();
     Optimizer *create_optimizer(matrix_format format=matrix_format::MC_MR);
     const string name() { return "adagrad"; }
@@ -168,6 +218,7 @@ namespace lbann
     lbann_comm* comm;
     float lr;
     float epsilon;
+    int state_bits;
   };
 
 }
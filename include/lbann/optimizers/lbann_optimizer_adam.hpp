@@ -32,6 +32,7 @@
 #define LBANN_OPTIMIZER_ADAM_HPP
 
 #include "lbann/optimizers/lbann_optimizer.hpp"
+#include "lbann/optimizers/lbann_optimizer_state.hpp"
 
 namespace lbann {
 
@@ -44,17 +45,22 @@ public:
    * @param rho1 Exponential decay rate of the first moment estimate.
    * @param rho2 Exponential decay rate of the second moment estimate.
    * @param eps Small constant for numerical stability.
+   * @param state_bits Bits per entry for the moments: 32 stores them as
+   * DataType, 8 or 16 stores them block-quantized.
    */
   Adam(lbann_comm* comm, float lr, float rho1 = 0.9f, float rho2 = 0.999f,
-       float eps = 1e-8f) :
+       float eps = 1e-8f, int state_bits = 32) :
     comm(comm), lr(lr), rho1(rho1), rho2(rho2), eps(eps),
-    cur_rho1(1.0f), cur_rho2(1.0f),
     moment1_hist(comm->get_model_grid()),
-    moment2_hist(comm->get_model_grid()) {
+    moment2_hist(comm->get_model_grid()),
+    cur_rho1(1.0f), cur_rho2(1.0f), state_bits(state_bits),
+    moment1_q(std::min(state_bits, 16)),
+    moment2_q(std::min(state_bits, 16)) {
     set_name("adam");
     if (comm->am_model_master()) {
       std::cout << "Initializing Adam optimizer with lr=" << lr <<
-        " eps=" << eps << " rho1=" << rho1 << " rho2=" << rho2 << std::endl;
+        " eps=" << eps << " rho1=" << rho1 << " rho2=" << rho2 <<
+        " state_bits=" << state_bits << std::endl;
     }
   }
   ~Adam() {
@@ -63,6 +69,12 @@ public:
   }
 
   void setup(int input_dim, int num_neurons) {
+    if (quantized_state()) {
+      // Sized on the first update, once the local size is known.
+      moment1_q.setup(0);
+      moment2_q.setup(0);
+      return;
+    }
     Zeros(moment1_hist, num_neurons, input_dim);
     Zeros(moment2_hist, num_neurons, input_dim);
   }
@@ -73,6 +85,24 @@ public:
     cur_rho2 *= rho2;
     // Compute the correction factor.
     const float correction = std::sqrt(1.0f - cur_rho2) / (1.0f - cur_rho1);
+    if (quantized_state()) {
+      const El::Int local_size = WB_D.LocalHeight() * WB_D.LocalWidth();
+      if (moment1_q.get_num_entries() != local_size) {
+        moment1_q.setup(local_size);
+        moment2_q.setup(local_size);
+      }
+      const DataType step = lr * correction;
+      const DataType _rho1 = rho1, _rho2 = rho2, _eps = eps;
+      apply_blockwise(
+        WB_D, WB, moment1_q, &moment2_q,
+        [step, _rho1, _rho2, _eps] (DataType& g, DataType& w,
+                                    DataType& m1, DataType& m2) {
+          m1 = _rho1 * m1 + (1.0f - _rho1) * g;
+          m2 = _rho2 * m2 + (1.0f - _rho2) * g * g;
+          w -= step * m1 / std::sqrt(m2 + _eps);
+        });
+      return;
+    }
     // Update the biased first and second moments.
     Scale(rho1, moment1_hist);
     Axpy(1.0f - rho1, WB_D, moment1_hist);
@@ -94,6 +124,28 @@ public:
 
   void set_learning_rate(float _lr) { lr = _lr; }
 
+  /** Return the number of bytes used to store the moments. */
+  size_t get_state_bytes() const {
+    if (quantized_state()) {
+      return moment1_q.get_bytes() + moment2_q.get_bytes();
+    }
+    return sizeof(DataType) *
+      (moment1_hist.LocalHeight() * moment1_hist.LocalWidth() +
+       moment2_hist.LocalHeight() * moment2_hist.LocalWidth());
+  }
+
+  void free_state() {
+    moment1_hist.Empty();
+    moment2_hist.Empty();
+  }
+
+  std::vector<ElMat*> get_state_matrices() {
+    if (quantized_state()) {
+      return {};
+    }
+    return {&moment1_hist, &moment2_hist};
+  }
+
   bool saveToCheckpointShared(persist& p, int Index) {
     char name[512];
   
@@ -115,6 +167,15 @@ public:
       p.write_float(persist_type::train, name, cur_rho2);
     }
   
+    // quantized moments are written in compressed form
+    if (quantized_state()) {
+      sprintf(name, "L%d_adam_moment1_q%d", Index, state_bits);
+      bool rc1 = moment1_q.save_to_checkpoint_shared(p, name);
+      sprintf(name, "L%d_adam_moment2_q%d", Index, state_bits);
+      bool rc2 = moment2_q.save_to_checkpoint_shared(p, name);
+      return (rc1 && rc2);
+    }
+
     // checkpoint matrix for first moment
     sprintf(name, "L%d_adam_moment1_%dx%d",
       Index, moment1_hist.Height(), moment1_hist.Width());
@@ -152,6 +213,15 @@ public:
     }
     MPI_Bcast(&cur_rho2, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
   
+    // quantized moments are read in compressed form
+    if (quantized_state()) {
+      sprintf(name, "L%d_adam_moment1_q%d", Index, state_bits);
+      bool rc1 = moment1_q.load_from_checkpoint_shared(p, name);
+      sprintf(name, "L%d_adam_moment2_q%d", Index, state_bits);
+      bool rc2 = moment2_q.load_from_checkpoint_shared(p, name);
+      return (rc1 && rc2);
+    }
+
     // checkpoint matrix for first moment
     sprintf(name, "L%d_adam_moment1_%dx%d.bin",
       Index, moment1_hist.Height(), moment1_hist.Width());
@@ -183,12 +253,21 @@ private:
   float cur_rho1;
   /** Current decay for the second moment. */
   float cur_rho2;
+  /** Bits per moment entry (32 for unquantized). */
+  int state_bits;
+  /** Block-quantized first moment (when state_bits < 32). */
+  block_quantized_state moment1_q;
+  /** Block-quantized second moment (when state_bits < 32). */
+  block_quantized_state moment2_q;
+
+  /** Return true if the moments are stored block-quantized. */
+  bool quantized_state() const { return state_bits < 32; }
 };
 
 class Adam_factory : public Optimizer_factory {
 public:
   Adam_factory(lbann_comm* comm, float lr, float rho1 = 0.9f,
-               float rho2 = 0.999f, float eps = 1e-8f);
+               float rho2 = 0.999f, float eps = 1e-8f, int state_bits = 32);
   ~Adam_factory();
   Optimizer* create_optimizer(matrix_format format = matrix_format::MC_MR);
   const string name() { return "adam"; }
@@ -198,6 +277,7 @@ private:
   float rho1;
   float rho2;
   float eps;
+  int state_bits;
 };
 
 }  // namespace lbann
@@ -0,0 +1,254 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_optimizer_lamb .hpp .cpp - Adam with layer-wise adaptive moments
+// Reference:
+// You, Y., et al. 2019. Large Batch Optimization for Deep Learning: Training
+// BERT in 76 minutes.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_OPTIMIZER_LAMB_HPP
+#define LBANN_OPTIMIZER_LAMB_HPP
+
+#include "lbann/optimizers/lbann_optimizer.hpp"
+
+namespace lbann {
+
+/**
+ * Adam with decoupled weight decay, where each layer's step is scaled by the
+ * trust ratio ||W|| / ||r|| between the weights and the Adam update r.
+ * Like LARS, this keeps large effective mini-batches stable.
+ * The trust ratio is computed over whatever matrix the optimizer is given, so
+ * it is only layer-wise when the layer is not part of a flat_params buffer.
+ */
+template <class _DistMat>
+class LAMB : public Optimizer {
+public:
+  /**
+   * Constructor.
+   * @param lr Learning rate (step size).
+   * @param beta1 Exponential decay rate of the first moment estimate.
+   * @param beta2 Exponential decay rate of the second moment estimate.
+   * @param weight_decay Decoupled weight decay coefficient.
+   * @param eps Small constant for numerical stability.
+   */
+  LAMB(lbann_comm* comm, float lr, float beta1 = 0.9f, float beta2 = 0.999f,
+       float weight_decay = 0.01f, float eps = 1e-6f) :
+    comm(comm), lr(lr), beta1(beta1), beta2(beta2),
+    weight_decay(weight_decay), eps(eps),
+    cur_beta1(1.0f), cur_beta2(1.0f), trust_ratio(1.0f),
+    moment1_hist(comm->get_model_grid()),
+    moment2_hist(comm->get_model_grid()),
+    update(comm->get_model_grid()) {
+    set_name("lamb");
+    if (comm->am_model_master()) {
+      std::cout << "Initializing LAMB optimizer with lr=" << lr <<
+        " beta1=" << beta1 << " beta2=" << beta2 <<
+        " weight_decay=" << weight_decay << " eps=" << eps << std::endl;
+    }
+  }
+  ~LAMB() {
+    moment1_hist.Empty();
+    moment2_hist.Empty();
+    update.Empty();
+  }
+
+  void setup(int input_dim, int num_neurons) {
+    Zeros(moment1_hist, num_neurons, input_dim);
+    Zeros(moment2_hist, num_neurons, input_dim);
+    Zeros(update, num_neurons, input_dim);
+  }
+
+  void update_weight_bias_matrix(ElMat& WB_D, ElMat& WB) {
+    // Update exponential decay rates.
+    cur_beta1 *= beta1;
+    cur_beta2 *= beta2;
+    const DataType correction1 = 1.0f / (1.0f - cur_beta1);
+    const DataType correction2 = 1.0f / (1.0f - cur_beta2);
+    // Update the moments and compute the Adam update with weight decay.
+    Mat& w_local = WB.Matrix();
+    const Mat& g_local = WB_D.LockedMatrix();
+    Mat& m1_local = moment1_hist.Matrix();
+    Mat& m2_local = moment2_hist.Matrix();
+    Mat& u_local = update.Matrix();
+    const Int height = w_local.Height();
+    const Int width = w_local.Width();
+#pragma omp parallel for
+    for (Int col = 0; col < width; ++col) {
+      for (Int row = 0; row < height; ++row) {
+        const DataType g = g_local(row, col);
+        const DataType m1 = beta1 * m1_local(row, col) + (1.0f - beta1) * g;
+        const DataType m2 = beta2 * m2_local(row, col) + (1.0f - beta2) * g * g;
+        m1_local(row, col) = m1;
+        m2_local(row, col) = m2;
+        u_local(row, col) = (m1 * correction1) /
+          (std::sqrt(m2 * correction2) + eps) +
+          weight_decay * w_local(row, col);
+      }
+    }
+    // Compute the layer's trust ratio.
+    DataType w_norm, r_norm;
+    fused_two_norms(WB, update, w_norm, r_norm);
+    trust_ratio = 1.0f;
+    if (w_norm > 0.0f && r_norm > 0.0f) {
+      trust_ratio = w_norm / r_norm;
+    }
+    Axpy(-lr * trust_ratio, u_local, w_local);
+  }
+
+  float get_learning_rate() const { return lr; }
+
+  void set_learning_rate(float _lr) { lr = _lr; }
+
+  /** Return the trust ratio used in the most recent update. */
+  float get_trust_ratio() const { return trust_ratio; }
+
+  void free_state() {
+    moment1_hist.Empty();
+    moment2_hist.Empty();
+    update.Empty();
+  }
+
+  std::vector<ElMat*> get_state_matrices() {
+    return {&moment1_hist, &moment2_hist};
+  }
+
+  bool saveToCheckpointShared(persist& p, int Index) {
+    char name[512];
+
+    // current learning rate value
+    if (p.m_rank == 0) {
+      sprintf(name, "L%d_learning_rate", Index);
+      p.write_float(persist_type::train, name, lr);
+    }
+
+    // current beta1 value
+    if (p.m_rank == 0) {
+      sprintf(name, "L%d_cur_beta1", Index);
+      p.write_float(persist_type::train, name, cur_beta1);
+    }
+
+    // current beta2 value
+    if (p.m_rank == 0) {
+      sprintf(name, "L%d_cur_beta2", Index);
+      p.write_float(persist_type::train, name, cur_beta2);
+    }
+
+    // checkpoint matrix for first moment
+    sprintf(name, "L%d_lamb_moment1_%lldx%lld",
+      Index, moment1_hist.Height(), moment1_hist.Width());
+    bool rc1 = p.write_distmat(persist_type::train, name, (DistMat*)&moment1_hist);
+
+    // checkpoint matrix for second moment
+    sprintf(name, "L%d_lamb_moment2_%lldx%lld",
+      Index, moment2_hist.Height(), moment2_hist.Width());
+    bool rc2 = p.write_distmat(persist_type::train, name, (DistMat*)&moment2_hist);
+
+    return (rc1 && rc2);
+  }
+
+  bool loadFromCheckpointShared(persist& p, int Index) {
+    char name[512];
+
+    // current learning rate value
+    if (p.m_rank == 0) {
+      sprintf(name, "L%d_learning_rate", Index);
+      p.read_float(persist_type::train, name, &lr);
+    }
+    MPI_Bcast(&lr, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+    // current beta1 value
+    if (p.m_rank == 0) {
+      sprintf(name, "L%d_cur_beta1", Index);
+      p.read_float(persist_type::train, name, &cur_beta1);
+    }
+    MPI_Bcast(&cur_beta1, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+    // current beta2 value
+    if (p.m_rank == 0) {
+      sprintf(name, "L%d_cur_beta2", Index);
+      p.read_float(persist_type::train, name, &cur_beta2);
+    }
+    MPI_Bcast(&cur_beta2, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+    // checkpoint matrix for first moment
+    sprintf(name, "L%d_lamb_moment1_%lldx%lld.bin",
+      Index, moment1_hist.Height(), moment1_hist.Width());
+    bool rc1 = p.read_distmat(persist_type::train, name, (DistMat*)&moment1_hist);
+
+    // checkpoint matrix for second moment
+    sprintf(name, "L%d_lamb_moment2_%lldx%lld.bin",
+      Index, moment2_hist.Height(), moment2_hist.Width());
+    bool rc2 = p.read_distmat(persist_type::train, name, (DistMat*)&moment2_hist);
+
+    return (rc1 && rc2);
+  }
+
+private:
+  lbann_comm* comm;
+  /** Learning rate. */
+  float lr;
+  /** Exponential decay rate for first moment estimate. */
+  float beta1;
+  /** Exponential decay rate for second moment estimate. */
+  float beta2;
+  /** Decoupled weight decay coefficient. */
+  float weight_decay;
+  /** Numerical stabilizer. */
+  float eps;
+  /** Current decay for the first moment. */
+  float cur_beta1;
+  /** Current decay for the second moment. */
+  float cur_beta2;
+  /** Trust ratio from the most recent update. */
+  float trust_ratio;
+  /** History of the first moment. */
+  _DistMat moment1_hist;
+  /** History of the second moment. */
+  _DistMat moment2_hist;
+  /** The Adam update with weight decay (scratch space, not checkpointed). */
+  _DistMat update;
+};
+
+class LAMB_factory : public Optimizer_factory {
+public:
+  LAMB_factory(lbann_comm* comm, float lr, float beta1 = 0.9f,
+               float beta2 = 0.999f, float weight_decay = 0.01f,
+               float eps = 1e-6f);
+  ~LAMB_factory();
+  Optimizer* create_optimizer(matrix_format format = matrix_format::MC_MR);
+  const string name() { return "lamb"; }
+private:
+  lbann_comm* comm;
+  float lr;
+  float beta1;
+  float beta2;
+  float weight_decay;
+  float eps;
+};
+
+}  // namespace lbann
+
+#endif  // LBANN_OPTIMIZER_LAMB_HPP
@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_optimizer_lars .hpp .cpp - SGD with layer-wise adaptive rate scaling
+// Reference:
+// You, Y., Gitman, I., and Ginsburg, B. 2017. Large Batch Training of
+// Convolutional Networks.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_OPTIMIZER_LARS_HPP
+#define LBANN_OPTIMIZER_LARS_HPP
+
+#include "lbann/optimizers/lbann_optimizer.hpp"
+
+namespace lbann {
+
+/**
+ * Momentum SGD where each layer's step is scaled by a trust ratio
+ * eta * ||W|| / (||dW|| + weight_decay * ||W||).
+ * This keeps the update small relative to the weights in every layer, which
+ * allows the large effective mini-batches that come from training many
+ * models at once.
+ * The trust ratio is computed over whatever matrix the optimizer is given, so
+ * it is only layer-wise when the layer is not part of a flat_params buffer.
+ */
+template <class _DistMat>
+class LARS : public Optimizer {
+public:
+  /**
+   * Constructor.
+   * @param lr Global learning rate.
+   * @param momentum Momentum.
+   * @param weight_decay Weight decay (L2 penalty) coefficient.
+   * @param eta Trust coefficient.
+   * @param eps Small constant for numerical stability.
+   */
+  LARS(lbann_comm* comm, float lr, float momentum = 0.9f,
+       float weight_decay = 0.0005f, float eta = 0.001f, float eps = 1e-9f) :
+    comm(comm), lr(lr), momentum(momentum), weight_decay(weight_decay),
+    eta(eta), eps(eps), trust_ratio(1.0f),
+    velocity(comm->get_model_grid()) {
+    set_name("lars");
+    if (comm->am_model_master()) {
+      std::cout << "Initializing LARS optimizer with lr=" << lr <<
+        " momentum=" << momentum << " weight_decay=" << weight_decay <<
+        " eta=" << eta << std::endl;
+    }
+  }
+  ~LARS() {
+    velocity.Empty();
+  }
+
+  void setup(int input_dim, int num_neurons) {
+    Zeros(velocity, num_neurons, input_dim);
+  }
+
+  void update_weight_bias_matrix(ElMat& WB_D, ElMat& WB) {
+    // Compute the layer's trust ratio.
+    DataType w_norm, g_norm;
+    fused_two_norms(WB, WB_D, w_norm, g_norm);
+    trust_ratio = 1.0f;
+    if (w_norm > 0.0f && g_norm > 0.0f) {
+      trust_ratio = eta * w_norm / (g_norm + weight_decay * w_norm + eps);
+    }
+    const DataType step = lr * trust_ratio;
+    // v = momentum * v + step * (dW + weight_decay * W); W = W - v
+    Mat& w_local = WB.Matrix();
+    Mat& g_local = WB_D.Matrix();
+    Mat& v_local = velocity.Matrix();
+    const Int height = w_local.Height();
+    const Int width = w_local.Width();
+#pragma omp parallel for
+    for (Int col = 0; col < width; ++col) {
+      for (Int row = 0; row < height; ++row) {
+        const DataType w = w_local(row, col);
+        const DataType v = momentum * v_local(row, col) +
+          step * (g_local(row, col) + weight_decay * w);
+        v_local(row, col) = v;
+        w_local(row, col) = w - v;
+      }
+    }
+  }
+
+  float get_learning_rate() const { return lr; }
+
+  void set_learning_rate(float _lr) { lr = _lr; }
+
+  /** Return the trust ratio used in the most recent update. */
+  float get_trust_ratio() const { return trust_ratio; }
+
+  void free_state() { velocity.Empty(); }
+
+  std::vector<ElMat*> get_state_matrices() { return {&velocity}; }
+
+  bool saveToCheckpointShared(persist& p, int Index) {
+    char name[512];
+
+    // current learning rate value
+    if (p.m_rank == 0) {
+      sprintf(name, "L%d_learning_rate", Index);
+      p.write_float(persist_type::train, name, lr);
+    }
+
+    // checkpoint matrix for the velocity
+    sprintf(name, "L%d_lars_velocity_%lldx%lld",
+      Index, velocity.Height(), velocity.Width());
+    return p.write_distmat(persist_type::train, name, (DistMat*)&velocity);
+  }
+
+  bool loadFromCheckpointShared(persist& p, int Index) {
+    char name[512];
+
+    // current learning rate value
+    if (p.m_rank == 0) {
+      sprintf(name, "L%d_learning_rate", Index);
+      p.read_float(persist_type::train, name, &lr);
+    }
+    MPI_Bcast(&lr, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+    // checkpoint matrix for the velocity
+    sprintf(name, "L%d_lars_velocity_%lldx%lld.bin",
+      Index, velocity.Height(), velocity.Width());
+    return p.read_distmat(persist_type::train, name, (DistMat*)&velocity);
+  }
+
+private:
+  lbann_comm* comm;
+  /** Global learning rate. */
+  float lr;
+  /** Momentum. */
+  float momentum;
+  /** Weight decay coefficient. */
+  float weight_decay;
+  /** Trust coefficient. */
+  float eta;
+  /** Numerical stabilizer. */
+  float eps;
+  /** Trust ratio from the most recent update. */
+  float trust_ratio;
+  /** Momentum history. */
+  _DistMat velocity;
+};
+
+class LARS_factory : public Optimizer_factory {
+public:
+  LARS_factory(lbann_comm* comm, float lr, float momentum = 0.9f,
+               float weight_decay = 0.0005f, float eta = 0.001f,
+               float eps = 1e-9f);
+  ~LARS_factory();
+  Optimizer* create_optimizer(matrix_format format = matrix_format::MC_MR);
+  const string name() { return "lars"; }
+private:
+  lbann_comm* comm;
+  float lr;
+  float momentum;
+  float weight_decay;
+  float eta;
+  float eps;
+};
+
+}  // namespace lbann
+
+#endif  // LBANN_OPTIMIZER_LARS_HPP
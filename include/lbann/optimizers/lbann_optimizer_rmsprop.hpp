@@ -36,6 +36,7 @@
 #define LBANN_OPTIMIZER_RMSPROP_HPP
 
 #include "lbann/optimizers/lbann_optimizer.hpp"
+#include "lbann/optimizers/lbann_optimizer_state.hpp"
 #include <sys/stat.h>
 
 namespace lbann
@@ -53,20 +54,25 @@ namespace lbann
     _DistMat     WB_D_Cache;     // Cache of Weights and Bias Gradient (current time t - 1)
     _DistMat     WB_D_Temp;      // Temporary for Weights and Bias Gradient computation
     _DistMat     WB_D_Temp2;     // Temporary for Weights and Bias Gradient computation
+    int          state_bits;     // Bits per cache entry (32 for unquantized)
+    block_quantized_state WB_D_Cache_q; // Block-quantized cache (when state_bits < 32)
 
   private:
     static inline DataType _sq(const DataType& x) { return (x * x); }
     static inline DataType _sqrt(const DataType& x) { return (1 / sqrt(x + 1e-8)); }
 
   public:
-    RMSprop(lbann_comm* comm, float lr, float rho, float epsilon)
+    RMSprop(lbann_comm* comm, float lr, float rho, float epsilon,
+            int state_bits = 32)
       : LearnRate(lr), rho(rho), epsilon(epsilon), comm(comm),
         WB_D_Cache(comm->get_model_grid()),
         WB_D_Temp(comm->get_model_grid()),
-        WB_D_Temp2(comm->get_model_grid()) {
+        WB_D_Temp2(comm->get_model_grid()),
+        state_bits(state_bits),
+        WB_D_Cache_q(std::min(state_bits, 16)) {
       set_name("rmsprop");
       if (comm->am_model_master()) {
-        printf("Initializing RMSprop optimizer with lr=%f, rho=%f, and epsilon=%f\n", lr, rho, epsilon);
+        printf("Initializing RMSprop optimizer with lr=%f, rho=%f, epsilon=%f, and state_bits=%d\n", lr, rho, epsilon, state_bits);
       }
     }
 
@@ -80,6 +86,11 @@ namespace lbann
       if (comm->am_model_master()) {
         printf("Setting up RMSprop optimizer with cache size %d x %d\n", num_neurons, input_dim);
       }
+      if (state_bits < 32) {
+        // Sized on the first update; the temporaries are not needed.
+        WB_D_Cache_q.setup(0);
+        return;
+      }
       Zeros(WB_D_Cache, num_neurons, input_dim);
       Zeros(WB_D_Temp, num_neurons, input_dim);
       Zeros(WB_D_Temp2, num_neurons, input_dim);  
@@ -89,6 +100,21 @@ namespace lbann
     }
 
     void update_weight_bias_matrix(ElMat &WB_D, ElMat& WB) {
+      if (state_bits < 32) {
+        // Fused update on the dequantized cache, one block at a time.
+        const El::Int local_size = WB_D.LocalHeight() * WB_D.LocalWidth();
+        if (WB_D_Cache_q.get_num_entries() != local_size) {
+          WB_D_Cache_q.setup(local_size);
+        }
+        const DataType _rho = rho, _lr = LearnRate;
+        apply_blockwise(WB_D, WB, WB_D_Cache_q, nullptr,
+                        [_rho, _lr] (DataType& g, DataType& w,
+                                     DataType& cache, DataType&) {
+                          cache = _rho * cache + (1 - _rho) * g * g;
+                          w -= _lr * g * _sqrt(cache);
+                        });
+        return;
+      }
       // update accumulator
       // KERAS: for p, g, a, c in zip(params, grads, accumulators, constraints):
       // KERAS: new_a = self.rho * a + (1 - self.rho) * K.square(g)
@@ -122,6 +148,19 @@ namespace lbann
       return true;
     }
 
+    void free_state() {
+      WB_D_Cache.Empty();
+      WB_D_Temp.Empty();
+      WB_D_Temp2.Empty();
+    }
+
+    std::vector<ElMat*> get_state_matrices() {
+      if (state_bits < 32) {
+        return {};
+      }
+      return {&WB_D_Cache};
+    }
+
     bool saveToCheckpointShared(persist& p, int Index) {
       char name[512];
 
@@ -131,6 +170,12 @@ namespace lbann
         p.write_float(persist_type::train, name, LearnRate);
       }
 
+      // quantized cache is written in compressed form
+      if (state_bits < 32) {
+        sprintf(name, "L%d_rmsprop_q%d", Index, state_bits);
+        return WB_D_Cache_q.save_to_checkpoint_shared(p, name);
+      }
+
       // build name of the checkpoint file
       sprintf(name, "L%d_rmsprop_%dx%d", Index, WB_D_Cache.Height(), WB_D_Cache.Width());
       p.write_distmat(persist_type::train, name, (DistMat*)&WB_D_Cache);
@@ -148,6 +193,12 @@ namespace lbann
       }
       MPI_Bcast(&LearnRate, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
 
+      // quantized cache is read in compressed form
+      if (state_bits < 32) {
+        sprintf(name, "L%d_rmsprop_q%d", Index, state_bits);
+        return WB_D_Cache_q.load_from_checkpoint_shared(p, name);
+      }
+
       // read in the cache of gradients for WB
       sprintf(name, "L%d_rmsprop_%dx%d.bin", Index, WB_D_Cache.Height(), WB_D_Cache.Width());
       p.read_distmat(persist_type::train, name, (DistMat*)&WB_D_Cache);
@@ -160,7 +211,8 @@ namespace lbann
   class RMSprop_factory : public Optimizer_factory {
   public:
     // Default values from Keras - it is recommended that they are left at their default values
-    RMSprop_factory(lbann_comm* comm, float lr=0.001, float rho=0.9, float epsilon=1e-6);
+    RMSprop_factory(lbann_comm* comm, float lr=0.001, float rho=0.9, float epsilon=1e-6,
+                    int state_bits=32);
     ~RMSprop_factory();
     Optimizer *create_optimizer(matrix_format format=matrix_format::MC_MR);
     const string name() { return "rmsprop"; }
@@ -170,6 +222,7 @@ namespace lbann
     float lr;
     float rho;
     float epsilon;
+    int state_bits;
   };
 
 }
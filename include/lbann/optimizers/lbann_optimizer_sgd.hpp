@@ -118,6 +118,18 @@ namespace lbann
       return true;
     }
 
+    void free_state() {
+      velocity.Empty();
+      nesterov_ag.Empty();
+    }
+
+    std::vector<ElMat*> get_state_matrices() {
+      if (momentum == 0.0f) {
+        return {};
+      }
+      return {&velocity};
+    }
+
     bool saveToCheckpointShared(persist& p, int Index) {
       char name[512];
 
@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_optimizer_state .hpp .cpp - Block-quantized optimizer state storage
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_OPTIMIZER_STATE_HPP
+#define LBANN_OPTIMIZER_STATE_HPP
+
+#include "lbann/lbann_base.hpp"
+#include "lbann/io/lbann_persist.hpp"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+namespace lbann {
+
+/**
+ * Store a process's local optimizer state (e.g. Adam moments) in 8- or 16-bit
+ * block-quantized form.
+ * Entries are indexed linearly in column-major order over the local matrix
+ * and split into blocks of block_size entries. Each block keeps the absolute
+ * maximum of its entries as a scale and one signed code per entry. Codes use
+ * square-root companding (x = sign * (code/qmax)^2 * scale), which gives small
+ * entries much finer resolution than a linear mapping; this matters for
+ * second moments, where rounding to zero would blow up the step.
+ * Optimizers dequantize a block into a scratch buffer, update it, and store it
+ * back, so only one block per thread is ever held at full precision.
+ */
+class block_quantized_state {
+public:
+  /** Number of entries in each block. */
+  static const El::Int block_size = 256;
+
+  /** Store state with the given number of bits per entry (8 or 16). */
+  block_quantized_state(int bits = 8);
+
+  /** Allocate zeroed state for num_entries entries. */
+  void setup(El::Int num_entries);
+  /** Return the number of entries. */
+  El::Int get_num_entries() const { return m_num_entries; }
+  /** Return the number of blocks. */
+  El::Int get_num_blocks() const { return m_scales.size(); }
+  /** Return the number of bits per entry. */
+  int get_bits() const { return m_bits; }
+  /** Return the number of bytes used to store the state. */
+  size_t get_bytes() const;
+
+  /**
+   * Dequantize block into vals, which must hold block_size entries.
+   * Returns the number of entries in the block.
+   */
+  El::Int load_block(El::Int block, DataType* vals) const;
+  /** Quantize the entries of block from vals. */
+  void store_block(El::Int block, const DataType* vals);
+
+  /**
+   * Write the compressed state to a per-rank file in the checkpoint
+   * directory.
+   */
+  bool save_to_checkpoint_shared(persist& p, const char* name);
+  /** Read the compressed state written by save_to_checkpoint_shared. */
+  bool load_from_checkpoint_shared(persist& p, const char* name);
+
+private:
+  /** Bits per entry. */
+  int m_bits;
+  /** Number of entries. */
+  El::Int m_num_entries;
+  /** Per-block scales (absolute maximum of the block). */
+  std::vector<float> m_scales;
+  /** Codes when using 8 bits. */
+  std::vector<int8_t> m_codes8;
+  /** Codes when using 16 bits. */
+  std::vector<int16_t> m_codes16;
+
+  /** Return the number of entries in block. */
+  El::Int block_length(El::Int block) const {
+    const El::Int start = block * block_size;
+    return std::min(m_num_entries - start, (El::Int) block_size);
+  }
+  /** Type-specific implementation of load_block. */
+  template <typename T>
+  void load_block_impl(const std::vector<T>& codes, El::Int block,
+                       DataType* vals) const;
+  /** Type-specific implementation of store_block. */
+  template <typename T>
+  void store_block_impl(std::vector<T>& codes, El::Int block,
+                        const DataType* vals);
+};
+
+/**
+ * Apply f to every local entry of grad and weights, one state block at a time.
+ * f is called as f(g, w, s0, s1), where g and w reference the gradient and
+ * weight entries and s0 and s1 reference the entry's dequantized state from
+ * state0 and state1. state1 may be nullptr, in which case s1 is scratch.
+ * The states must have one entry per local entry of grad.
+ */
+template <typename F>
+void apply_blockwise(ElMat& grad, ElMat& weights,
+                     block_quantized_state& state0,
+                     block_quantized_state* state1, F f) {
+  Mat& g_local = grad.Matrix();
+  Mat& w_local = weights.Matrix();
+  const El::Int height = g_local.Height();
+  const El::Int num_blocks = state0.get_num_blocks();
+#pragma omp parallel for
+  for (El::Int block = 0; block < num_blocks; ++block) {
+    DataType s0[block_quantized_state::block_size];
+    DataType s1[block_quantized_state::block_size];
+    const El::Int len = state0.load_block(block, s0);
+    if (state1 != nullptr) {
+      state1->load_block(block, s1);
+    }
+    const El::Int start = block * block_quantized_state::block_size;
+    for (El::Int i = 0; i < len; ++i) {
+      const El::Int row = (start + i) % height;
+      const El::Int col = (start + i) / height;
+      f(g_local(row, col), w_local(row, col), s0[i], s1[i]);
+    }
+    state0.store_block(block, s0);
+    if (state1 != nullptr) {
+      state1->store_block(block, s1);
+    }
+  }
+}
+
+}  // namespace lbann
+
+#endif  // LBANN_OPTIMIZER_STATE_HPP
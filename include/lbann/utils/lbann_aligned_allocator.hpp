@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_aligned_allocator .hpp - Cache-line-aligned allocation for std containers
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_ALIGNED_ALLOCATOR_HPP_INCLUDED
+#define LBANN_ALIGNED_ALLOCATOR_HPP_INCLUDED
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace lbann {
+
+/**
+ * Allocator returning memory aligned to Alignment bytes (a cache line by
+ * default), for communication and vectorized buffers.
+ */
+template <typename T, size_t Alignment = 64>
+class aligned_allocator {
+public:
+  typedef T value_type;
+  template <typename U>
+  struct rebind { typedef aligned_allocator<U, Alignment> other; };
+
+  aligned_allocator() {}
+  template <typename U>
+  aligned_allocator(const aligned_allocator<U, Alignment>&) {}
+
+  T* allocate(size_t n) {
+    void* p = nullptr;
+    if (posix_memalign(&p, Alignment, n * sizeof(T)) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(p);
+  }
+  void deallocate(T* p, size_t) { free(p); }
+};
+
+template <typename T, typename U, size_t Alignment>
+inline bool operator==(const aligned_allocator<T, Alignment>&,
+                       const aligned_allocator<U, Alignment>&) {
+  return true;
+}
+template <typename T, typename U, size_t Alignment>
+inline bool operator!=(const aligned_allocator<T, Alignment>&,
+                       const aligned_allocator<U, Alignment>&) {
+  return false;
+}
+
+/** A std::vector whose storage is cache-line aligned. */
+template <typename T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
+
+}  // namespace lbann
+
+#endif  // LBANN_ALIGNED_ALLOCATOR_HPP_INCLUDED
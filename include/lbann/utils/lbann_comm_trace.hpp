@@ -0,0 +1,173 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_comm_trace .hpp .cpp - Tracing of communication calls
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_COMM_TRACE_HPP_INCLUDED
+#define LBANN_COMM_TRACE_HPP_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "lbann/utils/lbann_timer.hpp"
+
+namespace lbann {
+
+/**
+ * One traced communication call. Names are string literals (they are not
+ * copied); peer is -1 for collectives. tid numbers the calling threads in
+ * the order they first recorded an event.
+ */
+struct comm_trace_event {
+  const char* op;
+  const char* comm;
+  const char* algorithm;
+  size_t bytes;
+  int peer;
+  double start;
+  double end;
+  int tid;
+};
+
+/**
+ * Records communication calls in memory and writes them out as Chrome trace
+ * JSON (viewable in chrome://tracing or Perfetto). Alongside the events it
+ * keeps, per operation, a histogram of message sizes (power-of-two buckets)
+ * with the count and total time in each bucket; the histograms keep counting
+ * after the event buffer is full.
+ * Recording is a vector append and a hash lookup under a mutex, so calls
+ * may be traced from several threads (e.g. a communication thread beside
+ * the main one); each thread gets its own track in the trace.
+ */
+class comm_tracer {
+public:
+  /** Number of power-of-two size buckets (the last one is open-ended). */
+  static const int NUM_SIZE_BUCKETS = 40;
+
+  comm_tracer() : enabled(false), max_events(0), num_dropped(0), epoch(0.0) {}
+  comm_tracer(const comm_tracer&) = delete;
+  comm_tracer& operator=(const comm_tracer&) = delete;
+
+  /**
+   * Start recording, keeping at most max_events events. Timestamps are
+   * relative to the time this is called.
+   */
+  void enable(size_t max_events_ = 1 << 20);
+  /** Stop recording (recorded events are kept). */
+  void disable() { enabled = false; }
+  inline bool is_enabled() const { return enabled; }
+  /** Discard recorded events and histograms. */
+  void clear();
+  /** Record a call that ran from start to end (as from get_time()). */
+  void record(const char* op, const char* comm, size_t bytes, int peer,
+              double start, double end, const char* algorithm = nullptr);
+
+  /** Return a copy of the recorded events. */
+  std::vector<comm_trace_event> get_events() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return events;
+  }
+  /** Return the number of events not kept because the buffer was full. */
+  size_t get_num_dropped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return num_dropped;
+  }
+  /** Return the size bucket of a message of bytes bytes. */
+  static int size_bucket(size_t bytes);
+
+  /**
+   * Write the events as Chrome trace JSON, as process pid (e.g. the world
+   * rank) named process_name; the histograms go in "otherData".
+   */
+  void write_chrome_trace(std::ostream& os, int pid,
+                          const std::string& process_name) const;
+  /** As above, to a file; throws lbann_exception if it cannot be written. */
+  void write_chrome_trace(const std::string& filename, int pid,
+                          const std::string& process_name) const;
+  /** Print the size histograms as a table. */
+  void print_histograms(std::ostream& os) const;
+
+private:
+  /** Calls and time per size bucket for one operation. */
+  struct size_histogram {
+    size_t count[NUM_SIZE_BUCKETS] = {};
+    double time[NUM_SIZE_BUCKETS] = {};
+  };
+  std::atomic<bool> enabled;
+  /** Guards everything below. */
+  mutable std::mutex mutex;
+  size_t max_events;
+  size_t num_dropped;
+  double epoch;
+  std::vector<comm_trace_event> events;
+  /** Keyed by the op literal; merged by name when written out. */
+  std::unordered_map<const char*, size_histogram> histograms;
+  /** Trace track of each thread that has recorded an event. */
+  std::map<std::thread::id, int> thread_ids;
+  /** Return the histograms keyed by operation name (mutex must be held). */
+  std::vector<std::pair<std::string, size_histogram>> merged_histograms() const;
+};
+
+/**
+ * Trace the enclosing scope as one call. This does nothing (beyond a flag
+ * check) when the tracer is disabled.
+ */
+class comm_trace_scope {
+public:
+  comm_trace_scope(comm_tracer& tracer_, const char* op_, const char* comm_,
+                   size_t bytes_ = 0, int peer_ = -1) :
+    tracer(tracer_.is_enabled() ? &tracer_ : nullptr), op(op_), comm(comm_),
+    algorithm(nullptr), bytes(bytes_), peer(peer_),
+    start(tracer != nullptr ? get_time() : 0.0) {}
+  ~comm_trace_scope() {
+    if (tracer != nullptr) {
+      tracer->record(op, comm, bytes, peer, start, get_time(), algorithm);
+    }
+  }
+  /** Set the algorithm the call used. */
+  void set_algorithm(const char* algorithm_) { algorithm = algorithm_; }
+  /** Set the size, when it is only known partway through the call. */
+  void set_bytes(size_t bytes_) { bytes = bytes_; }
+
+private:
+  comm_tracer* tracer;
+  const char* op;
+  const char* comm;
+  const char* algorithm;
+  size_t bytes;
+  int peer;
+  double start;
+};
+
+}  // namespace lbann
+
+#endif  // LBANN_COMM_TRACE_HPP_INCLUDED
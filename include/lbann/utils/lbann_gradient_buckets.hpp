@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_gradient_buckets .hpp .cpp - Fuse gradient reductions into buckets
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_GRADIENT_BUCKETS_HPP_INCLUDED
+#define LBANN_GRADIENT_BUCKETS_HPP_INCLUDED
+
+#include <vector>
+#include <unordered_map>
+#include "lbann/lbann_base.hpp"
+#include "lbann/lbann_comm.hpp"
+
+namespace lbann {
+
+/**
+ * Packs gradients into size-bounded buckets in a persistent staging buffer so
+ * that many small gradients are summed across models with one collective per
+ * bucket instead of one per gradient.
+ * Gradients are registered in the order they become ready (backprop order).
+ * A bucket's collective starts once its last gradient has been packed; each
+ * gradient is unpacked in place once its bucket has completed.
+ */
+class gradient_buckets {
+public:
+  /** Use buckets holding at most bucket_bytes (a larger gradient gets its own). */
+  gradient_buckets(lbann_comm* comm, size_t bucket_bytes);
+  /** Register a gradient with size local entries. Call in backprop order. */
+  void add_gradient(uint id, El::Int size);
+  /** Lay out the buckets and allocate the staging buffer. */
+  void setup();
+  /** Return true if id has been registered. */
+  bool has_gradient(uint id) const {
+    return m_entries.find(id) != m_entries.end();
+  }
+  /**
+   * Copy the local gradient of id into the staging buffer. When this
+   * completes its bucket, start the bucket's sum (non-blocking if requested).
+   */
+  void pack(uint id, const DistMat& grad, bool nonblocking);
+  /** Wait for the bucket holding id if needed and copy the sum back to grad. */
+  void unpack(uint id, DistMat& grad);
+
+  /** Return the maximum bucket size in bytes. */
+  size_t get_bucket_bytes() const { return m_bucket_bytes; }
+  /** Return the number of buckets. */
+  size_t get_num_buckets() const { return m_buckets.size(); }
+  /** Return the size of the staging buffer in bytes. */
+  size_t get_staging_bytes() const {
+    return m_staging.size() * sizeof(DataType);
+  }
+  /** Return the number of collectives started since the last reset. */
+  size_t get_num_collectives() const { return m_num_collectives; }
+  /** Return the time from starting to completing collectives since the last reset. */
+  double get_comm_time() const { return m_comm_time; }
+  /** Return the time spent blocked waiting on collectives since the last reset. */
+  double get_wait_time() const { return m_wait_time; }
+  void reset_counters() {
+    m_num_collectives = 0;
+    m_comm_time = 0.0;
+    m_wait_time = 0.0;
+  }
+
+private:
+  /** Location of a gradient in the staging buffer. */
+  struct entry {
+    size_t bucket;
+    El::Int offset;
+    El::Int size;
+  };
+  /** A contiguous range of the staging buffer summed with one collective. */
+  struct bucket {
+    El::Int offset = 0;
+    El::Int size = 0;
+    int num_gradients = 0;
+    int num_packed = 0;
+    int num_unpacked = 0;
+    bool nonblocking = false;
+    bool complete = false;
+    double start_time = 0.0;
+    mpi::Request<DataType> req;
+  };
+
+  lbann_comm* m_comm;
+  size_t m_bucket_bytes;
+  /** Registration order of gradients. */
+  std::vector<uint> m_order;
+  std::unordered_map<uint, entry> m_entries;
+  std::vector<bucket> m_buckets;
+  /** Persistent staging buffer holding all buckets back to back. */
+  std::vector<DataType> m_staging;
+
+  size_t m_num_collectives = 0;
+  double m_comm_time = 0.0;
+  double m_wait_time = 0.0;
+};
+
+}  // namespace lbann
+
+#endif  // LBANN_GRADIENT_BUCKETS_HPP_INCLUDED
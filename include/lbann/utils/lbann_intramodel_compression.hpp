@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_intramodel_compression .hpp .cpp - Lossy formats for intra-model
+// transfers and reduced-precision payloads
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_INTRAMODEL_COMPRESSION_HPP_INCLUDED
+#define LBANN_INTRAMODEL_COMPRESSION_HPP_INCLUDED
+
+#include "lbann/lbann_base.hpp"
+#include <cstdint>
+#include <cstddef>
+
+namespace lbann {
+
+/**
+ * Formats for compressing data moved between the processes of a model.
+ * FP16 stores IEEE half-precision values (round to nearest even); BLOCK8
+ * stores blocks of INTRAMODEL_BLOCK_SIZE values as a float scale (the
+ * block's largest magnitude over 127) followed by one signed byte each.
+ * NONE sends the values as-is.
+ */
+enum class intramodel_compression {NONE, FP16, BLOCK8};
+
+/** Number of values sharing a scale in BLOCK8 compression. */
+static const size_t INTRAMODEL_BLOCK_SIZE = 256;
+
+/** Return the number of bytes count values take compressed with c. */
+size_t compressed_bytes(intramodel_compression c, size_t count);
+/** Compress count values from src into compressed_bytes(c, count) bytes. */
+void compress_values(intramodel_compression c, const DataType* src,
+                     size_t count, unsigned char* dst);
+/**
+ * Decompress count values compressed with c into dst, adding them to the
+ * existing values if add.
+ */
+void decompress_values(intramodel_compression c, const unsigned char* src,
+                       size_t count, DataType* dst, bool add = false);
+/** Return a printable name for c. */
+const char* intramodel_compression_name(intramodel_compression c);
+
+/** Convert to IEEE half precision, rounding to nearest even. */
+uint16_t float_to_half(float f);
+/** Convert from IEEE half precision. */
+float half_to_float(uint16_t h);
+/** Convert to bfloat16 (the top half of a float), rounding to nearest even. */
+uint16_t float_to_bfloat16(float f);
+/** Convert from bfloat16. */
+float bfloat16_to_float(uint16_t h);
+
+/**
+ * Wire precision for inter-model collectives. FP16 and BF16 send two bytes
+ * per value; receivers accumulate in fp32. FP16 keeps more mantissa but
+ * overflows above 65504, BF16 keeps the float exponent range.
+ */
+enum class payload_precision {FP32, FP16, BF16};
+
+/**
+ * Pack a height x width column-major block with leading dimension ldim
+ * into height * width contiguous 16-bit values of precision p (FP16 or
+ * BF16).
+ */
+void pack_payload(payload_precision p, const DataType* src, size_t height,
+                  size_t width, size_t ldim, uint16_t* dst);
+/**
+ * Unpack height * width contiguous values of precision p into a block with
+ * leading dimension ldim, adding them in fp32 to the existing values if add.
+ */
+void unpack_payload(payload_precision p, const uint16_t* src, size_t height,
+                    size_t width, size_t ldim, DataType* dst,
+                    bool add = false);
+/** Return a printable name for p. */
+const char* payload_precision_name(payload_precision p);
+
+}  // namespace lbann
+
+#endif  // LBANN_INTRAMODEL_COMPRESSION_HPP_INCLUDED
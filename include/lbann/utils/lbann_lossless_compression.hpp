@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_lossless_compression .hpp .cpp - Lossless compression of parameters
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_LOSSLESS_COMPRESSION_HPP_INCLUDED
+#define LBANN_LOSSLESS_COMPRESSION_HPP_INCLUDED
+
+#include "lbann/lbann_base.hpp"
+#include <cstddef>
+
+namespace lbann {
+
+/**
+ * Lossless compression for model parameters.
+ * Each value is XORed with the previous one, so repeated values (e.g.
+ * constant biases or runs of zeros) become zero. The bytes are then split
+ * into planes (all first bytes, then all second bytes, ...), so the sign and
+ * exponent bytes, which vary slowly, sit together. Each plane is
+ * run-length encoded. Data that does not shrink is stored raw, so the output
+ * is never more than one byte longer than the input.
+ */
+
+/** Return the largest number of bytes count values can compress to. */
+size_t lossless_compress_bound(size_t count);
+/**
+ * Compress count values from src into dst, which must have room for
+ * lossless_compress_bound(count) bytes. Returns the number of bytes written.
+ */
+size_t lossless_compress(const DataType* src, size_t count,
+                         unsigned char* dst);
+/**
+ * Decompress count values from the bytes bytes at src into dst.
+ * Throws lbann_exception if src is malformed.
+ */
+void lossless_decompress(const unsigned char* src, size_t bytes,
+                         size_t count, DataType* dst);
+
+}  // namespace lbann
+
+#endif  // LBANN_LOSSLESS_COMPRESSION_HPP_INCLUDED
@@ -29,10 +29,12 @@
 #ifndef LBANN_QUANTIZER_HPP_INCLUDED
 #define LBANN_QUANTIZER_HPP_INCLUDED
 
+#include <map>
 #include <unordered_map>
 
 #include "lbann/lbann_base.hpp"
 #include "lbann/lbann_comm.hpp"
+#include "lbann/utils/lbann_aligned_allocator.hpp"
 #include "lbann/utils/lbann_timer.hpp"
 using namespace El;
 
@@ -71,6 +73,14 @@ public:
   typedef std::vector<uqtype> ThreshQuantized;
   typedef std::vector<uint32_t> ThreshQuantized32;
   typedef std::vector<uint64_t> ThreshQuantized64;
+  /** One entry of a top-k sparsified matrix. */
+  struct topk_entry {
+    /** Position in the local matrix (row + col * ldim). */
+    uqtype pos;
+    DataType value;
+  };
+  /** A top-k sparsified matrix, sorted by position. */
+  typedef std::vector<topk_entry> TopKQuantized;
 
   /** Thresholds for use in adaptive quantization. */
   struct adaptive_thresholds {
@@ -91,6 +101,30 @@ public:
 #endif
   };
 
+  /** Algorithms for the (unquantized) custom allreduce. */
+  enum class allreduce_algorithm {
+    /** Pick by message size (from autotune_allreduce if it has been run). */
+    AUTO,
+    /** Ring reduce-scatter/allgather over column blocks. */
+    RING,
+    /** Recursive doubling: log(p) exchanges of the whole buffer. */
+    RECURSIVE_DOUBLING,
+    /** Rabenseifner: recursive-halving reduce-scatter, recursive-doubling allgather. */
+    RABENSEIFNER
+  };
+
+  /** Codecs for the positions in adaptive threshold quantized messages. */
+  enum class position_codec {
+    /** Pick a codec per message from the density of its entries. */
+    AUTO,
+    /** Uncoded (position << 1) | sign words. */
+    RAW,
+    /** Golomb-Rice coded position deltas, parameter chosen per message. */
+    GOLOMB_RICE,
+    /** Group varint coded position deltas, with a SIMD decoder. */
+    VARINT
+  };
+
   lbann_quantizer();
   ~lbann_quantizer();
 
@@ -99,6 +133,38 @@ public:
    */
   void intermodel_sum(lbann_comm* comm, Mat& mat);
   void intermodel_sum(lbann_comm* comm, DistMat& mat);
+  /** Do an allreduce of mat with a specific algorithm. */
+  void intermodel_sum(lbann_comm* comm, Mat& mat, allreduce_algorithm alg);
+  /** Set the algorithm used by intermodel_sum (default AUTO). */
+  void set_allreduce_algorithm(allreduce_algorithm alg) { allreduce_alg = alg; }
+  /** Return the algorithm AUTO picks for an allreduce of count entries. */
+  allreduce_algorithm select_allreduce_algorithm(lbann_comm* comm,
+                                                 Int count) const;
+  /**
+   * Time every algorithm over message sizes from min_count to max_count
+   * entries (growing by 4x) on this communicator's models and record the
+   * crossover points that AUTO uses. Collective over the inter-model
+   * communicator; all models record the same choices.
+   */
+  void autotune_allreduce(lbann_comm* comm, Int min_count = 64,
+                          Int max_count = 1 << 22, int num_trials = 3);
+  /**
+   * Pipeline the reduce-scatter of the one-bit and adaptive quantized
+   * allreduces in segments of about segment_bytes (of unquantized data,
+   * rounded to whole columns): quantizing the next segment, sending the
+   * current one and unquantizing the previous one overlap. 0 (the default)
+   * sends each ring step as one message.
+   */
+  void set_ring_segment_size(size_t segment_bytes) {
+    ring_segment_bytes = segment_bytes;
+  }
+  /**
+   * Send the values of the ring allreduce in precision p (default FP32).
+   * With FP16/BF16 each reduce-scatter step adds the received chunk into
+   * the local fp32 partial sum, and the reduced chunks are rounded once
+   * before the allgather so every model ends with the same values.
+   */
+  void set_ring_precision(payload_precision p) { ring_precision = p; }
 
   /**
    * Quantize a matrix. qerror needs to be initialized with:
@@ -177,21 +243,46 @@ public:
    * @param qerror Running quantization error.
    * @param proportion Quantize one in proportion of the values.
    */
-  template <typename T>
-  void adaptive_threshold_quantize(const Mat& mat, std::vector<T>& q, Mat& qerror,
-                                   int proportion);
-  template <typename T>
-  void adaptive_threshold_quantize(const DistMat& mat, std::vector<T>& q,
+  template <typename T, typename Alloc>
+  void adaptive_threshold_quantize(const Mat& mat, std::vector<T, Alloc>& q,
+                                   Mat& qerror, int proportion);
+  template <typename T, typename Alloc>
+  void adaptive_threshold_quantize(const DistMat& mat, std::vector<T, Alloc>& q,
                                    Mat& qerror, int proportion);
   /**
    * Unquantize an adaptively-thresholded-and-quantized matrix.
    * @param q The quantizd matrix.
    * @param mat The output unquantized matrix.
    */
-  template <typename T>
-  void adaptive_threshold_unquantize(const std::vector<T>& q, Mat& mat);
-  template <typename T>
-  void adaptive_threshold_unquantize(const std::vector<T>& q, DistMat& mat);
+  template <typename T, typename Alloc>
+  void adaptive_threshold_unquantize(const std::vector<T, Alloc>& q, Mat& mat);
+  template <typename T, typename Alloc>
+  void adaptive_threshold_unquantize(const std::vector<T, Alloc>& q,
+                                     DistMat& mat);
+  /**
+   * Entropy code the positions of an adaptive threshold quantized message in
+   * place. Each column's entries become deltas from the previous entry (the
+   * first from the start of the column), which are Golomb-Rice or group
+   * varint coded. The header keeps its layout, so unquantization handles
+   * either form. The message is left raw if coding would not shrink it.
+   * @param q The message, from adaptive_threshold_quantize.
+   * @param width The width of the quantized matrix.
+   * @param ldim The leading dimension of the quantized matrix.
+   * @param scratch Buffer to encode into.
+   */
+  template <typename T, typename Alloc>
+  void encode_adaptive_positions(std::vector<T, Alloc>& q, Int width, Int ldim,
+                                 aligned_vector<T>& scratch);
+  /** Return the codec used for the positions in q. */
+  template <typename T, typename Alloc>
+  static position_codec adaptive_position_codec(
+    const std::vector<T, Alloc>& q);
+  /**
+   * Set the codec used for the positions in the adaptive quantized
+   * allreduce (default AUTO). A fixed codec is still skipped for messages it
+   * would not shrink.
+   */
+  void set_position_codec(position_codec codec) { pos_codec = codec; }
 
   /**
    * As with intermodel_sum_quantized, but use threshold quantization.
@@ -213,6 +304,72 @@ public:
   void intermodel_sum_adaptive_threshold_quantized(
     lbann_comm* comm, DistMat& mat, Mat& qerror, int proportion, Mat& im_qerror);
 
+  /**
+   * Top-k sparsify a matrix: select exactly k entries of mat + qerror with
+   * the largest magnitude (ties go to the lowest positions) using a parallel
+   * radix selection, without sorting the matrix. qerror must be initialized
+   * like for threshold_quantize; on return it holds the entries not sent.
+   * @param mat The matrix to sparsify.
+   * @param q The output entries, sorted by position.
+   * @param qerror Running error feedback.
+   * @param k The number of entries to keep.
+   */
+  void topk_quantize(const Mat& mat, TopKQuantized& q, Mat& qerror, Int k);
+  void topk_quantize(const DistMat& mat, TopKQuantized& q, Mat& qerror,
+                     Int k);
+  /** Set mat to the entries in q and zero elsewhere. */
+  void topk_unquantize(const TopKQuantized& q, Mat& mat);
+  void topk_unquantize(const TopKQuantized& q, DistMat& mat);
+  /** Add the entries in q to mat. */
+  void topk_unquantize_add(const TopKQuantized& q, Mat& mat);
+
+  /**
+   * Inter-model sum of top-k sparsified gradients with error feedback. Each
+   * model keeps the k = count / proportion largest-magnitude entries of
+   * mat + qerror (at least one). With a power-of-two number of models the
+   * sparse vectors are summed by recursive doubling, merging at each step;
+   * otherwise they are allgathered and summed locally. mat is replaced by
+   * the (sparse) sum, identical on every model.
+   */
+  void intermodel_sum_topk(lbann_comm* comm, Mat& mat, Mat& qerror,
+                           int proportion);
+  void intermodel_sum_topk(lbann_comm* comm, DistMat& mat, Mat& qerror,
+                           int proportion);
+
+  /**
+   * QSGD-style multi-level stochastic quantization. Each column is split
+   * into buckets of at most QSGD_BUCKET_SIZE rows; a bucket stores its
+   * max-norm followed by one bits-bit code per entry, a sign bit and a level
+   * in [0, s] with s = 2^(bits-1) - 1. An entry v is rounded to level
+   * floor(|v| / norm * s) or the one above it, with probability equal to the
+   * remainder, so unquantizing gives v in expectation. The random numbers are
+   * counter_random(key, position), so the result depends only on key.
+   * @param mat The matrix to quantize.
+   * @param qmat The output quantized matrix.
+   * @param bits Bits per entry: 2, 4 or 8.
+   * @param key Random stream to use.
+   */
+  void qsgd_quantize(const Mat& mat, QuantizedMatrix& qmat, int bits,
+                     uint64_t key);
+  /** Unquantize a QSGD-quantized matrix. */
+  void qsgd_unquantize(const QuantizedMatrix& qmat, Mat& mat, int bits);
+  /** Unquantize a QSGD-quantized matrix, adding to the entries of mat. */
+  void qsgd_unquantize_add(const QuantizedMatrix& qmat, Mat& mat, int bits);
+  /** Return the height of mat after qsgd_quantize with bits bits. */
+  Int get_qsgd_matrix_height(const Mat& mat, int bits) const;
+  /**
+   * Inter-model sum with QSGD quantization of bits bits per entry in the
+   * ring reduce-scatter and allgather. The quantization is unbiased, so
+   * there is no error feedback. Each call draws new random streams.
+   */
+  void intermodel_sum_qsgd(lbann_comm* comm, Mat& mat, int bits);
+  void intermodel_sum_qsgd(lbann_comm* comm, DistMat& mat, int bits);
+  /** Seed the QSGD random numbers and restart their streams. */
+  void set_qsgd_seed(uint64_t seed) {
+    qsgd_seed = seed;
+    qsgd_round = 0;
+  }
+
   /**
    * Compress the output of threshold_quantize.
    * This uses Golomb-Rice coding, with the quotient stored first, followed by
@@ -302,6 +459,15 @@ public:
   }
   /** Return the most recent number of quantized entries. */
   size_t get_quantized_count() const { return quantized_count; }
+  /**
+   * Release the persistent requests of the ring collectives. Otherwise they
+   * are kept for the most recently reduced MAX_RING_REQUEST_MATS matrices.
+   */
+  void free_ring_requests();
+  /** Return the number of matrices holding persistent ring requests. */
+  size_t get_num_ring_request_sets() const { return ring_requests.size(); }
+  /** Most matrices whose ring requests are kept. */
+  static const size_t MAX_RING_REQUEST_MATS = 256;
 
 private:
   /** Number of bits per quantized word. */
@@ -319,6 +485,8 @@ private:
   static const Int NUM_RECON_SAMPLES = 128;
   /** Samples to use to approximate column averages in onebit quantization. */
   static const Int NUM_ONEBIT_SAMPLES = 128;
+  /** Rows scanned per kernel call in threshold_scan_column. */
+  static const Int THRESHOLD_SCAN_BLOCK = 1024;
   /** Factor used when computing header lengths in adaptive quantization. */
 #if LBANN_QUANTIZER_TERNARY
   static const int HEADER_FACTOR = 4;
@@ -327,6 +495,8 @@ private:
 #endif
   /** Max factor by which adaptive quantization can exceed optimal amount. */
   static const Int MAX_QUANTIZED_EXCESS = 4;
+  /** Messages with fewer entries than this keep raw positions. */
+  static const Int MIN_CODED_ENTRIES = 64;
 
   /** Bytes sent in doing the reduce-scatter. */
   size_t rs_bytes_sent;
@@ -357,11 +527,167 @@ private:
   /** Most recent number of quantized entries. */
   size_t quantized_count;
 
-  /** Pre-allocated receive buffers for adaptive quantization. */
-  std::unordered_map<Int, std::vector<uint32_t>> adaptive_recv32_bufs1;
-  std::unordered_map<Int, std::vector<uint32_t>> adaptive_recv32_bufs2;
-  std::unordered_map<Int, std::vector<uint64_t>> adaptive_recv64_bufs1;
-  std::unordered_map<Int, std::vector<uint64_t>> adaptive_recv64_bufs2;
+  /** Algorithm used by intermodel_sum. */
+  allreduce_algorithm allreduce_alg;
+  /**
+   * Autotuned choices: the fastest algorithm for each tested size, in
+   * increasing size, and the number of models they were measured with.
+   */
+  std::vector<std::pair<Int, allreduce_algorithm>> allreduce_crossovers;
+  int allreduce_tuned_models;
+  /** Scratch buffers for the allreduce algorithms. */
+  std::vector<DataType> allreduce_recv_buf;
+  Mat allreduce_contig;
+
+  /** Ring allreduce (the original custom allreduce). */
+  void intermodel_sum_ring(lbann_comm* comm, Mat& mat);
+  /** Ring allreduce sending ring_precision payloads. */
+  void intermodel_sum_ring_reduced(lbann_comm* comm, Mat& mat);
+  /** Recursive-doubling allreduce of count contiguous entries. */
+  void intermodel_sum_recursive_doubling(lbann_comm* comm, DataType* buf,
+                                         Int count);
+  /** Rabenseifner allreduce of count contiguous entries. */
+  void intermodel_sum_rabenseifner(lbann_comm* comm, DataType* buf,
+                                   Int count);
+  /**
+   * Fold a non-power-of-two number of models onto the largest power of two,
+   * pof2. Returns this model's rank among the pof2 models, or -1 if it sat
+   * out (its data was added to a partner's).
+   */
+  int allreduce_fold(lbann_comm* comm, DataType* buf, Int count, int pof2);
+  /** Send the result back to the models that sat out of the fold. */
+  void allreduce_unfold(lbann_comm* comm, DataType* buf, Int count, int pof2);
+  /** Map a rank among the pof2 folded models back to its model rank. */
+  static int allreduce_unfolded_rank(int new_rank, int rem) {
+    return new_rank < rem ? new_rank * 2 + 1 : new_rank + rem;
+  }
+
+  /**
+   * Threshold quantize height contiguous entries starting at position start
+   * using the vectorized kernel and append them to quant. If prev_pos is not
+   * null, positions are delta encoded relative to it and it is updated.
+   * Only valid when uqtype is 32 bits.
+   */
+  void threshold_scan_column(const DataType* mat_buf, DataType* qerror_buf,
+                             Unsigned start, Int height, DataType pos_thresh,
+                             DataType neg_thresh, ThreshQuantized& quant,
+                             Unsigned* prev_pos);
+
+  /** Number of bits resolved per pass of the top-k radix selection. */
+  static const int TOPK_RADIX_BITS = 11;
+  /** Scratch for top-k sparsification. */
+  TopKQuantized topk_send;
+  TopKQuantized topk_recv;
+  TopKQuantized topk_merged;
+  /**
+   * Return the magnitude key of the k-th largest entry of the count entries
+   * of buf (radix selection over the IEEE bit pattern of |x|), and in
+   * num_equal how many entries with exactly that key are among the k largest.
+   */
+  uint64_t topk_select_key(const DataType* buf, Int height, Int width,
+                           Int ldim, Int k, Int& num_equal);
+  /** Sum-merge two position-sorted sparse vectors into out. */
+  static void topk_merge(const TopKQuantized& a, const TopKQuantized& b,
+                         TopKQuantized& out);
+
+  /** Maximum number of rows sharing a norm in QSGD quantization. */
+  static const Int QSGD_BUCKET_SIZE = 512;
+  /** Seed and number of rounds drawn for QSGD random streams. */
+  uint64_t qsgd_seed;
+  uint64_t qsgd_round;
+  /** Reused buffers for QSGD quantization in the ring. */
+  QuantizedMatrix qsgd_to_send;
+  QuantizedMatrix qsgd_rs_recv;
+  QuantizedMatrix qsgd_ag_send;
+  QuantizedMatrix qsgd_ag_recv;
+  /**
+   * Compute the QSGD layout of a column of height rows: rows per bucket,
+   * number of buckets, and words per bucket (including the norm).
+   */
+  void get_qsgd_layout(Int height, int bits, Int& bucket_rows,
+                       Int& num_buckets, Int& bucket_words) const;
+  /** Shared implementation of qsgd_unquantize(_add). */
+  void qsgd_unquantize_impl(const QuantizedMatrix& qmat, Mat& mat, int bits,
+                            bool add);
+  /** Return a fresh QSGD random stream key for this process. */
+  uint64_t next_qsgd_key(lbann_comm* comm);
+
+  /**
+   * Buffers for adaptive quantization, allocated once (they only grow, to
+   * the largest matrix seen) so the ring's persistent requests stay bound.
+   */
+  template <typename T>
+  struct adaptive_buffers {
+    aligned_vector<T> rs_quant;
+    aligned_vector<T> local_send;
+    aligned_vector<T> recv1;
+    aligned_vector<T> recv2;
+    aligned_vector<T> coded;
+  };
+  adaptive_buffers<uint32_t> adaptive_bufs32;
+  adaptive_buffers<uint64_t> adaptive_bufs64;
+  /** Codec for positions in the adaptive quantized allreduce. */
+  position_codec pos_codec;
+  /** Reused buffers for the ring allreduce and one-bit quantization. */
+  aligned_vector<DataType> ring_recv_buf;
+  Mat ring_rs_recv;
+  /** Wire precision and 16-bit buffers of the unquantized ring. */
+  payload_precision ring_precision;
+  aligned_vector<uint16_t> ring_payload_send;
+  aligned_vector<uint16_t> ring_payload_recv;
+  aligned_vector<qtype> onebit_recv_buf;
+  QuantizedMatrix onebit_rs_recv;
+  QuantizedMatrix onebit_to_send;
+  QuantizedMatrix onebit_ag_send;
+  QuantizedMatrix onebit_ag_recv;
+
+  /** Segment size for the pipelined reduce-scatter (0 = off). */
+  size_t ring_segment_bytes;
+  /** Number of segments in flight in the pipelined reduce-scatter. */
+  static const int NUM_RING_SLOTS = 2;
+  /** Per-slot buffers for pipelined one-bit and adaptive quantization. */
+  QuantizedMatrix onebit_seg_send[NUM_RING_SLOTS];
+  QuantizedMatrix onebit_seg_recv[NUM_RING_SLOTS];
+  QuantizedMatrix qsgd_seg_send[NUM_RING_SLOTS];
+  QuantizedMatrix qsgd_seg_recv[NUM_RING_SLOTS];
+  aligned_vector<uint32_t> adaptive32_seg_send[NUM_RING_SLOTS];
+  aligned_vector<uint32_t> adaptive32_seg_recv[NUM_RING_SLOTS];
+  aligned_vector<uint64_t> adaptive64_seg_send[NUM_RING_SLOTS];
+  aligned_vector<uint64_t> adaptive64_seg_recv[NUM_RING_SLOTS];
+  /** Return the adaptive per-slot buffers for T. */
+  template <typename T>
+  aligned_vector<T>* get_adaptive_seg_bufs(bool send);
+  /** Return the number of columns of mat per pipelined segment. */
+  Int get_segment_cols(const Mat& mat) const {
+    const size_t col_bytes = std::max(mat.Height(), (Int) 1) * sizeof(DataType);
+    return std::max((Int) 1, (Int) (ring_segment_bytes / col_bytes));
+  }
+
+  /** Phases of the ring collectives, for keying persistent requests. */
+  enum ring_phase { RS_SEND, RS_RECV, AG_SEND, AG_RECV, RS_SEG_SEND,
+                    RS_SEG_RECV };
+  /**
+   * Persistent requests for the ring collectives of one matrix, one per
+   * (phase, step), so repeated reductions of a layer reuse their MPI
+   * requests.
+   */
+  struct ring_request_set {
+    std::map<std::pair<int, int>, lbann_comm::persistent_request> reqs;
+    /** Value of ring_request_clock when the set was last used. */
+    uint64_t last_use = 0;
+  };
+  /**
+   * Request sets by matrix buffer. Requests rebind when their buffer, count
+   * or peer changes, so a set left by a freed matrix whose address is reused
+   * is still correct. The least recently used set is freed once there are
+   * MAX_RING_REQUEST_MATS, so temporary matrices do not pile up requests.
+   */
+  std::unordered_map<const DataType*, ring_request_set> ring_requests;
+  uint64_t ring_request_clock = 0;
+  /** Return the persistent request for phase and step of mat's collective. */
+  lbann_comm::persistent_request& get_ring_request(const Mat& mat,
+                                                   ring_phase phase,
+                                                   int step);
 
   /** Return the height of mat after quantization with quantize(). */
   inline Int get_quantized_matrix_height(const Mat& mat) const {
@@ -392,8 +718,16 @@ private:
   /**
    * Variant of adaptive_threshold_unquantize that adds its entries.
    */
-  template <typename T>
-  void adaptive_threshold_unquantize_add(const std::vector<T>& q, Mat& mat);
+  template <typename T, typename Alloc>
+  void adaptive_threshold_unquantize_add(const std::vector<T, Alloc>& q,
+                                         Mat& mat);
+  /**
+   * Unquantize (or, if add, add) a message whose positions were coded by
+   * encode_adaptive_positions. Columns are decoded in parallel.
+   */
+  template <typename T, typename Alloc>
+  void adaptive_threshold_unquantize_coded(const std::vector<T, Alloc>& q,
+                                           Mat& mat, bool add);
   /**
    * Variant of adaptive_threshold_quantize that also replaces entries in mat
    * with their quantized version. This is equivalent to:
@@ -401,21 +735,20 @@ private:
    * adaptive_threshold_unquantize(q, mat);
    * Note this does not (currently) support compression.
    */
-  template <typename T>
-  void adaptive_threshold_quantize_replace(Mat& mat, std::vector<T>& q,
+  template <typename T, typename Alloc>
+  void adaptive_threshold_quantize_replace(Mat& mat, std::vector<T, Alloc>& q,
                                            Mat& qerror, int proportion);
   /**
    * Ensure that q is no more than a factor of MAX_QUANTIZED_EXCESS larger
    * than optimal.
    */
-  template <typename T>
-  void adaptive_threshold_bound(const Mat& mat, Mat& qerror, std::vector<T>& q,
-                                int proportion);
+  template <typename T, typename Alloc>
+  void adaptive_threshold_bound(const Mat& mat, Mat& qerror,
+                                std::vector<T, Alloc>& q, int proportion);
   template <typename T>
   void intermodel_sum_adaptive_threshold_quantized_impl(
     lbann_comm* comm, Mat& mat, Mat& qerror, int proportion, Mat& im_qerror,
-    std::unordered_map<Int, std::vector<T>>& adaptive_recv_bufs1,
-    std::unordered_map<Int, std::vector<T>>& adaptive_recv_bufs2);
+    adaptive_buffers<T>& bufs);
 
   /** Handle compression starting from arbitrary locations. */
   void compress_thresholds(const ThreshQuantized& q,
@@ -435,6 +768,20 @@ private:
     std::function<T*(Mat&, int&)> get_recv_buf,
     std::function<void(T*, Mat&)> recv_trans);
 
+  /**
+   * Pipelined variant of intermodel_ring_reduce_scatter. Each step's block
+   * is split into segments of segment_cols columns, with up to
+   * NUM_RING_SLOTS segments in flight. The callbacks get the slot to use
+   * and must keep a slot's buffer valid until the slot is reused. Receive
+   * sizes must be known (no var_recv).
+   */
+  template <typename T>
+  void intermodel_ring_reduce_scatter_pipelined(
+    lbann_comm* comm, Mat& mat, Int segment_cols,
+    std::function<T*(Mat&, IR, IR, int, int&)> send_trans,
+    std::function<T*(Mat&, int, int&)> get_recv_buf,
+    std::function<void(T*, Mat&, int)> recv_trans);
+
   template <typename T>
   void intermodel_ring_allgather(
     lbann_comm* comm, Mat& mat, bool var_recv,
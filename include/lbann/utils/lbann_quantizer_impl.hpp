@@ -29,14 +29,16 @@
 #ifndef LBANN_QUANTIZER_IMPL_HPP_INCLUDED
 #define LBANN_QUANTIZER_IMPL_HPP_INCLUDED
 
+#include <limits>
 #include <omp.h>
+#include "lbann/utils/lbann_quantizer_kernels.hpp"
 
 namespace lbann
 {
 
-template <typename T>
+template <typename T, typename Alloc>
 void lbann_quantizer::adaptive_threshold_quantize(
-  const Mat& mat, std::vector<T>& q, Mat& qerror, int proportion) {
+  const Mat& mat, std::vector<T, Alloc>& q, Mat& qerror, int proportion) {
   // Ensure T is reasonable.
   static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value &&
                 (sizeof(T) == 4 || sizeof(T) == 8),
@@ -124,19 +126,23 @@ void lbann_quantizer::adaptive_threshold_quantize(
   adaptive_threshold_bound(mat, qerror, q, proportion);
 }
 
-template <typename T>
+template <typename T, typename Alloc>
 void lbann_quantizer::adaptive_threshold_quantize(
-  const DistMat& mat, std::vector<T>& q, Mat& qerror, int proportion) {
+  const DistMat& mat, std::vector<T, Alloc>& q, Mat& qerror, int proportion) {
   adaptive_threshold_quantize(mat.LockedMatrix(), q, qerror, proportion);
 }
 
-template <typename T>
+template <typename T, typename Alloc>
 void lbann_quantizer::adaptive_threshold_unquantize(
-  const std::vector<T>& q, Mat& mat) {
+  const std::vector<T, Alloc>& q, Mat& mat) {
   // Ensure T is reasonable.
   static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value &&
                 (sizeof(T) == 4 || sizeof(T) == 8),
                 "Quantization only works with unsigned 32- or 64-bit integers");
+  if (adaptive_position_codec(q) != position_codec::RAW) {
+    adaptive_threshold_unquantize_coded(q, mat, false);
+    return;
+  }
   DataType* __restrict__ buf = mat.Buffer();
   const Unsigned header_len = mat.Width() * HEADER_FACTOR;
   const Int height = mat.Height();
@@ -162,19 +168,23 @@ void lbann_quantizer::adaptive_threshold_unquantize(
   }
 }
 
-template <typename T>
+template <typename T, typename Alloc>
 void lbann_quantizer::adaptive_threshold_unquantize(
-  const std::vector<T>& q, DistMat& mat) {
+  const std::vector<T, Alloc>& q, DistMat& mat) {
   adaptive_threshold_unquantize(q, mat.Matrix());
 }
 
-template <typename T>
+template <typename T, typename Alloc>
 void lbann_quantizer::adaptive_threshold_unquantize_add(
-  const std::vector<T>& q, Mat& mat) {
+  const std::vector<T, Alloc>& q, Mat& mat) {
   // Ensure T is reasonable.
   static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value &&
                 (sizeof(T) == 4 || sizeof(T) == 8),
                 "Quantization only works with unsigned 32- or 64-bit integers");
+  if (adaptive_position_codec(q) != position_codec::RAW) {
+    adaptive_threshold_unquantize_coded(q, mat, true);
+    return;
+  }
   DataType* __restrict__ buf = mat.Buffer();
   const Unsigned header_len = mat.Width() * HEADER_FACTOR;
   const Int height = mat.Height();
@@ -205,9 +215,227 @@ void lbann_quantizer::adaptive_threshold_unquantize_add(
   }
 }
 
-template <typename T>
+template <typename T, typename Alloc>
+lbann_quantizer::position_codec lbann_quantizer::adaptive_position_codec(
+  const std::vector<T, Alloc>& q) {
+  // A raw message always starts with the offset of its first entry, which
+  // is small. Coded messages instead start with a tag: the top bit set, the
+  // Rice parameter in bits 8-15 and the codec in the low byte.
+  if (q.empty() || !(q[0] >> (sizeof(T) * 8 - 1))) {
+    return position_codec::RAW;
+  }
+  return static_cast<position_codec>(q[0] & 0xFF);
+}
+
+template <typename T, typename Alloc>
+void lbann_quantizer::encode_adaptive_positions(
+  std::vector<T, Alloc>& q, Int width, Int ldim, aligned_vector<T>& scratch) {
+  using namespace quantizer_kernels;
+  if (pos_codec == position_codec::RAW) {
+    return;
+  }
+  const Int header_len = HEADER_FACTOR * width + 1;
+  const Int num_entries = q[HEADER_FACTOR * width] - header_len;
+  if (num_entries < MIN_CODED_ENTRIES) {
+    return;
+  }
+  // Every entry is coded as ((pos - prev) << 1) | sign, where prev is the
+  // previous position in its column, or the start of the column. The mean
+  // code reflects the density of the message and sets the Rice parameter.
+  uint64_t code_sum = 0;
+  uint64_t max_code = 0;
+  #pragma omp parallel for schedule(static) reduction(+:code_sum) \
+    reduction(max:max_code)
+  for (Int col = 0; col < width; ++col) {
+    const Int header_loc = HEADER_FACTOR * col;
+    T prev = col * ldim;
+    for (T i = q[header_loc]; i < q[header_loc + HEADER_FACTOR]; ++i) {
+      const T pos = q[i] >> 1;
+      const uint64_t code = (uint64_t(pos - prev) << 1) | (q[i] & 1);
+      prev = pos;
+      code_sum += code;
+      max_code = std::max(max_code, code);
+    }
+  }
+  const uint64_t mean_code = code_sum / num_entries;
+  int k = 0;
+  while (k < 40 && (uint64_t(2) << k) <= mean_code) {
+    ++k;
+  }
+  // Size every column under both codecs. Each column's stream starts with
+  // its entry count: 32 bits for Golomb-Rice, the first varint otherwise.
+  const bool varint_ok = max_code <= 0xFFFFFFFFull;
+  std::vector<uint64_t> rice_offsets(width + 1, 0);
+  std::vector<uint64_t> varint_offsets(width + 1, 0);
+  #pragma omp parallel for schedule(static)
+  for (Int col = 0; col < width; ++col) {
+    const Int header_loc = HEADER_FACTOR * col;
+    const T start = q[header_loc];
+    const T end = q[header_loc + HEADER_FACTOR];
+    const uint64_t num_groups = (end - start + 1 + 3) / 4;
+    uint64_t rice_bits = 32;
+    uint64_t varint_len = num_groups + 4*num_groups - (end - start + 1) +
+      varint_bytes(end - start);
+    T prev = col * ldim;
+    for (T i = start; i < end; ++i) {
+      const T pos = q[i] >> 1;
+      const uint64_t code = (uint64_t(pos - prev) << 1) | (q[i] & 1);
+      prev = pos;
+      rice_bits += rice_writer::cost(code, k);
+      varint_len += varint_bytes(code);
+    }
+    rice_offsets[col + 1] = rice_bits;
+    varint_offsets[col + 1] = varint_len;
+  }
+  for (Int col = 0; col < width; ++col) {
+    rice_offsets[col + 1] += rice_offsets[col];
+    varint_offsets[col + 1] += varint_offsets[col];
+  }
+  auto to_words = [] (uint64_t bytes) {
+    return (bytes + VARINT_DECODE_SLACK + sizeof(T) - 1) / sizeof(T);
+  };
+  const uint64_t rice_words = to_words((rice_offsets[width] + 7) / 8);
+  const uint64_t varint_words = to_words(varint_offsets[width]);
+  // Golomb-Rice column offsets are in bits and must fit in a word.
+  const bool rice_ok =
+    rice_offsets[width] <= (uint64_t) std::numeric_limits<T>::max();
+  position_codec codec = pos_codec;
+  if (codec == position_codec::AUTO) {
+    // Group varint decodes faster, so Golomb-Rice has to be clearly
+    // smaller, which happens for dense messages with small gaps.
+    codec = rice_ok && (!varint_ok || 9 * rice_words < 8 * varint_words) ?
+      position_codec::GOLOMB_RICE : position_codec::VARINT;
+  }
+  if ((codec == position_codec::VARINT && !varint_ok) ||
+      (codec == position_codec::GOLOMB_RICE && !rice_ok)) {
+    return;
+  }
+  const uint64_t words =
+    codec == position_codec::GOLOMB_RICE ? rice_words : varint_words;
+  // Never grow the message, so receivers can keep sizing for raw ones.
+  if (words >= (uint64_t) num_entries) {
+    return;
+  }
+  const std::vector<uint64_t>& offsets =
+    codec == position_codec::GOLOMB_RICE ? rice_offsets : varint_offsets;
+  scratch.resize(header_len + words);
+  std::copy(q.begin(), q.begin() + header_len, scratch.begin());
+  std::fill(scratch.begin() + header_len, scratch.end(), 0);
+  scratch[0] = (T(1) << (sizeof(T) * 8 - 1)) | (T(k) << 8) | (T) codec;
+  for (Int col = 1; col < width; ++col) {
+    scratch[HEADER_FACTOR * col] = offsets[col];
+  }
+  scratch[HEADER_FACTOR * width] = header_len + words;
+  unsigned char* payload = reinterpret_cast<unsigned char*>(&scratch[header_len]);
+  if (codec == position_codec::GOLOMB_RICE) {
+    // Columns can share bytes, so this is serial.
+    rice_writer writer = {payload, 0};
+    for (Int col = 0; col < width; ++col) {
+      const Int header_loc = HEADER_FACTOR * col;
+      writer.write_bits(q[header_loc + HEADER_FACTOR] - q[header_loc], 32);
+      T prev = col * ldim;
+      for (T i = q[header_loc]; i < q[header_loc + HEADER_FACTOR]; ++i) {
+        const T pos = q[i] >> 1;
+        writer.write((uint64_t(pos - prev) << 1) | (q[i] & 1), k);
+        prev = pos;
+      }
+    }
+  } else {
+    #pragma omp parallel for schedule(static)
+    for (Int col = 0; col < width; ++col) {
+      const Int header_loc = HEADER_FACTOR * col;
+      unsigned char* out = payload + offsets[col];
+      uint32_t group[4];
+      group[0] = q[header_loc + HEADER_FACTOR] - q[header_loc];
+      int num_in_group = 1;
+      T prev = col * ldim;
+      for (T i = q[header_loc]; i < q[header_loc + HEADER_FACTOR]; ++i) {
+        const T pos = q[i] >> 1;
+        group[num_in_group++] = (uint32_t) (((pos - prev) << 1) | (q[i] & 1));
+        prev = pos;
+        if (num_in_group == 4) {
+          out += varint_encode_group(group, out);
+          num_in_group = 0;
+        }
+      }
+      if (num_in_group > 0) {
+        std::fill(group + num_in_group, group + 4, 0);
+        varint_encode_group(group, out);
+      }
+    }
+  }
+  std::copy(scratch.begin(), scratch.end(), q.begin());
+  q.resize(scratch.size());
+}
+
+template <typename T, typename Alloc>
+void lbann_quantizer::adaptive_threshold_unquantize_coded(
+  const std::vector<T, Alloc>& q, Mat& mat, bool add) {
+  using namespace quantizer_kernels;
+  const Int width = mat.Width();
+  const Int ldim = mat.LDim();
+  DataType* __restrict__ buf = mat.Buffer();
+  const position_codec codec = adaptive_position_codec(q);
+  const int k = (q[0] >> 8) & 0xFF;
+  const unsigned char* payload =
+    reinterpret_cast<const unsigned char*>(&q[HEADER_FACTOR * width + 1]);
+  #pragma omp parallel for schedule(static)
+  for (Int col = 0; col < width; ++col) {
+    const Int header_loc = HEADER_FACTOR * col;
+    const Int col_offset = col * ldim;
+    // Extract averages.
+    DataType pos_recon, neg_recon;
+    memcpy(&pos_recon, &q[header_loc + 1], sizeof(pos_recon));
+    memcpy(&neg_recon, &q[header_loc + 2], sizeof(neg_recon));
+#if LBANN_QUANTIZER_TERNARY
+    const Int height = mat.Height();
+    DataType zero_recon;
+    memcpy(&zero_recon, &q[header_loc + 3], sizeof(zero_recon));
+    if (add) {
+      for (Int row = 0; row < height; ++row) {
+        buf[row + col_offset] += zero_recon;
+      }
+      pos_recon -= zero_recon;
+      neg_recon += zero_recon;
+    } else {
+      std::fill_n(&buf[col_offset], height, zero_recon);
+    }
+#endif
+    const uint64_t start = col == 0 ? 0 : q[header_loc];
+    T pos = col_offset;
+    if (codec == position_codec::GOLOMB_RICE) {
+      rice_reader reader = {payload, start};
+      const uint64_t num = reader.read_bits(32);
+      for (uint64_t i = 0; i < num; ++i) {
+        const uint64_t code = reader.read(k);
+        pos += code >> 1;
+        const DataType val = code & 1 ? pos_recon : neg_recon;
+        if (add) buf[pos] += val;
+        else buf[pos] = val;
+      }
+    } else {
+      const unsigned char* in = payload + start;
+      uint32_t group[4];
+      in = varint_decode_group(in, group);
+      const uint32_t num = group[0];
+      int j = 1;
+      for (uint32_t i = 0; i < num; ++i, ++j) {
+        if (j == 4) {
+          in = varint_decode_group(in, group);
+          j = 0;
+        }
+        pos += group[j] >> 1;
+        const DataType val = group[j] & 1 ? pos_recon : neg_recon;
+        if (add) buf[pos] += val;
+        else buf[pos] = val;
+      }
+    }
+  }
+}
+
+template <typename T, typename Alloc>
 void lbann_quantizer::adaptive_threshold_quantize_replace(
-  Mat& mat, std::vector<T>& q, Mat& qerror, int proportion) {
+  Mat& mat, std::vector<T, Alloc>& q, Mat& qerror, int proportion) {
   // Ensure T is reasonable.
   static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value &&
                 (sizeof(T) == 4 || sizeof(T) == 8),
@@ -292,9 +520,9 @@ void lbann_quantizer::adaptive_threshold_quantize_replace(
   adaptive_threshold_bound(mat, qerror, q, proportion);
 }
 
-template <typename T>
+template <typename T, typename Alloc>
 void lbann_quantizer::adaptive_threshold_bound(
-  const Mat& mat, Mat& qerror, std::vector<T>& q, int proportion) {
+  const Mat& mat, Mat& qerror, std::vector<T, Alloc>& q, int proportion) {
   // Ensure T is reasonable.
   static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value &&
                 (sizeof(T) == 4 || sizeof(T) == 8),
@@ -354,60 +582,102 @@ void lbann_quantizer::adaptive_threshold_bound(
 template <typename T>
 void lbann_quantizer::intermodel_sum_adaptive_threshold_quantized_impl(
   lbann_comm* comm, Mat& mat, Mat& qerror, int proportion, Mat& im_qerror,
-  std::unordered_map<Int, std::vector<T>>& adaptive_recv_bufs1,
-  std::unordered_map<Int, std::vector<T>>& adaptive_recv_bufs2) {
+  adaptive_buffers<T>& bufs) {
   if (qerror.Height() == 0) {
     qerror.Resize(mat.Height(), mat.Width(), mat.LDim());
     Zero(qerror);
   }
   const Int max_size = mat.Width() * HEADER_FACTOR + 1 +
     MAX_QUANTIZED_EXCESS * mat.Width() * mat.Height() / proportion;
-  if (adaptive_recv_bufs1.find(max_size) == adaptive_recv_bufs1.end()) {
-    // Initialize receive buffers.
-    adaptive_recv_bufs1.emplace(std::make_pair(max_size, std::vector<T>(max_size)));
-    adaptive_recv_bufs2.emplace(std::make_pair(max_size, std::vector<T>(max_size)));
+  if (bufs.recv1.size() < (size_t) max_size) {
+    // Grow the receive buffers; smaller matrices reuse them.
+    bufs.recv1.resize(max_size);
+    bufs.recv2.resize(max_size);
   }
-  std::vector<T> rs_quant;
-  std::vector<T>& rs_recv = adaptive_recv_bufs1[max_size];
-  /* NOTE: std::vector::resize() initializes elements. This is unnecessary, but
-   * there is no way around it. You cannot use reserve() because that does not
-   * update the size or guarantee data() returns anything useful. As far as I
-   * can tell, the only way around this would be to either ensure the
-   * _implementation_ makes guarantees for reserve(), or implement a custom
-   * version of vector.
-   */
-  auto rs_send_trans = 
-    [&qerror, &rs_quant, proportion, this]
-    (Mat& mat, IR h, IR w, int& count) {
-      auto to_send = mat(h, w);
-      auto to_send_qerr = qerror(h, w);
-      rs_quant.clear();
-      adaptive_threshold_quantize(to_send, rs_quant, to_send_qerr, proportion);
-      count = rs_quant.size();
-      return rs_quant.data();
-    };
-  auto rs_get_recv_buf = 
-    [&rs_recv, max_size] (Mat& mat, int& count) {
-      count = max_size;
-      return rs_recv.data();
+  auto& rs_quant = bufs.rs_quant;
+  auto& rs_recv = bufs.recv1;
+  if (ring_segment_bytes > 0) {
+    aligned_vector<T>* seg_send = get_adaptive_seg_bufs<T>(true);
+    aligned_vector<T>* seg_recv = get_adaptive_seg_bufs<T>(false);
+    auto seg_max_size = [proportion] (const Mat& seg) {
+      return seg.Width() * HEADER_FACTOR + 1 +
+        MAX_QUANTIZED_EXCESS * seg.Width() * seg.Height() / proportion;
     };
-  auto rs_recv_trans = 
-    [&rs_recv, this]
-    (T* buf, Mat& accum) {
-      adaptive_threshold_unquantize_add(rs_recv, accum);
-      // Fix the received bytes count.
-      rs_bytes_received -= rs_recv.size() * sizeof(T);
-      rs_bytes_received += rs_recv[accum.Width() * HEADER_FACTOR];
-    };
-  intermodel_ring_reduce_scatter<T>(comm, mat, false, rs_send_trans,
-                                    rs_get_recv_buf, rs_recv_trans);
-  std::vector<T> local_send;
-  std::vector<T> ag_send = adaptive_recv_bufs1[max_size];
-  std::vector<T> ag_recv = adaptive_recv_bufs2[max_size];
+    auto seg_send_trans =
+      [&qerror, &bufs, seg_send, proportion, this]
+      (Mat& mat, IR h, IR w, int slot, int& count) {
+        auto to_send = mat(h, w);
+        auto to_send_qerr = qerror(h, w);
+        seg_send[slot].clear();
+        adaptive_threshold_quantize(to_send, seg_send[slot], to_send_qerr,
+                                    proportion);
+        encode_adaptive_positions(seg_send[slot], to_send.Width(),
+                                  to_send.LDim(), bufs.coded);
+        count = seg_send[slot].size();
+        return seg_send[slot].data();
+      };
+    auto seg_get_recv_buf =
+      [seg_recv, seg_max_size] (Mat& seg, int slot, int& count) {
+        count = seg_max_size(seg);
+        if (seg_recv[slot].size() < (size_t) count) {
+          seg_recv[slot].resize(count);
+        }
+        return seg_recv[slot].data();
+      };
+    auto seg_recv_trans =
+      [seg_recv, seg_max_size, this] (T*, Mat& accum, int slot) {
+        adaptive_threshold_unquantize_add(seg_recv[slot], accum);
+        // Fix the received bytes count.
+        rs_bytes_received -= seg_max_size(accum) * sizeof(T);
+        rs_bytes_received +=
+          seg_recv[slot][accum.Width() * HEADER_FACTOR] * sizeof(T);
+      };
+    intermodel_ring_reduce_scatter_pipelined<T>(
+      comm, mat, get_segment_cols(mat), seg_send_trans, seg_get_recv_buf,
+      seg_recv_trans);
+  } else {
+    /* NOTE: std::vector::resize() initializes elements. This is unnecessary, but
+     * there is no way around it. You cannot use reserve() because that does not
+     * update the size or guarantee data() returns anything useful. As far as I
+     * can tell, the only way around this would be to either ensure the
+     * _implementation_ makes guarantees for reserve(), or implement a custom
+     * version of vector.
+     */
+    auto rs_send_trans = 
+      [&qerror, &rs_quant, &bufs, proportion, this]
+      (Mat& mat, IR h, IR w, int& count) {
+        auto to_send = mat(h, w);
+        auto to_send_qerr = qerror(h, w);
+        rs_quant.clear();
+        adaptive_threshold_quantize(to_send, rs_quant, to_send_qerr, proportion);
+        encode_adaptive_positions(rs_quant, to_send.Width(), to_send.LDim(),
+                                  bufs.coded);
+        count = rs_quant.size();
+        return rs_quant.data();
+      };
+    auto rs_get_recv_buf = 
+      [&rs_recv, max_size] (Mat& mat, int& count) {
+        count = max_size;
+        return rs_recv.data();
+      };
+    auto rs_recv_trans = 
+      [&rs_recv, max_size, this]
+      (T* buf, Mat& accum) {
+        adaptive_threshold_unquantize_add(rs_recv, accum);
+        // Fix the received bytes count.
+        rs_bytes_received -= max_size * sizeof(T);
+        rs_bytes_received += rs_recv[accum.Width() * HEADER_FACTOR] * sizeof(T);
+      };
+    intermodel_ring_reduce_scatter<T>(comm, mat, false, rs_send_trans,
+                                      rs_get_recv_buf, rs_recv_trans);
+  }
+  auto& local_send = bufs.local_send;
+  auto& ag_send = bufs.recv1;
+  auto& ag_recv = bufs.recv2;
   int send_size = 0;
   bool local_sent = false;
   auto ag_reduced_trans =
-    [&im_qerror, &local_send, &send_size, proportion, this]
+    [&im_qerror, &local_send, &send_size, &bufs, proportion, this]
     (Mat& reduced) {
       if (im_qerror.Height() == 0) {
         im_qerror.Resize(reduced.Height(), reduced.Width(), reduced.LDim());
@@ -415,6 +685,8 @@ void lbann_quantizer::intermodel_sum_adaptive_threshold_quantized_impl(
       }
       adaptive_threshold_quantize_replace(reduced, local_send, im_qerror,
                                           proportion);
+      encode_adaptive_positions(local_send, reduced.Width(), reduced.LDim(),
+                                bufs.coded);
       send_size = local_send.size();
     };
   auto ag_get_send_buf = [&ag_send, &local_send, &send_size, &local_sent]
@@ -433,13 +705,13 @@ void lbann_quantizer::intermodel_sum_adaptive_threshold_quantized_impl(
       return ag_recv.data();
     };
   auto ag_recv_trans = 
-    [&ag_recv, &send_size, proportion, this]
+    [&ag_recv, &send_size, max_size, this]
     (T*, Mat& accum) {
       adaptive_threshold_unquantize(ag_recv, accum);
       send_size = ag_recv[accum.Width() * HEADER_FACTOR];
       // Fix the received bytes count.
-      ag_bytes_received -= ag_recv.size() * sizeof(T);
-      ag_bytes_received += ag_recv[accum.Width() * HEADER_FACTOR];
+      ag_bytes_received -= max_size * sizeof(T);
+      ag_bytes_received += ag_recv[accum.Width() * HEADER_FACTOR] * sizeof(T);
     };
   auto ag_swap_bufs =
     [&ag_send, &ag_recv, max_size] (T*, T*) {
@@ -448,6 +720,11 @@ void lbann_quantizer::intermodel_sum_adaptive_threshold_quantized_impl(
   intermodel_ring_allgather<T>(comm, mat, false, ag_reduced_trans,
                                ag_get_send_buf, ag_get_recv_buf,
                                ag_recv_trans, ag_swap_bufs);
+  // Undo an odd number of swaps so each ring step keeps its buffers (and
+  // persistent requests) across calls.
+  if ((comm->get_num_models() - 1) % 2 != 0) {
+    std::swap(ag_send, ag_recv);
+  }
 }
 
 template <typename T>
@@ -486,8 +763,9 @@ void lbann_quantizer::intermodel_ring_reduce_scatter(
       IR(dst * cols_per_proc, dst * cols_per_proc + send_col_width), send_size);
     rs_send_trans_time += get_time() - send_trans_start;
     // Send.
-    mpi::Request<T> req;
-    comm->nb_send(send_buf, send_size, dst, req);
+    lbann_comm::persistent_request& send_req =
+      get_ring_request(mat, RS_SEND, step);
+    comm->persistent_send(send_buf, send_size, dst, send_req);
     rs_bytes_sent += send_size * sizeof(T);
     // Get receive buffer.
     double recv_buf_start = get_time();
@@ -498,13 +776,130 @@ void lbann_quantizer::intermodel_ring_reduce_scatter(
     T* recv_buf = get_recv_buf(accum_view, recv_size);
     rs_recv_buf_time += get_time() - recv_buf_start;
     // Receive.
-    comm->recv(recv_buf, recv_size, src);
+    lbann_comm::persistent_request& recv_req =
+      get_ring_request(mat, RS_RECV, step);
+    comm->persistent_recv(recv_buf, recv_size, src, recv_req);
+    comm->wait(recv_req);
     rs_bytes_received += recv_size * sizeof(T);
     // Transform the received portion.
     double recv_trans_start = get_time();
     recv_trans(recv_buf, accum_view);
     rs_recv_trans_time += get_time() - recv_trans_start;
-    comm->wait<T>(req);
+    comm->wait(send_req);
+  }
+  rs_time += get_time() - rs_start;
+}
+
+template <>
+inline aligned_vector<uint32_t>* lbann_quantizer::get_adaptive_seg_bufs<uint32_t>(
+  bool send) {
+  return send ? adaptive32_seg_send : adaptive32_seg_recv;
+}
+
+template <>
+inline aligned_vector<uint64_t>* lbann_quantizer::get_adaptive_seg_bufs<uint64_t>(
+  bool send) {
+  return send ? adaptive64_seg_send : adaptive64_seg_recv;
+}
+
+template <typename T>
+void lbann_quantizer::intermodel_ring_reduce_scatter_pipelined(
+  lbann_comm* comm, Mat& mat, Int segment_cols,
+  std::function<T*(Mat&, IR, IR, int, int&)> send_trans,
+  std::function<T*(Mat&, int, int&)> get_recv_buf,
+  std::function<void(T*, Mat&, int)> recv_trans) {
+  double rs_start = get_time();
+  int rank = comm->get_model_rank();
+  int nprocs = comm->get_num_models();
+  // Same column partition as intermodel_ring_reduce_scatter.
+  Int cols_per_proc = mat.Width() / nprocs;
+  Int cols_remainder = mat.Width() % nprocs;
+  Int local_col_width = cols_per_proc;
+  if (rank == nprocs - 1) local_col_width += cols_remainder;
+  const Int local_col_start = rank * cols_per_proc;
+  const Int num_recv_segs =
+    (local_col_width + segment_cols - 1) / segment_cols;
+  // Segments per step, for keying persistent requests.
+  const Int max_segs =
+    (cols_per_proc + cols_remainder + segment_cols - 1) / segment_cols;
+  lbann_comm::persistent_request* send_reqs[NUM_RING_SLOTS] = {};
+  T* recv_bufs[NUM_RING_SLOTS] = {};
+  int recv_sizes[NUM_RING_SLOTS] = {};
+  for (int step = 1; step < nprocs; ++step) {
+    int dst = (rank + step) % nprocs;
+    int src = (rank - step) % nprocs;
+    if (src < 0) src += nprocs;
+    int send_col_width = cols_per_proc;
+    if (dst == nprocs - 1) send_col_width += cols_remainder;
+    const Int send_col_start = dst * cols_per_proc;
+    const Int num_send_segs =
+      (send_col_width + segment_cols - 1) / segment_cols;
+    auto seg_range = [segment_cols] (Int start, Int width, Int seg) {
+      return IR(start + seg * segment_cols,
+                start + std::min(width, (seg + 1) * segment_cols));
+    };
+    // Receive segment seg into its slot.
+    auto post_recv = [&] (Int seg) {
+      const int slot = seg % NUM_RING_SLOTS;
+      auto seg_view = mat(IR(0, mat.Height()),
+                          seg_range(local_col_start, local_col_width, seg));
+      double recv_buf_start = get_time();
+      recv_bufs[slot] = get_recv_buf(seg_view, slot, recv_sizes[slot]);
+      rs_recv_buf_time += get_time() - recv_buf_start;
+      lbann_comm::persistent_request& req =
+        get_ring_request(mat, RS_SEG_RECV, step * max_segs + seg);
+      comm->persistent_recv(recv_bufs[slot], recv_sizes[slot], src, req);
+      rs_bytes_received += recv_sizes[slot] * sizeof(T);
+      return &req;
+    };
+    lbann_comm::persistent_request* recv_req = nullptr;
+    if (num_recv_segs > 0) {
+      recv_req = post_recv(0);
+    }
+    const Int num_segs = std::max(num_send_segs, num_recv_segs);
+    for (Int seg = 0; seg < num_segs; ++seg) {
+      const int slot = seg % NUM_RING_SLOTS;
+      if (seg < num_send_segs) {
+        // The slot's previous send must finish before it is overwritten.
+        if (send_reqs[slot] != nullptr) {
+          comm->wait(*send_reqs[slot]);
+          send_reqs[slot] = nullptr;
+        }
+        int send_size;
+        double send_trans_start = get_time();
+        T* send_buf = send_trans(
+          mat, IR(0, mat.Height()),
+          seg_range(send_col_start, send_col_width, seg), slot, send_size);
+        rs_send_trans_time += get_time() - send_trans_start;
+        lbann_comm::persistent_request& req =
+          get_ring_request(mat, RS_SEG_SEND, step * max_segs + seg);
+        comm->persistent_send(send_buf, send_size, dst, req);
+        rs_bytes_sent += send_size * sizeof(T);
+        send_reqs[slot] = &req;
+      }
+      if (seg < num_recv_segs) {
+        // Post the next receive (its slot was consumed last iteration)
+        // before completing this one, so it arrives while we unquantize.
+        lbann_comm::persistent_request* next_req = nullptr;
+        if (seg + 1 < num_recv_segs) {
+          next_req = post_recv(seg + 1);
+        }
+        comm->wait(*recv_req);
+        auto seg_view = mat(IR(0, mat.Height()),
+                            seg_range(local_col_start, local_col_width, seg));
+        double recv_trans_start = get_time();
+        recv_trans(recv_bufs[slot], seg_view, slot);
+        rs_recv_trans_time += get_time() - recv_trans_start;
+        recv_req = next_req;
+      }
+    }
+    // Sends must complete before the next step reuses the slots.
+    for (int slot = 0; slot < NUM_RING_SLOTS; ++slot) {
+      if (send_reqs[slot] != nullptr) {
+        comm->wait(*send_reqs[slot]);
+        send_reqs[slot] = nullptr;
+      }
+    }
   }
   rs_time += get_time() - rs_start;
 }
@@ -541,10 +936,11 @@ void lbann_quantizer::intermodel_ring_allgather(
   // Do the allgather.
   for (int step = 0; step < nprocs - 1; ++step) {
     // Send our data or forward received data.
-    mpi::Request<T> req;
     int send_size;
     T* send_buf = get_send_buf(send_size);
-    comm->nb_send(send_buf, send_size, dst, req);
+    lbann_comm::persistent_request& send_req =
+      get_ring_request(mat, AG_SEND, step);
+    comm->persistent_send(send_buf, send_size, dst, send_req);
     ag_bytes_sent += send_size * sizeof(T);
     // Compute the original rank that sent the data we're going to receive.
     int data_src = (rank - step - 1) % nprocs;
@@ -565,13 +961,16 @@ void lbann_quantizer::intermodel_ring_allgather(
     T* recv_buf = get_recv_buf(recv_view, recv_size);
     ag_recv_buf_time += get_time() - recv_buf_start;
     // Receive data.
-    comm->recv(recv_buf, recv_size, src);
+    lbann_comm::persistent_request& recv_req =
+      get_ring_request(mat, AG_RECV, step);
+    comm->persistent_recv(recv_buf, recv_size, src, recv_req);
+    comm->wait(recv_req);
     ag_bytes_received += recv_size * sizeof(T);
     // Transform the received portion.
     double recv_trans_start = get_time();
     recv_trans(recv_buf, recv_view);
     ag_recv_trans_time += get_time() - recv_trans_start;
-    comm->wait<T>(req);
+    comm->wait(send_req);
     // Swap so we forward the data we just received.
     swap_bufs(send_buf, recv_buf);
     send_size = recv_size;
@@ -0,0 +1,201 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_quantizer_kernels .hpp .cpp - Vectorized quantization kernels
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_QUANTIZER_KERNELS_HPP_INCLUDED
+#define LBANN_QUANTIZER_KERNELS_HPP_INCLUDED
+
+#include "lbann/lbann_base.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/**
+ * Whether the x86 SIMD kernels are compiled in. They use function-level
+ * target attributes, so no special compiler flags are needed and the
+ * instruction set is chosen at runtime.
+ */
+#ifndef LBANN_QUANTIZER_SIMD
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LBANN_QUANTIZER_SIMD 1
+#else
+#define LBANN_QUANTIZER_SIMD 0
+#endif
+#endif
+
+namespace lbann {
+
+/**
+ * Per-column kernels for one-bit and threshold quantization.
+ * Each kernel has a scalar version and, when LBANN_QUANTIZER_SIMD is set,
+ * AVX2 and AVX-512 versions. The implementation is picked once at startup
+ * from the CPU's capabilities, and can be overridden with the
+ * LBANN_QUANTIZER_SIMD environment variable (scalar, avx2, avx512) or with
+ * set_simd_level. The SIMD versions are only used when DataType is float.
+ * One-bit words are always 32 bits wide here; bit i of word w is row 32w+i.
+ */
+namespace quantizer_kernels {
+
+/** Instruction sets the kernels can use. */
+enum class simd_level {SCALAR, AVX2, AVX512};
+
+/** Return the best level supported by this CPU. */
+simd_level detect_simd_level();
+/** Return the level currently in use. */
+simd_level get_simd_level();
+/**
+ * Use level, clamped to what the CPU supports. Returns the level actually
+ * in use. Not thread-safe with respect to concurrently running kernels.
+ */
+simd_level set_simd_level(simd_level level);
+/** Return a printable name for level. */
+const char* simd_level_name(simd_level level);
+
+/**
+ * Compute the sum and count of the non-negative and negative entries of
+ * mat + qerror over height rows.
+ */
+void onebit_column_sums(const DataType* mat, const DataType* qerror,
+                        Int height, DataType& pos_sum, DataType& neg_sum,
+                        Unsigned& num_pos, Unsigned& num_neg);
+/**
+ * One-bit quantize a column of mat + qerror into num_words 32-bit words of q
+ * (words past the end of the column are zeroed), setting bits for
+ * non-negative entries and updating qerror with the quantization error.
+ */
+void onebit_quantize_column(const DataType* mat, DataType* qerror, Int height,
+                            DataType avg_pos, DataType avg_neg, uint32_t* q,
+                            Int num_words);
+/**
+ * Unquantize height rows from q into mat, setting (or adding, if add) avg_pos
+ * for set bits and avg_neg otherwise.
+ */
+void onebit_unquantize_column(const uint32_t* q, DataType* mat, Int height,
+                              DataType avg_pos, DataType avg_neg, bool add);
+/**
+ * Threshold quantize height rows of mat + qerror. For every entry that is
+ * >= pos_thresh or <= neg_thresh, write ((base_pos + row) << 1) | sign to out
+ * in row order and update qerror. out must have room for height entries.
+ * Returns the number of entries written.
+ */
+size_t threshold_scan(const DataType* mat, DataType* qerror, Int height,
+                      uint32_t base_pos, DataType pos_thresh,
+                      DataType neg_thresh, uint32_t* out);
+
+/**
+ * Group varint coding of 32-bit values, used for sparse position deltas.
+ * Each group of four values is one control byte (two bits per value holding
+ * its length in bytes minus one) followed by the little-endian value bytes.
+ * Decoding uses a pshufb lookup when the SIMD kernels are enabled and
+ * always reads 16 bytes from the start of the group's data, so callers must
+ * leave VARINT_DECODE_SLACK readable bytes past the end of a stream.
+ */
+static const size_t VARINT_DECODE_SLACK = 16;
+/** Return the number of bytes v needs in a group varint. */
+inline size_t varint_bytes(uint32_t v) {
+  return v < (1u << 8) ? 1 : v < (1u << 16) ? 2 : v < (1u << 24) ? 3 : 4;
+}
+/** Encode four values from in to out; return the number of bytes written. */
+size_t varint_encode_group(const uint32_t* in, unsigned char* out);
+/** Decode one group from in into out[0..3]; return the next group. */
+const unsigned char* varint_decode_group(const unsigned char* in,
+                                         uint32_t* out);
+
+/**
+ * Bit-level writer for Golomb-Rice codes, least significant bit first.
+ * The buffer must be zeroed beforehand and have 8 bytes of slack past the
+ * last bit written.
+ */
+struct rice_writer {
+  unsigned char* buf;
+  uint64_t bit;
+  /** Write the low n bits of v, n <= 56. */
+  inline void write_bits(uint64_t v, int n) {
+    uint64_t w;
+    memcpy(&w, buf + (bit >> 3), sizeof(w));
+    w |= v << (bit & 7);
+    memcpy(buf + (bit >> 3), &w, sizeof(w));
+    bit += n;
+  }
+  /** Write v with parameter k: v >> k in unary, then the low k bits. */
+  inline void write(uint64_t v, int k) {
+    uint64_t q = v >> k;
+    for (; q >= 32; q -= 32) {
+      write_bits(0xFFFFFFFFull, 32);
+    }
+    // q ones followed by a zero; the zero is already in the buffer.
+    write_bits((uint64_t(1) << q) - 1, q + 1);
+    write_bits(v & ((uint64_t(1) << k) - 1), k);
+  }
+  /** Return the number of bits write(v, k) uses. */
+  static inline uint64_t cost(uint64_t v, int k) {
+    return (v >> k) + 1 + k;
+  }
+};
+
+/**
+ * Bit-level reader matching rice_writer. Reads 8 bytes at a time, so the
+ * buffer needs 8 bytes of slack past the last bit.
+ */
+struct rice_reader {
+  const unsigned char* buf;
+  uint64_t bit;
+  inline uint64_t peek() const {
+    uint64_t w;
+    memcpy(&w, buf + (bit >> 3), sizeof(w));
+    return w >> (bit & 7);
+  }
+  /** Read n bits, n <= 56. */
+  inline uint64_t read_bits(int n) {
+    const uint64_t v = peek() & ((uint64_t(1) << n) - 1);
+    bit += n;
+    return v;
+  }
+  /** Read a value written by rice_writer::write with parameter k. */
+  inline uint64_t read(int k) {
+    // At least 57 bits of each peek are valid. The sentinel keeps the
+    // argument of ctz non-zero when all 64 bits peeked are ones.
+    uint64_t q = 0;
+    for (;;) {
+      const int ones = __builtin_ctzll(~peek() | (uint64_t(1) << 57));
+      if (ones < 57) {
+        q += ones;
+        bit += ones + 1;
+        break;
+      }
+      q += 57;
+      bit += 57;
+    }
+    return (q << k) | read_bits(k);
+  }
+};
+
+}  // namespace quantizer_kernels
+
+}  // namespace lbann
+
+#endif  // LBANN_QUANTIZER_KERNELS_HPP_INCLUDED
@@ -28,6 +28,7 @@
 #define LBANN_UTILS_RNG_HPP
 
 #include "lbann/lbann_base.hpp"
+#include <cstdint>
 #include <random>
 
 namespace lbann {
@@ -93,6 +94,24 @@ void bernoulli_fill_procdet(ElMat& mat, El::Int m, El::Int n, double p = 0.5);
 void uniform_fill_procdet(ElMat& mat, El::Int m, El::Int n,
                           DataType center = 0.0f, DataType radius = 1.0f);
 
+/**
+ * Counter-based random number: a 64-bit value that depends only on key and
+ * counter, so a stream indexed by e.g. matrix position is reproducible no
+ * matter how the work is split across threads. This is the SplitMix64 output
+ * function applied to the counter-th element of the key's Weyl sequence.
+ */
+inline uint64_t counter_random(uint64_t key, uint64_t counter) {
+  uint64_t z = key + (counter + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/** Uniform float in [0, 1) from counter_random. */
+inline float counter_uniform(uint64_t key, uint64_t counter) {
+  return (counter_random(key, counter) >> 40) * (1.0f / 16777216.0f);
+}
+
 template<typename DistType,typename DType=DataType>
 class rng {
 
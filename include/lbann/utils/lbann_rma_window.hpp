@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_rma_window .hpp .cpp - MPI-3 one-sided (RMA) windows
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_RMA_WINDOW_HPP_INCLUDED
+#define LBANN_RMA_WINDOW_HPP_INCLUDED
+
+#include "lbann/lbann_base.hpp"
+#include "mpi.h"
+
+#if defined(MPI_VERSION) && MPI_VERSION >= 3
+#define LBANN_HAS_RMA_WINDOWS 1
+#else
+#define LBANN_HAS_RMA_WINDOWS 0
+#endif
+
+namespace lbann {
+
+#if LBANN_HAS_RMA_WINDOWS
+
+/**
+ * An RMA window (MPI_Win_allocate) of DataType values over a communicator.
+ * Every process exposes count values, and any process can put, accumulate
+ * into, or read any other's values without the target taking part. The
+ * window stays in a passive-target epoch (MPI_Win_lock_all): operations
+ * complete at the origin with flush, and fence closes a collective epoch
+ * after which every process's operations are visible everywhere.
+ * Every operation except put is atomic per element with respect to the
+ * others (but not across a whole message), so they can target the same
+ * values concurrently; puts must be kept apart from other operations on the
+ * same values by fences.
+ */
+class rma_window {
+public:
+  /** Collectively allocate count values for this process on comm. */
+  rma_window(MPI_Comm comm, size_t count);
+  ~rma_window();
+  rma_window(const rma_window&) = delete;
+  rma_window& operator=(const rma_window&) = delete;
+
+  /** Return this process's values. */
+  DataType* get_local() const { return m_base; }
+  /** Return the number of values each process exposes. */
+  size_t get_count() const { return m_count; }
+  /** Return this process's rank in the window's communicator. */
+  int get_rank() const { return m_rank; }
+  /** Return the number of processes in the window. */
+  int get_size() const { return m_size; }
+
+  /** Start writing count values from data to target's values at offset. */
+  void put(const DataType* data, int count, int target, size_t offset);
+  /** As put, but atomic per element. */
+  void replace(const DataType* data, int count, int target, size_t offset);
+  /** Start adding count values from data to target's values at offset. */
+  void accumulate(const DataType* data, int count, int target,
+                  size_t offset);
+  /** Start reading count of target's values at offset into data. */
+  void get(DataType* data, int count, int target, size_t offset);
+  /**
+   * Start reading count of target's values at offset into result while
+   * replacing them with the values in data.
+   */
+  void fetch_and_replace(const DataType* data, DataType* result, int count,
+                         int target, size_t offset);
+  /**
+   * Complete this process's operations to target (origin buffers can be
+   * reused and gets have arrived).
+   */
+  void flush(int target);
+  /** Complete this process's operations to every target. */
+  void flush_all();
+  /** Synchronize local loads and stores with RMA updates (MPI_Win_sync). */
+  void sync();
+  /**
+   * End an epoch, collectively: complete this process's operations, wait
+   * for every other process to do the same, and make all updates visible
+   * to local loads.
+   */
+  void fence();
+
+private:
+  MPI_Comm m_comm;
+  MPI_Win m_win;
+  DataType* m_base;
+  size_t m_count;
+  int m_rank;
+  int m_size;
+};
+
+#endif  // LBANN_HAS_RMA_WINDOWS
+
+}  // namespace lbann
+
+#endif  // LBANN_RMA_WINDOW_HPP_INCLUDED
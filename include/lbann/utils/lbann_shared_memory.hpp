@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_shared_memory .hpp .cpp - MPI-3 shared-memory windows within a node
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LBANN_SHARED_MEMORY_HPP_INCLUDED
+#define LBANN_SHARED_MEMORY_HPP_INCLUDED
+
+#include <vector>
+#include "mpi.h"
+
+#if defined(MPI_VERSION) && MPI_VERSION >= 3
+#define LBANN_HAS_SHARED_MEMORY_WINDOWS 1
+#else
+#define LBANN_HAS_SHARED_MEMORY_WINDOWS 0
+#endif
+
+namespace lbann {
+
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+
+/**
+ * A shared-memory window (MPI_Win_allocate_shared) over a communicator whose
+ * processes all live on one compute node.
+ * Every process contributes a segment, and every process can load and store
+ * directly into every segment with no MPI copies. The window stays in a
+ * passive-target epoch; use fence to make stores visible before peers read.
+ */
+class shared_memory_window {
+public:
+  /**
+   * Collectively allocate local_bytes for this process on comm, which must
+   * be a shared-memory communicator (e.g. from MPI_COMM_TYPE_SHARED).
+   */
+  shared_memory_window(MPI_Comm comm, size_t local_bytes);
+  ~shared_memory_window();
+  shared_memory_window(const shared_memory_window&) = delete;
+  shared_memory_window& operator=(const shared_memory_window&) = delete;
+
+  /** Return a pointer to the segment of the process with the given rank. */
+  void* get_segment(int rank) const { return m_segments[rank]; }
+  /** Return the size in bytes of the segment of the given rank. */
+  size_t get_segment_bytes(int rank) const { return m_segment_bytes[rank]; }
+  /** Return this process's rank in the window's communicator. */
+  int get_rank() const { return m_rank; }
+  /** Return the number of processes sharing the window. */
+  int get_size() const { return m_segments.size(); }
+  /**
+   * Synchronize the processes sharing the window: stores made before the
+   * fence are visible to every process after it.
+   */
+  void fence();
+
+private:
+  MPI_Comm m_comm;
+  MPI_Win m_win;
+  int m_rank;
+  std::vector<void*> m_segments;
+  std::vector<size_t> m_segment_bytes;
+};
+
+#endif  // LBANN_HAS_SHARED_MEMORY_WINDOWS
+
+}  // namespace lbann
+
+#endif  // LBANN_SHARED_MEMORY_HPP_INCLUDED
@@ -45,12 +45,13 @@ std::vector<double> test_mpi_datatype_allreduce(lbann_comm* comm, DistMat& mat)
   return times;
 }
 
-std::vector<double> test_cust_allreduce(lbann_comm* comm, DistMat& mat) {
-  lbann_quantizer quantizer;
+std::vector<double> test_cust_allreduce(
+  lbann_comm* comm, DistMat& mat, lbann_quantizer& quantizer,
+  lbann_quantizer::allreduce_algorithm alg) {
   std::vector<double> times;
   for (int trial = 0; trial < num_trials; ++trial) {
     double start = get_time();
-    quantizer.intermodel_sum(comm, mat);
+    quantizer.intermodel_sum(comm, mat.Matrix(), alg);
     double tot = get_time() - start;
     times.push_back(tot);
     comm->global_barrier();
@@ -58,6 +59,20 @@ std::vector<double> test_cust_allreduce(lbann_comm* comm, DistMat& mat) {
   return times;
 }
 
+std::vector<double> test_hierarchical_allreduce(lbann_comm* comm, DistMat& mat) {
+  std::vector<double> times;
+  comm->set_hierarchical_allreduce(true);
+  for (int trial = 0; trial < num_trials; ++trial) {
+    double start = get_time();
+    comm->intermodel_sum_matrix(mat);
+    double tot = get_time() - start;
+    times.push_back(tot);
+    comm->global_barrier();
+  }
+  comm->set_hierarchical_allreduce(false);
+  return times;
+}
+
 void print_stats(const std::vector<double>& times) {
   double sum = std::accumulate(times.begin(), times.end(), 0.0);
   double mean = sum / times.size();
@@ -78,7 +93,7 @@ void print_stats(const std::vector<double>& times) {
   std::cout << std::endl;
 }
 
-void test_mat(lbann_comm* comm, DistMat& mat) {
+void test_mat(lbann_comm* comm, DistMat& mat, lbann_quantizer& quantizer) {
   auto mpi_times = test_mpi_allreduce(comm, mat);
   if (comm->am_world_master()) {
     std::cout << "MPI (" << mat.Height() << "x" << mat.Width() << "):" <<
@@ -91,11 +106,28 @@ void test_mat(lbann_comm* comm, DistMat& mat) {
        "):" << std::endl;
     print_stats(mpi_dt_times);
   }
-  auto cust_times = test_cust_allreduce(comm, mat);
+  const std::vector<std::pair<const char*, lbann_quantizer::allreduce_algorithm>>
+    algs = {
+    {"ring", lbann_quantizer::allreduce_algorithm::RING},
+    {"recursive doubling",
+     lbann_quantizer::allreduce_algorithm::RECURSIVE_DOUBLING},
+    {"Rabenseifner", lbann_quantizer::allreduce_algorithm::RABENSEIFNER},
+    {"autotuned", lbann_quantizer::allreduce_algorithm::AUTO}
+  };
+  for (const auto& alg : algs) {
+    auto cust_times = test_cust_allreduce(comm, mat, quantizer, alg.second);
+    if (comm->am_world_master()) {
+      std::cout << "Custom " << alg.first << " (" << mat.Height() << "x" <<
+        mat.Width() << "):" << std::endl;
+      print_stats(cust_times);
+    }
+  }
+  auto hier_times = test_hierarchical_allreduce(comm, mat);
   if (comm->am_world_master()) {
-    std::cout << "Custom (" << mat.Height() << "x" << mat.Width() << "):" <<
-      std::endl;
-    print_stats(cust_times);
+    std::cout << "Hierarchical (" << mat.Height() << "x" << mat.Width() <<
+      ", " << comm->get_num_intermodel_nodes() << " nodes x " <<
+      comm->get_intermodel_procs_per_node() << "):" << std::endl;
+    print_stats(hier_times);
   }
 }
 
@@ -103,10 +135,12 @@ int main(int argc, char** argv) {
   El::Initialize(argc, argv);
   // 1 because we use MPI_COMM_WORLD above.
   lbann_comm* comm = new lbann_comm(1);
+  lbann_quantizer quantizer;
+  quantizer.autotune_allreduce(comm, 64, 16384 * 16384);
   for (int mat_size = 64; mat_size <= 16384; mat_size *= 2) {
     DistMat mat(comm->get_model_grid());
     El::Uniform(mat, mat_size, mat_size, 0.0f, 4.0f);
-    test_mat(comm, mat);
+    test_mat(comm, mat, quantizer);
   }
   El::Finalize();
 }
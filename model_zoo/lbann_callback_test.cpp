@@ -0,0 +1,353 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_callback_test.cpp - Tests the multi-model training callbacks
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <limits>
+#include "lbann/lbann_base.hpp"
+#include "lbann/lbann_comm.hpp"
+#include "lbann/models/lbann_model.hpp"
+#include "lbann/layers/lbann_layer_fully_connected.hpp"
+#include "lbann/optimizers/lbann_optimizer_sgd.hpp"
+#include "lbann/callbacks/lbann_callback_local_sgd.hpp"
+#include "lbann/callbacks/lbann_callback_gossip.hpp"
+#include "lbann/callbacks/lbann_callback_async_sgd.hpp"
+#include "lbann_test_utils.hpp"
+
+using namespace lbann;
+
+/** A model over a fixed set of layers, so callbacks can be driven directly. */
+class test_model : public model {
+public:
+  test_model(lbann_comm* comm, std::vector<Layer*> layers) :
+    model(comm, nullptr), m_layers(layers) {
+    m_execution_mode = execution_mode::training;
+  }
+  std::vector<Layer*>& get_layers() { return m_layers; }
+  bool at_epoch_start() { return false; }
+  void set_cur_step(int64_t step) { m_current_step = step; }
+private:
+  std::vector<Layer*> m_layers;
+};
+
+/** Create num_layers small fully-connected layers using SGD with momentum. */
+std::vector<Layer*> make_layers(lbann_comm* comm, SGD_factory& sgd_fac,
+                                int num_layers) {
+  std::vector<Layer*> layers;
+  for (int l = 0; l < num_layers; ++l) {
+    Layer* layer = new FullyConnectedLayer(
+      l, 3 + l, 2 + l, 4, activation_type::ID,
+      weight_initialization::glorot_uniform, comm,
+      sgd_fac.create_optimizer());
+    layer->setup(3 + l);
+    layers.push_back(layer);
+  }
+  return layers;
+}
+
+void free_layers(std::vector<Layer*>& layers) {
+  for (Layer* layer : layers) {
+    delete layer->optimizer;
+    delete layer;
+  }
+}
+
+/** Set every local entry (i, j) of mat to scale * (i + j + 1) + shift. */
+void fill_mat(ElMat& mat, DataType scale, DataType shift = 0.0f) {
+  Mat& local = mat.Matrix();
+  for (El::Int j = 0; j < local.Width(); ++j) {
+    for (El::Int i = 0; i < local.Height(); ++i) {
+      local.Set(i, j, scale * (i + j + 1) + shift);
+    }
+  }
+}
+
+/** Check every local entry (i, j) of mat is scale * (i + j + 1) + shift. */
+void check_mat(ElMat& mat, DataType scale, DataType shift = 0.0f) {
+  const Mat& local = mat.LockedMatrix();
+  for (El::Int j = 0; j < local.Width(); ++j) {
+    for (El::Int i = 0; i < local.Height(); ++i) {
+      ASSERT_TRUE(std::fabs(local.Get(i, j) - (scale * (i + j + 1) + shift))
+                  <= 1e-4f);
+    }
+  }
+}
+
+/**
+ * Set every layer's weights to weight_scale times a fixed matrix and its
+ * optimizer state to state_scale times it.
+ */
+void set_model_weights(std::vector<Layer*>& layers, DataType weight_scale,
+                       DataType state_scale) {
+  for (Layer* layer : layers) {
+    fill_mat(layer->get_weights_biases(), weight_scale);
+    for (ElMat* state : layer->get_optimizer()->get_state_matrices()) {
+      fill_mat(*state, state_scale);
+    }
+  }
+}
+
+/** Step local SGD up to its next average. */
+void run_local_steps(lbann_callback_local_sgd& cb, test_model& m) {
+  const int k = cb.get_k();
+  for (int step = 0; step < k; ++step) {
+    cb.on_batch_end(&m);
+  }
+}
+
+/**
+ * Verify local SGD averages weights and optimizer state over the models only
+ * every k steps, and that adaptive averaging halves k when the drift
+ * sum_i ||w_i - w_avg||^2 / (M ||w_avg||^2) is over the threshold, leaves it
+ * alone between a quarter of the threshold and the threshold, and doubles it
+ * below that.
+ */
+void test_local_sgd() {
+  lbann_comm* comm = new lbann_comm(1);
+  const int num_models = comm->get_num_models();
+  const DataType scale = comm->get_model_rank() + 1;
+  // Mean of 1, ..., M.
+  const DataType mean_scale = (num_models + 1) / 2.0f;
+  SGD_factory sgd_fac(comm, 0.1f, 0.9f);
+  std::vector<Layer*> layers = make_layers(comm, sgd_fac, 2);
+  test_model m(comm, layers);
+  lbann_callback_local_sgd cb(3, true);
+  cb.setup(&m);
+  ASSERT_EQ(cb.get_k(), 3);
+  set_model_weights(layers, scale, 2 * scale);
+  cb.on_batch_end(&m);
+  cb.on_batch_end(&m);
+  for (Layer* layer : layers) {
+    check_mat(layer->get_weights_biases(), scale);
+  }
+  cb.on_batch_end(&m);
+  for (Layer* layer : layers) {
+    check_mat(layer->get_weights_biases(),
+              num_models > 1 ? mean_scale : scale);
+    for (ElMat* state : layer->get_optimizer()->get_state_matrices()) {
+      check_mat(*state, num_models > 1 ? 2 * mean_scale : 2 * scale);
+    }
+  }
+  if (num_models > 1) {
+    // With w_i = (i + 1) w, the drift is var(1, ..., M) / mean^2.
+    const double drift = (num_models - 1) / (3.0 * (num_models + 1));
+    const int max_k = 64;
+    const std::vector<std::pair<double, int>> cases = {
+      {0.9 * drift, 1},  // Over the threshold.
+      {1.1 * drift, 1},  // Under it, but not by enough to grow.
+      {3.6 * drift, 1},
+      {4.4 * drift, 2},  // Under a quarter of it.
+      {4.4 * drift, 4},
+      {0.5 * drift, 2}};
+    for (const auto& c : cases) {
+      cb.set_adaptive(max_k, c.first);
+      set_model_weights(layers, scale, 0.0f);
+      run_local_steps(cb, m);
+      ASSERT_EQ(cb.get_k(), c.second);
+      for (Layer* layer : layers) {
+        check_mat(layer->get_weights_biases(), mean_scale);
+      }
+    }
+    // Identical models have no drift, so k grows up to max_k.
+    cb.set_adaptive(8, 0.5 * drift);
+    for (int k : {4, 8, 8}) {
+      set_model_weights(layers, 1.0f, 0.0f);
+      run_local_steps(cb, m);
+      ASSERT_EQ(cb.get_k(), k);
+    }
+  }
+  free_layers(layers);
+  delete comm;
+}
+
+/**
+ * Verify one gossip exchange per topology and step, with model i's weights at
+ * (i + 1) times a fixed matrix and a local step taken while the exchange is
+ * in flight. Ring models move to the mean of themselves and their one or two
+ * neighbours. With a random matching, paired models both move to their mean
+ * and the only model left alone is the odd one out.
+ */
+void test_gossip() {
+  lbann_comm* comm = new lbann_comm(1);
+  const int num_models = comm->get_num_models();
+  const int me = comm->get_model_rank();
+  const DataType local_step = 0.5f;
+  SGD_factory sgd_fac(comm, 0.1f, 0.9f);
+  std::vector<Layer*> layers = make_layers(comm, sgd_fac, 2);
+  test_model m(comm, layers);
+  for (auto topo : {lbann_callback_gossip::RING,
+                    lbann_callback_gossip::RANDOM}) {
+    lbann_callback_gossip cb(topo);
+    cb.setup(&m);
+    for (int64_t step = 0; step < 4; ++step) {
+      m.set_cur_step(step);
+      for (Layer* layer : layers) {
+        fill_mat(layer->get_weights_biases(), me + 1);
+      }
+      cb.on_batch_end(&m);
+      for (Layer* layer : layers) {
+        fill_mat(layer->get_weights_biases(), me + 1, local_step);
+      }
+      cb.on_epoch_end(&m);
+      const DataType scale =
+        layers[0]->get_weights_biases().LockedMatrix().Get(0, 0) - local_step;
+      for (Layer* layer : layers) {
+        check_mat(layer->get_weights_biases(), scale, local_step);
+      }
+      std::vector<DataType> scales(num_models);
+      comm->intermodel_allgather(&scale, scales.data(), 1);
+      if (topo == lbann_callback_gossip::RING) {
+        DataType sum = me + 1;
+        int count = 1;
+        if (num_models > 1) {
+          const int left = (me + num_models - 1) % num_models;
+          const int right = (me + 1) % num_models;
+          sum += left + 1;
+          ++count;
+          if (right != left) {
+            sum += right + 1;
+            ++count;
+          }
+        }
+        ASSERT_TRUE(std::fabs(scale - sum / count) <= 1e-4f);
+      } else {
+        int unpaired = 0;
+        for (int model = 0; model < num_models; ++model) {
+          if (std::fabs(scales[model] - (model + 1)) <= 1e-4f) {
+            ++unpaired;
+            continue;
+          }
+          const int partner = std::lround(2 * scales[model]) - (model + 1) - 1;
+          ASSERT_TRUE(partner >= 0 && partner < num_models);
+          ASSERT_NEQ(partner, model);
+          ASSERT_TRUE(std::fabs(scales[partner] - scales[model]) <= 1e-4f);
+        }
+        ASSERT_EQ(unpaired, num_models % 2);
+      }
+    }
+  }
+  free_layers(layers);
+  delete comm;
+}
+
+/**
+ * Verify the in-process parameter server (one model) applies every push,
+ * reports the pushing worker's clock once it has, and stops holding back
+ * clocks and shuts down once the worker is done.
+ */
+void test_parameter_server() {
+  lbann_comm* comm = new lbann_comm(0);
+  const int count = 10;
+  std::vector<DataType> base(count), weights;
+  for (int i = 0; i < count; ++i) {
+    base[i] = i;
+  }
+  parameter_server* server = new parameter_server(comm, base);
+  ASSERT_EQ(server->pull(weights), 0);
+  ASSERT_VECTOR_EQ(weights, base);
+  DataType total = 0.0f;
+  for (int64_t clock = 1; clock <= 3; ++clock) {
+    server->push(std::vector<DataType>(count, DataType(clock)));
+    total += clock;
+    server->wait_for_clock(clock);
+    ASSERT_EQ(server->pull(weights), clock);
+    for (int i = 0; i < count; ++i) {
+      ASSERT_EQ(weights[i], base[i] + total);
+    }
+  }
+  // Queue several pushes before waiting on any of them.
+  for (int64_t clock = 4; clock <= 8; ++clock) {
+    server->push(std::vector<DataType>(count, DataType(clock)));
+    total += clock;
+  }
+  server->wait_for_clock(8);
+  ASSERT_EQ(server->pull(weights), 8);
+  for (int i = 0; i < count; ++i) {
+    ASSERT_EQ(weights[i], base[i] + total);
+  }
+  server->finish_local();
+  ASSERT_EQ(server->pull(weights), std::numeric_limits<int64_t>::max());
+  server->wait_for_clock(9);
+  delete server;
+  delete comm;
+}
+
+/**
+ * Verify async SGD with one model and no staleness: after every step the
+ * weights are the starting weights plus every local update so far.
+ */
+void test_async_sgd() {
+  lbann_comm* comm = new lbann_comm(0);
+  SGD_factory sgd_fac(comm, 0.1f, 0.9f);
+  std::vector<Layer*> layers = make_layers(comm, sgd_fac, 2);
+  test_model m(comm, layers);
+  for (Layer* layer : layers) {
+    fill_mat(layer->get_weights_biases(), 1.0f);
+  }
+  lbann_callback_async_sgd* cb = new lbann_callback_async_sgd(0);
+  cb->setup(&m);
+  cb->on_train_begin(&m);
+  DataType total = 0.0f;
+  for (int step = 1; step <= 5; ++step) {
+    // Stand in for the local optimizer step.
+    for (Layer* layer : layers) {
+      fill_mat(layer->get_weights_biases(), 1.0f, total + step);
+    }
+    total += step;
+    cb->on_batch_end(&m);
+    for (Layer* layer : layers) {
+      check_mat(layer->get_weights_biases(), 1.0f, total);
+    }
+  }
+  cb->on_epoch_end(&m);
+  for (Layer* layer : layers) {
+    check_mat(layer->get_weights_biases(), 1.0f, total);
+  }
+  cb->on_train_end(&m);
+  // Stops the server, which needs the communicator.
+  delete cb;
+  free_layers(layers);
+  delete comm;
+}
+
+int main(int argc, char** argv) {
+  El::Initialize(argc, argv);
+  try {
+    test_local_sgd();
+    test_gossip();
+    test_parameter_server();
+    test_async_sgd();
+    El::mpi::Barrier(El::mpi::COMM_WORLD);
+    if (El::mpi::Rank(El::mpi::COMM_WORLD) == 0) {
+      std::cout << "All tests passed" << std::endl;
+    }
+  } catch (std::exception& e) {
+    ReportException(e);
+  }
+  El::Finalize();
+  return 0;
+}
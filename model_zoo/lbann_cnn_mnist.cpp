@@ -99,11 +99,20 @@ int main(int argc, char* argv[])
         SetBlocksize(perfParams.BlockSize);
 
         // Set up the communicator and get the grid.
-        comm = new lbann_comm(trainParams.ProcsPerModel);
+        comm = new lbann_comm(
+          trainParams.ProcsPerModel,
+          static_cast<rank_placement>(trainParams.RankPlacement));
+        comm->set_error_signal_compression(
+          static_cast<intramodel_compression>(trainParams.ErrorSignalCompression));
+        comm->set_gradient_compression(
+          static_cast<intramodel_compression>(trainParams.GradientCompression));
+        comm->set_payload_precision(
+          static_cast<payload_precision>(trainParams.PayloadPrecision));
         Grid& grid = comm->get_model_grid();
         if (comm->am_world_master()) {
           cout << "Number of models: " << comm->get_num_models() << endl;
           cout << "Grid is " << grid.Height() << " x " << grid.Width() << endl;
+          comm->print_placement_report(cout);
           cout << endl;
         }
 
@@ -302,6 +311,9 @@ int main(int argc, char* argv[])
 
         // Initialize the model's data structures
         dnn.setup();
+        if (trainParams.BroadcastModel) {
+            dnn.broadcast_weights(0);
+        }
         if (comm->am_world_master()) {
           cout << "Layer initialized:" << endl;
           for (uint n = 0; n < g_NumLayers; n++) {
@@ -321,11 +333,17 @@ int main(int argc, char* argv[])
         // main loop for training/testing
         ///////////////////////////////////////////////////////////////////
 
+        if (!trainParams.CommTrace.empty()) {
+            comm->enable_tracing();
+        }
         // train/test
         for (int t = 0; t < trainParams.EpochCount; t++) {
             dnn.train(1, true);
             dnn.evaluate(execution_mode::testing);
         }
+        if (!trainParams.CommTrace.empty()) {
+            comm->write_trace(trainParams.CommTrace);
+        }
 
         // Free dynamically allocated memory
         // delete lfac;  // Causes segfault
@@ -27,7 +27,15 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <stdlib.h>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <sstream>
+#include <thread>
 #include "lbann/lbann_comm.hpp"
+#include "lbann/utils/lbann_gradient_buckets.hpp"
 #include "lbann_test_utils.hpp"
 
 using namespace lbann;
@@ -114,6 +122,54 @@ void test_intermodel_sum_matrix() {
   fini_comm(comm);
 }
 
+/**
+ * Compare the hierarchical allreduce with intermodel_sum_matrix, including
+ * sizes the inter-model peers on a node cannot split evenly.
+ */
+void check_hierarchical_intermodel_sum(lbann_comm* comm) {
+  // The last size is smaller than the one before, so it reuses any buffers.
+  const std::vector<std::pair<int, int>> sizes = {
+    {1, 1}, {7, 3}, {8 * LBANN_COMM_TEST_NROWS + 1, 5}, {7, 3}};
+  for (const auto& size : sizes) {
+    DistMat mat(comm->get_model_grid());
+    mat.Resize(size.first, size.second);
+    // Small integers, so sums are exact whatever the reduction order.
+    for (int j = 0; j < mat.LocalWidth(); ++j) {
+      for (int i = 0; i < mat.LocalHeight(); ++i) {
+        mat.SetLocal(i, j, (DataType) ((comm->get_model_rank() + 1) * (i + j)));
+      }
+    }
+    DistMat expected(mat);
+    comm->intermodel_sum_matrix(expected);
+    Mat local(mat.Matrix());
+    comm->set_hierarchical_allreduce(true);
+    comm->intermodel_sum_matrix(mat);
+    comm->intermodel_sum_matrix(local);
+    comm->set_hierarchical_allreduce(false);
+    ASSERT_MAT_EQ(mat, expected);
+    ASSERT_MAT_EQ(local, expected.Matrix());
+  }
+}
+
+/** Verify the hierarchical allreduce with MPI collectives within the node. */
+void test_hierarchical_intermodel_sum() {
+  lbann_comm* comm = init_comm();
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+  comm->set_shared_memory_allreduce(false);
+#endif
+  check_hierarchical_intermodel_sum(comm);
+  fini_comm(comm);
+}
+
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+/** Verify the hierarchical allreduce through a shared-memory window. */
+void test_shm_hierarchical_intermodel_sum() {
+  lbann_comm* comm = init_comm();
+  check_hierarchical_intermodel_sum(comm);
+  fini_comm(comm);
+}
+#endif
+
 /** Verify inter-model matrix broadcast works. */
 void test_intermodel_broadcast_matrix() {
   lbann_comm* comm = init_comm();
@@ -125,6 +181,520 @@ void test_intermodel_broadcast_matrix() {
   fini_comm(comm);
 }
 
+/**
+ * Verify inter-model summation and broadcast with fp16/bf16 payloads (small
+ * integers and halves are exact in both).
+ */
+void test_reduced_precision_intermodel_matrix() {
+  lbann_comm* comm = init_comm();
+  const int num_models = comm->get_num_models();
+  for (payload_precision p : {payload_precision::FP16,
+                              payload_precision::BF16}) {
+    DistMat mat(comm->get_model_grid());
+    create_mat(mat, (float) (comm->get_model_rank() + 1));
+    comm->intermodel_barrier();
+    comm->intermodel_sum_matrix(mat, p);
+    validate_mat(mat, (float) (num_models * (num_models + 1) / 2));
+    create_mat(mat, comm->get_model_rank() + 0.5f);
+    comm->intermodel_broadcast_matrix(mat, 1, p);
+    validate_mat(mat, 1.5f);
+    // The default precision comes from the communicator.
+    comm->set_payload_precision(p);
+    create_mat(mat, 2.0f);
+    comm->intermodel_sum_matrix(mat);
+    validate_mat(mat, (float) (2 * num_models));
+  }
+  // Rounding: 1 + 2^-9 is not representable in bf16 but is in fp16.
+  ASSERT_EQ(bfloat16_to_float(float_to_bfloat16(1.0f + 1.0f/512)), 1.0f);
+  ASSERT_EQ(half_to_float(float_to_half(1.0f + 1.0f/512)), 1.0f + 1.0f/512);
+  ASSERT_TRUE(std::isnan(bfloat16_to_float(float_to_bfloat16(NAN))));
+  fini_comm(comm);
+}
+
+/** Verify processes are placed into models consistently by each policy. */
+void test_rank_placement() {
+  for (rank_placement placement : {rank_placement::CONTIGUOUS,
+                                   rank_placement::PACKED,
+                                   rank_placement::STRIPED}) {
+    lbann_comm* comm = new lbann_comm(LBANN_COMM_TEST_PPM, placement);
+    const int world_rank = comm->get_rank_in_world();
+    ASSERT_EQ(comm->get_world_rank(comm->get_model_rank(),
+                                   comm->get_rank_in_model()), world_rank);
+    ASSERT_EQ(comm->model_allreduce(1), LBANN_COMM_TEST_PPM);
+    ASSERT_EQ(comm->intermodel_allreduce(1), LBANN_COMM_TEST_NUM_MODELS);
+    ASSERT_EQ(comm->get_model_grid().Size(), LBANN_COMM_TEST_PPM);
+    // Every model agrees on who is where.
+    ASSERT_EQ(comm->model_allreduce(comm->get_model_rank(), mpi::MAX),
+              comm->get_model_rank());
+    const bool one_node = comm->get_node_of_world_rank(0) ==
+      comm->get_node_of_world_rank(LBANN_COMM_TEST_PROCS - 1);
+    if (one_node && placement == rank_placement::STRIPED) {
+      ASSERT_EQ(comm->get_model_rank(),
+                world_rank % LBANN_COMM_TEST_NUM_MODELS);
+    } else if (one_node || placement == rank_placement::CONTIGUOUS) {
+      ASSERT_EQ(comm->get_model_rank(), world_rank / LBANN_COMM_TEST_PPM);
+    }
+    std::ostringstream report;
+    comm->print_placement_report(report);
+    ASSERT_TRUE(report.str().find(rank_placement_name(placement)) !=
+                std::string::npos);
+    fini_comm(comm);
+  }
+}
+
+/** Verify communication calls are traced once tracing is enabled. */
+void test_tracing() {
+  lbann_comm* comm = init_comm();
+  DistMat mat(comm->get_model_grid());
+  create_mat(mat);
+  comm->intermodel_sum_matrix(mat);
+  ASSERT_EQ(comm->get_tracer().get_events().size(), (size_t) 0);
+  comm->enable_tracing(2);
+  comm->intermodel_sum_matrix(mat);
+  comm->model_barrier();
+  comm->intermodel_barrier();
+  const std::vector<comm_trace_event>& events = comm->get_tracer().get_events();
+  ASSERT_EQ(events.size(), (size_t) 2);
+  ASSERT_EQ(comm->get_tracer().get_num_dropped(), (size_t) 1);
+  ASSERT_EQ(strcmp(events[0].op, "intermodel_sum_matrix"), 0);
+  ASSERT_EQ(events[0].bytes, sizeof(DataType) * mat.LocalHeight() *
+                             mat.LocalWidth());
+  ASSERT_TRUE(events[0].end >= events[0].start);
+  ASSERT_EQ(strcmp(events[1].op, "barrier"), 0);
+  ASSERT_EQ(strcmp(events[1].comm, "model"), 0);
+  std::ostringstream trace;
+  comm->get_tracer().write_chrome_trace(trace, comm->get_rank_in_world(),
+                                        "test");
+  ASSERT_TRUE(trace.str().find("\"traceEvents\"") != std::string::npos);
+  ASSERT_TRUE(trace.str().find("\"dropped_events\":1") != std::string::npos);
+  ASSERT_EQ(comm_tracer::size_bucket(0), 0);
+  ASSERT_EQ(comm_tracer::size_bucket(1), 1);
+  ASSERT_EQ(comm_tracer::size_bucket(4096), 13);
+  // Several threads may record at once; each gets its own track.
+  comm_tracer tracer;
+  tracer.enable();
+  const int num_threads = 4;
+  const int per_thread = 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&tracer] () {
+        for (int i = 0; i < per_thread; ++i) {
+          tracer.record("test_op", "test", i, -1, 0.0, 1e-6);
+        }
+      });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const std::vector<comm_trace_event> thread_events = tracer.get_events();
+  ASSERT_EQ(thread_events.size(), (size_t) num_threads * per_thread);
+  std::vector<int> per_tid(num_threads, 0);
+  for (const comm_trace_event& e : thread_events) {
+    ASSERT_TRUE(e.tid >= 0 && e.tid < num_threads);
+    ++per_tid[e.tid];
+  }
+  for (int t = 0; t < num_threads; ++t) {
+    ASSERT_EQ(per_tid[t], per_thread);
+  }
+  fini_comm(comm);
+}
+
+/** Verify non-blocking inter-model matrix summation works. */
+void test_nb_intermodel_sum_matrix() {
+  lbann_comm* comm = init_comm();
+  DistMat mat(comm->get_model_grid());
+  create_mat(mat);
+  Mat local_mat;
+  El::Ones(local_mat, LBANN_COMM_TEST_NROWS, LBANN_COMM_TEST_NCOLS);
+  comm->intermodel_barrier();
+  comm->reset_stats_counters();
+  mpi::Request<DataType> req;
+  mpi::Request<DataType> local_req;
+  comm->nb_intermodel_sum_matrix(mat, req);
+  comm->nb_intermodel_sum_matrix(local_mat, local_req);
+  comm->wait(req);
+  // Poll the second request to exercise test.
+  while (!comm->test(local_req)) {}
+  validate_mat(mat, (float) LBANN_COMM_TEST_NUM_MODELS);
+  for (int i = 0; i < local_mat.Height(); ++i) {
+    for (int j = 0; j < local_mat.Width(); ++j) {
+      ASSERT_EQ(local_mat.Get(i, j), (float) LBANN_COMM_TEST_NUM_MODELS);
+    }
+  }
+  ASSERT_EQ(comm->get_bytes_sent(),
+            sizeof(DataType) * (mat.LocalHeight() * mat.LocalWidth() +
+                                local_mat.Height() * local_mat.Width()));
+  ASSERT_EQ(comm->get_bytes_received(), comm->get_bytes_sent());
+  fini_comm(comm);
+}
+
+/** Verify non-blocking inter-model matrix broadcast works. */
+void test_nb_intermodel_broadcast_matrix() {
+  lbann_comm* comm = init_comm();
+  DistMat mat(comm->get_model_grid());
+  create_mat(mat, (float) comm->get_model_rank());
+  comm->intermodel_barrier();
+  comm->reset_stats_counters();
+  mpi::Request<DataType> req;
+  comm->nb_intermodel_broadcast_matrix(mat, 1, req);
+  while (!comm->test(req)) {}
+  validate_mat(mat, (float) 1);  // Should come from the 1st model.
+  const size_t bytes = sizeof(DataType) * mat.LocalHeight() * mat.LocalWidth();
+  if (comm->get_model_rank() == 1) {
+    ASSERT_EQ(comm->get_bytes_sent(), bytes);
+  } else {
+    ASSERT_EQ(comm->get_bytes_received(), bytes);
+  }
+  fini_comm(comm);
+}
+
+/** Verify parameter-server probes only see parameter-server messages. */
+void test_ps_messages() {
+  lbann_comm* comm = init_comm();
+  const int num_models = comm->get_num_models();
+  const int model_rank = comm->get_model_rank();
+  if (model_rank != 0) {
+    // Ordinary traffic first, so it is pending when model 0 probes.
+    const int64_t world_msg = model_rank;
+    const int64_t ps_msg = 100 + model_rank;
+    comm->send(&world_msg, 1, 0);
+    comm->ps_send(&ps_msg, 1, 0);
+  } else {
+    std::vector<bool> seen(num_models, false);
+    int remaining = num_models - 1;
+    while (remaining > 0) {
+      int model, rank;
+      if (comm->ps_probe_any(model, rank)) {
+        ASSERT_EQ(rank, comm->get_rank_in_model());
+        int64_t msg;
+        comm->ps_recv(&msg, 1, model, rank);
+        ASSERT_EQ(msg, (int64_t) (100 + model));
+        ASSERT_TRUE(!seen[model]);
+        seen[model] = true;
+        --remaining;
+      }
+    }
+    for (int model = 1; model < num_models; ++model) {
+      int64_t msg;
+      comm->recv(&msg, 1, model);
+      ASSERT_EQ(msg, (int64_t) model);
+    }
+  }
+  comm->global_barrier();
+  fini_comm(comm);
+}
+
+/** Verify the chunked, compressed inter-model broadcast is lossless. */
+void test_intermodel_broadcast_compressed() {
+  lbann_comm* comm = init_comm();
+  const int count = 1000;
+  std::vector<DataType> expected(count);
+  std::vector<DataType> data(count);
+  // Zeros, sparse values, and incompressible values.
+  for (int pattern = 0; pattern < 3; ++pattern) {
+    for (int i = 0; i < count; ++i) {
+      if (pattern == 0) {
+        expected[i] = 0.0f;
+      } else if (pattern == 1) {
+        expected[i] = i % 10 == 0 ? 0.5f * i : 0.0f;
+      } else {
+        expected[i] = std::sin((DataType) i) * 1e3f;
+      }
+    }
+    const int root = pattern % comm->get_num_models();
+    if (comm->get_model_rank() == root) {
+      data = expected;
+    } else {
+      std::fill(data.begin(), data.end(), -1.0f);
+    }
+    // Small chunks so the pipeline has many stages.
+    const size_t bytes = comm->intermodel_broadcast_compressed(
+      data.data(), count, root, 64);
+    ASSERT_VECTOR_EQ(data, expected);
+    if (pattern == 0) {
+      ASSERT_TRUE(bytes < sizeof(DataType) * count / 10);
+    }
+    ASSERT_EQ(comm->intermodel_allreduce((int) bytes, mpi::MAX), (int) bytes);
+  }
+  fini_comm(comm);
+}
+
+#if LBANN_HAS_RMA_WINDOWS
+/** Verify one-sided inter-model sums, broadcasts and async updates work. */
+void test_rma_intermodel() {
+  lbann_comm* comm = init_comm();
+  const int num_models = comm->get_num_models();
+  const int model_rank = comm->get_model_rank();
+  // Sum, with a size that does not split evenly across models.
+  const int count = 2 * num_models + 3;
+  std::vector<DataType> data(count, (DataType) (model_rank + 1));
+  comm->rma_intermodel_sum(data.data(), count);
+  for (int i = 0; i < count; ++i) {
+    ASSERT_EQ(data[i], (DataType) (num_models * (num_models + 1) / 2));
+  }
+  DistMat mat(comm->get_model_grid());
+  create_mat(mat);
+  comm->rma_intermodel_sum_matrix(mat);
+  validate_mat(mat, (float) num_models);
+  // Broadcast.
+  create_mat(mat, (float) model_rank);
+  comm->rma_intermodel_broadcast_matrix(mat, 1);
+  validate_mat(mat, (float) 1);  // Should come from the 1st model.
+  // Every model accumulates into model 0 without model 0 taking part.
+  comm->rma_setup(count);
+  std::vector<DataType> ones(count, 1.0f);
+  comm->rma_accumulate(ones.data(), count, 0);
+  comm->rma_flush();
+  comm->rma_fence();
+  if (model_rank == 0) {
+    std::vector<DataType> drained(count);
+    comm->rma_drain(drained.data(), count);
+    for (int i = 0; i < count; ++i) {
+      ASSERT_EQ(drained[i], (DataType) num_models);
+    }
+    comm->rma_drain(drained.data(), count);
+    for (int i = 0; i < count; ++i) {
+      ASSERT_EQ(drained[i], 0.0f);
+    }
+  }
+  comm->rma_fence();
+  // Model 0 publishes values that every model fetches.
+  if (model_rank == 0) {
+    std::vector<DataType> values(count);
+    std::iota(values.begin(), values.end(), 0.0f);
+    comm->rma_put(values.data(), count, 0);
+    comm->rma_flush();
+  }
+  comm->rma_fence();
+  std::vector<DataType> fetched(count - 1);
+  comm->rma_get(fetched.data(), count - 1, 0, 1);
+  comm->rma_flush();
+  for (int i = 0; i < count - 1; ++i) {
+    ASSERT_EQ(fetched[i], (DataType) (i + 1));
+  }
+  fini_comm(comm);
+}
+#endif  // LBANN_HAS_RMA_WINDOWS
+
+/** Verify non-blocking operations complete with the progress thread. */
+void test_progress_thread() {
+  lbann_comm* comm = init_comm();
+  int provided;
+  MPI_Query_thread(&provided);
+  bool started = comm->start_progress_thread();
+  ASSERT_EQ(started, provided == MPI_THREAD_MULTIPLE);
+  ASSERT_EQ(comm->has_progress_thread(), started);
+  DistMat mat(comm->get_model_grid());
+  create_mat(mat);
+  comm->intermodel_barrier();
+  mpi::Request<DataType> req;
+  comm->nb_intermodel_sum_matrix(mat, req);
+  comm->wait(req);
+  validate_mat(mat, (float) LBANN_COMM_TEST_NUM_MODELS);
+  comm->stop_progress_thread();
+  ASSERT_FALSE(comm->has_progress_thread());
+  fini_comm(comm);
+}
+
+/**
+ * Verify inter-model sums overlapped with intra-model work (non-blocking, or
+ * on a helper thread as the imcomm callback does) match blocking sums, and
+ * that the byte counters stay consistent.
+ */
+void test_overlapped_intermodel_sum() {
+  lbann_comm* comm = init_comm();
+  const int num_layers = 4;
+  std::vector<DistMat> mats, expected;
+  for (int l = 0; l < num_layers; ++l) {
+    mats.emplace_back(comm->get_model_grid());
+    mats[l].Resize(LBANN_COMM_TEST_NROWS * (l + 1), LBANN_COMM_TEST_NCOLS);
+    // Small integers, so sums are exact whatever the reduction order.
+    for (int j = 0; j < mats[l].LocalWidth(); ++j) {
+      for (int i = 0; i < mats[l].LocalHeight(); ++i) {
+        mats[l].SetLocal(i, j, (DataType) (comm->get_model_rank() + i + l));
+      }
+    }
+    expected.emplace_back(mats[l]);
+    comm->intermodel_sum_matrix(expected[l]);
+  }
+  // Non-blocking, started layer by layer with intra-model work in between.
+  std::vector<DistMat> nb_mats(mats);
+  std::vector<mpi::Request<DataType>> reqs(num_layers);
+  for (int l = num_layers; l-- > 0;) {
+    comm->nb_intermodel_sum_matrix(nb_mats[l], reqs[l]);
+    ASSERT_EQ(comm->model_allreduce(1), comm->get_procs_per_model());
+  }
+  for (int l = 0; l < num_layers; ++l) {
+    comm->wait(reqs[l]);
+    ASSERT_MAT_EQ(nb_mats[l].Matrix(), expected[l].Matrix());
+  }
+  // On a helper thread, while this thread keeps doing intra-model work.
+  int provided;
+  MPI_Query_thread(&provided);
+  if (provided == MPI_THREAD_MULTIPLE) {
+    std::vector<DistMat> thread_mats(mats);
+    comm->intermodel_barrier();
+    comm->reset_stats_counters();
+    std::thread helper([comm, &thread_mats] () {
+        for (auto& mat : thread_mats) {
+          comm->intermodel_sum_matrix(mat);
+        }
+      });
+    const int num_allreduces = 100;
+    for (int i = 0; i < num_allreduces; ++i) {
+      comm->model_allreduce(i);
+    }
+    helper.join();
+    size_t sum_bytes = 0;
+    for (int l = 0; l < num_layers; ++l) {
+      ASSERT_MAT_EQ(thread_mats[l].Matrix(), expected[l].Matrix());
+      sum_bytes += sizeof(DataType) * thread_mats[l].LocalHeight() *
+        thread_mats[l].LocalWidth();
+    }
+    ASSERT_EQ(comm->get_bytes_sent(), sum_bytes + num_allreduces * sizeof(int));
+  }
+  fini_comm(comm);
+}
+
+/**
+ * Verify summing gradients through gradient_buckets matches summing each one
+ * with intermodel_sum_matrix, blocking and not, over several mini-batches.
+ * One gradient is larger than a bucket, and the gradients after it only
+ * partly fill the last bucket.
+ */
+void test_gradient_buckets() {
+  lbann_comm* comm = init_comm();
+  const std::vector<std::pair<int, int>> sizes = {
+    {3, 2}, {5, 4}, {40, 3}, {2, 2}, {3, 1}};
+  const El::Int bucket_entries = 8;
+  gradient_buckets buckets(comm, bucket_entries * sizeof(DataType));
+  std::vector<DistMat> grads;
+  size_t total_entries = 0;
+  for (size_t l = 0; l < sizes.size(); ++l) {
+    grads.emplace_back(comm->get_model_grid());
+    grads[l].Resize(sizes[l].first, sizes[l].second);
+    const El::Int local_size = grads[l].LocalHeight() * grads[l].LocalWidth();
+    buckets.add_gradient(l, local_size);
+    total_entries += local_size;
+  }
+  buckets.setup();
+  ASSERT_TRUE(grads[2].LocalHeight() * grads[2].LocalWidth() > bucket_entries);
+  ASSERT_TRUE(buckets.get_num_buckets() >= 3);
+  ASSERT_EQ(buckets.get_staging_bytes(), total_entries * sizeof(DataType));
+  for (bool nonblocking : {false, true}) {
+    for (int batch = 0; batch < 2; ++batch) {
+      std::vector<DistMat> expected;
+      for (size_t l = 0; l < sizes.size(); ++l) {
+        // Small integers, so sums are exact whatever the reduction order.
+        for (int j = 0; j < grads[l].LocalWidth(); ++j) {
+          for (int i = 0; i < grads[l].LocalHeight(); ++i) {
+            grads[l].SetLocal(i, j, (DataType) ((comm->get_model_rank() + 1) *
+                                                (i + 2 * j) + batch + l));
+          }
+        }
+        expected.emplace_back(grads[l]);
+        comm->intermodel_sum_matrix(expected[l]);
+      }
+      buckets.reset_counters();
+      for (size_t l = 0; l < sizes.size(); ++l) {
+        buckets.pack(l, grads[l], nonblocking);
+      }
+      ASSERT_EQ(buckets.get_num_collectives(), buckets.get_num_buckets());
+      for (size_t l = 0; l < sizes.size(); ++l) {
+        buckets.unpack(l, grads[l]);
+        ASSERT_MAT_EQ(grads[l], expected[l]);
+      }
+    }
+  }
+  fini_comm(comm);
+}
+
+/** Verify inter-model reduce-scatter and allgather work. */
+void test_intermodel_reduce_scatter_allgather() {
+  lbann_comm* comm = init_comm();
+  const int count = 3;
+  std::vector<DataType> send(count * LBANN_COMM_TEST_NUM_MODELS);
+  for (size_t i = 0; i < send.size(); ++i) {
+    send[i] = i;
+  }
+  std::vector<DataType> shard(count);
+  comm->intermodel_reduce_scatter(send.data(), shard.data(), count);
+  for (int i = 0; i < count; ++i) {
+    ASSERT_EQ(shard[i], (DataType) (LBANN_COMM_TEST_NUM_MODELS *
+                                    (comm->get_model_rank() * count + i)));
+  }
+  std::vector<DataType> gathered(count * LBANN_COMM_TEST_NUM_MODELS);
+  comm->intermodel_allgather(shard.data(), gathered.data(), count);
+  for (size_t i = 0; i < gathered.size(); ++i) {
+    ASSERT_EQ(gathered[i], (DataType) (LBANN_COMM_TEST_NUM_MODELS * i));
+  }
+  fini_comm(comm);
+}
+
+/** Verify compressed sums within a model work. */
+void test_model_sum_compressed() {
+  lbann_comm* comm = init_comm();
+  const int count = 1000;
+  for (intramodel_compression c : {intramodel_compression::FP16,
+                                   intramodel_compression::BLOCK8}) {
+    std::vector<DataType> data(count);
+    for (int i = 0; i < count; ++i) {
+      data[i] = (DataType) (i % 7) * (comm->get_rank_in_model() + 1);
+    }
+    comm->model_sum_compressed(data.data(), count, c);
+    // Small integers are exact in fp16; 8-bit blocks are within a step.
+    const DataType ppm_sum = LBANN_COMM_TEST_PPM * (LBANN_COMM_TEST_PPM + 1) / 2;
+    for (int i = 0; i < count; ++i) {
+      const DataType expected = (i % 7) * ppm_sum;
+      if (c == intramodel_compression::FP16) {
+        ASSERT_EQ(data[i], expected);
+      } else {
+        ASSERT_TRUE(std::fabs(data[i] - expected) <= 6 * ppm_sum / 127.0);
+      }
+    }
+    // Every process in the model must end with the same values.
+    std::vector<DataType> max_vals(count), min_vals(count);
+    comm->model_allreduce(data.data(), count, max_vals.data(), El::mpi::MAX);
+    comm->model_allreduce(data.data(), count, min_vals.data(), El::mpi::MIN);
+    for (int i = 0; i < count; ++i) {
+      ASSERT_EQ(max_vals[i], min_vals[i]);
+    }
+  }
+  fini_comm(comm);
+}
+
+/** Verify compressed redistributions within a model work. */
+void test_model_redistribute_compressed() {
+  lbann_comm* comm = init_comm();
+  DistMat mat(comm->get_model_grid());
+  mat.Resize(LBANN_COMM_TEST_NROWS, LBANN_COMM_TEST_NCOLS);
+  El::IndexDependentFill(mat, (std::function<DataType(El::Int,El::Int)>)
+                         ([] (El::Int i, El::Int j) -> DataType {
+                           return i + 100 * j;
+                         }));
+  StarVCMat star_vc(comm->get_model_grid());
+  ASSERT_TRUE(comm->model_redistribute_compressed(
+                mat, star_vc, intramodel_compression::FP16));
+  ASSERT_EQ(star_vc.Height(), mat.Height());
+  ASSERT_EQ(star_vc.Width(), mat.Width());
+  for (int jL = 0; jL < star_vc.LocalWidth(); ++jL) {
+    for (int iL = 0; iL < star_vc.LocalHeight(); ++iL) {
+      ASSERT_EQ(star_vc.GetLocal(iL, jL),
+                (DataType) (star_vc.GlobalRow(iL) + 100 * star_vc.GlobalCol(jL)));
+    }
+  }
+  // And back.
+  DistMat back(comm->get_model_grid());
+  ASSERT_TRUE(comm->model_redistribute_compressed(
+                star_vc, back, intramodel_compression::FP16));
+  ASSERT_MAT_EQ(back, mat);
+  ASSERT_TRUE(!comm->model_redistribute_compressed(
+                mat, back, intramodel_compression::FP16));
+  ASSERT_TRUE(!comm->model_redistribute_compressed(
+                mat, star_vc, intramodel_compression::NONE));
+  fini_comm(comm);
+}
+
 /** Verify sends/receives of blob data work. */
 void test_send_recv_blob() {
   lbann_comm* comm = init_comm();
@@ -174,6 +744,63 @@ void test_send_recv_mat() {
   fini_comm(comm);
 }
 
+/**
+ * Verify persistent requests are rebound, and deliver the right data, when
+ * the buffer, count or peer changes between uses, and are reused otherwise.
+ */
+void test_persistent_send_recv() {
+  lbann_comm* comm = init_comm();
+  const int num_models = comm->get_num_models();
+  const int model = comm->get_model_rank();
+  std::vector<int> send_a(8), recv_a(8), send_b(16), recv_b(16);
+  lbann_comm::persistent_request send_req, recv_req;
+  auto exchange = [&] (std::vector<int>& send_buf, std::vector<int>& recv_buf,
+                       int count, int step) {
+    const int dst = (model + step) % num_models;
+    const int src = (model + num_models - step) % num_models;
+    for (int i = 0; i < count; ++i) {
+      send_buf[i] = 1000 * model + 100 * step + count + i;
+    }
+    std::fill(recv_buf.begin(), recv_buf.end(), -1);
+    comm->persistent_recv(recv_buf.data(), count, src, recv_req);
+    comm->persistent_send(send_buf.data(), count, dst, send_req);
+    comm->wait(recv_req);
+    comm->wait(send_req);
+    for (int i = 0; i < count; ++i) {
+      ASSERT_EQ(recv_buf[i], 1000 * src + 100 * step + count + i);
+    }
+    for (size_t i = count; i < recv_buf.size(); ++i) {
+      ASSERT_EQ(recv_buf[i], -1);
+    }
+    ASSERT_TRUE(send_req.buf == send_buf.data());
+    ASSERT_EQ(send_req.count, count);
+    ASSERT_EQ(send_req.peer, comm->get_world_rank(dst, comm->get_rank_in_model()));
+    ASSERT_TRUE(recv_req.buf == recv_buf.data());
+    ASSERT_EQ(recv_req.count, count);
+    ASSERT_EQ(recv_req.peer, comm->get_world_rank(src, comm->get_rank_in_model()));
+  };
+  exchange(send_a, recv_a, 8, 1);
+  // Same buffer, count and peer: the requests are restarted as they are.
+  const MPI_Request first_send = send_req.req;
+  const MPI_Request first_recv = recv_req.req;
+  exchange(send_a, recv_a, 8, 1);
+  ASSERT_TRUE(send_req.req == first_send);
+  ASSERT_TRUE(recv_req.req == first_recv);
+  // New buffers.
+  exchange(send_b, recv_b, 16, 1);
+  // Fewer entries from the same buffers.
+  exchange(send_b, recv_b, 5, 1);
+  // Another peer.
+  exchange(send_b, recv_b, 5, 2);
+  // Back to the first binding.
+  exchange(send_a, recv_a, 8, 1);
+  lbann_comm::free_persistent(send_req);
+  lbann_comm::free_persistent(recv_req);
+  ASSERT_TRUE(send_req.req == MPI_REQUEST_NULL);
+  ASSERT_TRUE(recv_req.req == MPI_REQUEST_NULL);
+  fini_comm(comm);
+}
+
 /** Verify broadcasting blob data works. */
 void test_broadcast_blob() {
   lbann_comm* comm = init_comm();
@@ -220,9 +847,30 @@ int main(int argc, char** argv) {
     test_grid();
     test_mat();
     test_intermodel_sum_matrix();
+    test_hierarchical_intermodel_sum();
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+    test_shm_hierarchical_intermodel_sum();
+#endif
     test_intermodel_broadcast_matrix();
+    test_reduced_precision_intermodel_matrix();
+    test_rank_placement();
+    test_tracing();
+    test_nb_intermodel_sum_matrix();
+    test_nb_intermodel_broadcast_matrix();
+    test_intermodel_broadcast_compressed();
+    test_ps_messages();
+#if LBANN_HAS_RMA_WINDOWS
+    test_rma_intermodel();
+#endif
+    test_progress_thread();
+    test_overlapped_intermodel_sum();
+    test_gradient_buckets();
+    test_intermodel_reduce_scatter_allgather();
+    test_model_sum_compressed();
+    test_model_redistribute_compressed();
     test_send_recv_blob();
     test_send_recv_mat();
+    test_persistent_send_recv();
     test_broadcast_blob();
     test_broadcast_mat();
     El::mpi::Barrier(El::mpi::COMM_WORLD);
@@ -106,11 +106,26 @@ int main(int argc, char* argv[])
     SetBlocksize(perfParams.BlockSize);
 
     // Set up the communicator and get the grid.
-    comm = new lbann_comm(trainParams.ProcsPerModel);
+    comm = new lbann_comm(
+      trainParams.ProcsPerModel,
+      static_cast<rank_placement>(trainParams.RankPlacement));
+    comm->set_hierarchical_allreduce(trainParams.HierarchicalAllreduce);
+    comm->set_error_signal_compression(
+      static_cast<intramodel_compression>(trainParams.ErrorSignalCompression));
+    comm->set_gradient_compression(
+      static_cast<intramodel_compression>(trainParams.GradientCompression));
+    comm->set_payload_precision(
+      static_cast<payload_precision>(trainParams.PayloadPrecision));
+    if (trainParams.AsyncProgress && !comm->start_progress_thread() &&
+        comm->am_world_master()) {
+      cout << "MPI_THREAD_MULTIPLE unavailable; not starting the progress "
+           << "thread" << endl;
+    }
     Grid& grid = comm->get_model_grid();
     if (comm->am_world_master()) {
       cout << "Number of models: " << comm->get_num_models() << endl;
       cout << "Grid is " << grid.Height() << " x " << grid.Width() << endl;
+      comm->print_placement_report(cout);
       cout << endl;
     }
 
@@ -279,6 +294,17 @@ int main(int argc, char* argv[])
       static_cast<lbann_callback_imcomm::comm_type>(
         trainParams.IntermodelCommMethod),
       layer_indices, &summarizer);
+    imcomm_cb.set_overlap(trainParams.OverlapImcomm);
+    imcomm_cb.set_bucket_size(trainParams.ImcommBucketSize);
+    imcomm_cb.set_allreduce_algorithm(
+      static_cast<lbann_quantizer::allreduce_algorithm>(
+        trainParams.AllreduceAlgorithm),
+      trainParams.AutotuneAllreduce);
+    imcomm_cb.set_ring_segment_size(trainParams.RingSegmentSize);
+    imcomm_cb.set_ring_precision(
+      static_cast<payload_precision>(trainParams.PayloadPrecision));
+    imcomm_cb.set_topk_proportion(trainParams.TopKProportion);
+    imcomm_cb.set_qsgd_bits(trainParams.QSGDBits);
 
     if (comm->am_world_master()) {
       cout << "Layer initialized:" << endl;
@@ -302,16 +328,25 @@ int main(int argc, char* argv[])
 
     // Initialize model.
     dnn.setup();
+    if (trainParams.BroadcastModel) {
+      dnn.broadcast_weights(0);
+    }
     
     comm->global_barrier();
 
     ///////////////////////////////////////////////////////////////////
     // main loop for training/testing
     ///////////////////////////////////////////////////////////////////
+    if (!trainParams.CommTrace.empty()) {
+      comm->enable_tracing();
+    }
     for (int t = 0; t < trainParams.EpochCount; ++t) {
       dnn.train(1, true);
       dnn.evaluate();
     }
+    if (!trainParams.CommTrace.empty()) {
+      comm->write_trace(trainParams.CommTrace);
+    }
   }
   catch (lbann_exception& e) { lbann_report_exception(e, comm); }
   catch (exception& e) { ReportException(e); } /// Elemental exceptions
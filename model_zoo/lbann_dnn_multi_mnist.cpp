@@ -85,12 +85,27 @@ int main(int argc, char* argv[])
     SetBlocksize(perfParams.BlockSize);
 
     // Set up the communicator and get the grid.
-    comm = new lbann_comm(trainParams.ProcsPerModel);
+    comm = new lbann_comm(
+      trainParams.ProcsPerModel,
+      static_cast<rank_placement>(trainParams.RankPlacement));
+    comm->set_hierarchical_allreduce(trainParams.HierarchicalAllreduce);
+    comm->set_error_signal_compression(
+      static_cast<intramodel_compression>(trainParams.ErrorSignalCompression));
+    comm->set_gradient_compression(
+      static_cast<intramodel_compression>(trainParams.GradientCompression));
+    comm->set_payload_precision(
+      static_cast<payload_precision>(trainParams.PayloadPrecision));
+    if (trainParams.AsyncProgress && !comm->start_progress_thread() &&
+        comm->am_world_master()) {
+      cout << "MPI_THREAD_MULTIPLE unavailable; not starting the progress "
+           << "thread" << endl;
+    }
     Grid& grid = comm->get_model_grid();
     if (comm->am_world_master()) {
       cout << "Number of models: " << comm->get_num_models() << 
         " (" << comm->get_procs_per_model() << " procs per model)" << endl;
       cout << "Grid is " << grid.Height() << " x " << grid.Width() << endl;
+      comm->print_placement_report(cout);
       cout << endl;
     }
 
@@ -170,11 +185,18 @@ int main(int argc, char* argv[])
     ///////////////////////////////////////////////////////////////////
     Optimizer_factory *optimizer;
     if (trainParams.LearnRateMethod == 1) { // Adagrad
-      optimizer = new Adagrad_factory(comm, trainParams.LearnRate);
+      optimizer = new Adagrad_factory(comm, trainParams.LearnRate, 1e-6,
+                                      trainParams.OptimizerStateBits);
     } else if (trainParams.LearnRateMethod == 2) { // RMSprop
-      optimizer = new RMSprop_factory(comm/*, trainParams.LearnRate*/);
+      optimizer = new RMSprop_factory(comm/*, trainParams.LearnRate*/, 0.001, 0.9, 1e-6,
+                                      trainParams.OptimizerStateBits);
     } else if (trainParams.LearnRateMethod == 3) { // Adam
-      optimizer = new Adam_factory(comm, trainParams.LearnRate);
+      optimizer = new Adam_factory(comm, trainParams.LearnRate, 0.9f, 0.999f, 1e-8f,
+                                   trainParams.OptimizerStateBits);
+    } else if (trainParams.LearnRateMethod == 5) { // LARS
+      optimizer = new LARS_factory(comm, trainParams.LearnRate);
+    } else if (trainParams.LearnRateMethod == 6) { // LAMB
+      optimizer = new LAMB_factory(comm, trainParams.LearnRate);
     } else {
       optimizer = new SGD_factory(comm, trainParams.LearnRate, 0.9,
                                   trainParams.LrDecayRate, true);
@@ -224,7 +246,40 @@ int main(int argc, char* argv[])
       static_cast<lbann_callback_imcomm::comm_type>(
         trainParams.IntermodelCommMethod),
       {fcidx1, fcidx2, fcidx3, smidx}, &summarizer);
-    dnn.add_callback(&imcomm_cb);
+    imcomm_cb.set_overlap(trainParams.OverlapImcomm);
+    imcomm_cb.set_bucket_size(trainParams.ImcommBucketSize);
+    imcomm_cb.set_allreduce_algorithm(
+      static_cast<lbann_quantizer::allreduce_algorithm>(
+        trainParams.AllreduceAlgorithm),
+      trainParams.AutotuneAllreduce);
+    imcomm_cb.set_ring_segment_size(trainParams.RingSegmentSize);
+    imcomm_cb.set_ring_precision(
+      static_cast<payload_precision>(trainParams.PayloadPrecision));
+    imcomm_cb.set_topk_proportion(trainParams.TopKProportion);
+    imcomm_cb.set_qsgd_bits(trainParams.QSGDBits);
+    // Or average models every few local steps instead.
+    lbann_callback_local_sgd local_sgd_cb(
+      trainParams.LocalSGDSteps, {fcidx1, fcidx2, fcidx3, smidx}, true,
+      &summarizer);
+    if (trainParams.LocalSGDMaxSteps > 0) {
+      local_sgd_cb.set_adaptive(trainParams.LocalSGDMaxSteps);
+    }
+    // Or train asynchronously against a parameter server.
+    lbann_callback_async_sgd async_sgd_cb(trainParams.AsyncStaleness,
+                                          &summarizer);
+    // Or gossip with neighbouring models.
+    lbann_callback_gossip gossip_cb(
+      trainParams.GossipTopology == 1 ? lbann_callback_gossip::RANDOM :
+      lbann_callback_gossip::RING, 42, &summarizer);
+    if (trainParams.GossipTopology >= 0) {
+      dnn.add_callback(&gossip_cb);
+    } else if (trainParams.AsyncStaleness >= 0) {
+      dnn.add_callback(&async_sgd_cb);
+    } else if (trainParams.LocalSGDSteps > 0) {
+      dnn.add_callback(&local_sgd_cb);
+    } else {
+      dnn.add_callback(&imcomm_cb);
+    }
     lbann_callback_adaptive_learning_rate lrsched(4, 0.1f);
     dnn.add_callback(&lrsched);
     // lbann_callback_io io_cb({0,4}); // Monitor layers 0 and 4
@@ -256,18 +311,29 @@ int main(int argc, char* argv[])
     ///////////////////////////////////////////////////////////////////
 
     // Initialize the model's data structures
+    dnn.set_use_flat_params(trainParams.FlatParams || trainParams.ShardOptimizer,
+                            trainParams.ShardOptimizer);
     dnn.setup();
+    if (trainParams.BroadcastModel) {
+      dnn.broadcast_weights(0);
+    }
 
     // Reinitialize the RNG differently for each rank.
     init_random(comm->get_rank_in_world() + 1);
 
     comm->global_barrier();
 
+    if (!trainParams.CommTrace.empty()) {
+      comm->enable_tracing();
+    }
     // train/test
     for (int t = 0; t < trainParams.EpochCount; t++) {
       dnn.train(1, true);
       dnn.evaluate();
     }
+    if (!trainParams.CommTrace.empty()) {
+      comm->write_trace(trainParams.CommTrace);
+    }
   }
   catch (lbann_exception& e) { lbann_report_exception(e, comm); }
   catch (exception& e) { ReportException(e); }
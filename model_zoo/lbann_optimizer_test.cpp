@@ -0,0 +1,421 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_optimizer_test.cpp - Tests optimizers, their state storage and the
+// flattened parameter buffers
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <random>
+#include "lbann/lbann_base.hpp"
+#include "lbann/lbann_comm.hpp"
+#include "lbann/io/lbann_persist.hpp"
+#include "lbann/layers/lbann_layer_fully_connected.hpp"
+#include "lbann/models/lbann_flat_params.hpp"
+#include "lbann/optimizers/lbann_optimizer_lamb.hpp"
+#include "lbann/optimizers/lbann_optimizer_lars.hpp"
+#include "lbann/optimizers/lbann_optimizer_sgd.hpp"
+#include "lbann/optimizers/lbann_optimizer_state.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+#include "lbann_test_utils.hpp"
+
+using namespace lbann;
+
+/** Number of state entries: three full blocks and a partial one. */
+const El::Int num_state_entries = 3 * block_quantized_state::block_size + 37;
+
+/**
+ * Return num_entries state values whose blocks cycle through uniform values,
+ * all zeros, magnitudes spanning many orders (like second moments), and
+ * non-negative values.
+ */
+std::vector<DataType> make_state_values(El::Int num_entries, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<DataType> uniform(-10.0f, 10.0f);
+  std::uniform_real_distribution<DataType> exponent(-12.0f, 0.0f);
+  std::vector<DataType> vals(num_entries);
+  for (El::Int i = 0; i < num_entries; ++i) {
+    switch ((i / block_quantized_state::block_size) % 4) {
+    case 0:
+      vals[i] = uniform(gen);
+      break;
+    case 1:
+      vals[i] = 0.0f;
+      break;
+    case 2:
+      vals[i] = (i % 2 ? -1.0f : 1.0f) * std::exp(exponent(gen));
+      break;
+    default:
+      vals[i] = std::fabs(uniform(gen));
+    }
+  }
+  return vals;
+}
+
+/** Store vals into state, one block at a time. */
+void store_state(block_quantized_state& state,
+                 const std::vector<DataType>& vals) {
+  state.setup(vals.size());
+  for (El::Int block = 0; block < state.get_num_blocks(); ++block) {
+    state.store_block(block, &vals[block * block_quantized_state::block_size]);
+  }
+}
+
+/** Return every dequantized entry of state. */
+std::vector<DataType> load_state(const block_quantized_state& state) {
+  std::vector<DataType> vals(state.get_num_entries());
+  DataType block_vals[block_quantized_state::block_size];
+  for (El::Int block = 0; block < state.get_num_blocks(); ++block) {
+    const El::Int len = state.load_block(block, block_vals);
+    std::copy(block_vals, block_vals + len,
+              &vals[block * block_quantized_state::block_size]);
+  }
+  return vals;
+}
+
+/**
+ * Return the largest error block_quantized_state may make storing x in a
+ * block with absolute maximum scale. Codes round sqrt(|x| / scale) * qmax, so
+ * they are off by at most 1/2, which is squared back.
+ */
+DataType quantization_bound(DataType x, DataType scale, int bits) {
+  const DataType qmax = bits == 8 ? 127.0f : 32767.0f;
+  const DataType r = std::sqrt(std::fabs(x) / scale);
+  return scale * (r / qmax + 0.25f / (qmax * qmax) + 1e-6f);
+}
+
+/** Check that approx is within the quantization bound of exact, per block. */
+void check_quantized(const std::vector<DataType>& approx,
+                     const std::vector<DataType>& exact, int bits) {
+  ASSERT_EQ(approx.size(), exact.size());
+  for (size_t start = 0; start < exact.size();
+       start += block_quantized_state::block_size) {
+    const size_t end = std::min(exact.size(),
+                                start + block_quantized_state::block_size);
+    DataType scale = 0.0f;
+    for (size_t i = start; i < end; ++i) {
+      scale = std::max(scale, std::fabs(exact[i]));
+    }
+    for (size_t i = start; i < end; ++i) {
+      if (scale == 0.0f) {
+        ASSERT_EQ(approx[i], 0.0f);
+        continue;
+      }
+      ASSERT_TRUE(std::fabs(approx[i] - exact[i]) <=
+                  quantization_bound(exact[i], scale, bits));
+      // Signs survive, and the largest entry is exact.
+      ASSERT_TRUE(approx[i] * exact[i] >= 0.0f);
+      if (std::fabs(exact[i]) == scale) {
+        ASSERT_EQ(std::fabs(approx[i]), scale);
+      }
+    }
+  }
+}
+
+/** Test the 8- and 16-bit codecs stay within their error bounds. */
+void test_block_quantize() {
+  for (int bits : {8, 16}) {
+    const std::vector<DataType> vals =
+      make_state_values(num_state_entries, bits);
+    block_quantized_state state(bits);
+    store_state(state, vals);
+    ASSERT_EQ(state.get_num_entries(), num_state_entries);
+    ASSERT_EQ(state.get_num_blocks(), 4);
+    ASSERT_EQ(state.get_bytes(), 4 * sizeof(float) +
+              num_state_entries * (bits / 8));
+    check_quantized(load_state(state), vals, bits);
+    // Loading the partial last block leaves the rest of the buffer alone.
+    DataType block_vals[block_quantized_state::block_size];
+    std::fill(block_vals, block_vals + block_quantized_state::block_size,
+              -42.0f);
+    ASSERT_EQ(state.load_block(3, block_vals), 37);
+    for (El::Int i = 37; i < block_quantized_state::block_size; ++i) {
+      ASSERT_EQ(block_vals[i], -42.0f);
+    }
+  }
+}
+
+/**
+ * Test apply_blockwise visits every local entry once, with the state entry
+ * that matches it in column-major order, and stores the updated state.
+ */
+void test_apply_blockwise() {
+  DistMat grad, weights;
+  El::Uniform(grad, 37, 29, 0.0f, 1.0f);
+  El::Uniform(weights, 37, 29, 0.0f, 1.0f);
+  DistMat orig_weights(weights);
+  const El::Int height = grad.LocalHeight();
+  const El::Int num_entries = height * grad.LocalWidth();
+  std::vector<DataType> grad_vals(num_entries), grad_sq_vals(num_entries);
+  for (El::Int k = 0; k < num_entries; ++k) {
+    grad_vals[k] = grad.GetLocal(k % height, k / height);
+    grad_sq_vals[k] = grad_vals[k] * grad_vals[k];
+  }
+  block_quantized_state m(8), v(16);
+  m.setup(num_entries);
+  v.setup(num_entries);
+  // Both states start at zero, so s0 holds exactly g when w is updated.
+  apply_blockwise(grad, weights, m, &v,
+                  [] (DataType& g, DataType& w, DataType& s0, DataType& s1) {
+                    s0 += g;
+                    s1 += g * g;
+                    w -= s0 + 1.0f;
+                  });
+  for (El::Int k = 0; k < num_entries; ++k) {
+    const El::Int row = k % height;
+    const El::Int col = k / height;
+    const DataType expected =
+      orig_weights.GetLocal(row, col) - grad_vals[k] - 1.0f;
+    ASSERT_TRUE(std::fabs(weights.GetLocal(row, col) - expected) <= 1e-5f);
+  }
+  const std::vector<DataType> m_vals = load_state(m);
+  check_quantized(m_vals, grad_vals, 8);
+  check_quantized(load_state(v), grad_sq_vals, 16);
+  // Without a second state, f sees the dequantized first state.
+  El::Copy(weights, orig_weights);
+  apply_blockwise(grad, weights, m, nullptr,
+                  [] (DataType&, DataType& w, DataType& s0, DataType&) {
+                    w += s0;
+                    s0 *= 0.5f;
+                  });
+  std::vector<DataType> half_m(num_entries);
+  for (El::Int k = 0; k < num_entries; ++k) {
+    const El::Int row = k % height;
+    const El::Int col = k / height;
+    const DataType expected = orig_weights.GetLocal(row, col) + m_vals[k];
+    ASSERT_TRUE(std::fabs(weights.GetLocal(row, col) - expected) <= 1e-5f);
+    half_m[k] = 0.5f * m_vals[k];
+  }
+  check_quantized(load_state(m), half_m, 8);
+}
+
+/** Test saving and restoring the per-rank checkpoint files. */
+void test_state_checkpoint() {
+  const char* dir = "lbann_optimizer_test_checkpoint";
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  for (int bits : {8, 16}) {
+    block_quantized_state state(bits);
+    store_state(state, make_state_values(num_state_entries, rank + bits));
+    persist p;
+    p.open_checkpoint(dir);
+    state.save_to_checkpoint_shared(p, "state");
+    p.close_checkpoint();
+    ASSERT_EQ(p.get_bytes(),
+              sizeof(uint32_t) + sizeof(uint64_t) + state.get_bytes());
+    // The restored state takes its size from the file.
+    block_quantized_state restored(bits);
+    restored.setup(10);
+    persist r;
+    r.open_restart(dir);
+    restored.load_from_checkpoint_shared(r, "state");
+    r.close_restart();
+    ASSERT_EQ(r.get_bytes(), p.get_bytes());
+    ASSERT_EQ(restored.get_num_entries(), state.get_num_entries());
+    ASSERT_EQ(restored.get_num_blocks(), state.get_num_blocks());
+    ASSERT_VECTOR_EQ(load_state(restored), load_state(state));
+    // A state of the other width must refuse the file.
+    block_quantized_state other(bits == 8 ? 16 : 8);
+    persist r2;
+    r2.open_restart(dir);
+    bool threw = false;
+    try {
+      other.load_from_checkpoint_shared(r2, "state");
+    } catch (lbann_exception&) {
+      threw = true;
+    }
+    r2.close_restart();
+    ASSERT_TRUE(threw);
+  }
+}
+
+/**
+ * Set up a 2x2 layer with weights diag(3, 4) and gradient diag(0.6, 0.8), so
+ * ||W|| = 5 and ||dW|| = 1.
+ */
+void make_layer(DistMat& W, DistMat& G) {
+  El::Zeros(W, 2, 2);
+  W.Set(0, 0, 3.0f);
+  W.Set(1, 1, 4.0f);
+  El::Zeros(G, 2, 2);
+  G.Set(0, 0, 0.6f);
+  G.Set(1, 1, 0.8f);
+}
+
+/** Check W is diag(w0, w1) and the gradient was left alone. */
+void check_layer(DistMat& W, DistMat& G, DataType w0, DataType w1) {
+  ASSERT_TRUE(std::fabs(W.Get(0, 0) - w0) <= 1e-5f);
+  ASSERT_TRUE(std::fabs(W.Get(1, 1) - w1) <= 1e-5f);
+  ASSERT_EQ(W.Get(0, 1), 0.0f);
+  ASSERT_EQ(W.Get(1, 0), 0.0f);
+  ASSERT_EQ(G.Get(0, 0), 0.6f);
+  ASSERT_EQ(G.Get(1, 1), 0.8f);
+  ASSERT_EQ(G.Get(0, 1), 0.0f);
+  ASSERT_EQ(G.Get(1, 0), 0.0f);
+}
+
+/**
+ * Test two LARS steps (lr 0.1, momentum 0.9, weight decay 0.01, eta 0.5)
+ * against a hand-computed update.
+ */
+void test_lars_step() {
+  lbann_comm* comm = new lbann_comm(0);
+  DistMat W(comm->get_model_grid()), G(comm->get_model_grid());
+  make_layer(W, G);
+  LARS<DistMat> lars(comm, 0.1f, 0.9f, 0.01f, 0.5f);
+  lars.setup(2, 2);
+  // trust = 0.5 * 5 / (1 + 0.01 * 5), v = 0.1 * trust * (dW + 0.01 * W)
+  // = diag(0.15, 0.2).
+  lars.update_weight_bias_matrix(G, W);
+  ASSERT_TRUE(std::fabs(lars.get_trust_ratio() - 2.5f / 1.05f) <= 1e-5f);
+  check_layer(W, G, 2.85f, 3.8f);
+  // ||W|| = 4.75, so trust = 0.5 * 4.75 / (1 + 0.01 * 4.75), and
+  // v = 0.9 * v + 0.1 * trust * (dW + 0.01 * W) = diag(0.2775, 0.37).
+  lars.update_weight_bias_matrix(G, W);
+  ASSERT_TRUE(std::fabs(lars.get_trust_ratio() - 2.375f / 1.0475f) <= 1e-5f);
+  check_layer(W, G, 2.5725f, 3.43f);
+  delete comm;
+}
+
+/**
+ * Test two LAMB steps (lr 0.1, beta1 0.9, beta2 0.999, weight decay 0.01,
+ * eps 1e-6) against a hand-computed update. With a constant gradient the
+ * bias-corrected moments are dW and dW^2, so the Adam update is
+ * r = dW / (|dW| + eps) + 0.01 * W and the trust ratio is ||W|| / ||r||.
+ */
+void test_lamb_step() {
+  lbann_comm* comm = new lbann_comm(0);
+  DistMat W(comm->get_model_grid()), G(comm->get_model_grid());
+  make_layer(W, G);
+  LAMB<DistMat> lamb(comm, 0.1f, 0.9f, 0.999f, 0.01f, 1e-6f);
+  lamb.setup(2, 2);
+  // r = diag(1.0299983, 1.0399988). The trust ratios get a looser tolerance
+  // since 1 - beta2^t loses digits in single precision.
+  lamb.update_weight_bias_matrix(G, W);
+  ASSERT_TRUE(std::fabs(lamb.get_trust_ratio() - 3.4159397f) <= 1e-4f);
+  check_layer(W, G, 2.6481588f, 3.6447427f);
+  // r = diag(1.0264799, 1.0364462).
+  lamb.update_weight_bias_matrix(G, W);
+  ASSERT_TRUE(std::fabs(lamb.get_trust_ratio() - 3.0884534f) <= 1e-4f);
+  check_layer(W, G, 2.3311352f, 3.3246411f);
+  delete comm;
+}
+
+/**
+ * Test that flat_params::setup keeps the layers' weights and gradients and
+ * turns them into views of the flat buffers, frees the layers' optimizer
+ * state, and that the flat optimizer step matches stepping every layer on
+ * its own. The last layer has no optimizer, so it is left out.
+ */
+void test_flat_params() {
+  lbann_comm* comm = new lbann_comm(0);
+  SGD_factory sgd_fac(comm, 0.1f, 0.9f);
+  const std::vector<int> neurons = {7, 5, 3, 2};
+  const size_t num_layers = neurons.size() - 1;
+  std::vector<Layer*> ref_layers, flat_layers;
+  for (size_t l = 0; l < num_layers; ++l) {
+    const bool trainable = l + 1 < num_layers;
+    for (auto layers : {&ref_layers, &flat_layers}) {
+      Layer* layer = new FullyConnectedLayer(
+        l, neurons[l], neurons[l + 1], 4, activation_type::ID,
+        weight_initialization::glorot_uniform, comm,
+        trainable ? sgd_fac.create_optimizer() : nullptr);
+      layer->setup(neurons[l]);
+      layers->push_back(layer);
+    }
+    El::Copy(*ref_layers[l]->m_weights, *flat_layers[l]->m_weights);
+    El::Uniform(*ref_layers[l]->m_weights_gradient, neurons[l + 1],
+                neurons[l] + 1);
+    El::Copy(*ref_layers[l]->m_weights_gradient,
+             *flat_layers[l]->m_weights_gradient);
+  }
+  flat_params flat(comm, &sgd_fac);
+  flat.setup(flat_layers);
+  ASSERT_EQ(flat.get_layers().size(), num_layers - 1);
+  ASSERT_FALSE(flat.is_flattened(flat_layers.back()));
+  // The layers' local data now lives back to back in the flat buffers.
+  El::Int offset = 0;
+  for (Layer* layer : flat.get_layers()) {
+    ASSERT_TRUE(layer->m_weights->Buffer() ==
+                flat.get_local_weights().Buffer() + offset);
+    ASSERT_TRUE(layer->m_weights_gradient->Buffer() ==
+                flat.get_local_gradients().Buffer() + offset);
+    offset += layer->m_weights->LocalHeight() * layer->m_weights->LocalWidth();
+  }
+  ASSERT_EQ(offset, flat.get_local_size());
+  for (size_t l = 0; l < num_layers; ++l) {
+    ASSERT_MAT_EQ_TOL(flat_layers[l]->m_weights->Matrix(),
+                      ref_layers[l]->m_weights->Matrix(), 0.0f);
+    ASSERT_MAT_EQ_TOL(flat_layers[l]->m_weights_gradient->Matrix(),
+                      ref_layers[l]->m_weights_gradient->Matrix(), 0.0f);
+  }
+  // Two steps, so the momentum is carried over too.
+  for (int step = 0; step < 2; ++step) {
+    for (Layer* layer : ref_layers) {
+      if (layer->optimizer != nullptr) {
+        layer->update();
+      }
+    }
+    flat.update();
+  }
+  for (size_t l = 0; l < num_layers; ++l) {
+    ASSERT_MAT_EQ(flat_layers[l]->m_weights->Matrix(),
+                  ref_layers[l]->m_weights->Matrix());
+  }
+  // The layers' own optimizers keep no state.
+  for (Layer* layer : flat.get_layers()) {
+    for (ElMat* state : layer->optimizer->get_state_matrices()) {
+      ASSERT_EQ(state->Height(), 0);
+    }
+  }
+  // Layers whose learning rates differ cannot share the flat step.
+  flat.get_layers().back()->optimizer->set_learning_rate(0.05f);
+  bool threw = false;
+  try {
+    flat.update();
+  } catch (lbann_exception&) {
+    threw = true;
+  }
+  ASSERT_TRUE(threw);
+  for (auto layers : {&ref_layers, &flat_layers}) {
+    for (Layer* layer : *layers) {
+      delete layer->optimizer;
+      delete layer;
+    }
+  }
+  delete comm;
+}
+
+int main(int argc, char** argv) {
+  El::Initialize(argc, argv);
+  test_block_quantize();
+  test_apply_blockwise();
+  test_state_checkpoint();
+  test_lars_step();
+  test_lamb_step();
+  test_flat_params();
+  El::Finalize();
+  return 0;
+}
@@ -397,6 +397,13 @@ void init_model(bool master, const lbann_data::LbannPB &p, sequential_model *&mo
     } else if (train_params.LearnRateMethod == 2) { // RMSprop
         optimizer = new RMSprop_factory(comm/*, train_params.LearnRate*/);
         if (master) cout << "optimizer is: RMSprop\n";
+    } else if (train_params.LearnRateMethod == 5) { // LARS
+        optimizer = new LARS_factory(comm, train_params.LearnRate, train_params.LrMomentum);
+        if (master) cout << "optimizer is: LARS; learnRate: " << train_params.LearnRate
+                         << " momentum: " << train_params.LrMomentum << endl;
+    } else if (train_params.LearnRateMethod == 6) { // LAMB
+        optimizer = new LAMB_factory(comm, train_params.LearnRate);
+        if (master) cout << "optimizer is: LAMB; learnRate: " << train_params.LearnRate << endl;
     } else {
         optimizer = new SGD_factory(comm, train_params.LearnRate, train_params.LrMomentum, train_params.LrDecayRate, true); 
         if (master) cout << "optimizer is: SGD; learnRate: " << train_params.LearnRate
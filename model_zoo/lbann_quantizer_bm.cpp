@@ -28,6 +28,7 @@
 
 #include "lbann/lbann.hpp"
 #include "lbann/utils/lbann_quantizer.hpp"
+#include "lbann/utils/lbann_quantizer_kernels.hpp"
 #include "lbann/utils/lbann_timer.hpp"
 #ifdef LBANN_VTUNE
 #include <ittnotify.h>
@@ -35,6 +36,8 @@
 
 /** Number of times to run the quantization. */
 const int num_trials = 20;
+/** Segment size for the pipelined quantized reduce-scatter. */
+const size_t pipeline_segment_bytes = 256 * 1024;
 
 using namespace lbann;
 
@@ -110,9 +113,11 @@ void quantize_summary(lbann_summary* summarizer, lbann_quantizer& quantizer,
   quantizer.reset_time_counters();
 }
 
-std::vector<double> test_onebit(lbann_comm* comm, DistMat& mat) {
+std::vector<double> test_onebit(lbann_comm* comm, DistMat& mat,
+                                size_t segment_bytes = 0) {
   std::vector<double> times;
   lbann_quantizer quantizer;
+  quantizer.set_ring_segment_size(segment_bytes);
   Mat qerror;
   Mat im_qerror;
   // Allocate here, prevents messing with timing.
@@ -173,9 +178,10 @@ std::vector<double> test_comp_thresh(lbann_comm* comm, DistMat& mat,
 }
 
 std::vector<double> test_adaptive(lbann_comm* comm, DistMat& mat,
-                                  int proportion) {
+                                  int proportion, size_t segment_bytes = 0) {
   std::vector<double> times;
   lbann_quantizer quantizer;
+  quantizer.set_ring_segment_size(segment_bytes);
   Mat qerror;
   Mat im_qerror;
   // Allocate here, prevents messing with timing.
@@ -234,6 +240,14 @@ void print_stats(const std::vector<double>& times) {
   std::cout << std::endl;
 }
 
+/** Print the mean speedup of times over base_times. */
+void print_speedup(const std::vector<double>& base_times,
+                   const std::vector<double>& times) {
+  double base = std::accumulate(base_times.begin(), base_times.end(), 0.0);
+  double t = std::accumulate(times.begin(), times.end(), 0.0);
+  std::cout << "\tSpeedup: " << base / t << std::endl;
+}
+
 void test_mat(lbann_comm* comm, DistMat& mat) {
   DistMat normal_copy(mat);
   auto normal_times = test_normal(comm, normal_copy);
@@ -251,6 +265,16 @@ void test_mat(lbann_comm* comm, DistMat& mat) {
     print_stats(onebit_times);
   }
   onebit_copy.Empty();
+  DistMat onebit_pipe_copy(mat);
+  auto onebit_pipe_times = test_onebit(comm, onebit_pipe_copy,
+                                       pipeline_segment_bytes);
+  if (comm->am_world_master()) {
+    std::cout << "Onebit pipelined " << pipeline_segment_bytes << "B (" <<
+      mat.Height() << "x" << mat.Width() << "):" << std::endl;
+    print_stats(onebit_pipe_times);
+    print_speedup(onebit_times, onebit_pipe_times);
+  }
+  onebit_pipe_copy.Empty();
   DistMat thresh_copy(mat);
   auto thresh_times = test_thresh(comm, thresh_copy, 3.875f);
   if (comm->am_world_master()) {
@@ -275,6 +299,16 @@ void test_mat(lbann_comm* comm, DistMat& mat) {
     print_stats(adaptive_times);
   }
   adaptive_copy.Empty();
+  DistMat adaptive_pipe_copy(mat);
+  auto adaptive_pipe_times = test_adaptive(comm, adaptive_pipe_copy, 64,
+                                           pipeline_segment_bytes);
+  if (comm->am_world_master()) {
+    std::cout << "Adaptive 64 pipelined " << pipeline_segment_bytes << "B (" <<
+      mat.Height() << "x" << mat.Width() << "):" << std::endl;
+    print_stats(adaptive_pipe_times);
+    print_speedup(adaptive_times, adaptive_pipe_times);
+  }
+  adaptive_pipe_copy.Empty();
   /*DistMat comp_adaptive_copy(mat);
   auto comp_adaptive_times = test_comp_adaptive(comm, comp_adaptive_copy, 64);
   if (comm->am_world_master()) {
@@ -298,6 +332,9 @@ int main(int argc, char** argv) {
   if (comm->am_world_master()) {
     std::cout << "Models: " << comm->get_num_models() << std::endl;
     std::cout << "Procs per model: " << comm->get_procs_per_model() << std::endl;
+    std::cout << "Quantizer SIMD: " <<
+      quantizer_kernels::simd_level_name(quantizer_kernels::get_simd_level()) <<
+      " (set LBANN_QUANTIZER_SIMD to override)" << std::endl;
   }
   for (int mat_size = 64; mat_size <= 16384; mat_size *= 2) {
     DistMat mat(comm->get_model_grid());
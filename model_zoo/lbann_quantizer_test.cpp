@@ -27,8 +27,12 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include "lbann/lbann_comm.hpp"
 #include "lbann/utils/lbann_quantizer.hpp"
+#include "lbann/utils/lbann_quantizer_kernels.hpp"
 #include "lbann_test_utils.hpp"
 
 using namespace lbann;
@@ -99,6 +103,150 @@ void test_threshold_quantize() {
   ASSERT_MAT_EQ(mat, with_qerror);
 }
 
+/**
+ * Test that every SIMD level supported here gives the same results as the
+ * scalar kernels. Heights are chosen to exercise the partial-word tails.
+ */
+void test_simd_kernels() {
+  namespace qk = quantizer_kernels;
+  const qk::simd_level best = qk::detect_simd_level();
+  const qk::simd_level prev = qk::get_simd_level();
+  for (Int height : {7, 32, 45, 1000, 2100}) {
+    Mat mat;
+    El::Gaussian(mat, height, 5, 0.0f, 1.0f);
+    lbann_quantizer quantizer;
+    // Scalar reference results.
+    qk::set_simd_level(qk::simd_level::SCALAR);
+    lbann_quantizer::QuantizedMatrix ref_qmat;
+    Mat ref_qerror;
+    El::Zeros(ref_qerror, mat.Height(), mat.Width());
+    quantizer.quantize(mat, ref_qmat, ref_qerror);
+    Mat ref_uqmat(mat);
+    quantizer.unquantize_add(ref_qmat, ref_uqmat);
+    lbann_quantizer::ThreshQuantized ref_tq, ref_tq_delta;
+    Mat ref_terror, ref_terror_delta;
+    El::Zeros(ref_terror, mat.Height(), mat.Width());
+    El::Zeros(ref_terror_delta, mat.Height(), mat.Width());
+    quantizer.threshold_quantize(mat, ref_tq, ref_terror, 0.5f, -0.5f);
+    quantizer.threshold_quantize(mat, ref_tq_delta, ref_terror_delta, 0.5f,
+                                 -0.5f, true);
+    for (int level = 1; level <= (int) best; ++level) {
+      qk::set_simd_level((qk::simd_level) level);
+      lbann_quantizer::QuantizedMatrix qmat;
+      Mat qerror;
+      El::Zeros(qerror, mat.Height(), mat.Width());
+      quantizer.quantize(mat, qmat, qerror);
+      // The column averages are summed in a different order, so only compare
+      // the results approximately.
+      ASSERT_MAT_EQ(qerror, ref_qerror);
+      Mat uqmat(mat);
+      quantizer.unquantize_add(qmat, uqmat);
+      ASSERT_MAT_EQ(uqmat, ref_uqmat);
+      lbann_quantizer::ThreshQuantized tq, tq_delta;
+      Mat terror, terror_delta;
+      El::Zeros(terror, mat.Height(), mat.Width());
+      El::Zeros(terror_delta, mat.Height(), mat.Width());
+      quantizer.threshold_quantize(mat, tq, terror, 0.5f, -0.5f);
+      quantizer.threshold_quantize(mat, tq_delta, terror_delta, 0.5f, -0.5f,
+                                   true);
+      ASSERT_VECTOR_EQ(tq, ref_tq);
+      ASSERT_VECTOR_EQ(tq_delta, ref_tq_delta);
+      ASSERT_MAT_EQ(terror, ref_terror);
+      ASSERT_MAT_EQ(terror_delta, ref_terror_delta);
+    }
+  }
+  qk::set_simd_level(prev);
+}
+
+/**
+ * Test top-k sparsification: exactly k entries, the largest in magnitude, and
+ * the rest left in the error feedback.
+ */
+void test_topk_quantize() {
+  Mat mat;
+  El::Gaussian(mat, 50, 10, 0.0f, 1.0f);
+  Mat qerror;
+  El::Zeros(qerror, mat.Height(), mat.Width());
+  lbann_quantizer::TopKQuantized q;
+  lbann_quantizer quantizer;
+  const Int k = 37;
+  quantizer.topk_quantize(mat, q, qerror, k);
+  ASSERT_EQ((Int) q.size(), k);
+  // Compare against sorting the magnitudes.
+  std::vector<DataType> mags;
+  for (Int col = 0; col < mat.Width(); ++col) {
+    for (Int row = 0; row < mat.Height(); ++row) {
+      mags.push_back(std::fabs(mat.Get(row, col)));
+    }
+  }
+  std::sort(mags.begin(), mags.end(), std::greater<DataType>());
+  for (size_t i = 0; i < q.size(); ++i) {
+    ASSERT_TRUE(std::fabs(q[i].value) >= mags[k - 1]);
+    if (i > 0) {
+      ASSERT_TRUE(q[i - 1].pos < q[i].pos);
+    }
+  }
+  Mat uqmat;
+  El::Zeros(uqmat, mat.Height(), mat.Width());
+  quantizer.topk_unquantize(q, uqmat);
+  Mat with_qerror(uqmat);
+  with_qerror += qerror;
+  ASSERT_MAT_EQ(mat, with_qerror);
+}
+
+/** Test top-k sparsification with a constant matrix (all ties). */
+void test_topk_quantize_ties() {
+  Mat mat;
+  El::Ones(mat, 20, 5);
+  Mat qerror;
+  El::Zeros(qerror, mat.Height(), mat.Width());
+  lbann_quantizer::TopKQuantized q;
+  lbann_quantizer quantizer;
+  quantizer.topk_quantize(mat, q, qerror, 13);
+  ASSERT_EQ((int) q.size(), 13);
+  // Ties go to the lowest positions.
+  ASSERT_EQ((int) q.back().pos, 12);
+}
+
+/**
+ * Test QSGD quantization: reproducible for a key, bounded error per entry,
+ * and unbiased on average.
+ */
+void test_qsgd_quantize() {
+  Mat mat;
+  El::Gaussian(mat, 1100, 3, 0.0f, 1.0f);
+  lbann_quantizer quantizer;
+  for (int bits : {2, 4, 8}) {
+    lbann_quantizer::QuantizedMatrix qmat, qmat2;
+    quantizer.qsgd_quantize(mat, qmat, bits, 42);
+    quantizer.qsgd_quantize(mat, qmat2, bits, 42);
+    ASSERT_EQ(qmat.Height(), qmat2.Height());
+    for (Int col = 0; col < qmat.Width(); ++col) {
+      for (Int row = 0; row < qmat.Height(); ++row) {
+        ASSERT_EQ(qmat.Get(row, col), qmat2.Get(row, col));
+      }
+    }
+    Mat uqmat(mat.Height(), mat.Width());
+    quantizer.qsgd_unquantize(qmat, uqmat, bits);
+    // Each entry is off by at most one level of its bucket.
+    const DataType levels = (1 << (bits - 1)) - 1;
+    const DataType max_norm = El::MaxAbs(mat);
+    Mat diff(uqmat);
+    diff -= mat;
+    ASSERT_TRUE(El::MaxAbs(diff) <= max_norm / levels + 1e-5f);
+    // Averaging many independent quantizations converges to mat.
+    Mat avg;
+    El::Zeros(avg, mat.Height(), mat.Width());
+    const int trials = 200;
+    for (int t = 0; t < trials; ++t) {
+      quantizer.qsgd_quantize(mat, qmat, bits, 1000 + t);
+      quantizer.qsgd_unquantize_add(qmat, avg, bits);
+    }
+    El::Scale(1.0f / trials, avg);
+    ASSERT_MAT_EQ_TOL(avg, mat, 0.5f * max_norm / levels);
+  }
+}
+
 /** Test compression with manual inputs. */
 void test_compression() {
   lbann_quantizer::ThreshQuantized in = {1000, 0, 1, 2, 1000, 137};
@@ -161,6 +309,66 @@ void test_adaptive_threshold_quantize() {
   ASSERT_MAT_EQ(mat, with_qerror);
 }
 
+/** Test that coded positions unquantize the same as raw ones. */
+template <typename T>
+void test_adaptive_position_codecs() {
+  typedef lbann_quantizer::position_codec position_codec;
+  Mat mat;
+  El::Uniform(mat, 1000, 20, 0.0f, 10.0f);
+  for (position_codec codec : {position_codec::GOLOMB_RICE,
+                               position_codec::VARINT,
+                               position_codec::AUTO}) {
+    std::vector<T> qmat;
+    Mat qerror;
+    El::Zeros(qerror, mat.Height(), mat.Width());
+    lbann_quantizer quantizer;
+    quantizer.set_position_codec(codec);
+    quantizer.adaptive_threshold_quantize(mat, qmat, qerror, 16);
+    std::vector<T> raw(qmat);
+    aligned_vector<T> scratch;
+    quantizer.encode_adaptive_positions(qmat, mat.Width(), mat.LDim(),
+                                        scratch);
+    const position_codec used = lbann_quantizer::adaptive_position_codec(qmat);
+    ASSERT_TRUE(used != position_codec::RAW);
+    if (codec != position_codec::AUTO) {
+      ASSERT_TRUE(used == codec);
+    }
+    ASSERT_TRUE(qmat.size() < raw.size());
+    Mat uqmat, raw_uqmat;
+    El::Zeros(uqmat, mat.Height(), mat.Width());
+    El::Zeros(raw_uqmat, mat.Height(), mat.Width());
+    quantizer.adaptive_threshold_unquantize(qmat, uqmat);
+    quantizer.adaptive_threshold_unquantize(raw, raw_uqmat);
+    ASSERT_MAT_EQ(uqmat, raw_uqmat);
+  }
+  // Golomb-Rice quotients of 64 and more, which span a whole 64-bit read of
+  // ones, starting at every bit offset within a byte.
+  for (int k : {0, 3, 7}) {
+    std::vector<uint64_t> values;
+    for (int offset = 0; offset < 8; ++offset) {
+      values.push_back(offset);  // Shifts the next value's starting bit.
+      for (uint64_t q : {56, 57, 63, 64, 65, 120, 200, 1000}) {
+        values.push_back((q << k) | (k > 0 ? 1 : 0));
+      }
+    }
+    uint64_t bits = 0;
+    for (uint64_t v : values) {
+      bits += quantizer_kernels::rice_writer::cost(v, k);
+    }
+    std::vector<unsigned char> buf(bits / 8 + 16, 0);
+    quantizer_kernels::rice_writer writer = {buf.data(), 0};
+    for (uint64_t v : values) {
+      writer.write(v, k);
+    }
+    ASSERT_EQ(writer.bit, bits);
+    quantizer_kernels::rice_reader reader = {buf.data(), 0};
+    for (uint64_t v : values) {
+      ASSERT_EQ(reader.read(k), v);
+    }
+    ASSERT_EQ(reader.bit, bits);
+  }
+}
+
 /** Test adaptive threshold compression/uncompression. */
 /*void test_adaptive_threshold_compression() {
   Mat mat;
@@ -198,6 +406,115 @@ void test_allreduce() {
   delete comm;
 }
 
+/**
+ * Test every custom allreduce algorithm against intermodel_sum_matrix, on
+ * contiguous and non-contiguous (LDim > Height) matrices. Every process is
+ * its own model, so running with a non-power-of-two number of processes
+ * exercises the folding in recursive doubling and Rabenseifner.
+ */
+void test_allreduce_algorithms() {
+  typedef lbann_quantizer::allreduce_algorithm allreduce_algorithm;
+  lbann_comm* comm = new lbann_comm(1);
+  const Int ldim = 600;
+  for (allreduce_algorithm alg : {allreduce_algorithm::RING,
+                                  allreduce_algorithm::RECURSIVE_DOUBLING,
+                                  allreduce_algorithm::RABENSEIFNER,
+                                  allreduce_algorithm::AUTO}) {
+    for (Int width : {1, 37}) {
+      // The ring splits by columns, so it needs one per model.
+      if (alg == allreduce_algorithm::RING && width < comm->get_num_models()) {
+        continue;
+      }
+      Mat mat;
+      El::Uniform(mat, 513, width, 0.0f, 10.0f);
+      Mat exact_sum(mat);
+      comm->intermodel_sum_matrix(exact_sum);
+      lbann_quantizer quantizer;
+      Mat contig(mat);
+      quantizer.intermodel_sum(comm, contig, alg);
+      ASSERT_MAT_EQ(contig, exact_sum);
+      // A view into a taller matrix, whose other rows must be left alone.
+      Mat big;
+      El::Ones(big, ldim, width);
+      Mat noncontig;
+      El::View(noncontig, big, El::IR(0, mat.Height()), El::IR(0, width));
+      ASSERT_TRUE(noncontig.LDim() > noncontig.Height());
+      El::Copy(mat, noncontig);
+      quantizer.intermodel_sum(comm, noncontig, alg);
+      ASSERT_MAT_EQ(noncontig, exact_sum);
+      for (Int j = 0; j < width; ++j) {
+        for (Int i = mat.Height(); i < ldim; ++i) {
+          ASSERT_EQ(big.Get(i, j), 1.0f);
+        }
+      }
+    }
+  }
+  delete comm;
+}
+
+/**
+ * Test the ring keeps persistent requests for at most MAX_RING_REQUEST_MATS
+ * matrices, still sums correctly after a matrix's requests were freed, and
+ * frees them all on request and after autotuning.
+ */
+void test_ring_request_bound() {
+  typedef lbann_quantizer::allreduce_algorithm allreduce_algorithm;
+  lbann_comm* comm = new lbann_comm(1);
+  const int num_models = comm->get_num_models();
+  if (num_models > 1) {
+    lbann_quantizer quantizer;
+    // All alive at once, so every matrix has its own buffer.
+    std::vector<Mat> mats(lbann_quantizer::MAX_RING_REQUEST_MATS + 10);
+    for (Mat& mat : mats) {
+      El::Ones(mat, 4, num_models);
+      quantizer.intermodel_sum(comm, mat, allreduce_algorithm::RING);
+      ASSERT_EQ(mat.Get(3, 0), (DataType) num_models);
+      ASSERT_TRUE(quantizer.get_num_ring_request_sets() <=
+                  lbann_quantizer::MAX_RING_REQUEST_MATS);
+    }
+    ASSERT_EQ(quantizer.get_num_ring_request_sets(),
+              lbann_quantizer::MAX_RING_REQUEST_MATS);
+    // The first matrix's requests were freed, the last one's were not.
+    for (Mat* mat : {&mats.front(), &mats.back()}) {
+      El::Ones(*mat, 4, num_models);
+      quantizer.intermodel_sum(comm, *mat, allreduce_algorithm::RING);
+      ASSERT_EQ(mat->Get(3, 0), (DataType) num_models);
+    }
+    quantizer.free_ring_requests();
+    ASSERT_EQ(quantizer.get_num_ring_request_sets(), (size_t) 0);
+    quantizer.autotune_allreduce(comm, 64, 4096, 1);
+    ASSERT_EQ(quantizer.get_num_ring_request_sets(), (size_t) 0);
+  }
+  delete comm;
+}
+
+/** Test the ring allreduce with fp16 and bf16 payloads. */
+void test_reduced_precision_allreduce() {
+  lbann_comm* comm = new lbann_comm(2);
+  const float num_models = comm->get_num_models();
+  for (payload_precision p : {payload_precision::FP16,
+                              payload_precision::BF16}) {
+    DistMat mat(comm->get_model_grid());
+    El::Uniform(mat, 512, 512, 0.0f, 10.0f);
+    DistMat exact_sum(mat);
+    lbann_quantizer quantizer;
+    quantizer.set_ring_precision(p);
+    quantizer.intermodel_sum(comm, mat,
+                             lbann_quantizer::allreduce_algorithm::RING);
+    comm->intermodel_sum_matrix(exact_sum);
+    comm->global_barrier();
+    // Each contribution and the final sum are rounded once (relative
+    // errors of 2^-11 for fp16 and 2^-8 for bf16, on sums up to 20 per model).
+    ASSERT_MAT_EQ_TOL(mat, exact_sum, (p == payload_precision::FP16 ?
+                                       0.05f : 0.4f) * num_models);
+    // Every model must hold the same rounded result.
+    DistMat model0_sum(mat);
+    comm->intermodel_broadcast_matrix(model0_sum, 0);
+    ASSERT_MAT_EQ_TOL(mat, model0_sum, 0.0f);
+  }
+  delete comm;
+}
+
 /** Test the inter-model quantize-and-allreduce. */
 void test_quantize_allreduce() {
   lbann_comm* comm = new lbann_comm(2);
@@ -376,21 +693,136 @@ void test_adaptive_threshold_quantize_allreduce() {
   delete comm;
   }*/
 
+/**
+ * Test that pipelining the one-bit and adaptive reduce-scatters in segments
+ * gives the same result as sending each ring step whole. Each model's columns
+ * split into at least three segments, the last one shorter.
+ */
+void test_segmented_quantize_allreduce() {
+  lbann_comm* comm = new lbann_comm(1);
+  const Int height = 16;
+  const Int width = 7 * comm->get_num_models() + 1;
+  const size_t segment_bytes = 3 * height * sizeof(DataType);
+  // One-bit quantization is per column, so any input works.
+  Mat onebit_input;
+  El::Gaussian(onebit_input, height, width, 0.0f, 1.0f);
+  // The adaptive thresholds depend on every entry quantized together, so use
+  // entries of one magnitude per model, which are all sent either way.
+  Mat adaptive_input;
+  if (comm->get_model_rank() == 0) {
+    El::Rademacher(adaptive_input, height, width);
+  } else {
+    El::Zeros(adaptive_input, height, width);
+  }
+  comm->intermodel_broadcast_matrix(adaptive_input, 0);
+  El::Scale(comm->get_model_rank() + 1, adaptive_input);
+  Mat onebit_sum[2], onebit_qerror[2], onebit_im_qerror[2];
+  Mat adaptive_sum[2], adaptive_qerror[2], adaptive_im_qerror[2];
+  for (int segmented = 0; segmented < 2; ++segmented) {
+    lbann_quantizer quantizer;
+    quantizer.set_ring_segment_size(segmented ? segment_bytes : 0);
+    El::Copy(onebit_input, onebit_sum[segmented]);
+    quantizer.intermodel_sum_quantized(comm, onebit_sum[segmented],
+                                       onebit_qerror[segmented],
+                                       onebit_im_qerror[segmented]);
+    El::Copy(adaptive_input, adaptive_sum[segmented]);
+    quantizer.intermodel_sum_adaptive_threshold_quantized(
+      comm, adaptive_sum[segmented], adaptive_qerror[segmented], 1,
+      adaptive_im_qerror[segmented]);
+  }
+  ASSERT_MAT_EQ_TOL(onebit_sum[1], onebit_sum[0], 0.0f);
+  ASSERT_MAT_EQ_TOL(onebit_qerror[1], onebit_qerror[0], 0.0f);
+  ASSERT_MAT_EQ_TOL(onebit_im_qerror[1], onebit_im_qerror[0], 0.0f);
+  ASSERT_MAT_EQ_TOL(adaptive_sum[1], adaptive_sum[0], 0.0f);
+  ASSERT_MAT_EQ_TOL(adaptive_qerror[1], adaptive_qerror[0], 0.0f);
+  ASSERT_MAT_EQ_TOL(adaptive_im_qerror[1], adaptive_im_qerror[0], 0.0f);
+  Mat exact_sum(adaptive_input);
+  comm->intermodel_sum_matrix(exact_sum);
+  ASSERT_MAT_EQ(adaptive_sum[1], exact_sum);
+  delete comm;
+}
+
+/** Test the top-k sparsified allreduce with everything sent. */
+void test_topk_allreduce() {
+  lbann_comm* comm = new lbann_comm(2);
+  DistMat mat(comm->get_model_grid());
+  if (comm->get_model_rank() == 0) {
+    El::Gaussian(mat, 10, 10, 0.0f, 1.0f);
+    comm->intermodel_broadcast_matrix(mat, 0);
+  } else {
+    El::Zeros(mat, 10, 10);
+    comm->intermodel_broadcast_matrix(mat, 0);
+  }
+  El::Scale(comm->get_model_rank() + 1, mat);
+  DistMat exact_sum(mat);
+  Mat qerror;
+  El::Zeros(qerror, mat.LocalHeight(), mat.LocalWidth());
+  lbann_quantizer quantizer;
+  // Proportion such that everything is sent.
+  quantizer.intermodel_sum_topk(comm, mat, qerror, 1);
+  comm->intermodel_sum_matrix(exact_sum);
+  Mat z;
+  El::Zeros(z, mat.LocalHeight(), mat.LocalWidth());
+  ASSERT_MAT_EQ(qerror, z);
+  ASSERT_MAT_EQ(mat, exact_sum);
+  delete comm;
+}
+
+/**
+ * Test the QSGD allreduce. Entries of +-1 scaled per model quantize exactly,
+ * so the sum should have no error.
+ */
+void test_qsgd_allreduce() {
+  lbann_comm* comm = new lbann_comm(2);
+  for (int bits : {2, 4, 8}) {
+    DistMat mat(comm->get_model_grid());
+    if (comm->get_model_rank() == 0) {
+      El::Rademacher(mat, 10, 10);
+      comm->intermodel_broadcast_matrix(mat, 0);
+    } else {
+      El::Zeros(mat, 10, 10);
+      comm->intermodel_broadcast_matrix(mat, 0);
+    }
+    El::Scale(comm->get_model_rank() + 1, mat);
+    DistMat exact_sum(mat);
+    lbann_quantizer quantizer;
+    quantizer.intermodel_sum_qsgd(comm, mat, bits);
+    comm->intermodel_sum_matrix(exact_sum);
+    ASSERT_MAT_EQ(mat, exact_sum);
+  }
+  delete comm;
+}
+
 int main(int argc, char** argv) {
   El::Initialize(argc, argv);
   test_quantize();
   test_2value_quantize();
   test_threshold_quantize();
+  test_simd_kernels();
+  test_topk_quantize();
+  test_topk_quantize_ties();
+  test_qsgd_quantize();
   //test_compression();
   //test_threshold_compression();
   test_adaptive_threshold_quantize();
+  test_adaptive_position_codecs<uint32_t>();
+  test_adaptive_position_codecs<uint64_t>();
   //test_adaptive_threshold_compression();
-  test_allreduce();
-  test_quantize_allreduce();
-  test_threshold_quantize_allreduce();
-  //test_compressed_threshold_quantize_allreduce();
-  test_adaptive_threshold_quantize_allreduce();
-  //test_compressed_adaptive_threshold_quantize_allreduce();
+  test_allreduce_algorithms();
+  test_ring_request_bound();
+  test_segmented_quantize_allreduce();
+  // The remaining tests use two processes per model.
+  if (El::mpi::Size(El::mpi::COMM_WORLD) % 2 == 0) {
+    test_allreduce();
+    test_reduced_precision_allreduce();
+    test_quantize_allreduce();
+    test_threshold_quantize_allreduce();
+    //test_compressed_threshold_quantize_allreduce();
+    test_adaptive_threshold_quantize_allreduce();
+    test_topk_allreduce();
+    test_qsgd_allreduce();
+    //test_compressed_adaptive_threshold_quantize_allreduce();
+  }
   El::Finalize();
   return 0;
 }
@@ -0,0 +1,162 @@
+#include "lbann/lbann.hpp"
+#include "lbann/utils/lbann_quantizer.hpp"
+#include "lbann/utils/lbann_timer.hpp"
+
+using namespace lbann;
+
+const int num_trials = 20;
+
+#if LBANN_HAS_RMA_WINDOWS
+
+std::vector<double> test_mpi_allreduce(lbann_comm* comm, DistMat& mat) {
+  std::vector<double> times;
+  for (int trial = 0; trial < num_trials; ++trial) {
+    double start = get_time();
+    comm->intermodel_sum_matrix(mat);
+    double tot = get_time() - start;
+    times.push_back(tot);
+    comm->global_barrier();
+  }
+  return times;
+}
+
+std::vector<double> test_ring_allreduce(lbann_comm* comm, DistMat& mat,
+                                        lbann_quantizer& quantizer) {
+  std::vector<double> times;
+  for (int trial = 0; trial < num_trials; ++trial) {
+    double start = get_time();
+    quantizer.intermodel_sum(comm, mat.Matrix(),
+                             lbann_quantizer::allreduce_algorithm::RING);
+    double tot = get_time() - start;
+    times.push_back(tot);
+    comm->global_barrier();
+  }
+  return times;
+}
+
+std::vector<double> test_rma_allreduce(lbann_comm* comm, DistMat& mat) {
+  std::vector<double> times;
+  for (int trial = 0; trial < num_trials; ++trial) {
+    double start = get_time();
+    comm->rma_intermodel_sum_matrix(mat);
+    double tot = get_time() - start;
+    times.push_back(tot);
+    comm->global_barrier();
+  }
+  return times;
+}
+
+std::vector<double> test_mpi_broadcast(lbann_comm* comm, DistMat& mat) {
+  std::vector<double> times;
+  for (int trial = 0; trial < num_trials; ++trial) {
+    double start = get_time();
+    comm->intermodel_broadcast_matrix(mat, 0);
+    double tot = get_time() - start;
+    times.push_back(tot);
+    comm->global_barrier();
+  }
+  return times;
+}
+
+std::vector<double> test_rma_broadcast(lbann_comm* comm, DistMat& mat) {
+  std::vector<double> times;
+  for (int trial = 0; trial < num_trials; ++trial) {
+    double start = get_time();
+    comm->rma_intermodel_broadcast_matrix(mat, 0);
+    double tot = get_time() - start;
+    times.push_back(tot);
+    comm->global_barrier();
+  }
+  return times;
+}
+
+/**
+ * Time asynchronous accumulation into model 0: every other model pushes its
+ * matrix and flushes, without model 0 taking part until it drains.
+ */
+std::vector<double> test_rma_accumulate(lbann_comm* comm, DistMat& mat) {
+  std::vector<double> times;
+  const int count = mat.LocalHeight() * mat.LocalWidth();
+  comm->rma_setup(count);
+  for (int trial = 0; trial < num_trials; ++trial) {
+    double start = get_time();
+    if (comm->get_model_rank() != 0) {
+      comm->rma_accumulate(mat.LockedBuffer(), count, 0);
+      comm->rma_flush();
+    }
+    double tot = get_time() - start;
+    times.push_back(tot);
+    comm->global_barrier();
+  }
+  comm->rma_fence();
+  if (comm->get_model_rank() == 0) {
+    comm->rma_drain(mat.Buffer(), count);
+  }
+  return times;
+}
+
+void print_stats(const std::vector<double>& times) {
+  double sum = std::accumulate(times.begin(), times.end(), 0.0);
+  double mean = sum / times.size();
+  auto minmax = std::minmax_element(times.begin(), times.end());
+  double sqsum = 0.0;
+  for (const auto& t : times) {
+    sqsum += (t - mean) * (t - mean);
+  }
+  double stdev = std::sqrt(sqsum / (times.size() - 1));
+  std::cout << "\tMean: " << mean << std::endl;
+  std::cout << "\tMin: " << *(minmax.first) << std::endl;
+  std::cout << "\tMax: " << *(minmax.second) << std::endl;
+  std::cout << "\tStdev: " << stdev << std::endl;
+  std::cout << "\tRaw: ";
+  for (const auto& t : times) {
+    std::cout << t << ", ";
+  }
+  std::cout << std::endl;
+}
+
+void report(lbann_comm* comm, const char* name, DistMat& mat,
+            const std::vector<double>& times) {
+  if (comm->am_world_master()) {
+    std::cout << name << " (" << mat.Height() << "x" << mat.Width() << "):" <<
+      std::endl;
+    print_stats(times);
+  }
+}
+
+void test_mat(lbann_comm* comm, DistMat& mat, lbann_quantizer& quantizer) {
+  report(comm, "MPI allreduce", mat, test_mpi_allreduce(comm, mat));
+  report(comm, "Ring allreduce", mat,
+         test_ring_allreduce(comm, mat, quantizer));
+  report(comm, "RMA allreduce", mat, test_rma_allreduce(comm, mat));
+  report(comm, "MPI broadcast", mat, test_mpi_broadcast(comm, mat));
+  report(comm, "RMA broadcast", mat, test_rma_broadcast(comm, mat));
+  report(comm, "RMA accumulate to model 0", mat,
+         test_rma_accumulate(comm, mat));
+}
+
+int main(int argc, char** argv) {
+  El::Initialize(argc, argv);
+  // 1 so that the inter-model communicator spans every process.
+  lbann_comm* comm = new lbann_comm(1);
+  lbann_quantizer quantizer;
+  for (int mat_size = 64; mat_size <= 16384; mat_size *= 2) {
+    DistMat mat(comm->get_model_grid());
+    El::Uniform(mat, mat_size, mat_size, 0.0f, 4.0f);
+    test_mat(comm, mat, quantizer);
+  }
+  delete comm;
+  El::Finalize();
+}
+
+#else
+
+int main(int argc, char** argv) {
+  El::Initialize(argc, argv);
+  if (El::mpi::Rank() == 0) {
+    std::cout << "RMA windows need MPI-3, skipping" << std::endl;
+  }
+  El::Finalize();
+}
+
+#endif  // LBANN_HAS_RMA_WINDOWS
@@ -0,0 +1,319 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_callback_async_sgd .hpp .cpp - Asynchronous parameter-server SGD
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/callbacks/lbann_callback_async_sgd.hpp"
+#include "lbann/utils/lbann_timer.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+#include "lbann/models/lbann_flat_params.hpp"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace lbann {
+
+parameter_server::parameter_server(lbann_comm* comm,
+                                   const std::vector<DataType>& weights) :
+  m_comm(comm), m_weights(weights),
+  m_clocks(comm->get_num_models(), 0),
+  m_done(comm->get_num_models(), false) {
+  m_thread = std::thread(&parameter_server::serve, this);
+}
+
+parameter_server::~parameter_server() {
+  finish_local();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void parameter_server::push(const std::vector<DataType>& delta) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_local_pushes.push_back(delta);
+  }
+  m_cv.notify_all();
+}
+
+int64_t parameter_server::pull(std::vector<DataType>& weights) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  weights = m_weights;
+  return min_clock();
+}
+
+void parameter_server::wait_for_clock(int64_t clock) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cv.wait(lock, [this, clock] { return min_clock() >= clock; });
+}
+
+void parameter_server::finish_local() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_done[m_comm->get_model_rank()] = true;
+  }
+  m_cv.notify_all();
+}
+
+void parameter_server::apply(int worker, const DataType* delta) {
+  const El::Int count = m_weights.size();
+  #pragma omp parallel for
+  for (El::Int i = 0; i < count; ++i) {
+    m_weights[i] += delta[i];
+  }
+  ++m_clocks[worker];
+}
+
+int64_t parameter_server::min_clock() const {
+  int64_t clock = std::numeric_limits<int64_t>::max();
+  for (size_t worker = 0; worker < m_clocks.size(); ++worker) {
+    if (!m_done[worker]) {
+      clock = std::min(clock, m_clocks[worker]);
+    }
+  }
+  return clock;
+}
+
+void parameter_server::serve() {
+  const int local = m_comm->get_model_rank();
+  const El::Int count = m_weights.size();
+  while (true) {
+    bool idle = true;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (!m_local_pushes.empty()) {
+        apply(local, m_local_pushes.front().data());
+        m_local_pushes.pop_front();
+        idle = false;
+      }
+      if (std::all_of(m_done.begin(), m_done.end(), [] (bool d) { return d; })) {
+        break;
+      }
+    }
+    if (!idle) {
+      m_cv.notify_all();
+    }
+    int model, rank;
+    if (m_comm->get_num_models() > 1 && m_comm->ps_probe_any(model, rank)) {
+      idle = false;
+      int64_t header[2];
+      m_comm->ps_recv(header, 2, model, rank);
+      if (header[0] == DONE) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done[model] = true;
+      } else {
+        if (header[0] == PUSH_PULL) {
+          m_recv_buf.resize(count);
+          m_comm->ps_recv(m_recv_buf.data(), count, model, rank);
+        }
+        int64_t reply;
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          if (header[0] == PUSH_PULL) {
+            apply(model, m_recv_buf.data());
+          }
+          reply = min_clock();
+          m_send_buf = m_weights;
+        }
+        m_comm->ps_send(&reply, 1, model, rank);
+        m_comm->ps_send(m_send_buf.data(), count, model, rank);
+      }
+      m_cv.notify_all();
+    }
+    if (idle) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait_for(lock, std::chrono::microseconds(100),
+                    [this] { return !m_local_pushes.empty(); });
+    }
+  }
+  m_cv.notify_all();
+}
+
+lbann_callback_async_sgd::lbann_callback_async_sgd(int staleness,
+                                                   lbann_summary* _summarizer) :
+  lbann_callback(1, _summarizer), m_staleness(std::max(staleness, 0)) {
+  set_name("async_sgd");
+}
+
+lbann_callback_async_sgd::~lbann_callback_async_sgd() {
+  delete m_server;
+}
+
+void lbann_callback_async_sgd::setup(model* m) {
+  lbann_comm* comm = m->get_comm();
+  flat_params* flat = m->get_flat_params();
+  if (flat != nullptr && flat->is_sharded()) {
+    throw lbann_exception(
+      "lbann_callback_async_sgd: sharded optimizer state requires "
+      "synchronous gradient sums");
+  }
+  for (Layer* layer : m->get_layers()) {
+    if (layer->get_optimizer() != nullptr) {
+      m_layers.push_back(layer);
+      const Mat& local = layer->get_weights_biases().LockedMatrix();
+      m_count += local.Height() * local.Width();
+    }
+  }
+  if (comm->get_model_rank() == 0) {
+    if (comm->get_num_models() > 1) {
+      int provided;
+      MPI_Query_thread(&provided);
+      if (provided != MPI_THREAD_MULTIPLE) {
+        throw lbann_exception(
+          "lbann_callback_async_sgd: the parameter server needs "
+          "MPI_THREAD_MULTIPLE");
+      }
+    }
+    pack_weights(m_buf);
+    m_server = new parameter_server(comm, m_buf);
+  }
+}
+
+void lbann_callback_async_sgd::on_train_begin(model* m) {
+  exchange(m->get_comm(), false);
+  m_epoch_start = get_time();
+}
+
+void lbann_callback_async_sgd::on_batch_end(model* m) {
+  if (m->get_execution_mode() != execution_mode::training) {
+    return;
+  }
+  lbann_comm* comm = m->get_comm();
+  const double start_time = get_time();
+  int64_t slowest = exchange(comm, true);
+  const int64_t staleness = m_clock - slowest;
+  // Hold back until the slowest model is within the staleness bound.
+  while (m_clock - slowest > m_staleness) {
+    if (m_server != nullptr) {
+      m_server->wait_for_clock(m_clock - m_staleness);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    slowest = exchange(comm, false);
+  }
+  const double wait_time = get_time() - start_time;
+  ++m_epoch_steps;
+  m_epoch_wait_time += wait_time;
+  m_epoch_max_staleness = std::max(m_epoch_max_staleness, staleness);
+  if (summarizer != nullptr) {
+    summarizer->reduce_scalar("async_sgd/staleness", staleness,
+                              m->get_cur_step());
+    summarizer->reduce_scalar("async_sgd/exchange_time", wait_time,
+                              m->get_cur_step());
+  }
+}
+
+void lbann_callback_async_sgd::on_epoch_end(model* m) {
+  lbann_comm* comm = m->get_comm();
+  exchange(comm, false);
+  const double elapsed = get_time() - m_epoch_start;
+  const double steps_per_sec = elapsed > 0.0 ? m_epoch_steps / elapsed : 0.0;
+  if (comm->am_model_master()) {
+    std::cout << "Model " << comm->get_model_rank() << " async SGD: "
+              << steps_per_sec << " steps/s, "
+              << m_epoch_wait_time << "s exchanging, max staleness "
+              << m_epoch_max_staleness << std::endl;
+  }
+  if (summarizer != nullptr) {
+    summarizer->reduce_scalar("async_sgd/steps_per_sec", steps_per_sec,
+                              m->get_cur_step());
+    summarizer->reduce_scalar("async_sgd/max_staleness",
+                              m_epoch_max_staleness, m->get_cur_step());
+  }
+  m_epoch_start = get_time();
+  m_epoch_steps = 0;
+  m_epoch_wait_time = 0.0;
+  m_epoch_max_staleness = 0;
+}
+
+void lbann_callback_async_sgd::on_train_end(model* m) {
+  if (m_server != nullptr) {
+    m_server->finish_local();
+  } else {
+    send_header(m->get_comm(), parameter_server::DONE);
+  }
+}
+
+int64_t lbann_callback_async_sgd::exchange(lbann_comm* comm, bool push) {
+  if (push) {
+    // The delta is what the local optimizer did since the last pull.
+    pack_weights(m_buf);
+    for (El::Int i = 0; i < m_count; ++i) {
+      m_buf[i] -= m_base[i];
+    }
+    ++m_clock;
+  }
+  int64_t slowest;
+  if (m_server != nullptr) {
+    if (push) {
+      m_server->push(m_buf);
+    }
+    slowest = m_server->pull(m_base);
+  } else {
+    send_header(comm, push ? parameter_server::PUSH_PULL :
+                parameter_server::PULL);
+    if (push) {
+      comm->ps_send(m_buf.data(), m_count, 0);
+    }
+    comm->ps_recv(&slowest, 1, 0);
+    m_base.resize(m_count);
+    comm->ps_recv(m_base.data(), m_count, 0);
+  }
+  unpack_weights(m_base);
+  return slowest;
+}
+
+void lbann_callback_async_sgd::send_header(lbann_comm* comm,
+                                           parameter_server::message_type type) {
+  int64_t header[2] = {type, (int64_t) m_count};
+  comm->ps_send(header, 2, 0);
+}
+
+void lbann_callback_async_sgd::pack_weights(std::vector<DataType>& buf) {
+  buf.resize(m_count);
+  DataType* dst = buf.data();
+  for (Layer* layer : m_layers) {
+    const Mat& local = layer->get_weights_biases().LockedMatrix();
+    for (El::Int col = 0; col < local.Width(); ++col) {
+      std::copy(local.LockedBuffer(0, col),
+                local.LockedBuffer(0, col) + local.Height(), dst);
+      dst += local.Height();
+    }
+  }
+}
+
+void lbann_callback_async_sgd::unpack_weights(const std::vector<DataType>& buf) {
+  const DataType* src = buf.data();
+  for (Layer* layer : m_layers) {
+    Mat& local = layer->get_weights_biases().Matrix();
+    for (El::Int col = 0; col < local.Width(); ++col) {
+      std::copy(src, src + local.Height(), local.Buffer(0, col));
+      src += local.Height();
+    }
+  }
+}
+
+}  // namespace lbann
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_callback_gossip .hpp .cpp - Decentralized gossip averaging
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/callbacks/lbann_callback_gossip.hpp"
+#include "lbann/utils/lbann_timer.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+#include "lbann/models/lbann_flat_params.hpp"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+namespace lbann {
+
+lbann_callback_gossip::lbann_callback_gossip(topology topo, int seed,
+                                             lbann_summary* _summarizer) :
+  lbann_callback(1, _summarizer), m_topology(topo), m_seed(seed) {
+  set_name("gossip");
+}
+
+void lbann_callback_gossip::setup(model* m) {
+  flat_params* flat = m->get_flat_params();
+  if (flat != nullptr && flat->is_sharded()) {
+    throw lbann_exception(
+      "lbann_callback_gossip: sharded optimizer state requires "
+      "synchronous gradient sums");
+  }
+  for (Layer* layer : m->get_layers()) {
+    if (layer->get_optimizer() != nullptr) {
+      m_layers.push_back(layer);
+      const Mat& local = layer->get_weights_biases().LockedMatrix();
+      m_count += local.Height() * local.Width();
+    }
+  }
+  m_snapshot.resize(m_count);
+}
+
+void lbann_callback_gossip::on_batch_end(model* m) {
+  if (m->get_comm()->get_num_models() == 1 ||
+      m->get_execution_mode() != execution_mode::training) {
+    return;
+  }
+  finish_exchange(m);
+  start_exchange(m);
+}
+
+void lbann_callback_gossip::on_epoch_end(model* m) {
+  finish_exchange(m);
+}
+
+std::vector<int> lbann_callback_gossip::get_peers(lbann_comm* comm,
+                                                  int64_t step) const {
+  const int num_models = comm->get_num_models();
+  const int me = comm->get_model_rank();
+  std::vector<int> peers;
+  if (m_topology == RING) {
+    const int left = (me + num_models - 1) % num_models;
+    const int right = (me + 1) % num_models;
+    peers.push_back(left);
+    if (right != left) {
+      peers.push_back(right);
+    }
+  } else {
+    // Every model draws the same matching from the shared seed and step.
+    std::vector<int> order(num_models);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(m_seed + step);
+    std::shuffle(order.begin(), order.end(), gen);
+    const int pos = std::find(order.begin(), order.end(), me) - order.begin();
+    const int partner = pos ^ 1;
+    if (partner < num_models) {
+      peers.push_back(order[partner]);
+    }
+  }
+  return peers;
+}
+
+void lbann_callback_gossip::start_exchange(model* m) {
+  lbann_comm* comm = m->get_comm();
+  m_peers = get_peers(comm, m->get_cur_step());
+  if (m_peers.empty()) {
+    return;
+  }
+  DataType* dst = m_snapshot.data();
+  for (Layer* layer : m_layers) {
+    const Mat& local = layer->get_weights_biases().LockedMatrix();
+    for (El::Int col = 0; col < local.Width(); ++col) {
+      std::copy(local.LockedBuffer(0, col),
+                local.LockedBuffer(0, col) + local.Height(), dst);
+      dst += local.Height();
+    }
+  }
+  m_recv_bufs.resize(m_peers.size());
+  m_send_reqs.resize(m_peers.size());
+  m_recv_reqs.resize(m_peers.size());
+  // Receives are posted in the same peer order the senders use.
+  for (size_t i = 0; i < m_peers.size(); ++i) {
+    m_recv_bufs[i].resize(m_count);
+    comm->nb_recv(m_recv_bufs[i].data(), m_count, m_peers[i], m_recv_reqs[i]);
+  }
+  for (size_t i = 0; i < m_peers.size(); ++i) {
+    comm->nb_send(m_snapshot.data(), m_count, m_peers[i], m_send_reqs[i]);
+  }
+  m_in_flight = true;
+}
+
+void lbann_callback_gossip::finish_exchange(model* m) {
+  if (!m_in_flight) {
+    return;
+  }
+  lbann_comm* comm = m->get_comm();
+  const double start_time = get_time();
+  for (size_t i = 0; i < m_peers.size(); ++i) {
+    comm->wait(m_recv_reqs[i]);
+    comm->wait(m_send_reqs[i]);
+  }
+  const double wait_time = get_time() - start_time;
+  // w += mean(snapshots of self and peers) - own snapshot
+  //    = (sum(peer snapshots) - n * own snapshot) / (n + 1)
+  const int num_peers = m_peers.size();
+  const DataType scale = DataType(1) / (num_peers + 1);
+  DataType* snapshot = m_snapshot.data();
+  #pragma omp parallel for
+  for (El::Int j = 0; j < m_count; ++j) {
+    DataType diff = -num_peers * snapshot[j];
+    for (int i = 0; i < num_peers; ++i) {
+      diff += m_recv_bufs[i][j];
+    }
+    snapshot[j] = scale * diff;
+  }
+  const DataType* delta = m_snapshot.data();
+  for (Layer* layer : m_layers) {
+    Mat& local = layer->get_weights_biases().Matrix();
+    for (El::Int col = 0; col < local.Width(); ++col) {
+      DataType* w = local.Buffer(0, col);
+      for (El::Int row = 0; row < local.Height(); ++row) {
+        w[row] += delta[row];
+      }
+      delta += local.Height();
+    }
+  }
+  m_in_flight = false;
+  if (summarizer != nullptr) {
+    summarizer->reduce_scalar("gossip/wait_time", wait_time,
+                              m->get_cur_step());
+    summarizer->reduce_scalar("gossip/bytes_sent",
+                              sizeof(DataType) * m_count * m_peers.size(),
+                              m->get_cur_step());
+  }
+}
+
+}  // namespace lbann
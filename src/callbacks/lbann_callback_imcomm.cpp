@@ -29,6 +29,9 @@
 #include "lbann/callbacks/lbann_callback_imcomm.hpp"
 #include "lbann/utils/lbann_timer.hpp"
 #include "lbann/utils/lbann_exception.hpp"
+#include "lbann/models/lbann_flat_params.hpp"
+#include <algorithm>
+#include <iostream>
 
 namespace lbann {
 
@@ -45,7 +48,32 @@ lbann_callback_imcomm::lbann_callback_imcomm(lbann_callback_imcomm::comm_type ct
   set_name("imcomm");  
 }
 
+lbann_callback_imcomm::~lbann_callback_imcomm() {
+  delete m_buckets;
+  if (m_comm_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_comm_mutex);
+      m_comm_thread_stop = true;
+    }
+    m_comm_cv.notify_all();
+    m_comm_thread.join();
+  }
+}
+
 void lbann_callback_imcomm::setup(model* m) {
+  flat_params* flat = m->get_flat_params();
+  if (ct_does_quantization() && flat != nullptr) {
+    throw lbann_exception(
+      "lbann_callback_imcomm: quantization is not supported with flattened "
+      "parameters");
+  }
+  // The sharded update sums gradients across models no matter what, so the
+  // mini-batch size must be scaled for it.
+  if (ct == NONE && flat != nullptr && flat->is_sharded()) {
+    throw lbann_exception(
+      "lbann_callback_imcomm: sharded optimizer state requires inter-model "
+      "gradient sums");
+  }
   if (ct != NONE) {
     bool add = layer_indices.size() == 0;
     std::vector<Layer*>& layers = m->get_layers();
@@ -58,7 +86,7 @@ void lbann_callback_imcomm::setup(model* m) {
         layer->set_effective_minibatch_size(
           layer->get_minibatch_size() * m->get_comm()->get_num_models());
         // Skip adding matrices when we don't need to.
-        if (!ct_does_quantization()) continue;
+        if (!ct_has_error_feedback()) continue;
         // TODO: handle case where weights_gradient is in other matrix distribution
         DistMat& weights_gradient = (DistMat&) layer->get_weights_biases_gradient();
         quantization_errors.emplace(idx, Mat{});
@@ -82,6 +110,67 @@ void lbann_callback_imcomm::setup(model* m) {
       }
     }
   }
+  if (ct == NORMAL_AR) {
+    quantizer.set_allreduce_algorithm(m_allreduce_alg);
+    if (m_autotune_allreduce) {
+      Int max_count = 0;
+      for (Layer* layer : m->get_layers()) {
+        if (!reduces_layer(m, layer)) {
+          continue;
+        }
+        // TODO: handle case where weights_gradient is in other matrix distribution
+        DistMat& weights_gradient = (DistMat&) layer->get_weights_biases_gradient();
+        max_count = std::max(
+          max_count, weights_gradient.LocalHeight() * weights_gradient.LocalWidth());
+      }
+      quantizer.autotune_allreduce(m->get_comm(), 64, max_count);
+    }
+  }
+  if (ct == NORMAL && m_bucket_bytes > 0) {
+    // Lay the buckets out in backprop order.
+    m_buckets = new gradient_buckets(m->get_comm(), m_bucket_bytes);
+    std::vector<Layer*>& layers = m->get_layers();
+    for (size_t l = layers.size(); l-- > 0;) {
+      if (!reduces_layer(m, layers[l])) {
+        continue;
+      }
+      // TODO: handle case where weights_gradient is in other matrix distribution
+      DistMat& weights_gradient = (DistMat&) layers[l]->get_weights_biases_gradient();
+      m_buckets->add_gradient(
+        layers[l]->get_index(),
+        weights_gradient.LocalHeight() * weights_gradient.LocalWidth());
+    }
+    m_buckets->setup();
+    if (m->get_comm()->am_world_master()) {
+      std::cout << "lbann_callback_imcomm: " << m_buckets->get_num_buckets()
+                << " gradient buckets of at most " << m_bucket_bytes
+                << " bytes (" << m_buckets->get_staging_bytes()
+                << " bytes staged)" << std::endl;
+    }
+  }
+  if (m_overlap) {
+    // Create all entries up front so the comm thread never races an insert.
+    for (uint idx : layer_indices) {
+      m_pending[idx];
+    }
+  }
+  if (m_overlap && ct != NONE && ct != NORMAL) {
+    // Only the plain sum has a non-blocking collective; the other reductions
+    // are run on a communication thread, which requires MPI to allow
+    // concurrent calls (the main thread keeps doing intra-model collectives).
+    int provided;
+    MPI_Query_thread(&provided);
+    m_use_comm_thread = provided == MPI_THREAD_MULTIPLE;
+    if (m_use_comm_thread) {
+      m_comm = m->get_comm();
+      m_layers = &(m->get_layers());
+      m_comm_thread = std::thread(&lbann_callback_imcomm::comm_thread_loop,
+                                  this);
+    } else if (m->get_comm()->am_world_master()) {
+      std::cout << "lbann_callback_imcomm: MPI_THREAD_MULTIPLE not available, "
+                << "quantized reductions will not be overlapped" << std::endl;
+    }
+  }
 }
 
 void lbann_callback_imcomm::on_epoch_end(model* m) {
@@ -90,7 +179,7 @@ void lbann_callback_imcomm::on_epoch_end(model* m) {
       m->get_execution_mode() != execution_mode::training) {
     return;  // No point with only one model.
   }
-  if (ct_does_quantization()) {
+  if (ct_has_error_feedback()) {
     std::vector<Layer*>& layers = m->get_layers();
     for (size_t l = 0; l < layers.size(); ++l) {
       if (layer_indices.find(layers[l]->get_index()) == layer_indices.end()) {
@@ -114,103 +203,332 @@ void lbann_callback_imcomm::on_backward_prop_end(model* m) {
       m->get_execution_mode() != execution_mode::training) {
     return;  // No point with only one model.
   }
+  // Sum the gradients of all flattened layers with a single allreduce.
+  // Sharded flat parameters reduce-scatter their gradients during the update.
+  flat_params* flat = ct == NORMAL ? m->get_flat_params() : nullptr;
+  if (flat != nullptr && !flat->is_sharded()) {
+    double start_time = get_time();
+    Mat& flat_gradients = flat->get_local_gradients();
+    comm->intermodel_sum_matrix(flat_gradients);
+    double im_time = get_time() - start_time;
+    if (summarizer != nullptr) {
+      size_t bytes = sizeof(DataType) * flat_gradients.Height() *
+        flat_gradients.Width();
+      summarizer->reduce_scalar("flat/imcomm_time", im_time,
+                                m->get_cur_step());
+      summarizer->reduce_scalar("flat/imcomm_bytes_sent", bytes,
+                                m->get_cur_step());
+      summarizer->reduce_scalar("flat/imcomm_bytes_received", bytes,
+                                m->get_cur_step());
+    }
+  }
+  if (m_overlap) {
+    return;  // Layers were reduced as backprop went.
+  }
   std::vector<Layer*>& layers = m->get_layers();
+  if (m_buckets != nullptr) {
+    // Pack in backprop order; each bucket is summed once it fills.
+    for (size_t l = layers.size(); l-- > 0;) {
+      if (m_buckets->has_gradient(layers[l]->get_index())) {
+        m_buckets->pack(layers[l]->get_index(),
+                        (DistMat&) layers[l]->get_weights_biases_gradient(),
+                        false);
+      }
+    }
+    for (size_t l = 0; l < layers.size(); ++l) {
+      if (m_buckets->has_gradient(layers[l]->get_index())) {
+        m_buckets->unpack(layers[l]->get_index(),
+                          (DistMat&) layers[l]->get_weights_biases_gradient());
+      }
+    }
+    return;
+  }
   for (size_t l = 0; l < layers.size(); ++l) {
-    if (layer_indices.find(layers[l]->get_index()) == layer_indices.end()) {
+    if (!reduces_layer(m, layers[l])) {
       continue;
     }
     double start_time = get_time();
+    reduce_layer(comm, layers[l], layers[l]->get_index());
+    double im_time = get_time() - start_time;
     // TODO: handle case where weights_gradient is in other matrix distribution
     DistMat& weights_gradient = (DistMat&) layers[l]->get_weights_biases_gradient();
-    switch (ct) {
-    case NONE:
-      break;
-    case NORMAL:
-      comm->intermodel_sum_matrix(weights_gradient);
-      break;
-    case NORMAL_AR:
-      quantizer.intermodel_sum(comm, weights_gradient);
-      break;
-    case ONEBIT_QUANTIZATION:
-      quantizer.intermodel_sum_quantized(
-        comm, weights_gradient, quantization_errors[l], im_quantization_errors[l], true,
-        &(gradhistories[l]));
-      break;
-    case THRESH_QUANTIZATION:
-      // TODO: Don't hardcode thresholds.
-      quantizer.intermodel_sum_threshold_quantized(
-        comm, weights_gradient, quantization_errors[l], 0.01f, -0.01f,
-        im_quantization_errors[l], false);
-      break;
-    case COMPRESSED_THRESH_QUANTIZATION:
-      // TODO: Don't hardcode thresholds.
-      quantizer.intermodel_sum_threshold_quantized(
-        comm, weights_gradient, quantization_errors[l], 0.01f, -0.01f,
-        im_quantization_errors[l], true);
-      break;
-    case ADAPTIVE_THRESH_QUANTIZATION:
-      // TODO: Don't hardcode proportion.
-      quantizer.intermodel_sum_adaptive_threshold_quantized(
-        comm, weights_gradient, quantization_errors[l], 64,
-        im_quantization_errors[l]);
-      break;
-      /*case COMPRESSED_ADAPTIVE_THRESH_QUANTIZATION:
-      // TODO: Don't hardcode proportion.
-      quantizer.intermodel_sum_adaptive_threshold_quantized(
-        comm, weights_gradient, quantization_errors[l], 64,
-        im_quantization_errors[l], true);
-        break;*/
+    summarize_layer(m, layers[l], im_time, collect_stats(weights_gradient));
+  }
+}
+
+void lbann_callback_imcomm::on_backward_prop_end(model* m, Layer* l) {
+  lbann_comm* comm = m->get_comm();
+  if (!m_overlap || comm->get_num_models() == 1 ||
+      m->get_execution_mode() != execution_mode::training ||
+      !reduces_layer(m, l)) {
+    return;
+  }
+  uint idx = l->get_index();
+  pending_reduction& pending = m_pending.at(idx);
+  pending.in_flight = true;
+  pending.start_time = get_time();
+  if (m_buckets != nullptr) {
+    m_buckets->pack(idx, (DistMat&) l->get_weights_biases_gradient(), true);
+    pending.uses_request = false;
+  } else if (ct == NORMAL) {
+    // TODO: handle case where weights_gradient is in other matrix distribution
+    DistMat& weights_gradient = (DistMat&) l->get_weights_biases_gradient();
+    pending.uses_request = true;
+    comm->nb_intermodel_sum_matrix(weights_gradient, pending.req);
+  } else if (m_use_comm_thread) {
+    pending.uses_request = false;
+    {
+      std::lock_guard<std::mutex> lock(m_comm_mutex);
+      pending.done = false;
+      m_comm_queue.push_back(idx);
     }
-    double im_time = get_time() - start_time;
-    if (summarizer != nullptr && ct != NONE) {
-      std::string prefix = "layer" + std::to_string(
-        static_cast<long long>(layers[l]->get_index())) + "/imcomm_";
-      summarizer->reduce_scalar(prefix + "time",
-                                im_time, m->get_cur_step());
-      size_t bytes_sent = 0;
-      size_t bytes_received = 0;
-      if (ct_does_quantization()) {
-        bytes_sent = quantizer.get_bytes_sent();
-        bytes_received = quantizer.get_bytes_received();
-      } else {
-        // Use the same approximation the comm layer does.
-        bytes_sent = sizeof(DataType) * weights_gradient.LocalHeight() * weights_gradient.LocalWidth();
-        bytes_received = sizeof(DataType) * weights_gradient.LocalHeight() * weights_gradient.LocalWidth();
-      }
-      summarizer->reduce_scalar(prefix + "bytes_sent",
-                                bytes_sent, m->get_cur_step());
-      summarizer->reduce_scalar(prefix + "bytes_received",
-                                bytes_received, m->get_cur_step());
-      if (ct_does_quantization()) {
-        summarizer->reduce_scalar(prefix + "rs_bytes_sent",
-                                  quantizer.get_rs_bytes_sent(),
-                                  m->get_cur_step());
-        summarizer->reduce_scalar(prefix + "ag_bytes_sent",
-                                  quantizer.get_ag_bytes_sent(),
-                                  m->get_cur_step());
-        summarizer->reduce_scalar(prefix + "rs_bytes_received",
-                                  quantizer.get_rs_bytes_received(),
-                                  m->get_cur_step());
-        summarizer->reduce_scalar(prefix + "ag_bytes_received",
-                                  quantizer.get_ag_bytes_received(),
-                                  m->get_cur_step());
-        summarizer->reduce_scalar(prefix + "rs_send_trans_time",
-                                  quantizer.get_rs_send_trans_time(),
-                                  m->get_cur_step());
-        summarizer->reduce_scalar(prefix + "rs_recv_trans_time",
-                                  quantizer.get_rs_recv_trans_time(),
-                                  m->get_cur_step());
-        summarizer->reduce_scalar(prefix + "ag_recv_trans_time",
-                                  quantizer.get_ag_recv_trans_time(),
-                                  m->get_cur_step());
-        quantizer.reset_bytes_counters();
-        quantizer.reset_time_counters();
-        if (ct == ADAPTIVE_THRESH_QUANTIZATION) {
-          summarizer->reduce_scalar(prefix + "quantized_count",
-                                    quantizer.get_quantized_count(),
-                                    m->get_cur_step());
-        }
+    m_comm_cv.notify_one();
+  } else {
+    // No way to overlap this; reduce it now so it is at least started early.
+    pending.uses_request = false;
+    reduce_layer(comm, l, idx);
+    DistMat& weights_gradient = (DistMat&) l->get_weights_biases_gradient();
+    pending.stats = collect_stats(weights_gradient);
+    pending.end_time = get_time();
+    pending.done = true;
+    m_exposed_time += pending.end_time - pending.start_time;
+  }
+}
+
+void lbann_callback_imcomm::on_update_begin(model* m, Layer* l) {
+  if (!m_overlap) {
+    return;
+  }
+  auto iter = m_pending.find(l->get_index());
+  if (iter == m_pending.end() || !iter->second.in_flight) {
+    return;
+  }
+  pending_reduction& pending = iter->second;
+  if (m_buckets != nullptr) {
+    // Bucket timers are kept by the buckets and reported per mini-batch.
+    m_buckets->unpack(l->get_index(),
+                      (DistMat&) l->get_weights_biases_gradient());
+    pending.in_flight = false;
+    return;
+  }
+  double wait_start = get_time();
+  if (pending.uses_request) {
+    m->get_comm()->wait(pending.req);
+    pending.end_time = get_time();
+    m_exposed_time += pending.end_time - wait_start;
+    // TODO: handle case where weights_gradient is in other matrix distribution
+    DistMat& weights_gradient = (DistMat&) l->get_weights_biases_gradient();
+    pending.stats = collect_stats(weights_gradient);
+  } else if (m_use_comm_thread) {
+    std::unique_lock<std::mutex> lock(m_comm_mutex);
+    m_comm_cv.wait(lock, [&pending] { return pending.done; });
+    lock.unlock();
+    // Time spent blocked here, capped by when the thread actually finished.
+    m_exposed_time += std::max(0.0, pending.end_time - wait_start);
+  }
+  pending.in_flight = false;
+  double im_time = pending.end_time - pending.start_time;
+  m_comm_time += im_time;
+  summarize_layer(m, l, im_time, pending.stats);
+}
+
+void lbann_callback_imcomm::on_batch_end(model* m) {
+  if (m->get_execution_mode() != execution_mode::training ||
+      m->get_comm()->get_num_models() == 1) {
+    return;
+  }
+  if (m_buckets != nullptr) {
+    m_comm_time += m_buckets->get_comm_time();
+    m_exposed_time += m_overlap ? m_buckets->get_wait_time() :
+      m_buckets->get_comm_time();
+    if (summarizer != nullptr) {
+      summarizer->reduce_scalar("imcomm_bucket_size",
+                                m_buckets->get_bucket_bytes(),
+                                m->get_cur_step());
+      summarizer->reduce_scalar("imcomm_num_buckets",
+                                m_buckets->get_num_buckets(),
+                                m->get_cur_step());
+      summarizer->reduce_scalar("imcomm_bucket_collectives",
+                                m_buckets->get_num_collectives(),
+                                m->get_cur_step());
+      summarizer->reduce_scalar("imcomm_bucket_time",
+                                m_buckets->get_comm_time(),
+                                m->get_cur_step());
+      summarizer->reduce_scalar("imcomm_bucket_bytes_sent",
+                                m_buckets->get_staging_bytes(),
+                                m->get_cur_step());
+    }
+    m_buckets->reset_counters();
+  }
+  if (!m_overlap) {
+    m_comm_time = 0.0;
+    m_exposed_time = 0.0;
+    return;
+  }
+  if (summarizer != nullptr && ct != NONE) {
+    summarizer->reduce_scalar("imcomm_overlap_comm_time", m_comm_time,
+                              m->get_cur_step());
+    summarizer->reduce_scalar("imcomm_overlap_exposed_time", m_exposed_time,
+                              m->get_cur_step());
+    summarizer->reduce_scalar("imcomm_overlap_hidden_time",
+                              std::max(0.0, m_comm_time - m_exposed_time),
+                              m->get_cur_step());
+  }
+  m_comm_time = 0.0;
+  m_exposed_time = 0.0;
+}
+
+bool lbann_callback_imcomm::reduces_layer(model* m, Layer* layer) const {
+  if (ct == NONE ||
+      layer_indices.find(layer->get_index()) == layer_indices.end()) {
+    return false;
+  }
+  flat_params* flat = m->get_flat_params();
+  if (flat == nullptr || !flat->is_flattened(layer)) {
+    return true;
+  }
+  // Sharded flat parameters are summed by their update; otherwise the plain
+  // sum reduces the whole flat buffer at once.
+  return !flat->is_sharded() && ct != NORMAL;
+}
+
+void lbann_callback_imcomm::comm_thread_loop() {
+  while (true) {
+    uint idx;
+    {
+      std::unique_lock<std::mutex> lock(m_comm_mutex);
+      m_comm_cv.wait(lock, [this] {
+          return m_comm_thread_stop || !m_comm_queue.empty(); });
+      if (m_comm_queue.empty()) {
+        return;  // Stopping.
       }
+      idx = m_comm_queue.front();
+      m_comm_queue.pop_front();
+    }
+    Layer* layer = (*m_layers)[idx];
+    reduce_layer(m_comm, layer, idx);
+    // TODO: handle case where weights_gradient is in other matrix distribution
+    DistMat& weights_gradient = (DistMat&) layer->get_weights_biases_gradient();
+    reduction_stats stats = collect_stats(weights_gradient);
+    {
+      std::lock_guard<std::mutex> lock(m_comm_mutex);
+      pending_reduction& pending = m_pending.at(idx);
+      pending.stats = stats;
+      pending.end_time = get_time();
+      pending.done = true;
+    }
+    m_comm_cv.notify_all();
+  }
+}
+
+void lbann_callback_imcomm::reduce_layer(lbann_comm* comm, Layer* layer,
+                                         uint l) {
+  // TODO: handle case where weights_gradient is in other matrix distribution
+  DistMat& weights_gradient = (DistMat&) layer->get_weights_biases_gradient();
+  switch (ct) {
+  case NONE:
+    break;
+  case NORMAL:
+    comm->intermodel_sum_matrix(weights_gradient);
+    break;
+  case NORMAL_AR:
+    quantizer.intermodel_sum(comm, weights_gradient);
+    break;
+  case ONEBIT_QUANTIZATION:
+    quantizer.intermodel_sum_quantized(
+      comm, weights_gradient, quantization_errors[l], im_quantization_errors[l], true,
+      &(gradhistories[l]));
+    break;
+  case THRESH_QUANTIZATION:
+    // TODO: Don't hardcode thresholds.
+    quantizer.intermodel_sum_threshold_quantized(
+      comm, weights_gradient, quantization_errors[l], 0.01f, -0.01f,
+      im_quantization_errors[l], false);
+    break;
+  case COMPRESSED_THRESH_QUANTIZATION:
+    // TODO: Don't hardcode thresholds.
+    quantizer.intermodel_sum_threshold_quantized(
+      comm, weights_gradient, quantization_errors[l], 0.01f, -0.01f,
+      im_quantization_errors[l], true);
+    break;
+  case ADAPTIVE_THRESH_QUANTIZATION:
+    // TODO: Don't hardcode proportion.
+    quantizer.intermodel_sum_adaptive_threshold_quantized(
+      comm, weights_gradient, quantization_errors[l], 64,
+      im_quantization_errors[l]);
+    break;
+  case QSGD_QUANTIZATION:
+    quantizer.intermodel_sum_qsgd(comm, weights_gradient, m_qsgd_bits);
+    break;
+  case TOPK_SPARSIFICATION:
+    quantizer.intermodel_sum_topk(comm, weights_gradient,
+                                  quantization_errors[l], m_topk_proportion);
+    break;
+    /*case COMPRESSED_ADAPTIVE_THRESH_QUANTIZATION:
+    // TODO: Don't hardcode proportion.
+    quantizer.intermodel_sum_adaptive_threshold_quantized(
+      comm, weights_gradient, quantization_errors[l], 64,
+      im_quantization_errors[l], true);
+      break;*/
+  }
+}
+
+lbann_callback_imcomm::reduction_stats lbann_callback_imcomm::collect_stats(
+  const DistMat& weights_gradient) {
+  reduction_stats stats;
+  if (ct_does_quantization()) {
+    stats.bytes_sent = quantizer.get_bytes_sent();
+    stats.bytes_received = quantizer.get_bytes_received();
+    stats.rs_bytes_sent = quantizer.get_rs_bytes_sent();
+    stats.ag_bytes_sent = quantizer.get_ag_bytes_sent();
+    stats.rs_bytes_received = quantizer.get_rs_bytes_received();
+    stats.ag_bytes_received = quantizer.get_ag_bytes_received();
+    stats.rs_send_trans_time = quantizer.get_rs_send_trans_time();
+    stats.rs_recv_trans_time = quantizer.get_rs_recv_trans_time();
+    stats.ag_recv_trans_time = quantizer.get_ag_recv_trans_time();
+    stats.quantized_count = quantizer.get_quantized_count();
+    quantizer.reset_bytes_counters();
+    quantizer.reset_time_counters();
+  } else {
+    // Use the same approximation the comm layer does.
+    stats.bytes_sent = sizeof(DataType) * weights_gradient.LocalHeight() * weights_gradient.LocalWidth();
+    stats.bytes_received = sizeof(DataType) * weights_gradient.LocalHeight() * weights_gradient.LocalWidth();
+  }
+  return stats;
+}
+
+void lbann_callback_imcomm::summarize_layer(model* m, Layer* layer,
+                                            double im_time,
+                                            const reduction_stats& stats) {
+  if (summarizer == nullptr || ct == NONE) {
+    return;
+  }
+  std::string prefix = "layer" + std::to_string(
+    static_cast<long long>(layer->get_index())) + "/imcomm_";
+  summarizer->reduce_scalar(prefix + "time",
+                            im_time, m->get_cur_step());
+  summarizer->reduce_scalar(prefix + "bytes_sent",
+                            stats.bytes_sent, m->get_cur_step());
+  summarizer->reduce_scalar(prefix + "bytes_received",
+                            stats.bytes_received, m->get_cur_step());
+  if (ct_does_quantization()) {
+    summarizer->reduce_scalar(prefix + "rs_bytes_sent",
+                              stats.rs_bytes_sent, m->get_cur_step());
+    summarizer->reduce_scalar(prefix + "ag_bytes_sent",
+                              stats.ag_bytes_sent, m->get_cur_step());
+    summarizer->reduce_scalar(prefix + "rs_bytes_received",
+                              stats.rs_bytes_received, m->get_cur_step());
+    summarizer->reduce_scalar(prefix + "ag_bytes_received",
+                              stats.ag_bytes_received, m->get_cur_step());
+    summarizer->reduce_scalar(prefix + "rs_send_trans_time",
+                              stats.rs_send_trans_time, m->get_cur_step());
+    summarizer->reduce_scalar(prefix + "rs_recv_trans_time",
+                              stats.rs_recv_trans_time, m->get_cur_step());
+    summarizer->reduce_scalar(prefix + "ag_recv_trans_time",
+                              stats.ag_recv_trans_time, m->get_cur_step());
+    if (ct == ADAPTIVE_THRESH_QUANTIZATION || ct == TOPK_SPARSIFICATION) {
+      summarizer->reduce_scalar(prefix + "quantized_count",
+                                stats.quantized_count, m->get_cur_step());
     }
   }
 }
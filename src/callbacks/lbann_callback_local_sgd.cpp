@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_callback_local_sgd .hpp .cpp - Periodic model averaging (local SGD)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/callbacks/lbann_callback_local_sgd.hpp"
+#include "lbann/utils/lbann_timer.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+#include "lbann/models/lbann_flat_params.hpp"
+#include <algorithm>
+
+namespace lbann {
+
+lbann_callback_local_sgd::lbann_callback_local_sgd(
+  int k, bool average_optimizer_state, lbann_summary* _summarizer) :
+  lbann_callback(1, _summarizer), m_k(std::max(k, 1)), m_max_k(m_k),
+  m_drift_threshold(0.0), m_average_optimizer_state(average_optimizer_state) {
+  set_name("local_sgd");
+}
+
+lbann_callback_local_sgd::lbann_callback_local_sgd(
+  int k, std::unordered_set<uint> _layers, bool average_optimizer_state,
+  lbann_summary* _summarizer) :
+  lbann_callback(1, _summarizer), m_k(std::max(k, 1)), m_max_k(m_k),
+  m_drift_threshold(0.0), m_average_optimizer_state(average_optimizer_state),
+  layer_indices(_layers) {
+  set_name("local_sgd");
+}
+
+void lbann_callback_local_sgd::setup(model* m) {
+  flat_params* flat = m->get_flat_params();
+  if (flat != nullptr && flat->is_sharded()) {
+    throw lbann_exception(
+      "lbann_callback_local_sgd: sharded optimizer state requires "
+      "synchronous gradient sums");
+  }
+  bool add = layer_indices.size() == 0;
+  for (Layer* layer : m->get_layers()) {
+    if (layer->get_optimizer() == nullptr) {
+      continue;
+    }
+    if (!add && layer_indices.find(layer->get_index()) == layer_indices.end()) {
+      continue;
+    }
+    // Flattened layers are averaged together through the flat buffer.
+    if (flat != nullptr && flat->is_flattened(layer)) {
+      continue;
+    }
+    m_layers.push_back(layer);
+  }
+}
+
+void lbann_callback_local_sgd::on_batch_end(model* m) {
+  if (m->get_comm()->get_num_models() == 1 ||
+      m->get_execution_mode() != execution_mode::training) {
+    return;
+  }
+  if (++m_steps >= m_k) {
+    average(m);
+  }
+}
+
+void lbann_callback_local_sgd::on_epoch_end(model* m) {
+  lbann_comm* comm = m->get_comm();
+  if (comm->get_num_models() == 1) {
+    return;
+  }
+  if (m_steps > 0) {
+    average(m);
+  }
+  if (comm->am_world_master()) {
+    std::cout << "Local SGD: " << m_epoch_averages << " averages this epoch, "
+              << m_epoch_bytes << " bytes sent per process, k=" << m_k
+              << std::endl;
+  }
+  m_epoch_bytes = 0;
+  m_epoch_averages = 0;
+}
+
+void lbann_callback_local_sgd::average(model* m) {
+  lbann_comm* comm = m->get_comm();
+  const double start_time = get_time();
+  const size_t start_bytes = comm->get_bytes_sent();
+  std::vector<ElMat*> weights;
+  std::vector<ElMat*> states;
+  for (Layer* layer : m_layers) {
+    weights.push_back(&(layer->get_weights_biases()));
+    if (m_average_optimizer_state) {
+      for (ElMat* state : layer->get_optimizer()->get_state_matrices()) {
+        states.push_back(state);
+      }
+    }
+  }
+  flat_params* flat = m->get_flat_params();
+  if (flat != nullptr) {
+    weights.push_back(&(flat->get_weights()));
+    if (m_average_optimizer_state && flat->get_optimizer() != nullptr) {
+      for (ElMat* state : flat->get_optimizer()->get_state_matrices()) {
+        states.push_back(state);
+      }
+    }
+  }
+
+  double pre_sqsum = 0.0;
+  if (m_adaptive) {
+    for (ElMat* w : weights) {
+      pre_sqsum += local_sqsum(*w);
+    }
+  }
+  for (ElMat* w : weights) {
+    average_matrix(comm, *w);
+  }
+  for (ElMat* state : states) {
+    average_matrix(comm, *state);
+  }
+
+  double drift = 0.0;
+  if (m_adaptive) {
+    // Sums over every process in every model; the averaged weights are the
+    // same in each model, so post is M times the squared norm of w_avg.
+    double local[2] = {pre_sqsum, 0.0};
+    for (ElMat* w : weights) {
+      local[1] += local_sqsum(*w);
+    }
+    double model_sums[2];
+    comm->model_allreduce(local, 2, model_sums);
+    const double pre = comm->intermodel_allreduce(model_sums[0]);
+    const double post = comm->intermodel_allreduce(model_sums[1]);
+    drift = post > 0.0 ? (pre - post) / post : 0.0;
+    if (drift > m_drift_threshold) {
+      m_k = std::max(m_k / 2, 1);
+    } else if (drift < m_drift_threshold / 4) {
+      m_k = std::min(m_k * 2, m_max_k);
+    }
+  }
+
+  const size_t bytes = comm->get_bytes_sent() - start_bytes;
+  m_epoch_bytes += bytes;
+  ++m_epoch_averages;
+  m_steps = 0;
+  if (summarizer != nullptr) {
+    summarizer->reduce_scalar("local_sgd/time", get_time() - start_time,
+                              m->get_cur_step());
+    summarizer->reduce_scalar("local_sgd/bytes_sent", bytes,
+                              m->get_cur_step());
+    summarizer->reduce_scalar("local_sgd/k", m_k, m->get_cur_step());
+    if (m_adaptive) {
+      summarizer->reduce_scalar("local_sgd/drift", drift, m->get_cur_step());
+    }
+  }
+}
+
+void lbann_callback_local_sgd::average_matrix(lbann_comm* comm, ElMat& mat) {
+  Mat& local = mat.Matrix();
+  comm->intermodel_sum_matrix(local);
+  El::Scale(DataType(1) / comm->get_num_models(), local);
+}
+
+double lbann_callback_local_sgd::local_sqsum(ElMat& mat) {
+  const Mat& local = mat.LockedMatrix();
+  double sqsum = 0.0;
+  for (El::Int col = 0; col < local.Width(); ++col) {
+    for (El::Int row = 0; row < local.Height(); ++row) {
+      const double val = local.Get(row, col);
+      sqsum += val * val;
+    }
+  }
+  return sqsum;
+}
+
+}  // namespace lbann
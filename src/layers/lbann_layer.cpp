@@ -127,7 +127,11 @@ void lbann::Layer::backProp() {
   // Get incoming loss and convert matrix distribution if necessary
   // Note that on assignment Elemental handles distribution conversion so a DistMatrixReadProxy is unnecessary
   if(bp_input != NULL) { // Target layers will not have a valid bp_input
-    *m_prev_error_signal = *bp_input;
+    // Optionally send the entries that change process in lower precision
+    if(!comm->model_redistribute_compressed(*bp_input, *m_prev_error_signal,
+                                            comm->get_error_signal_compression())) {
+      *m_prev_error_signal = *bp_input;
+    }
   }
   // Set the view for all of the standard matrices based on the
   // current mini-batch size
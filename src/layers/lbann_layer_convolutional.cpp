@@ -594,7 +594,17 @@ void lbann::convolutional_layer::bp_linearity() {
   }
 
   // Obtain filter gradient with reduction and scaling
-  AllReduce(*m_weights_gradient, m_weights_gradient->DistComm());
+  if(comm->get_gradient_compression() != intramodel_compression::NONE) {
+    // Lossy sum over the processes of the model (m_weights_gradient is a
+    // single column, so its local matrix is contiguous)
+    Mat& weights_gradient_local = m_weights_gradient->Matrix();
+    comm->model_sum_compressed(weights_gradient_local.Buffer(),
+                               weights_gradient_local.Height() * weights_gradient_local.Width(),
+                               comm->get_gradient_compression());
+  }
+  else {
+    AllReduce(*m_weights_gradient, m_weights_gradient->DistComm());
+  }
   *m_weights_gradient *= 1.0/get_effective_minibatch_size();
 
 }
@@ -146,18 +146,22 @@ void lbann::FullyConnectedLayer::setup(int numPrevNeurons) {
     Zeros(*m_activations, NumNeurons, m_mini_batch_size);
     Zeros(*m_prev_activations, numPrevNeurons, m_mini_batch_size);
 
-    /// Setup independent views of the weight matrix for the activations and bias terms
-    View(m_activation_weights_v, *m_weights, IR(0, m_weights->Height()), IR(0, m_weights->Width()-1));
-    View(m_bias_weights_v, *m_weights, IR(0, m_weights->Height()), IR(m_weights->Width()-1, m_weights->Width()));
-
-    /// Setup independent views of the weights gradient matrix for the activations and bias terms
-    View(m_activation_weights_gradient_v, *m_weights_gradient, IR(0, m_weights_gradient->Height()), IR(0, m_weights_gradient->Width()-1));
-    View(m_bias_weights_gradient_v, *m_weights_gradient, IR(0, m_weights_gradient->Height()), IR(m_weights_gradient->Width()-1, m_weights_gradient->Width()));
+    setup_weight_views();
 
     /// Create a "transposed" vector of the bias term for use in backprop
     Ones(m_bias_bp_t, m_mini_batch_size, 1);
 }
 
+void lbann::FullyConnectedLayer::setup_weight_views() {
+  /// Setup independent views of the weight matrix for the activations and bias terms
+  View(m_activation_weights_v, *m_weights, IR(0, m_weights->Height()), IR(0, m_weights->Width()-1));
+  View(m_bias_weights_v, *m_weights, IR(0, m_weights->Height()), IR(m_weights->Width()-1, m_weights->Width()));
+
+  /// Setup independent views of the weights gradient matrix for the activations and bias terms
+  View(m_activation_weights_gradient_v, *m_weights_gradient, IR(0, m_weights_gradient->Height()), IR(0, m_weights_gradient->Width()-1));
+  View(m_bias_weights_gradient_v, *m_weights_gradient, IR(0, m_weights_gradient->Height()), IR(m_weights_gradient->Width()-1, m_weights_gradient->Width()));
+}
+
 void lbann::FullyConnectedLayer::fp_set_std_matrix_view() {
   int64_t cur_mini_batch_size = neural_network_model->get_current_mini_batch_size();
 
@@ -30,14 +30,63 @@
 #include "lbann/utils/lbann_exception.hpp"
 #include "mpi.h"
 #include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
 
 using namespace std;
 using namespace El;
 
-lbann::lbann_comm::lbann_comm(int _procs_per_model) :
-  procs_per_model(_procs_per_model), num_model_barriers(0),
-  num_intermodel_barriers(0), num_global_barriers(0), bytes_sent(0),
-  bytes_received(0) {
+namespace {
+
+/**
+ * MPI reduction ops for 16-bit payloads: widen both operands to fp32, add,
+ * and round the sum back once.
+ */
+void half_sum(void* in_, void* inout_, int* len, MPI_Datatype*) {
+  const uint16_t* in = (const uint16_t*) in_;
+  uint16_t* inout = (uint16_t*) inout_;
+  for (int i = 0; i < *len; ++i) {
+    inout[i] = lbann::float_to_half(
+      lbann::half_to_float(in[i]) + lbann::half_to_float(inout[i]));
+  }
+}
+
+void bfloat16_sum(void* in_, void* inout_, int* len, MPI_Datatype*) {
+  const uint16_t* in = (const uint16_t*) in_;
+  uint16_t* inout = (uint16_t*) inout_;
+  for (int i = 0; i < *len; ++i) {
+    inout[i] = lbann::float_to_bfloat16(
+      lbann::bfloat16_to_float(in[i]) + lbann::bfloat16_to_float(inout[i]));
+  }
+}
+
+}  // namespace
+
+lbann::lbann_comm::lbann_comm(int _procs_per_model,
+                              rank_placement _placement) :
+  use_hierarchical_allreduce(false),
+  error_signal_compression(intramodel_compression::NONE),
+  gradient_compression(intramodel_compression::NONE),
+  progress_thread_stop(false),
+  procs_per_model(_procs_per_model), placement(_placement),
+  num_model_barriers(0), num_intermodel_barriers(0), num_global_barriers(0),
+  bytes_sent(0), bytes_received(0) {
+
+  payload_prec = payload_precision::FP32;
+  MPI_Type_contiguous(1, MPI_UINT16_T, &payload_type);
+  MPI_Type_commit(&payload_type);
+  MPI_Op_create(half_sum, 1, &half_sum_op);
+  MPI_Op_create(bfloat16_sum, 1, &bfloat16_sum_op);
+
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+  use_shm_allreduce = true;
+  intermodel_node_window = nullptr;
+#endif
+#if LBANN_HAS_RMA_WINDOWS
+  intermodel_rma_window = nullptr;
+#endif
 
   // Initialize parameters
   int world_size = mpi::Size(mpi::COMM_WORLD);
@@ -45,8 +94,6 @@ lbann::lbann_comm::lbann_comm(int _procs_per_model) :
     procs_per_model = world_size;
   }
   num_models = world_size / procs_per_model;
-  model_rank = mpi::Rank(mpi::COMM_WORLD) / procs_per_model;
-  rank_in_model = mpi::Rank(mpi::COMM_WORLD) % procs_per_model;
 
   // Check if parameters are valid
   if (procs_per_model > world_size) {
@@ -64,89 +111,902 @@ lbann::lbann_comm::lbann_comm(int _procs_per_model) :
     throw lbann_exception(err.str());
   }
 
+  // Find the compute nodes and place processes into models
+  setup_node_comm();
+  procs_per_node = mpi::Size(node_comm);
+  rank_in_node = mpi::Rank(node_comm);
+  setup_placement();
+  const int slot = world_rank_slots[mpi::Rank(mpi::COMM_WORLD)];
+  model_rank = slot / procs_per_model;
+  rank_in_model = slot % procs_per_model;
+
   // Initialize model and intermodel communicators
   mpi::Split(mpi::COMM_WORLD, model_rank, rank_in_model, model_comm);
   mpi::Split(mpi::COMM_WORLD, rank_in_model, model_rank, intermodel_comm);
+  // Parameter-server traffic is kept apart from everything else
+  MPI_Comm_dup(mpi::COMM_WORLD.comm, &(ps_comm.comm));
 
   // Initialize Elemental grid
   grid = new Grid(model_comm);
 
-  // Initialize node communicators
-  setup_node_comm();
-  procs_per_node = mpi::Size(node_comm);
-  rank_in_node = mpi::Rank(node_comm);
+  setup_intermodel_node_comms();
   
 }
 
 lbann::lbann_comm::~lbann_comm() {
+  stop_progress_thread();
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+  delete intermodel_node_window;
+#endif
+#if LBANN_HAS_RMA_WINDOWS
+  delete intermodel_rma_window;
+#endif
   delete grid;
+  MPI_Op_free(&half_sum_op);
+  MPI_Op_free(&bfloat16_sum_op);
+  MPI_Type_free(&payload_type);
   mpi::Free(model_comm);
   mpi::Free(intermodel_comm);
+  mpi::Free(node_comm);
+  mpi::Free(intermodel_node_comm);
+  mpi::Free(intermodel_lane_comm);
+  mpi::Free(ps_comm);
 }
 
 void lbann::lbann_comm::intermodel_sum_matrix(Mat& mat) {
+  intermodel_sum_matrix(mat, payload_prec);
+}
+
+void lbann::lbann_comm::intermodel_sum_matrix(DistMat& mat) {
+  intermodel_sum_matrix(mat, payload_prec);
+}
+
+void lbann::lbann_comm::intermodel_sum_matrix(Mat& mat, payload_precision p) {
+  comm_trace_scope trace(tracer, "intermodel_sum_matrix", "intermodel",
+                         sizeof(DataType) * mat.Height() * mat.Width());
+  if (p != payload_precision::FP32) {
+    trace.set_algorithm(payload_precision_name(p));
+    reduced_precision_sum(mat.Buffer(), mat.Height(), mat.Width(), mat.LDim(),
+                          p);
+    return;
+  }
+  if (use_hierarchical_allreduce && mat.LDim() == mat.Height()) {
+    trace.set_algorithm("hierarchical");
+    hierarchical_intermodel_sum(mat.Buffer(), mat.Height() * mat.Width());
+    return;
+  }
   bytes_sent += sizeof(DataType) * mat.Height() * mat.Width();
   AllReduce(mat, intermodel_comm, mpi::SUM);
   bytes_received += sizeof(DataType) * mat.Height() * mat.Width();
 }
 
-void lbann::lbann_comm::intermodel_sum_matrix(DistMat& mat) {
+void lbann::lbann_comm::intermodel_sum_matrix(DistMat& mat,
+                                              payload_precision p) {
+  comm_trace_scope trace(tracer, "intermodel_sum_matrix", "intermodel",
+                         sizeof(DataType) * mat.LocalHeight() *
+                         mat.LocalWidth());
+  if (p != payload_precision::FP32) {
+    trace.set_algorithm(payload_precision_name(p));
+    reduced_precision_sum(mat.Buffer(), mat.LocalHeight(), mat.LocalWidth(),
+                          mat.LDim(), p);
+    return;
+  }
+  if (use_hierarchical_allreduce && mat.LDim() == mat.LocalHeight()) {
+    trace.set_algorithm("hierarchical");
+    hierarchical_intermodel_sum(mat.Buffer(),
+                                mat.LocalHeight() * mat.LocalWidth());
+    return;
+  }
   bytes_sent += sizeof(DataType) * mat.LocalHeight() * mat.LocalWidth();
   AllReduce(mat, intermodel_comm, mpi::SUM);
   bytes_received += sizeof(DataType) * mat.LocalHeight() * mat.LocalWidth();
 }
 
-/*void lbann::lbann_comm::nb_intermodel_sum_matrix(Mat& mat, mpi::Request& req) {
+void lbann::lbann_comm::reduced_precision_sum(DataType* data, Int height,
+                                              Int width, Int ldim,
+                                              payload_precision p) {
+  const Int count = height * width;
+  if (count == 0) {
+    return;
+  }
+  if (payload_buf.size() < (size_t) count) {
+    payload_buf.resize(count);
+  }
+  pack_payload(p, data, height, width, ldim, payload_buf.data());
+  bytes_sent += sizeof(uint16_t) * count;
+  MPI_Allreduce(MPI_IN_PLACE, payload_buf.data(), count, payload_type,
+                p == payload_precision::BF16 ? bfloat16_sum_op : half_sum_op,
+                intermodel_comm.comm);
+  bytes_received += sizeof(uint16_t) * count;
+  unpack_payload(p, payload_buf.data(), height, width, ldim, data);
+}
+
+void lbann::lbann_comm::nb_intermodel_sum_matrix(Mat& mat,
+                                                 mpi::Request<DataType>& req) {
+  // Note: This reaches into the Elemental internals where presently the
+  // underlying MPI_Request is mpi::Request::backend and the MPI communicator
+  // is mpi::Comm::comm.
+  if (mat.LDim() != mat.Height() && mat.Width() > 1) {
+    throw lbann_exception("lbann_comm: non-blocking sums need a contiguous matrix");
+  }
+  comm_trace_scope trace(tracer, "nb_intermodel_sum_matrix", "intermodel",
+                         sizeof(DataType) * mat.Height() * mat.Width());
+  bytes_sent += sizeof(DataType) * mat.Height() * mat.Width();
   MPI_Iallreduce(MPI_IN_PLACE, mat.Buffer(),
                  mat.Height() * mat.Width(), DataTypeMPI, MPI_SUM,
-                 intermodel_comm.comm, &req);
+                 intermodel_comm.comm, &(req.backend));
+  bytes_received += sizeof(DataType) * mat.Height() * mat.Width();
 }
 
 void lbann::lbann_comm::nb_intermodel_sum_matrix(DistMat& mat,
-                                                 mpi::Request& req) {
-  // Note: This reaches into the Elemental internals where presently
-  // mpi::Request is a typedef of MPI_Request and the MPI communicator
-  // is mpi::Comm::comm.
+                                                 mpi::Request<DataType>& req) {
+  if (mat.LDim() != mat.LocalHeight() && mat.LocalWidth() > 1) {
+    throw lbann_exception("lbann_comm: non-blocking sums need a contiguous matrix");
+  }
+  comm_trace_scope trace(tracer, "nb_intermodel_sum_matrix", "intermodel",
+                         sizeof(DataType) * mat.LocalHeight() *
+                         mat.LocalWidth());
+  bytes_sent += sizeof(DataType) * mat.LocalHeight() * mat.LocalWidth();
   MPI_Iallreduce(MPI_IN_PLACE, mat.Buffer(),
                  mat.LocalHeight() * mat.LocalWidth(), DataTypeMPI, MPI_SUM,
-                 intermodel_comm.comm, &req);
-                 }*/
+                 intermodel_comm.comm, &(req.backend));
+  bytes_received += sizeof(DataType) * mat.LocalHeight() * mat.LocalWidth();
+}
+
+void lbann::lbann_comm::intermodel_sum(DataType* data, int count) {
+  comm_trace_scope trace(tracer, "intermodel_sum", "intermodel",
+                         sizeof(DataType) * count);
+  if (use_hierarchical_allreduce) {
+    trace.set_algorithm("hierarchical");
+    hierarchical_intermodel_sum(data, count);
+    return;
+  }
+  bytes_sent += sizeof(DataType) * count;
+  mpi::AllReduce(data, count, mpi::SUM, intermodel_comm);
+  bytes_received += sizeof(DataType) * count;
+}
+
+void lbann::lbann_comm::nb_intermodel_sum(DataType* data, int count,
+                                          mpi::Request<DataType>& req) {
+  comm_trace_scope trace(tracer, "nb_intermodel_sum", "intermodel",
+                         sizeof(DataType) * count);
+  bytes_sent += sizeof(DataType) * count;
+  MPI_Iallreduce(MPI_IN_PLACE, data, count, DataTypeMPI, MPI_SUM,
+                 intermodel_comm.comm, &(req.backend));
+  bytes_received += sizeof(DataType) * count;
+}
+
+void lbann::lbann_comm::hierarchical_intermodel_sum(DataType* data,
+                                                    int count) {
+  const int node_size = mpi::Size(intermodel_node_comm);
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+  if (node_size > 1 && use_shm_allreduce) {
+    shm_hierarchical_intermodel_sum(data, count);
+    return;
+  }
+#endif
+  if (uniform_intermodel_nodes) {
+    // Lanes: each peer in the node owns 1/node_size of the data.
+    const int chunk = (count + node_size - 1) / node_size;
+    hierarchical_send_buf.resize(chunk * node_size);
+    hierarchical_recv_buf.resize(chunk);
+    std::copy(data, data + count, hierarchical_send_buf.begin());
+    std::fill(hierarchical_send_buf.begin() + count,
+              hierarchical_send_buf.end(), DataType(0));
+    if (node_size > 1) {
+      mpi::ReduceScatter(hierarchical_send_buf.data(),
+                         hierarchical_recv_buf.data(), chunk, mpi::SUM,
+                         intermodel_node_comm);
+    } else {
+      std::copy(hierarchical_send_buf.begin(), hierarchical_send_buf.end(),
+                hierarchical_recv_buf.begin());
+    }
+    if (num_intermodel_nodes > 1) {
+      bytes_sent += sizeof(DataType) * chunk;
+      mpi::AllReduce(hierarchical_recv_buf.data(), chunk, mpi::SUM,
+                     intermodel_lane_comm);
+      bytes_received += sizeof(DataType) * chunk;
+    }
+    if (node_size > 1) {
+      mpi::AllGather(hierarchical_recv_buf.data(), chunk,
+                     hierarchical_send_buf.data(), chunk,
+                     intermodel_node_comm);
+    } else {
+      std::copy(hierarchical_recv_buf.begin(), hierarchical_recv_buf.end(),
+                hierarchical_send_buf.begin());
+    }
+    std::copy(hierarchical_send_buf.begin(),
+              hierarchical_send_buf.begin() + count, data);
+  } else {
+    // Leaders: reduce to the node leader, which joins the inter-node sum.
+    if (node_size > 1) {
+      mpi::Reduce(data, count, mpi::SUM, 0, intermodel_node_comm);
+    }
+    if (mpi::Rank(intermodel_node_comm) == 0 && num_intermodel_nodes > 1) {
+      bytes_sent += sizeof(DataType) * count;
+      mpi::AllReduce(data, count, mpi::SUM, intermodel_lane_comm);
+      bytes_received += sizeof(DataType) * count;
+    }
+    if (node_size > 1) {
+      mpi::Broadcast(data, count, 0, intermodel_node_comm);
+    }
+  }
+}
+
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+void lbann::lbann_comm::shm_hierarchical_intermodel_sum(DataType* data,
+                                                        int count) {
+  const int node_size = mpi::Size(intermodel_node_comm);
+  const int node_rank = mpi::Rank(intermodel_node_comm);
+  const int chunk = (count + node_size - 1) / node_size;
+  const size_t slot_bytes = sizeof(DataType) * chunk * node_size;
+  if (intermodel_node_window == nullptr ||
+      intermodel_node_window->get_segment_bytes(node_rank) < slot_bytes) {
+    // Every peer sees the same count, so they all grow the window together.
+    delete intermodel_node_window;
+    intermodel_node_window = new shared_memory_window(intermodel_node_comm.comm,
+                                                      slot_bytes);
+  }
+  shared_memory_window& win = *intermodel_node_window;
+  std::vector<DataType*> slots(node_size);
+  for (int r = 0; r < node_size; ++r) {
+    slots[r] = (DataType*) win.get_segment(r);
+  }
+  std::copy(data, data + count, slots[node_rank]);
+  win.fence();
+  if (uniform_intermodel_nodes) {
+    // Sum this peer's chunk straight out of every peer's slot.
+    const int begin = std::min(count, node_rank * chunk);
+    const int end = std::min(count, begin + chunk);
+    hierarchical_recv_buf.assign(chunk, DataType(0));
+    DataType* sum = hierarchical_recv_buf.data();
+    #pragma omp parallel for
+    for (int i = begin; i < end; ++i) {
+      DataType val = 0;
+      for (int r = 0; r < node_size; ++r) {
+        val += slots[r][i];
+      }
+      sum[i - begin] = val;
+    }
+    if (num_intermodel_nodes > 1) {
+      bytes_sent += sizeof(DataType) * chunk;
+      mpi::AllReduce(sum, chunk, mpi::SUM, intermodel_lane_comm);
+      bytes_received += sizeof(DataType) * chunk;
+    }
+    // Publish the chunk in this peer's slot; nobody else reads that range.
+    std::copy(sum, sum + (end - begin), slots[node_rank] + begin);
+    win.fence();
+    for (int r = 0; r < node_size; ++r) {
+      const int rbegin = std::min(count, r * chunk);
+      const int rend = std::min(count, rbegin + chunk);
+      std::copy(slots[r] + rbegin, slots[r] + rend, data + rbegin);
+    }
+  } else {
+    // The node leader sums every slot into its own and joins the inter-node sum.
+    if (node_rank == 0) {
+      #pragma omp parallel for
+      for (int i = 0; i < count; ++i) {
+        DataType val = slots[0][i];
+        for (int r = 1; r < node_size; ++r) {
+          val += slots[r][i];
+        }
+        slots[0][i] = val;
+      }
+      if (num_intermodel_nodes > 1) {
+        bytes_sent += sizeof(DataType) * count;
+        mpi::AllReduce(slots[0], count, mpi::SUM, intermodel_lane_comm);
+        bytes_received += sizeof(DataType) * count;
+      }
+    }
+    win.fence();
+    std::copy(slots[0], slots[0] + count, data);
+  }
+  // Slots are overwritten by the next call.
+  win.fence();
+}
+
+lbann::shared_memory_window* lbann::lbann_comm::allocate_node_shared(
+  size_t bytes) {
+  return new shared_memory_window(node_comm.comm,
+                                  rank_in_node == 0 ? bytes : 0);
+}
+#endif  // LBANN_HAS_SHARED_MEMORY_WINDOWS
+
+#if LBANN_HAS_RMA_WINDOWS
+void lbann::lbann_comm::setup_rma_window(int count) {
+  if (intermodel_rma_window == nullptr ||
+      intermodel_rma_window->get_count() < (size_t) count) {
+    delete intermodel_rma_window;
+    intermodel_rma_window = new rma_window(intermodel_comm.comm, count);
+  }
+}
+
+void lbann::lbann_comm::rma_intermodel_sum(DataType* data, int count) {
+  if (num_models == 1 || count == 0) {
+    return;
+  }
+  comm_trace_scope trace(tracer, "rma_intermodel_sum", "intermodel",
+                         sizeof(DataType) * count);
+  setup_rma_window(count);
+  rma_window& win = *intermodel_rma_window;
+  DataType* local = win.get_local();
+  const int p = num_models;
+  auto chunk_start = [count, p] (int chunk) {
+    return (int) ((int64_t) count * chunk / p);
+  };
+  auto chunk_size = [&chunk_start] (int chunk) {
+    return chunk_start(chunk + 1) - chunk_start(chunk);
+  };
+  // Epoch 1: seed our window with our own contribution.
+  std::copy(data, data + count, local);
+  win.fence();
+  // Epoch 2: add our part of every other chunk into its owner's window,
+  // starting at different owners to spread the load.
+  for (int step = 1; step < p; ++step) {
+    const int owner = (model_rank + step) % p;
+    if (chunk_size(owner) > 0) {
+      win.accumulate(data + chunk_start(owner), chunk_size(owner), owner,
+                     chunk_start(owner));
+      bytes_sent += sizeof(DataType) * chunk_size(owner);
+    }
+  }
+  win.fence();
+  // Epoch 3: our chunk is summed; put it into everyone else's window.
+  const int own_start = chunk_start(model_rank);
+  const int own_size = chunk_size(model_rank);
+  for (int step = 1; step < p && own_size > 0; ++step) {
+    const int dst = (model_rank + step) % p;
+    win.put(local + own_start, own_size, dst, own_start);
+    bytes_sent += sizeof(DataType) * own_size;
+  }
+  win.fence();
+  std::copy(local, local + count, data);
+  bytes_received += sizeof(DataType) * (own_size * (p - 1) + count - own_size);
+}
+
+void lbann::lbann_comm::rma_intermodel_sum_matrix(Mat& mat) {
+  if (mat.LDim() != mat.Height() && mat.Width() > 1) {
+    throw lbann_exception("lbann_comm: RMA sums need a contiguous matrix");
+  }
+  rma_intermodel_sum(mat.Buffer(), mat.Height() * mat.Width());
+}
+
+void lbann::lbann_comm::rma_intermodel_sum_matrix(DistMat& mat) {
+  if (mat.LDim() != mat.LocalHeight() && mat.LocalWidth() > 1) {
+    throw lbann_exception("lbann_comm: RMA sums need a contiguous matrix");
+  }
+  rma_intermodel_sum(mat.Buffer(), mat.LocalHeight() * mat.LocalWidth());
+}
+
+void lbann::lbann_comm::rma_intermodel_broadcast(DataType* data, int count,
+                                                 int root) {
+  if (num_models == 1 || count == 0) {
+    return;
+  }
+  comm_trace_scope trace(tracer, "rma_intermodel_broadcast", "intermodel",
+                         sizeof(DataType) * count);
+  setup_rma_window(count);
+  rma_window& win = *intermodel_rma_window;
+  // Others may still be reading the results of the last operation.
+  win.fence();
+  if (model_rank == root) {
+    for (int step = 1; step < num_models; ++step) {
+      win.put(data, count, (root + step) % num_models, 0);
+    }
+    bytes_sent += sizeof(DataType) * count * (num_models - 1);
+  }
+  win.fence();
+  if (model_rank != root) {
+    std::copy(win.get_local(), win.get_local() + count, data);
+    bytes_received += sizeof(DataType) * count;
+  }
+}
+
+void lbann::lbann_comm::rma_intermodel_broadcast_matrix(Mat& mat, int root) {
+  if (mat.LDim() != mat.Height() && mat.Width() > 1) {
+    throw lbann_exception("lbann_comm: RMA broadcasts need a contiguous matrix");
+  }
+  rma_intermodel_broadcast(mat.Buffer(), mat.Height() * mat.Width(), root);
+}
+
+void lbann::lbann_comm::rma_intermodel_broadcast_matrix(DistMat& mat,
+                                                       int root) {
+  if (mat.LDim() != mat.LocalHeight() && mat.LocalWidth() > 1) {
+    throw lbann_exception("lbann_comm: RMA broadcasts need a contiguous matrix");
+  }
+  rma_intermodel_broadcast(mat.Buffer(), mat.LocalHeight() * mat.LocalWidth(),
+                           root);
+}
+
+void lbann::lbann_comm::rma_setup(int count) {
+  setup_rma_window(count);
+  std::fill(intermodel_rma_window->get_local(),
+            intermodel_rma_window->get_local() + count, DataType(0));
+  if (rma_zeros.size() < (size_t) count) {
+    rma_zeros.assign(count, DataType(0));
+  }
+  intermodel_rma_window->fence();
+}
+
+void lbann::lbann_comm::rma_accumulate(const DataType* data, int count,
+                                       int model, int offset) {
+  comm_trace_scope trace(tracer, "rma_accumulate", "intermodel",
+                         sizeof(DataType) * count, model);
+  intermodel_rma_window->accumulate(data, count, model, offset);
+  bytes_sent += sizeof(DataType) * count;
+}
+
+void lbann::lbann_comm::rma_put(const DataType* data, int count, int model,
+                                int offset) {
+  comm_trace_scope trace(tracer, "rma_put", "intermodel",
+                         sizeof(DataType) * count, model);
+  intermodel_rma_window->replace(data, count, model, offset);
+  bytes_sent += sizeof(DataType) * count;
+}
+
+void lbann::lbann_comm::rma_get(DataType* data, int count, int model,
+                                int offset) {
+  comm_trace_scope trace(tracer, "rma_get", "intermodel",
+                         sizeof(DataType) * count, model);
+  intermodel_rma_window->get(data, count, model, offset);
+  bytes_received += sizeof(DataType) * count;
+}
+
+void lbann::lbann_comm::rma_flush() {
+  comm_trace_scope trace(tracer, "rma_flush", "intermodel");
+  intermodel_rma_window->flush_all();
+}
+
+void lbann::lbann_comm::rma_drain(DataType* data, int count) {
+  comm_trace_scope trace(tracer, "rma_drain", "intermodel",
+                         sizeof(DataType) * count);
+  // Swap in zeros atomically, so concurrent accumulates land either in what
+  // we take now or in the next drain.
+  intermodel_rma_window->fetch_and_replace(rma_zeros.data(), data, count,
+                                           model_rank, 0);
+  intermodel_rma_window->flush(model_rank);
+}
+
+void lbann::lbann_comm::rma_fence() {
+  comm_trace_scope trace(tracer, "rma_fence", "intermodel");
+  intermodel_rma_window->fence();
+}
+#endif  // LBANN_HAS_RMA_WINDOWS
+
+void lbann::lbann_comm::model_sum_compressed(DataType* data, int count,
+                                             intramodel_compression c) {
+  const int p = procs_per_model;
+  if (p == 1 || count == 0) {
+    return;
+  }
+  comm_trace_scope trace(tracer, "model_sum_compressed", "model",
+                         sizeof(DataType) * count);
+  trace.set_algorithm(intramodel_compression_name(c));
+  if (c == intramodel_compression::NONE) {
+    bytes_sent += sizeof(DataType) * count;
+    mpi::AllReduce(data, count, mpi::SUM, model_comm);
+    bytes_received += sizeof(DataType) * count;
+    return;
+  }
+  const int rank = rank_in_model;
+  const int dst = (rank + 1) % p;
+  const int src = (rank + p - 1) % p;
+  auto chunk_start = [count, p] (int chunk) {
+    return (int) ((int64_t) count * chunk / p);
+  };
+  auto chunk_size = [&chunk_start] (int chunk) {
+    return chunk_start(chunk + 1) - chunk_start(chunk);
+  };
+  const size_t max_bytes = compressed_bytes(c, (count + p - 1) / p);
+  compressed_send_buf.resize(max_bytes);
+  compressed_recv_buf.resize(max_bytes);
+  // Reduce-scatter: after p-1 steps chunk rank+1 is fully summed here.
+  for (int step = 0; step < p - 1; ++step) {
+    const int send_chunk = (rank - step + p) % p;
+    const int recv_chunk = (rank - step - 1 + 2*p) % p;
+    const int send_bytes = compressed_bytes(c, chunk_size(send_chunk));
+    const int recv_bytes = compressed_bytes(c, chunk_size(recv_chunk));
+    compress_values(c, data + chunk_start(send_chunk), chunk_size(send_chunk),
+                    compressed_send_buf.data());
+    mpi::SendRecv(compressed_send_buf.data(), send_bytes, dst,
+                  compressed_recv_buf.data(), recv_bytes, src, model_comm);
+    bytes_sent += send_bytes;
+    bytes_received += recv_bytes;
+    decompress_values(c, compressed_recv_buf.data(), chunk_size(recv_chunk),
+                      data + chunk_start(recv_chunk), true);
+  }
+  // Allgather: compress the summed chunk once and forward it unchanged, so
+  // every process (including this one) decompresses the same bytes.
+  const int own_chunk = (rank + 1) % p;
+  compress_values(c, data + chunk_start(own_chunk), chunk_size(own_chunk),
+                  compressed_send_buf.data());
+  decompress_values(c, compressed_send_buf.data(), chunk_size(own_chunk),
+                    data + chunk_start(own_chunk));
+  for (int step = 0; step < p - 1; ++step) {
+    const int send_chunk = (rank + 1 - step + p) % p;
+    const int recv_chunk = (rank - step + p) % p;
+    const int send_bytes = compressed_bytes(c, chunk_size(send_chunk));
+    const int recv_bytes = compressed_bytes(c, chunk_size(recv_chunk));
+    mpi::SendRecv(compressed_send_buf.data(), send_bytes, dst,
+                  compressed_recv_buf.data(), recv_bytes, src, model_comm);
+    bytes_sent += send_bytes;
+    bytes_received += recv_bytes;
+    decompress_values(c, compressed_recv_buf.data(), chunk_size(recv_chunk),
+                      data + chunk_start(recv_chunk));
+    std::swap(compressed_send_buf, compressed_recv_buf);
+  }
+}
+
+namespace {
+
+/** Whether model_redistribute_compressed handles A's distribution. */
+bool compressible_dist(const ElMat& A) {
+  return (A.ColDist() == El::MC && A.RowDist() == El::MR) ||
+    (A.ColDist() == El::STAR && A.RowDist() == El::VC) ||
+    (A.ColDist() == El::VC && A.RowDist() == El::STAR);
+}
+
+/**
+ * For every local row and column of A, the part of the model rank that owns
+ * the matching global entry of B: entry (iL, jL) of A lives on
+ * row_owner[iL] + col_owner[jL]. This holds for the distributions in
+ * compressible_dist because they tile the (column-major) model grid in VC
+ * order, and a model's VC rank is its rank in the model.
+ */
+void owner_tables(const ElMat& A, const ElMat& B,
+                  std::vector<int>& row_owner, std::vector<int>& col_owner) {
+  row_owner.resize(A.LocalHeight());
+  col_owner.resize(A.LocalWidth());
+  for (El::Int iL = 0; iL < A.LocalHeight(); ++iL) {
+    row_owner[iL] = B.RowOwner(A.GlobalRow(iL));
+  }
+  for (El::Int jL = 0; jL < A.LocalWidth(); ++jL) {
+    col_owner[jL] = B.ColOwner(A.GlobalCol(jL)) * B.ColStride();
+  }
+}
+
+}  // namespace
+
+bool lbann::lbann_comm::model_redistribute_compressed(
+  const ElMat& src, ElMat& dst, intramodel_compression c) {
+  if (c == intramodel_compression::NONE || procs_per_model == 1 ||
+      !compressible_dist(src) || !compressible_dist(dst) ||
+      (src.ColDist() == dst.ColDist() && src.RowDist() == dst.RowDist())) {
+    return false;
+  }
+  comm_trace_scope trace(tracer, "model_redistribute_compressed", "model",
+                         sizeof(DataType) * src.LocalHeight() *
+                         src.LocalWidth());
+  trace.set_algorithm(intramodel_compression_name(c));
+  const int p = procs_per_model;
+  dst.Resize(src.Height(), src.Width());
+  // Both sides visit the entries a pair of processes exchange in
+  // column-major global order, so only the values need to be sent.
+  std::vector<int> send_row, send_col, recv_row, recv_col;
+  owner_tables(src, dst, send_row, send_col);
+  owner_tables(dst, src, recv_row, recv_col);
+  const Mat& src_local = src.LockedMatrix();
+  Mat& dst_local = dst.Matrix();
+  std::vector<int> send_counts(p, 0), recv_counts(p, 0);
+  for (El::Int jL = 0; jL < src_local.Width(); ++jL) {
+    for (El::Int iL = 0; iL < src_local.Height(); ++iL) {
+      ++send_counts[send_row[iL] + send_col[jL]];
+    }
+  }
+  for (El::Int jL = 0; jL < dst_local.Width(); ++jL) {
+    for (El::Int iL = 0; iL < dst_local.Height(); ++iL) {
+      ++recv_counts[recv_row[iL] + recv_col[jL]];
+    }
+  }
+  std::vector<int> send_offsets(p + 1, 0), recv_offsets(p + 1, 0);
+  for (int r = 0; r < p; ++r) {
+    send_offsets[r + 1] = send_offsets[r] + send_counts[r];
+    recv_offsets[r + 1] = recv_offsets[r] + recv_counts[r];
+  }
+  // Pack values by destination.
+  redistribute_send_buf.resize(send_offsets[p]);
+  redistribute_recv_buf.resize(recv_offsets[p]);
+  std::vector<int> next(send_offsets.begin(), send_offsets.end() - 1);
+  for (El::Int jL = 0; jL < src_local.Width(); ++jL) {
+    for (El::Int iL = 0; iL < src_local.Height(); ++iL) {
+      redistribute_send_buf[next[send_row[iL] + send_col[jL]]++] =
+        src_local.Get(iL, jL);
+    }
+  }
+  // Compress everything leaving this process; what stays is copied.
+  std::vector<int> send_bytes(p, 0), recv_bytes(p, 0);
+  std::vector<int> send_displs(p, 0), recv_displs(p, 0);
+  size_t total_send = 0, total_recv = 0;
+  for (int r = 0; r < p; ++r) {
+    if (r != rank_in_model) {
+      send_bytes[r] = compressed_bytes(c, send_counts[r]);
+      recv_bytes[r] = compressed_bytes(c, recv_counts[r]);
+    }
+    send_displs[r] = total_send;
+    recv_displs[r] = total_recv;
+    total_send += send_bytes[r];
+    total_recv += recv_bytes[r];
+  }
+  compressed_send_buf.resize(std::max(total_send, (size_t) 1));
+  compressed_recv_buf.resize(std::max(total_recv, (size_t) 1));
+  for (int r = 0; r < p; ++r) {
+    if (r != rank_in_model) {
+      compress_values(c, redistribute_send_buf.data() + send_offsets[r],
+                      send_counts[r],
+                      compressed_send_buf.data() + send_displs[r]);
+    }
+  }
+  mpi::AllToAll(compressed_send_buf.data(), send_bytes.data(),
+                send_displs.data(), compressed_recv_buf.data(),
+                recv_bytes.data(), recv_displs.data(), model_comm);
+  bytes_sent += total_send;
+  bytes_received += total_recv;
+  for (int r = 0; r < p; ++r) {
+    if (r == rank_in_model) {
+      std::copy(redistribute_send_buf.data() + send_offsets[r],
+                redistribute_send_buf.data() + send_offsets[r + 1],
+                redistribute_recv_buf.data() + recv_offsets[r]);
+    } else {
+      decompress_values(c, compressed_recv_buf.data() + recv_displs[r],
+                        recv_counts[r],
+                        redistribute_recv_buf.data() + recv_offsets[r]);
+    }
+  }
+  // Unpack in the same order.
+  std::copy(recv_offsets.begin(), recv_offsets.end() - 1, next.begin());
+  for (El::Int jL = 0; jL < dst_local.Width(); ++jL) {
+    for (El::Int iL = 0; iL < dst_local.Height(); ++iL) {
+      dst_local.Set(iL, jL,
+                    redistribute_recv_buf[next[recv_row[iL] + recv_col[jL]]++]);
+    }
+  }
+  return true;
+}
 
 void lbann::lbann_comm::intermodel_broadcast_matrix(Mat& mat, int root) {
-  Broadcast(mat, intermodel_comm, root);
+  intermodel_broadcast_matrix(mat, root, payload_prec);
 }
 
 void lbann::lbann_comm::intermodel_broadcast_matrix(DistMat& mat, int root) {
+  intermodel_broadcast_matrix(mat, root, payload_prec);
+}
+
+void lbann::lbann_comm::intermodel_broadcast_matrix(Mat& mat, int root,
+                                                    payload_precision p) {
+  comm_trace_scope trace(tracer, "intermodel_broadcast_matrix", "intermodel",
+                         sizeof(DataType) * mat.Height() * mat.Width());
+  if (p != payload_precision::FP32) {
+    trace.set_algorithm(payload_precision_name(p));
+    reduced_precision_broadcast(mat.Buffer(), mat.Height(), mat.Width(),
+                                mat.LDim(), root, p);
+    return;
+  }
+  if (model_rank == root) {
+    bytes_sent += sizeof(DataType) * mat.Height() * mat.Width();
+  } else {
+    bytes_received += sizeof(DataType) * mat.Height() * mat.Width();
+  }
   Broadcast(mat, intermodel_comm, root);
 }
 
-/*void lbann::lbann_comm::nb_intermodel_broadcast_matrix(Mat& mat, int root,
-                                                       mpi::Request& req) {
+void lbann::lbann_comm::intermodel_broadcast_matrix(DistMat& mat, int root,
+                                                    payload_precision p) {
+  comm_trace_scope trace(tracer, "intermodel_broadcast_matrix", "intermodel",
+                         sizeof(DataType) * mat.LocalHeight() *
+                         mat.LocalWidth());
+  if (p != payload_precision::FP32) {
+    trace.set_algorithm(payload_precision_name(p));
+    reduced_precision_broadcast(mat.Buffer(), mat.LocalHeight(),
+                                mat.LocalWidth(), mat.LDim(), root, p);
+    return;
+  }
+  if (model_rank == root) {
+    bytes_sent += sizeof(DataType) * mat.LocalHeight() * mat.LocalWidth();
+  } else {
+    bytes_received += sizeof(DataType) * mat.LocalHeight() * mat.LocalWidth();
+  }
+  Broadcast(mat, intermodel_comm, root);
+}
+
+void lbann::lbann_comm::reduced_precision_broadcast(DataType* data,
+                                                    Int height, Int width,
+                                                    Int ldim, int root,
+                                                    payload_precision p) {
+  const Int count = height * width;
+  if (count == 0) {
+    return;
+  }
+  if (payload_buf.size() < (size_t) count) {
+    payload_buf.resize(count);
+  }
+  if (model_rank == root) {
+    pack_payload(p, data, height, width, ldim, payload_buf.data());
+    bytes_sent += sizeof(uint16_t) * count;
+  } else {
+    bytes_received += sizeof(uint16_t) * count;
+  }
+  MPI_Bcast(payload_buf.data(), count, payload_type, root,
+            intermodel_comm.comm);
+  // The root unpacks too, so it keeps the same rounded values as the others.
+  unpack_payload(p, payload_buf.data(), height, width, ldim, data);
+}
+
+size_t lbann::lbann_comm::intermodel_broadcast_compressed(
+  DataType* data, size_t count, int root, size_t chunk_count) {
+  const int p = num_models;
+  if (p == 1 || count == 0) {
+    return 0;
+  }
+  comm_trace_scope trace(tracer, "intermodel_broadcast_compressed",
+                         "intermodel", sizeof(DataType) * count);
+  trace.set_algorithm("tree");
+  // MPI counts are ints, so split chunks whose compressed bytes might not
+  // fit in one. Every model clamps the same way, so the chunks still match.
+  const size_t max_chunk_count =
+    (std::numeric_limits<int>::max() - lossless_compress_bound(0)) /
+    sizeof(DataType);
+  chunk_count = std::max(std::min(std::min(chunk_count, count),
+                                  max_chunk_count), (size_t) 1);
+  const size_t num_chunks = (count + chunk_count - 1) / chunk_count;
+  // Binary tree over model ranks relative to the root.
+  const int vrank = (model_rank - root + p) % p;
+  const int parent = vrank == 0 ? -1 : ((vrank - 1) / 2 + root) % p;
+  std::vector<int> children;
+  for (int child = 2*vrank + 1; child <= 2*vrank + 2 && child < p; ++child) {
+    children.push_back((child + root) % p);
+  }
+  // Each slot holds one chunk's compressed bytes until its sends complete.
+  const size_t slot_bytes = lossless_compress_bound(chunk_count);
+  broadcast_buf.resize(BROADCAST_SLOTS * slot_bytes);
+  std::vector<MPI_Request> send_reqs(BROADCAST_SLOTS * 2, MPI_REQUEST_NULL);
+  MPI_Request recv_req = MPI_REQUEST_NULL;
+  auto slot_data = [&] (size_t chunk) {
+    return broadcast_buf.data() + (chunk % BROADCAST_SLOTS) * slot_bytes;
+  };
+  auto wait_slot = [&] (size_t chunk) {
+    MPI_Waitall(2, send_reqs.data() + (chunk % BROADCAST_SLOTS) * 2,
+                MPI_STATUSES_IGNORE);
+  };
+  auto post_recv = [&] (size_t chunk) {
+    wait_slot(chunk);
+    MPI_Irecv(slot_data(chunk), slot_bytes, MPI_BYTE, parent, BROADCAST_TAG,
+              intermodel_comm.comm, &recv_req);
+  };
+  size_t total_bytes = 0;
+  if (parent >= 0) {
+    post_recv(0);
+  }
+  for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+    DataType* chunk_data = data + chunk * chunk_count;
+    const size_t chunk_size = std::min(chunk_count, count - chunk*chunk_count);
+    unsigned char* buf = slot_data(chunk);
+    int bytes;
+    if (parent < 0) {
+      wait_slot(chunk);
+      bytes = lossless_compress(chunk_data, chunk_size, buf);
+    } else {
+      MPI_Status status;
+      MPI_Wait(&recv_req, &status);
+      MPI_Get_count(&status, MPI_BYTE, &bytes);
+      bytes_received += bytes;
+      // Start receiving the next chunk before forwarding and decompressing.
+      if (chunk + 1 < num_chunks) {
+        post_recv(chunk + 1);
+      }
+    }
+    MPI_Request* reqs = send_reqs.data() + (chunk % BROADCAST_SLOTS) * 2;
+    for (size_t i = 0; i < children.size(); ++i) {
+      MPI_Isend(buf, bytes, MPI_BYTE, children[i], BROADCAST_TAG,
+                intermodel_comm.comm, &reqs[i]);
+      bytes_sent += bytes;
+    }
+    if (parent >= 0) {
+      lossless_decompress(buf, bytes, chunk_size, chunk_data);
+    }
+    total_bytes += bytes;
+  }
+  MPI_Waitall(send_reqs.size(), send_reqs.data(), MPI_STATUSES_IGNORE);
+  return total_bytes;
+}
+
+void lbann::lbann_comm::nb_intermodel_broadcast_matrix(
+  Mat& mat, int root, mpi::Request<DataType>& req) {
+  if (mat.LDim() != mat.Height() && mat.Width() > 1) {
+    throw lbann_exception("lbann_comm: non-blocking broadcasts need a contiguous matrix");
+  }
+  comm_trace_scope trace(tracer, "nb_intermodel_broadcast_matrix",
+                         "intermodel",
+                         sizeof(DataType) * mat.Height() * mat.Width());
+  if (model_rank == root) {
+    bytes_sent += sizeof(DataType) * mat.Height() * mat.Width();
+  } else {
+    bytes_received += sizeof(DataType) * mat.Height() * mat.Width();
+  }
   MPI_Ibcast(mat.Buffer(), mat.Height() * mat.Width(), DataTypeMPI, root,
-             intermodel_comm.comm, &req);
+             intermodel_comm.comm, &(req.backend));
 }
 
-void lbann::lbann_comm::nb_intermodel_broadcast_matrix(DistMat& mat, int root,
-                                                       mpi::Request& req) {
+void lbann::lbann_comm::nb_intermodel_broadcast_matrix(
+  DistMat& mat, int root, mpi::Request<DataType>& req) {
+  if (mat.LDim() != mat.LocalHeight() && mat.LocalWidth() > 1) {
+    throw lbann_exception("lbann_comm: non-blocking broadcasts need a contiguous matrix");
+  }
+  comm_trace_scope trace(tracer, "nb_intermodel_broadcast_matrix",
+                         "intermodel",
+                         sizeof(DataType) * mat.LocalHeight() *
+                         mat.LocalWidth());
+  if (model_rank == root) {
+    bytes_sent += sizeof(DataType) * mat.LocalHeight() * mat.LocalWidth();
+  } else {
+    bytes_received += sizeof(DataType) * mat.LocalHeight() * mat.LocalWidth();
+  }
   MPI_Ibcast(mat.Buffer(), mat.LocalHeight() * mat.LocalWidth(), DataTypeMPI,
-             root, intermodel_comm.comm, &req);
-             }*/
+             root, intermodel_comm.comm, &(req.backend));
+}
+
+bool lbann::lbann_comm::start_progress_thread(int interval_us) {
+  if (progress_thread.joinable()) {
+    return true;
+  }
+  int provided;
+  MPI_Query_thread(&provided);
+  if (provided != MPI_THREAD_MULTIPLE) {
+    return false;
+  }
+  progress_thread_stop = false;
+  progress_thread = std::thread([this, interval_us] () {
+      // Probing on a communicator nobody sends on enters the progress engine
+      // without matching any of the application's messages.
+      while (!progress_thread_stop) {
+        int flag;
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_SELF, &flag,
+                   MPI_STATUS_IGNORE);
+        std::this_thread::sleep_for(std::chrono::microseconds(interval_us));
+      }
+    });
+  return true;
+}
+
+void lbann::lbann_comm::stop_progress_thread() {
+  if (progress_thread.joinable()) {
+    progress_thread_stop = true;
+    progress_thread.join();
+  }
+}
 
 void lbann::lbann_comm::intermodel_barrier() {
+  comm_trace_scope trace(tracer, "barrier", "intermodel");
   ++num_intermodel_barriers;
   mpi::Barrier(intermodel_comm);
 }
 
 void lbann::lbann_comm::model_barrier() {
+  comm_trace_scope trace(tracer, "barrier", "model");
   ++num_model_barriers;
   mpi::Barrier(model_comm);
 }
 
 void lbann::lbann_comm::global_barrier() {
+  comm_trace_scope trace(tracer, "barrier", "world");
   ++num_global_barriers;
   mpi::Barrier(mpi::COMM_WORLD);
 }
 
+void lbann::lbann_comm::enable_tracing(size_t max_events) {
+  // Line the traces up at a common starting point.
+  mpi::Barrier(mpi::COMM_WORLD);
+  tracer.enable(max_events);
+}
+
+void lbann::lbann_comm::write_trace(const std::string& prefix) const {
+  const int rank = get_rank_in_world();
+  stringstream name;
+  name << "rank " << rank << " (model " << model_rank << ", rank "
+       << rank_in_model << ")";
+  tracer.write_chrome_trace(prefix + "." + std::to_string(rank) + ".json",
+                            rank, name.str());
+}
+
 void lbann::lbann_comm::send(Mat& mat, int model, int rank) {
   send(mat.Buffer(), mat.Height() * mat.Width(), model, rank);
 }
@@ -181,6 +1041,18 @@ void lbann::lbann_comm::recv(DistMat& mat) {
   recv(mat.Buffer(), mat.LocalHeight() * mat.LocalWidth());
 }
 
+bool lbann::lbann_comm::ps_probe_any(int& model, int& rank) {
+  int flag;
+  MPI_Status status;
+  MPI_Iprobe(MPI_ANY_SOURCE, PS_TAG, ps_comm.comm, &flag, &status);
+  if (flag) {
+    const int slot = world_rank_slots[status.MPI_SOURCE];
+    model = slot / procs_per_model;
+    rank = slot % procs_per_model;
+  }
+  return flag;
+}
+
 void lbann::lbann_comm::nb_recv(Mat& mat, int model, int rank,
                                 mpi::Request<DataType>& req) {
   nb_recv(mat.Buffer(), mat.Height() * mat.Width(), model, rank, req);
@@ -210,6 +1082,13 @@ void lbann::lbann_comm::broadcast(DistMat& mat,
 }
 
 void lbann::lbann_comm::setup_node_comm() {
+
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+  // Processes that can share memory are exactly the compute node
+  MPI_Comm_split_type(mpi::COMM_WORLD.comm, MPI_COMM_TYPE_SHARED,
+                      mpi::Rank(mpi::COMM_WORLD), MPI_INFO_NULL,
+                      &(node_comm.comm));
+#else
  
   // Get string specifying compute node
   char node_name[MPI_MAX_PROCESSOR_NAME];
@@ -233,5 +1112,144 @@ void lbann::lbann_comm::setup_node_comm() {
   node_string += node_name;
   hash = std::hash<std::string>()(node_string);
   mpi::Split(hash_comm, hash, mpi::Rank(mpi::COMM_WORLD), node_comm);
+  mpi::Free(hash_comm);
+#endif  // LBANN_HAS_SHARED_MEMORY_WINDOWS
+
+}
+
+void lbann::lbann_comm::setup_placement() {
+
+  // Identify each node by the world rank of its first process; nodes are
+  // numbered in order of those ranks
+  const int world_size = mpi::Size(mpi::COMM_WORLD);
+  int node_leader = mpi::Rank(mpi::COMM_WORLD);
+  mpi::Broadcast(&node_leader, 1, 0, node_comm);
+  std::vector<int> leaders(world_size);
+  mpi::AllGather(&node_leader, 1, leaders.data(), 1, mpi::COMM_WORLD);
+  world_rank_nodes.assign(world_size, -1);
+  num_nodes = 0;
+  for (int r = 0; r < world_size; ++r) {
+    // A node's leader is its lowest rank, so it is numbered first.
+    world_rank_nodes[r] = leaders[r] == r ? num_nodes++ :
+      world_rank_nodes[leaders[r]];
+  }
+
+  // Order the processes: by world rank, or by node then world rank
+  std::vector<int> order(world_size);
+  for (int r = 0; r < world_size; ++r) {
+    order[r] = r;
+  }
+  if (placement != rank_placement::CONTIGUOUS) {
+    std::stable_sort(order.begin(), order.end(),
+                     [this] (int a, int b) {
+                       return world_rank_nodes[a] < world_rank_nodes[b];
+                     });
+  }
+
+  // Assign the i'th process in order to a (model, rank in model) slot
+  placed_world_ranks.assign(world_size, -1);
+  world_rank_slots.assign(world_size, -1);
+  for (int i = 0; i < world_size; ++i) {
+    int slot = i;
+    if (placement == rank_placement::STRIPED) {
+      slot = (i % num_models) * procs_per_model + i / num_models;
+    }
+    placed_world_ranks[slot] = order[i];
+    world_rank_slots[order[i]] = slot;
+  }
+
+}
+
+void lbann::lbann_comm::print_placement_report(std::ostream& os) const {
+  // For each ring (a model, or the peers with one rank in model), count the
+  // nodes it spans and the neighbour links that stay within a node.
+  auto ring_stats = [this] (int num_rings, int ring_size,
+                            std::function<int(int, int)> member,
+                            double& avg_nodes, int& max_nodes,
+                            int& local_links, int& links) {
+    avg_nodes = 0.0;
+    max_nodes = 0;
+    local_links = 0;
+    links = 0;
+    for (int ring = 0; ring < num_rings; ++ring) {
+      std::vector<int> nodes;
+      for (int i = 0; i < ring_size; ++i) {
+        const int node = world_rank_nodes[member(ring, i)];
+        if (std::find(nodes.begin(), nodes.end(), node) == nodes.end()) {
+          nodes.push_back(node);
+        }
+        if (ring_size > 1) {
+          ++links;
+          if (node == world_rank_nodes[member(ring, (i + 1) % ring_size)]) {
+            ++local_links;
+          }
+        }
+      }
+      avg_nodes += nodes.size();
+      max_nodes = std::max(max_nodes, (int) nodes.size());
+    }
+    avg_nodes /= num_rings;
+  };
+  auto print_stats = [&os] (const char* name, double avg_nodes,
+                            int max_nodes, int local_links, int links) {
+    os << "  " << name << ": " << avg_nodes << " nodes on average (max "
+       << max_nodes << "); ";
+    if (links == 0) {
+      os << "no ring traffic" << endl;
+    } else {
+      os << local_links << "/" << links << " ring links within a node ("
+         << 100.0 * local_links / links << "% of ring traffic intra-node, "
+         << 100.0 * (links - local_links) / links << "% inter-node)" << endl;
+    }
+  };
+  double avg_nodes;
+  int max_nodes, local_links, links;
+  os << "Rank placement: " << rank_placement_name(placement) << " ("
+     << num_models << " models of " << procs_per_model << " processes on "
+     << num_nodes << " nodes)" << endl;
+  ring_stats(num_models, procs_per_model,
+             [this] (int model, int i) { return get_world_rank(model, i); },
+             avg_nodes, max_nodes, local_links, links);
+  print_stats("Model communicators", avg_nodes, max_nodes, local_links,
+              links);
+  ring_stats(procs_per_model, num_models,
+             [this] (int rank, int i) { return get_world_rank(i, rank); },
+             avg_nodes, max_nodes, local_links, links);
+  print_stats("Inter-model communicators", avg_nodes, max_nodes, local_links,
+              links);
+}
+
+const char* lbann::rank_placement_name(rank_placement p) {
+  switch (p) {
+  case rank_placement::PACKED: return "packed";
+  case rank_placement::STRIPED: return "striped";
+  default: return "contiguous";
+  }
+}
+
+void lbann::lbann_comm::setup_intermodel_node_comms() {
+
+  // Group inter-model peers by node, then by position within the node
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+  MPI_Comm_split_type(intermodel_comm.comm, MPI_COMM_TYPE_SHARED, model_rank,
+                      MPI_INFO_NULL, &(intermodel_node_comm.comm));
+#else
+  // Identify the node by the world rank of its first process
+  int node_id = mpi::Rank(mpi::COMM_WORLD);
+  mpi::Broadcast(&node_id, 1, 0, node_comm);
+  mpi::Split(intermodel_comm, node_id, model_rank, intermodel_node_comm);
+#endif
+  const int lane = mpi::Rank(intermodel_node_comm);
+  mpi::Split(intermodel_comm, lane, model_rank, intermodel_lane_comm);
+
+  // Lane 0 has one member per node
+  int leaders = lane == 0 ? mpi::Size(intermodel_lane_comm) : 0;
+  num_intermodel_nodes = mpi::AllReduce(leaders, mpi::MAX, intermodel_comm);
+
+  // Lanes are only usable when every node has the same number of peers
+  const int node_size = mpi::Size(intermodel_node_comm);
+  const int min_size = mpi::AllReduce(node_size, mpi::MIN, intermodel_comm);
+  const int max_size = mpi::AllReduce(node_size, mpi::MAX, intermodel_comm);
+  uniform_intermodel_nodes = min_size == max_size;
 
 }
@@ -42,7 +42,16 @@ lbann::TrainingParams::TrainingParams(void)
     CkptEpochs(0), CkptSteps(0), CkptSecs(0.0),
     TrainFile(" "), TestFile(" "), SummaryDir("."), DumpWeights(false), DumpActivations(false),
     DumpGradients(false), DumpDir("."), IntermodelCommMethod(0),
-    ProcsPerModel(0) {
+    ProcsPerModel(0), RankPlacement(0), FlatParams(false),
+    ShardOptimizer(false), OptimizerStateBits(32),
+    OverlapImcomm(false), ImcommBucketSize(0),
+    HierarchicalAllreduce(false), AllreduceAlgorithm(0),
+    AutotuneAllreduce(false), AsyncProgress(false), RingSegmentSize(0),
+    TopKProportion(64), QSGDBits(4),
+    ErrorSignalCompression(0), GradientCompression(0), PayloadPrecision(0),
+    LocalSGDSteps(0), LocalSGDMaxSteps(0),
+    AsyncStaleness(-1), GossipTopology(-1), CommTrace(""),
+    BroadcastModel(false) {
 }
 
 void lbann::TrainingParams::parse_params(void) {
@@ -61,7 +70,7 @@ void lbann::TrainingParams::parse_params(void) {
   MBSize = Input("--mb-size", "Size of the mini-batch to be trained", MBSize);
 
   LearnRate = Input("--learning-rate", "How much of the gradient update is applied to the weight matrix", LearnRate);
-  LearnRateMethod = Input("--learning-rate-method", "1 - Adagrad, 2 - RMSprop, 3 - Adam", LearnRateMethod);
+  LearnRateMethod = Input("--learning-rate-method", "1 - Adagrad, 2 - RMSprop, 3 - Adam, 5 - LARS, 6 - LAMB", LearnRateMethod);
   LrDecayRate = Input("--lr-decay-rate", "How much does the learning rate decay when it decays", LrDecayRate);
   LrDecayCycles = Input("--lr-decay-cycle", "How often does the learning rate decay", LrDecayCycles);
   ActivationType = static_cast<activation_type>(Input("--activation-type", "1 - Sigmoid, 2 - Tanh, 3 - reLU, 4 - id", static_cast<int>(ActivationType)));
@@ -92,6 +101,80 @@ void lbann::TrainingParams::parse_params(void) {
   ProcsPerModel = Input("--procs-per-model",
                         "Number of processes per model (0 = one model)",
                         ProcsPerModel);
+  RankPlacement = Input("--rank-placement",
+                        "Placement of processes into models (0 = contiguous, "
+                        "1 = packed by node, 2 = striped across models)",
+                        RankPlacement);
+  FlatParams = Input("--flat-params",
+                     "Pack layer parameters into one contiguous buffer",
+                     FlatParams);
+  ShardOptimizer = Input("--shard-optimizer",
+                         "Shard optimizer state across models (implies --flat-params)",
+                         ShardOptimizer);
+  OptimizerStateBits = Input("--optimizer-state-bits",
+                             "Bits per optimizer state entry (32, 16, or 8)",
+                             OptimizerStateBits);
+  OverlapImcomm = Input("--overlap-imcomm",
+                        "Overlap inter-model gradient reduction with backprop",
+                        OverlapImcomm);
+  ImcommBucketSize = Input("--imcomm-bucket-size",
+                           "Maximum bytes per fused gradient bucket (0 = no bucketing)",
+                           ImcommBucketSize);
+  HierarchicalAllreduce = Input("--hierarchical-allreduce",
+                                "Use a node-aware allreduce for inter-model sums",
+                                HierarchicalAllreduce);
+  AllreduceAlgorithm = Input("--allreduce-algorithm",
+                             "Custom allreduce algorithm (0 = auto, 1 = ring, "
+                             "2 = recursive doubling, 3 = Rabenseifner)",
+                             AllreduceAlgorithm);
+  AutotuneAllreduce = Input("--autotune-allreduce",
+                            "Time the custom allreduce algorithms at startup",
+                            AutotuneAllreduce);
+  AsyncProgress = Input("--async-progress",
+                        "Drive MPI progress from a helper thread",
+                        AsyncProgress);
+  RingSegmentSize = Input("--ring-segment-size",
+                          "Bytes per segment of the pipelined quantized "
+                          "reduce-scatter (0 = off)",
+                          RingSegmentSize);
+  TopKProportion = Input("--topk-proportion",
+                         "Keep one in this many gradient entries with top-k "
+                         "sparsification",
+                         TopKProportion);
+  QSGDBits = Input("--qsgd-bits",
+                   "Bits per entry for QSGD quantization (2, 4 or 8)",
+                   QSGDBits);
+  ErrorSignalCompression = Input("--error-signal-compression",
+                                 "Compress error signals moved within a model "
+                                 "(0 = none, 1 = fp16, 2 = 8-bit block-scaled)",
+                                 ErrorSignalCompression);
+  GradientCompression = Input("--gradient-compression",
+                              "Compress gradient sums within a model "
+                              "(0 = none, 1 = fp16, 2 = 8-bit block-scaled)",
+                              GradientCompression);
+  PayloadPrecision = Input("--payload-precision",
+                           "Wire precision of inter-model sums and broadcasts "
+                           "(0 = fp32, 1 = fp16, 2 = bf16)",
+                           PayloadPrecision);
+  LocalSGDSteps = Input("--local-sgd-steps",
+                        "Local steps between model averages (0 = sum gradients every step)",
+                        LocalSGDSteps);
+  LocalSGDMaxSteps = Input("--local-sgd-max-steps",
+                           "Adapt local steps up to this many (0 = fixed)",
+                           LocalSGDMaxSteps);
+  AsyncStaleness = Input("--async-staleness",
+                         "Train asynchronously with a parameter server, at most this many steps stale (-1 = synchronous)",
+                         AsyncStaleness);
+  GossipTopology = Input("--gossip",
+                         "Average with neighbours instead of all models (-1 = off, 0 = ring, 1 = random)",
+                         GossipTopology);
+  CommTrace = Input("--comm-trace",
+                    "Write per-rank Chrome traces of communication to "
+                    "<prefix>.<rank>.json",
+                    CommTrace);
+  BroadcastModel = Input("--broadcast-model",
+                         "Broadcast model 0's initial weights to the other models",
+                         BroadcastModel);
 }
 
 lbann::PerformanceParams::PerformanceParams(void) : BlockSize(256), MaxParIOSize(0) {}
@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_flat_params .hpp .cpp - Contiguous per-model parameter buffers
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/models/lbann_flat_params.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+#include <algorithm>
+
+namespace lbann {
+
+flat_params::flat_params(lbann_comm* comm, Optimizer_factory* optimizer_fac,
+                         bool sharded) :
+  comm(comm), m_optimizer_fac(optimizer_fac), m_optimizer(nullptr),
+  m_weights(comm->get_model_grid()), m_gradients(comm->get_model_grid()),
+  m_local_size(0), m_sharded(sharded), m_shard_size(0),
+  m_shard_weights(comm->get_model_grid()),
+  m_shard_gradients(comm->get_model_grid()) {}
+
+flat_params::~flat_params() {
+  if (m_optimizer != nullptr) {
+    delete m_optimizer;
+  }
+}
+
+bool flat_params::can_flatten(Layer* layer) const {
+  if (layer->optimizer == nullptr) {
+    return false;
+  }
+  // Other layers do more than an optimizer step in update().
+  if (layer->m_type != layer_type::fully_connected &&
+      layer->m_type != layer_type::softmax) {
+    return false;
+  }
+  return dynamic_cast<DistMat*>(layer->m_weights) != nullptr &&
+    dynamic_cast<DistMat*>(layer->m_weights_gradient) != nullptr;
+}
+
+El::Int flat_params::attach_to_buffer(ElMat& mat, DataType* buf) {
+  const El::Int local_height = mat.LocalHeight();
+  const El::Int local_width = mat.LocalWidth();
+  const El::Int ldim = std::max(local_height, El::Int(1));
+  Mat slice;
+  slice.Attach(local_height, local_width, buf, ldim);
+  El::Copy(mat.LockedMatrix(), slice);
+  mat.Attach(mat.Height(), mat.Width(), mat.Grid(), mat.ColAlign(),
+             mat.RowAlign(), buf, ldim, mat.Root());
+  return local_height * local_width;
+}
+
+void flat_params::setup(std::vector<Layer*>& layers) {
+  if (m_optimizer_fac == nullptr) {
+    throw lbann_exception("flat_params: no optimizer factory");
+  }
+  m_local_size = 0;
+  for (Layer* layer : layers) {
+    if (can_flatten(layer)) {
+      m_layers.push_back(layer);
+      m_flattened.insert(layer);
+      m_local_size += layer->m_weights->LocalHeight() *
+        layer->m_weights->LocalWidth();
+      // The flat optimizer keeps the state; the layer's optimizer is only
+      // kept for its learning rate.
+      layer->optimizer->free_state();
+    }
+  }
+  // Every process's slice is padded to the longest one in the model so the
+  // flat buffers can be viewed as a [STAR,VC] matrix. Padding stays zero.
+  // When sharding, it is also padded to a multiple of the number of models.
+  const El::Int num_shards = m_sharded ? comm->get_num_models() : 1;
+  const El::Int max_local_size = std::max(
+    comm->model_allreduce(m_local_size, mpi::MAX), El::Int(1));
+  m_shard_size = (max_local_size + num_shards - 1) / num_shards;
+  const El::Int height = m_shard_size * num_shards;
+  El::Zeros(m_local_weights, height, 1);
+  El::Zeros(m_local_gradients, height, 1);
+  El::Int offset = 0;
+  for (Layer* layer : m_layers) {
+    attach_to_buffer(*(layer->m_weights), m_local_weights.Buffer() + offset);
+    offset += attach_to_buffer(*(layer->m_weights_gradient),
+                               m_local_gradients.Buffer() + offset);
+    layer->setup_weight_views();
+  }
+  // One column per process; with width equal to the grid size, the process
+  // with VC rank r owns exactly column r.
+  const Grid& grid = comm->get_model_grid();
+  m_weights.Attach(height, grid.Size(), grid, 0, 0,
+                   m_local_weights.Buffer(), m_local_weights.LDim());
+  m_gradients.Attach(height, grid.Size(), grid, 0, 0,
+                     m_local_gradients.Buffer(), m_local_gradients.LDim());
+  m_optimizer = m_optimizer_fac->create_optimizer(matrix_format::STAR_VC);
+  if (m_sharded) {
+    // This model's shard of the weights is updated in place; the summed
+    // gradients for it land in a separate buffer.
+    El::Zeros(m_local_shard_gradients, m_shard_size, 1);
+    m_shard_weights.Attach(m_shard_size, grid.Size(), grid, 0, 0,
+                           m_local_weights.Buffer() +
+                           comm->get_model_rank() * m_shard_size,
+                           m_shard_size);
+    m_shard_gradients.Attach(m_shard_size, grid.Size(), grid, 0, 0,
+                             m_local_shard_gradients.Buffer(),
+                             m_local_shard_gradients.LDim());
+    m_optimizer->setup(grid.Size(), m_shard_size);
+  } else {
+    m_optimizer->setup(grid.Size(), height);
+  }
+  if (comm->am_world_master()) {
+    std::cout << "Flattened " << m_layers.size() << " layers into a " <<
+      height << "x" << grid.Size() << " parameter buffer";
+    if (m_sharded) {
+      std::cout << " with optimizer state sharded " << num_shards << " ways";
+    }
+    std::cout << std::endl;
+  }
+}
+
+void flat_params::update() {
+  if (m_layers.empty()) {
+    return;
+  }
+  // Follow any learning rate changes made to the layers' optimizers.
+  const float lr = m_layers.front()->get_optimizer()->get_learning_rate();
+  for (Layer* layer : m_layers) {
+    if (layer->get_optimizer()->get_learning_rate() != lr) {
+      throw lbann_exception(
+        "flat_params: flattened layers must share one learning rate");
+    }
+  }
+  m_optimizer->set_learning_rate(lr);
+  if (!m_sharded) {
+    m_optimizer->update_weight_bias_matrix(m_gradients, m_weights);
+    return;
+  }
+  // Sum this model's shard of the gradients over all models.
+  DataType* shard_buf = m_local_shard_gradients.Buffer();
+  comm->intermodel_reduce_scatter(m_local_gradients.LockedBuffer(), shard_buf,
+                                  m_shard_size);
+  m_optimizer->update_weight_bias_matrix(m_shard_gradients, m_shard_weights);
+  // Share the updated shard. The shard gradients are no longer needed, so
+  // use them as the send buffer (send and receive buffers may not overlap).
+  const DataType* shard_weights = m_local_weights.LockedBuffer() +
+    comm->get_model_rank() * m_shard_size;
+  std::copy(shard_weights, shard_weights + m_shard_size, shard_buf);
+  comm->intermodel_allgather(shard_buf, m_local_weights.Buffer(),
+                             m_shard_size);
+}
+
+bool flat_params::save_to_checkpoint_shared(persist& p) {
+  char name[512];
+  sprintf(name, "flat_weights_%lldx%lld", m_weights.Height(), m_weights.Width());
+  p.write_distmat(persist_type::model, name, (DistMat*)&m_weights);
+  return m_optimizer->saveToCheckpointShared(p, checkpoint_index());
+}
+
+bool flat_params::load_from_checkpoint_shared(persist& p) {
+  char name[512];
+  sprintf(name, "flat_weights_%lldx%lld.bin", m_weights.Height(), m_weights.Width());
+  p.read_distmat(persist_type::model, name, (DistMat*)&m_weights);
+  return m_optimizer->loadFromCheckpointShared(p, checkpoint_index());
+}
+
+}  // namespace lbann
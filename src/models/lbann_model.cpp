@@ -204,6 +204,14 @@ void lbann::model::do_layer_backward_prop_end_cbs(Layer* l) {
   }
 }
 
+void lbann::model::do_layer_update_begin_cbs(Layer* l) {
+  for (auto&& cb : callbacks) {
+    if (get_cur_step() % cb->batch_interval == 0) {
+      cb->on_update_begin(this, l);
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Evaluation callbacks
 ////////////////////////////////////////////////////////////////////////////////
@@ -187,9 +187,21 @@ bool lbann::deep_neural_network::train_mini_batch()
   do_model_backward_prop_end_cbs();
 
   /// Update layers
+  /// Flattened layers are updated together in a single optimizer step
+  /// Their update callbacks run first so pending gradient reductions finish
+  if (m_flat_params != nullptr) {
+    for (Layer* layer : m_flat_params->get_layers()) {
+      do_layer_update_begin_cbs(layer);
+    }
+    m_flat_params->update();
+  }
   for (size_t l = m_layers.size() - 1; l > 0; --l) {
-    m_layers[l]->update();
+    if (m_flat_params == nullptr || !m_flat_params->is_flattened(m_layers[l])) {
+      do_layer_update_begin_cbs(m_layers[l]);
+      m_layers[l]->update();
+    }
   }
+  do_layer_update_begin_cbs(m_layers[0]);
   const bool data_set_processed = m_layers[0]->update();
 
   do_batch_end_cbs();
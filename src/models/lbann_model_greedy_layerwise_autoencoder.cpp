@@ -191,8 +191,15 @@ bool lbann::greedy_layerwise_autoencoder::train_mini_batch(size_t phase_index)
   /// Update (active) layers
   ///Freeze inactive layers
   for (size_t l = phase_end; l > phase_index; --l) {
+    do_layer_update_begin_cbs(m_layers[l]);
     m_layers[l]->update();
   }
+  /// Inactive layers were backpropagated too, so let callbacks finish any
+  /// work they started on them (e.g. overlapped gradient reductions)
+  for (size_t l = phase_index; l > 0; --l) {
+    do_layer_update_begin_cbs(m_layers[l]);
+  }
+  do_layer_update_begin_cbs(m_layers[0]);
   const bool data_set_processed = m_layers[0]->update();
 
   do_batch_end_cbs();
@@ -37,11 +37,13 @@
 #include "lbann/optimizers/lbann_optimizer_adagrad.hpp"
 #include "lbann/optimizers/lbann_optimizer_rmsprop.hpp"
 #include "lbann/io/lbann_persist.hpp"
+#include "lbann/utils/lbann_exception.hpp"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <algorithm>
 
 #include "mpi.h"
 
@@ -56,10 +58,16 @@ lbann::sequential_model::sequential_model(const uint mini_batch_size,
   : model(comm, obj_fn),
     m_mini_batch_size(mini_batch_size),
     layer_fac(_layer_fac),
-    optimizer_fac(_optimizer_fac) {}
+    optimizer_fac(_optimizer_fac),
+    m_use_flat_params(false),
+    m_shard_optimizer(false),
+    m_flat_params(nullptr) {}
 
 lbann::sequential_model::~sequential_model()
 {
+  if (m_flat_params != nullptr) {
+    delete m_flat_params;
+  }
   // Free layers
   for (size_t l = 0; l < m_layers.size(); ++l) {
     delete m_layers[l];
@@ -335,11 +343,19 @@ bool lbann::sequential_model::save_to_checkpoint_shared(lbann::persist& p)
 
     // write out details for each layer
     for (size_t l = 0; l < m_layers.size(); l++) {
+        // flattened layers are written in one shot below
+        if (m_flat_params != nullptr && m_flat_params->is_flattened(m_layers[l])) {
+            continue;
+        }
         if (! m_layers[l]->saveToCheckpointShared(p)) {
             return false;
         }
     }
 
+    if (m_flat_params != nullptr) {
+        return m_flat_params->save_to_checkpoint_shared(p);
+    }
+
     return true;
 }
 
@@ -369,11 +385,18 @@ bool lbann::sequential_model::load_from_checkpoint_shared(lbann::persist& p)
 
     // read in each layer
     for (size_t l = 0; l < m_layers.size(); l++) {
+        if (m_flat_params != nullptr && m_flat_params->is_flattened(m_layers[l])) {
+            continue;
+        }
         if (! m_layers[l]->loadFromCheckpointShared(p)) {
             return false;
         }
     }
 
+    if (m_flat_params != nullptr) {
+        return m_flat_params->load_from_checkpoint_shared(p);
+    }
+
     return true;
 }
 
@@ -497,10 +520,75 @@ void lbann::sequential_model::setup(size_t start_index,size_t end_index)
     m_layers[l]->setup_bp_input(m_layers[l+1]->bp_output());
   }
 
+  // Pack parameters into contiguous buffers once the whole model is set up
+  if (m_use_flat_params && !supports_flat_params()) {
+    throw lbann_exception(
+      "sequential_model: this model does not support flattened parameters");
+  }
+  if (m_use_flat_params && m_flat_params == nullptr
+      && start_index == 0 && end_index == m_layers.size()) {
+    m_flat_params = new flat_params(comm, optimizer_fac, m_shard_optimizer);
+    m_flat_params->setup(m_layers);
+  }
+
   // Set up callbacks
   setup_callbacks();
 }
 
+void lbann::sequential_model::broadcast_weights(int root)
+{
+    if (comm->get_num_models() == 1) {
+        return;
+    }
+
+    // Pack the local part of every layer's weights into one buffer
+    El::Int local_size = 0;
+    for (Layer* layer : m_layers) {
+        local_size += layer->m_weights->LocalHeight() * layer->m_weights->LocalWidth();
+    }
+    std::vector<DataType> buf(local_size);
+    DataType* pos = buf.data();
+    for (Layer* layer : m_layers) {
+        ElMat& weights = *(layer->m_weights);
+        for (El::Int j = 0; j < weights.LocalWidth(); ++j) {
+            const DataType* col = weights.LockedBuffer() + j * weights.LDim();
+            pos = std::copy(col, col + weights.LocalHeight(), pos);
+        }
+    }
+
+    comm->global_barrier();
+    Timer timer;
+    timer.Start();
+    const El::Int sent = comm->intermodel_broadcast_compressed(buf.data(), local_size, root);
+    comm->global_barrier();
+    const double secs = timer.Stop();
+
+    // Unpack into the layers
+    pos = buf.data();
+    for (Layer* layer : m_layers) {
+        ElMat& weights = *(layer->m_weights);
+        for (El::Int j = 0; j < weights.LocalWidth(); ++j) {
+            std::copy(pos, pos + weights.LocalHeight(), weights.Buffer() + j * weights.LDim());
+            pos += weights.LocalHeight();
+        }
+    }
+
+    // Report totals over the processes of the model
+    const El::Int raw_bytes = comm->model_allreduce(local_size * (El::Int) sizeof(DataType));
+    const El::Int compressed_bytes = comm->model_allreduce(sent);
+    if (comm->am_world_master()) {
+        double bw = 0.0;
+        if (secs > 0.0) {
+            bw = ((double) raw_bytes) / (secs * 1024.0 * 1024.0);
+        }
+        printf("Model broadcast: %d models, %llu bytes, %llu compressed (%.1f%%) (%f secs, %f MB/sec)\n",
+               comm->get_num_models(), (unsigned long long) raw_bytes,
+               (unsigned long long) compressed_bytes,
+               raw_bytes > 0 ? 100.0 * compressed_bytes / raw_bytes : 0.0, secs, bw);
+        fflush(stdout);
+    }
+}
+
 bool lbann::sequential_model::at_epoch_start()
 {
   // use mini batch index in data reader to signify start of epoch
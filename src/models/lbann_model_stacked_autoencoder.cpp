@@ -234,8 +234,10 @@ bool lbann::stacked_autoencoder::train_mini_batch()
 
   // Update pretrained layers
   for (size_t l = round(m_num_layers / 2); l > 0; --l) {
+    do_layer_update_begin_cbs(m_layers[l]);
     m_layers[l]->update();
   }
+  do_layer_update_begin_cbs(m_layers[0]);
   const bool data_set_processed = m_layers[0]->update();
   //cout << "data processed : " << data_set_processed << endl;
   do_batch_end_cbs();
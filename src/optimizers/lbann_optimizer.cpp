@@ -40,6 +40,34 @@ void lbann::Optimizer::update_weight_bias_matrix(ElMat &WB_D, ElMat& WB) {
   exit(-1);
 }
 
+void lbann::fused_two_norms(const ElMat& a, const ElMat& b,
+                            DataType& norm_a, DataType& norm_b) {
+  const Mat& a_local = a.LockedMatrix();
+  const Mat& b_local = b.LockedMatrix();
+  const Int height = a_local.Height();
+  const Int width = a_local.Width();
+  const DataType* a_buf = a_local.LockedBuffer();
+  const DataType* b_buf = b_local.LockedBuffer();
+  const Int a_ldim = a_local.LDim();
+  const Int b_ldim = b_local.LDim();
+  double sqsum_a = 0.0;
+  double sqsum_b = 0.0;
+#pragma omp parallel for reduction(+:sqsum_a,sqsum_b)
+  for (Int col = 0; col < width; ++col) {
+    for (Int row = 0; row < height; ++row) {
+      const double a_val = a_buf[row + col * a_ldim];
+      const double b_val = b_buf[row + col * b_ldim];
+      sqsum_a += a_val * a_val;
+      sqsum_b += b_val * b_val;
+    }
+  }
+  // Sum over the processes that own distinct entries.
+  double sqsums[2] = {sqsum_a, sqsum_b};
+  mpi::AllReduce(sqsums, 2, mpi::SUM, a.DistComm());
+  norm_a = std::sqrt(sqsums[0]);
+  norm_b = std::sqrt(sqsums[1]);
+}
+
 #if 0
 lbann::Optimizer::Optimizer() {
 
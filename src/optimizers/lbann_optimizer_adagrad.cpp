@@ -39,8 +39,8 @@
 using namespace std;
 using namespace El;
 
-lbann::Adagrad_factory::Adagrad_factory(lbann_comm* comm, float lr, float epsilon)
-  : comm(comm), lr(lr), epsilon(epsilon)
+lbann::Adagrad_factory::Adagrad_factory(lbann_comm* comm, float lr, float epsilon, int state_bits)
+  : comm(comm), lr(lr), epsilon(epsilon), state_bits(state_bits)
 {
 }
 
@@ -51,13 +51,13 @@ lbann::Adagrad_factory::~Adagrad_factory()
 lbann::Optimizer *lbann::Adagrad_factory::create_optimizer(matrix_format format) {
   switch(format) {
   case matrix_format::MC_MR:
-    return new Adagrad<DistMat>(this->comm, this->lr, this->epsilon);
+    return new Adagrad<DistMat>(this->comm, this->lr, this->epsilon, this->state_bits);
   case matrix_format::CIRC_CIRC:
-    return new Adagrad<CircMat>(this->comm, this->lr, this->epsilon);
+    return new Adagrad<CircMat>(this->comm, this->lr, this->epsilon, this->state_bits);
   case matrix_format::STAR_STAR:
-    return new Adagrad<StarMat>(this->comm, this->lr, this->epsilon);
+    return new Adagrad<StarMat>(this->comm, this->lr, this->epsilon, this->state_bits);
   case matrix_format::STAR_VC:
-    return new Adagrad<StarVCMat>(this->comm, this->lr, this->epsilon);
+    return new Adagrad<StarVCMat>(this->comm, this->lr, this->epsilon, this->state_bits);
   default:
     // TODO: throw an exception
     printf("LBANN Error: unknown matrix distribution for Adagrad optimizer\n");
@@ -31,21 +31,22 @@
 namespace lbann {
 
 Adam_factory::Adam_factory(lbann_comm* comm, float lr, float rho1, float rho2,
-                           float eps) :
-  comm(comm), lr(lr), rho1(rho1), rho2(rho2), eps(eps) {}
+                           float eps, int state_bits) :
+  comm(comm), lr(lr), rho1(rho1), rho2(rho2), eps(eps),
+  state_bits(state_bits) {}
 
 Adam_factory::~Adam_factory() {}
 
 Optimizer* Adam_factory::create_optimizer(matrix_format format) {
   switch(format) {
   case matrix_format::MC_MR:
-    return new Adam<DistMat>(comm, lr, rho1, rho2, eps);
+    return new Adam<DistMat>(comm, lr, rho1, rho2, eps, state_bits);
   case matrix_format::CIRC_CIRC:
-    return new Adam<CircMat>(comm, lr, rho1, rho2, eps);
+    return new Adam<CircMat>(comm, lr, rho1, rho2, eps, state_bits);
   case matrix_format::STAR_STAR:
-    return new Adam<StarMat>(comm, lr, rho1, rho2, eps);
+    return new Adam<StarMat>(comm, lr, rho1, rho2, eps, state_bits);
   case matrix_format::STAR_VC:
-    return new Adam<StarVCMat>(comm, lr, rho1, rho2, eps);
+    return new Adam<StarVCMat>(comm, lr, rho1, rho2, eps, state_bits);
   default:
     // TODO: throw an exception
     printf("LBANN Error: unknown matrix distribution for Adam optimizer\n");
@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_optimizer_lars .hpp .cpp - SGD with layer-wise adaptive rate scaling
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/optimizers/lbann_optimizer_lars.hpp"
+
+namespace lbann {
+
+LARS_factory::LARS_factory(lbann_comm* comm, float lr, float momentum,
+                           float weight_decay, float eta, float eps) :
+  comm(comm), lr(lr), momentum(momentum), weight_decay(weight_decay),
+  eta(eta), eps(eps) {}
+
+LARS_factory::~LARS_factory() {}
+
+Optimizer* LARS_factory::create_optimizer(matrix_format format) {
+  switch(format) {
+  case matrix_format::MC_MR:
+    return new LARS<DistMat>(comm, lr, momentum, weight_decay, eta, eps);
+  case matrix_format::CIRC_CIRC:
+    return new LARS<CircMat>(comm, lr, momentum, weight_decay, eta, eps);
+  case matrix_format::STAR_STAR:
+    return new LARS<StarMat>(comm, lr, momentum, weight_decay, eta, eps);
+  case matrix_format::STAR_VC:
+    return new LARS<StarVCMat>(comm, lr, momentum, weight_decay, eta, eps);
+  default:
+    // TODO: throw an exception
+    printf("LBANN Error: unknown matrix distribution for LARS optimizer\n");
+    exit(-1);
+  }
+}
+
+}  // namespace lbann
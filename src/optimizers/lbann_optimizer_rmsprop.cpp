@@ -39,8 +39,9 @@
 using namespace std;
 using namespace El;
 
-lbann::RMSprop_factory::RMSprop_factory(lbann_comm* comm, float lr, float rho, float epsilon)
-  : comm(comm), lr(lr), rho(rho), epsilon(epsilon)
+lbann::RMSprop_factory::RMSprop_factory(lbann_comm* comm, float lr, float rho, float epsilon,
+                                        int state_bits)
+  : comm(comm), lr(lr), rho(rho), epsilon(epsilon), state_bits(state_bits)
 {
 }
 
@@ -51,13 +52,13 @@ lbann::RMSprop_factory::~RMSprop_factory()
 lbann::Optimizer *lbann::RMSprop_factory::create_optimizer(matrix_format format) {
   switch(format) {
   case matrix_format::MC_MR:
-    return new RMSprop<DistMat>(this->comm, this->lr, this->rho, this->epsilon);
+    return new RMSprop<DistMat>(this->comm, this->lr, this->rho, this->epsilon, this->state_bits);
   case matrix_format::CIRC_CIRC:
-    return new RMSprop<CircMat>(this->comm, this->lr, this->rho, this->epsilon);
+    return new RMSprop<CircMat>(this->comm, this->lr, this->rho, this->epsilon, this->state_bits);
   case matrix_format::STAR_STAR:
-    return new RMSprop<StarMat>(this->comm, this->lr, this->rho, this->epsilon);
+    return new RMSprop<StarMat>(this->comm, this->lr, this->rho, this->epsilon, this->state_bits);
   case matrix_format::STAR_VC:
-    return new RMSprop<StarVCMat>(this->comm, this->lr, this->rho, this->epsilon);
+    return new RMSprop<StarVCMat>(this->comm, this->lr, this->rho, this->epsilon, this->state_bits);
   default:
     // TODO: throw an exception
     printf("LBANN Error: unknown matrix distribution for RMSprop optimizer\n");
@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_optimizer_state .hpp .cpp - Block-quantized optimizer state storage
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/optimizers/lbann_optimizer_state.hpp"
+#include "lbann/io/lbann_file_io.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace lbann {
+
+const El::Int block_quantized_state::block_size;
+
+block_quantized_state::block_quantized_state(int bits) :
+  m_bits(bits), m_num_entries(0) {
+  if (bits != 8 && bits != 16) {
+    std::stringstream err;
+    err << __FILE__ << " " << __LINE__ <<
+      " :: block_quantized_state: unsupported number of bits " << bits;
+    throw lbann_exception(err.str());
+  }
+}
+
+void block_quantized_state::setup(El::Int num_entries) {
+  m_num_entries = num_entries;
+  m_scales.assign((num_entries + block_size - 1) / block_size, 0.0f);
+  if (m_bits == 8) {
+    m_codes8.assign(num_entries, 0);
+  } else {
+    m_codes16.assign(num_entries, 0);
+  }
+}
+
+size_t block_quantized_state::get_bytes() const {
+  return m_scales.size() * sizeof(float) +
+    m_codes8.size() * sizeof(int8_t) + m_codes16.size() * sizeof(int16_t);
+}
+
+template <typename T>
+void block_quantized_state::load_block_impl(const std::vector<T>& codes,
+                                            El::Int block,
+                                            DataType* vals) const {
+  const DataType qmax = std::numeric_limits<T>::max();
+  const DataType scale = m_scales[block];
+  const El::Int start = block * block_size;
+  const El::Int len = block_length(block);
+  for (El::Int i = 0; i < len; ++i) {
+    const DataType r = codes[start + i] / qmax;
+    vals[i] = (r < 0 ? -r * r : r * r) * scale;
+  }
+}
+
+template <typename T>
+void block_quantized_state::store_block_impl(std::vector<T>& codes,
+                                             El::Int block,
+                                             const DataType* vals) {
+  const DataType qmax = std::numeric_limits<T>::max();
+  const El::Int start = block * block_size;
+  const El::Int len = block_length(block);
+  DataType scale = 0.0f;
+  for (El::Int i = 0; i < len; ++i) {
+    scale = std::max(scale, std::fabs(vals[i]));
+  }
+  m_scales[block] = scale;
+  const DataType inv_scale = scale > 0.0f ? 1.0f / scale : 0.0f;
+  for (El::Int i = 0; i < len; ++i) {
+    const DataType r = std::sqrt(std::fabs(vals[i]) * inv_scale) * qmax;
+    const T code = (T) std::round(r);
+    codes[start + i] = vals[i] < 0 ? -code : code;
+  }
+}
+
+El::Int block_quantized_state::load_block(El::Int block, DataType* vals) const {
+  if (m_bits == 8) {
+    load_block_impl(m_codes8, block, vals);
+  } else {
+    load_block_impl(m_codes16, block, vals);
+  }
+  return block_length(block);
+}
+
+void block_quantized_state::store_block(El::Int block, const DataType* vals) {
+  if (m_bits == 8) {
+    store_block_impl(m_codes8, block, vals);
+  } else {
+    store_block_impl(m_codes16, block, vals);
+  }
+}
+
+bool block_quantized_state::save_to_checkpoint_shared(persist& p,
+                                                      const char* name) {
+  // Every rank holds different state, so each writes its own file.
+  char filename[1024];
+  snprintf(filename, sizeof(filename), "%s/train_%s.%d",
+           p.m_checkpoint_dir, name, p.m_rank);
+  int fd = lbann::openwrite(filename);
+  if (fd < 0) {
+    throw lbann_exception(std::string("Failed to open: ") + filename);
+  }
+  const uint32_t bits = m_bits;
+  const uint64_t num_entries = m_num_entries;
+  lbann::write_uint32(fd, filename, bits);
+  lbann::write_uint64(fd, filename, num_entries);
+  lbann::write_bytes(fd, filename, m_scales.data(),
+                     m_scales.size() * sizeof(float));
+  if (m_bits == 8) {
+    lbann::write_bytes(fd, filename, m_codes8.data(),
+                       m_codes8.size() * sizeof(int8_t));
+  } else {
+    lbann::write_bytes(fd, filename, m_codes16.data(),
+                       m_codes16.size() * sizeof(int16_t));
+  }
+  lbann::closewrite(fd, filename);
+  p.m_bytes += sizeof(uint32_t) + sizeof(uint64_t) + get_bytes();
+  return true;
+}
+
+bool block_quantized_state::load_from_checkpoint_shared(persist& p,
+                                                        const char* name) {
+  char filename[1024];
+  snprintf(filename, sizeof(filename), "%s/train_%s.%d",
+           p.m_checkpoint_dir, name, p.m_rank);
+  int fd = lbann::openread(filename);
+  if (fd < 0) {
+    throw lbann_exception(std::string("Failed to read file: ") + filename);
+  }
+  uint32_t bits;
+  uint64_t num_entries;
+  lbann::read_uint32(fd, filename, &bits);
+  lbann::read_uint64(fd, filename, &num_entries);
+  if ((int) bits != m_bits) {
+    lbann::closeread(fd, filename);
+    throw lbann_exception(
+      std::string("block_quantized_state: bit width mismatch in ") + filename);
+  }
+  setup(num_entries);
+  lbann::read_bytes(fd, filename, m_scales.data(),
+                    m_scales.size() * sizeof(float));
+  if (m_bits == 8) {
+    lbann::read_bytes(fd, filename, m_codes8.data(),
+                      m_codes8.size() * sizeof(int8_t));
+  } else {
+    lbann::read_bytes(fd, filename, m_codes16.data(),
+                      m_codes16.size() * sizeof(int16_t));
+  }
+  lbann::closeread(fd, filename);
+  p.m_bytes += sizeof(uint32_t) + sizeof(uint64_t) + get_bytes();
+  return true;
+}
+
+}  // namespace lbann
@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_comm_trace .hpp .cpp - Tracing of communication calls
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/utils/lbann_comm_trace.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+namespace lbann {
+
+namespace {
+
+/** Write s as a JSON string. */
+void write_json_string(std::ostream& os, const char* s) {
+  os << '"';
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') {
+      os << '\\' << *s;
+    } else if ((unsigned char) *s < 0x20) {
+      os << ' ';
+    } else {
+      os << *s;
+    }
+  }
+  os << '"';
+}
+
+}  // namespace
+
+void comm_tracer::enable(size_t max_events_) {
+  std::lock_guard<std::mutex> lock(mutex);
+  max_events = max_events_;
+  // Reserve up front (up to a point) so recording rarely reallocates.
+  events.reserve(std::min(max_events, (size_t) 1 << 16));
+  epoch = get_time();
+  enabled = true;
+}
+
+void comm_tracer::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  events.clear();
+  histograms.clear();
+  num_dropped = 0;
+}
+
+void comm_tracer::record(const char* op, const char* comm, size_t bytes,
+                         int peer, double start, double end,
+                         const char* algorithm) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto tid = thread_ids.emplace(std::this_thread::get_id(),
+                                (int) thread_ids.size()).first->second;
+  if (events.size() < max_events) {
+    events.push_back({op, comm, algorithm, bytes, peer, start, end, tid});
+  } else {
+    ++num_dropped;
+  }
+  size_histogram& hist = histograms[op];
+  const int bucket = size_bucket(bytes);
+  ++hist.count[bucket];
+  hist.time[bucket] += end - start;
+}
+
+int comm_tracer::size_bucket(size_t bytes) {
+  // Bucket b > 0 holds [2^(b-1), 2^b) bytes; bucket 0 holds empty messages.
+  int bucket = 0;
+  while (bytes > 0 && bucket < NUM_SIZE_BUCKETS - 1) {
+    bytes >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+std::vector<std::pair<std::string, comm_tracer::size_histogram>>
+comm_tracer::merged_histograms() const {
+  std::map<std::string, size_histogram> merged;
+  for (const auto& entry : histograms) {
+    size_histogram& hist = merged[entry.first];
+    for (int b = 0; b < NUM_SIZE_BUCKETS; ++b) {
+      hist.count[b] += entry.second.count[b];
+      hist.time[b] += entry.second.time[b];
+    }
+  }
+  return std::vector<std::pair<std::string, size_histogram>>(merged.begin(),
+                                                             merged.end());
+}
+
+void comm_tracer::write_chrome_trace(std::ostream& os, int pid,
+                                     const std::string& process_name) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  os << std::fixed << std::setprecision(3);
+  os << "{\"traceEvents\":[\n";
+  os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+     << ",\"tid\":0,\"args\":{\"name\":";
+  write_json_string(os, process_name.c_str());
+  os << "}}";
+  for (const comm_trace_event& e : events) {
+    // Complete ("X") events, in microseconds since enable().
+    os << ",\n{\"name\":";
+    write_json_string(os, e.op);
+    os << ",\"cat\":";
+    write_json_string(os, e.comm);
+    os << ",\"ph\":\"X\",\"ts\":" << (e.start - epoch) * 1e6
+       << ",\"dur\":" << (e.end - e.start) * 1e6
+       << ",\"pid\":" << pid << ",\"tid\":" << e.tid
+       << ",\"args\":{\"bytes\":" << e.bytes;
+    if (e.peer >= 0) {
+      os << ",\"peer\":" << e.peer;
+    }
+    if (e.algorithm != nullptr) {
+      os << ",\"algorithm\":";
+      write_json_string(os, e.algorithm);
+    }
+    os << "}}";
+  }
+  os << "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"dropped_events\":"
+     << num_dropped << ",\"size_histograms\":{";
+  bool first = true;
+  for (const auto& entry : merged_histograms()) {
+    if (!first) os << ",";
+    first = false;
+    os << "\n";
+    write_json_string(os, entry.first.c_str());
+    // [min bytes, calls, seconds] for each non-empty bucket.
+    os << ":[";
+    bool first_bucket = true;
+    for (int b = 0; b < NUM_SIZE_BUCKETS; ++b) {
+      if (entry.second.count[b] == 0) continue;
+      if (!first_bucket) os << ",";
+      first_bucket = false;
+      os << "[" << (b == 0 ? (size_t) 0 : (size_t) 1 << (b - 1)) << ","
+         << entry.second.count[b] << ","
+         << std::setprecision(9) << entry.second.time[b]
+         << std::setprecision(3) << "]";
+    }
+    os << "]";
+  }
+  os << "}}}\n";
+}
+
+void comm_tracer::write_chrome_trace(const std::string& filename, int pid,
+                                     const std::string& process_name) const {
+  std::ofstream out(filename);
+  if (!out) {
+    throw lbann_exception("comm_tracer: cannot open " + filename);
+  }
+  write_chrome_trace(out, pid, process_name);
+  if (!out) {
+    throw lbann_exception("comm_tracer: error writing " + filename);
+  }
+}
+
+void comm_tracer::print_histograms(std::ostream& os) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& entry : merged_histograms()) {
+    os << entry.first << ":" << std::endl;
+    for (int b = 0; b < NUM_SIZE_BUCKETS; ++b) {
+      if (entry.second.count[b] == 0) continue;
+      const size_t lo = b == 0 ? 0 : (size_t) 1 << (b - 1);
+      os << "  >= " << std::setw(12) << lo << " bytes: "
+         << std::setw(8) << entry.second.count[b] << " calls, "
+         << entry.second.time[b] << "s" << std::endl;
+    }
+  }
+}
+
+}  // namespace lbann
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_gradient_buckets .hpp .cpp - Fuse gradient reductions into buckets
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/utils/lbann_gradient_buckets.hpp"
+#include "lbann/utils/lbann_timer.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+#include <algorithm>
+
+namespace lbann {
+
+gradient_buckets::gradient_buckets(lbann_comm* comm, size_t bucket_bytes) :
+  m_comm(comm), m_bucket_bytes(bucket_bytes) {}
+
+void gradient_buckets::add_gradient(uint id, El::Int size) {
+  if (has_gradient(id)) {
+    throw lbann_exception("gradient_buckets: gradient registered twice");
+  }
+  m_order.push_back(id);
+  m_entries[id] = {0, 0, size};
+}
+
+void gradient_buckets::setup() {
+  const El::Int bucket_size = std::max<El::Int>(
+    1, m_bucket_bytes / sizeof(DataType));
+  m_buckets.clear();
+  El::Int offset = 0;
+  for (uint id : m_order) {
+    entry& e = m_entries[id];
+    // Start a new bucket when this gradient would overflow the current one.
+    if (m_buckets.empty() ||
+        (m_buckets.back().num_gradients > 0 &&
+         m_buckets.back().size + e.size > bucket_size)) {
+      m_buckets.emplace_back();
+      m_buckets.back().offset = offset;
+    }
+    bucket& b = m_buckets.back();
+    e.bucket = m_buckets.size() - 1;
+    e.offset = offset;
+    b.size += e.size;
+    ++b.num_gradients;
+    offset += e.size;
+  }
+  m_staging.assign(offset, DataType(0));
+}
+
+void gradient_buckets::pack(uint id, const DistMat& grad, bool nonblocking) {
+  const entry& e = m_entries.at(id);
+  const Mat& local = grad.LockedMatrix();
+  if (local.Height() * local.Width() != e.size) {
+    throw lbann_exception("gradient_buckets: gradient size changed");
+  }
+  DataType* dst = m_staging.data() + e.offset;
+  for (El::Int j = 0; j < local.Width(); ++j) {
+    std::copy(local.LockedBuffer(0, j), local.LockedBuffer(0, j) + local.Height(),
+              dst + j * local.Height());
+  }
+  bucket& b = m_buckets[e.bucket];
+  if (++b.num_packed < b.num_gradients) {
+    return;
+  }
+  b.start_time = get_time();
+  b.nonblocking = nonblocking;
+  ++m_num_collectives;
+  if (nonblocking) {
+    m_comm->nb_intermodel_sum(m_staging.data() + b.offset, b.size, b.req);
+    b.complete = false;
+  } else {
+    m_comm->intermodel_sum(m_staging.data() + b.offset, b.size);
+    b.complete = true;
+    m_comm_time += get_time() - b.start_time;
+  }
+}
+
+void gradient_buckets::unpack(uint id, DistMat& grad) {
+  const entry& e = m_entries.at(id);
+  bucket& b = m_buckets[e.bucket];
+  if (b.num_packed < b.num_gradients) {
+    throw lbann_exception("gradient_buckets: unpacking an incomplete bucket");
+  }
+  if (!b.complete) {
+    double wait_start = get_time();
+    m_comm->wait(b.req);
+    double end_time = get_time();
+    m_wait_time += end_time - wait_start;
+    m_comm_time += end_time - b.start_time;
+    b.complete = true;
+  }
+  Mat& local = grad.Matrix();
+  const DataType* src = m_staging.data() + e.offset;
+  for (El::Int j = 0; j < local.Width(); ++j) {
+    std::copy(src + j * local.Height(), src + (j + 1) * local.Height(),
+              local.Buffer(0, j));
+  }
+  // Reset the bucket for the next mini-batch once every gradient is out.
+  if (++b.num_unpacked == b.num_gradients) {
+    b.num_packed = 0;
+    b.num_unpacked = 0;
+    b.complete = false;
+  }
+}
+
+}  // namespace lbann
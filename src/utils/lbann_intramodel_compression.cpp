@@ -0,0 +1,266 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_intramodel_compression .hpp .cpp - Lossy formats for intra-model
+// transfers and reduced-precision payloads
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/utils/lbann_intramodel_compression.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lbann {
+
+uint16_t float_to_half(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  const uint16_t sign = (x >> 16) & 0x8000;
+  const int exp = (x >> 23) & 0xFF;
+  uint32_t mant = x & 0x7FFFFF;
+  if (exp == 0xFF) {
+    // Infinity or NaN (keep NaNs quiet).
+    return sign | 0x7C00 | (mant ? 0x200 : 0);
+  }
+  const int half_exp = exp - 127 + 15;
+  if (half_exp >= 0x1F) {
+    return sign | 0x7C00;
+  }
+  if (half_exp <= 0) {
+    // Subnormal half, or too small and flushed to zero.
+    if (half_exp < -10) {
+      return sign;
+    }
+    mant |= 0x800000;
+    const int shift = 14 - half_exp;
+    uint32_t h = mant >> shift;
+    const uint32_t rem = mant & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (rem > halfway || (rem == halfway && (h & 1))) {
+      ++h;
+    }
+    return sign | h;
+  }
+  // A carry out of the mantissa correctly bumps the exponent (possibly to
+  // infinity).
+  uint32_t h = (half_exp << 10) | (mant >> 13);
+  const uint32_t rem = mant & 0x1FFF;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) {
+    ++h;
+  }
+  return sign | h;
+}
+
+float half_to_float(uint16_t h) {
+  const uint32_t sign = uint32_t(h & 0x8000) << 16;
+  int exp = (h >> 10) & 0x1F;
+  uint32_t mant = h & 0x3FF;
+  uint32_t x;
+  if (exp == 0x1F) {
+    x = sign | 0x7F800000 | (mant << 13);
+  } else if (exp == 0) {
+    if (mant == 0) {
+      x = sign;
+    } else {
+      // Normalize the subnormal.
+      exp = 1;
+      while (!(mant & 0x400)) {
+        mant <<= 1;
+        --exp;
+      }
+      x = sign | uint32_t(exp + 127 - 15) << 23 | ((mant & 0x3FF) << 13);
+    }
+  } else {
+    x = sign | uint32_t(exp + 127 - 15) << 23 | (mant << 13);
+  }
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+uint16_t float_to_bfloat16(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  if ((x & 0x7FFFFFFF) > 0x7F800000) {
+    // NaN: truncate, keeping it quiet (rounding could make it infinity).
+    return (x >> 16) | 0x40;
+  }
+  x += 0x7FFF + ((x >> 16) & 1);
+  return x >> 16;
+}
+
+float bfloat16_to_float(uint16_t h) {
+  const uint32_t x = uint32_t(h) << 16;
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+void pack_payload(payload_precision p, const DataType* src, size_t height,
+                  size_t width, size_t ldim, uint16_t* dst) {
+  for (size_t col = 0; col < width; ++col) {
+    const DataType* src_col = src + col * ldim;
+    uint16_t* dst_col = dst + col * height;
+    if (p == payload_precision::BF16) {
+      for (size_t i = 0; i < height; ++i) {
+        dst_col[i] = float_to_bfloat16(src_col[i]);
+      }
+    } else {
+      for (size_t i = 0; i < height; ++i) {
+        dst_col[i] = float_to_half(src_col[i]);
+      }
+    }
+  }
+}
+
+void unpack_payload(payload_precision p, const uint16_t* src, size_t height,
+                    size_t width, size_t ldim, DataType* dst, bool add) {
+  for (size_t col = 0; col < width; ++col) {
+    const uint16_t* src_col = src + col * height;
+    DataType* dst_col = dst + col * ldim;
+    if (p == payload_precision::BF16) {
+      if (add) {
+        for (size_t i = 0; i < height; ++i) {
+          dst_col[i] += bfloat16_to_float(src_col[i]);
+        }
+      } else {
+        for (size_t i = 0; i < height; ++i) {
+          dst_col[i] = bfloat16_to_float(src_col[i]);
+        }
+      }
+    } else {
+      if (add) {
+        for (size_t i = 0; i < height; ++i) {
+          dst_col[i] += half_to_float(src_col[i]);
+        }
+      } else {
+        for (size_t i = 0; i < height; ++i) {
+          dst_col[i] = half_to_float(src_col[i]);
+        }
+      }
+    }
+  }
+}
+
+size_t compressed_bytes(intramodel_compression c, size_t count) {
+  switch (c) {
+  case intramodel_compression::FP16:
+    return count * sizeof(uint16_t);
+  case intramodel_compression::BLOCK8:
+    return count + sizeof(float) *
+      ((count + INTRAMODEL_BLOCK_SIZE - 1) / INTRAMODEL_BLOCK_SIZE);
+  default:
+    return count * sizeof(DataType);
+  }
+}
+
+void compress_values(intramodel_compression c, const DataType* src,
+                     size_t count, unsigned char* dst) {
+  switch (c) {
+  case intramodel_compression::FP16:
+    for (size_t i = 0; i < count; ++i) {
+      const uint16_t h = float_to_half(src[i]);
+      memcpy(dst + i*sizeof(h), &h, sizeof(h));
+    }
+    break;
+  case intramodel_compression::BLOCK8:
+    for (size_t start = 0; start < count; start += INTRAMODEL_BLOCK_SIZE) {
+      const size_t end = std::min(count, start + INTRAMODEL_BLOCK_SIZE);
+      float max_abs = 0.0f;
+      for (size_t i = start; i < end; ++i) {
+        max_abs = std::max(max_abs, (float) std::fabs(src[i]));
+      }
+      const float scale = max_abs / 127.0f;
+      memcpy(dst, &scale, sizeof(scale));
+      dst += sizeof(scale);
+      const float inv_scale = scale > 0.0f ? 1.0f / scale : 0.0f;
+      for (size_t i = start; i < end; ++i) {
+        const float q = std::round(src[i] * inv_scale);
+        *dst++ = (unsigned char) (int8_t) std::max(-127.0f, std::min(127.0f, q));
+      }
+    }
+    break;
+  default:
+    memcpy(dst, src, count * sizeof(DataType));
+    break;
+  }
+}
+
+void decompress_values(intramodel_compression c, const unsigned char* src,
+                       size_t count, DataType* dst, bool add) {
+  switch (c) {
+  case intramodel_compression::FP16:
+    for (size_t i = 0; i < count; ++i) {
+      uint16_t h;
+      memcpy(&h, src + i*sizeof(h), sizeof(h));
+      const DataType v = half_to_float(h);
+      if (add) dst[i] += v;
+      else dst[i] = v;
+    }
+    break;
+  case intramodel_compression::BLOCK8:
+    for (size_t start = 0; start < count; start += INTRAMODEL_BLOCK_SIZE) {
+      const size_t end = std::min(count, start + INTRAMODEL_BLOCK_SIZE);
+      float scale;
+      memcpy(&scale, src, sizeof(scale));
+      src += sizeof(scale);
+      for (size_t i = start; i < end; ++i) {
+        const DataType v = (int8_t) *src++ * scale;
+        if (add) dst[i] += v;
+        else dst[i] = v;
+      }
+    }
+    break;
+  default:
+    if (add) {
+      for (size_t i = 0; i < count; ++i) {
+        DataType v;
+        memcpy(&v, src + i*sizeof(v), sizeof(v));
+        dst[i] += v;
+      }
+    } else {
+      memcpy(dst, src, count * sizeof(DataType));
+    }
+    break;
+  }
+}
+
+const char* intramodel_compression_name(intramodel_compression c) {
+  switch (c) {
+  case intramodel_compression::FP16: return "fp16";
+  case intramodel_compression::BLOCK8: return "block8";
+  default: return "none";
+  }
+}
+
+const char* payload_precision_name(payload_precision p) {
+  switch (p) {
+  case payload_precision::FP16: return "fp16";
+  case payload_precision::BF16: return "bf16";
+  default: return "fp32";
+  }
+}
+
+}  // namespace lbann
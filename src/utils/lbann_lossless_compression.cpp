@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_lossless_compression .hpp .cpp - Lossless compression of parameters
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/utils/lbann_lossless_compression.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace lbann {
+
+namespace {
+
+/** Leading byte of a compressed buffer. */
+const unsigned char FORMAT_RAW = 0;
+const unsigned char FORMAT_RLE = 1;
+
+/**
+ * Run-length tokens: a control byte below 128 is followed by control+1
+ * literal bytes; a control byte c of 128 or more is followed by one byte that
+ * is repeated c-128+MIN_RUN times.
+ */
+const size_t MAX_LITERAL = 128;
+const size_t MIN_RUN = 3;
+const size_t MAX_RUN = 127 + MIN_RUN;
+
+typedef uint32_t word_t;
+static_assert(sizeof(word_t) == sizeof(DataType),
+              "lossless compression assumes 4-byte values");
+
+/** Return the plane-th byte of value i after the XOR with value i-1. */
+inline unsigned char delta_byte(const DataType* src, size_t i, size_t plane) {
+  word_t cur, prev = 0;
+  memcpy(&cur, src + i, sizeof(cur));
+  if (i > 0) {
+    memcpy(&prev, src + i - 1, sizeof(prev));
+  }
+  return (unsigned char) ((cur ^ prev) >> (8 * plane));
+}
+
+/**
+ * Run-length encode every byte plane of src into dst, writing at most limit
+ * bytes. Returns the number of bytes written, or 0 if it would not fit.
+ */
+size_t encode_planes(const DataType* src, size_t count, unsigned char* dst,
+                     size_t limit) {
+  size_t out = 0;
+  for (size_t plane = 0; plane < sizeof(word_t); ++plane) {
+    size_t i = 0;
+    size_t literal_start = 0;
+    auto flush_literals = [&] (size_t end) {
+      while (literal_start < end) {
+        const size_t len = std::min(MAX_LITERAL, end - literal_start);
+        if (out + 1 + len > limit) {
+          return false;
+        }
+        dst[out++] = (unsigned char) (len - 1);
+        for (size_t j = 0; j < len; ++j) {
+          dst[out++] = delta_byte(src, literal_start + j, plane);
+        }
+        literal_start += len;
+      }
+      return true;
+    };
+    while (i < count) {
+      const unsigned char b = delta_byte(src, i, plane);
+      size_t run = 1;
+      while (i + run < count && run < MAX_RUN &&
+             delta_byte(src, i + run, plane) == b) {
+        ++run;
+      }
+      if (run >= MIN_RUN) {
+        if (!flush_literals(i) || out + 2 > limit) {
+          return 0;
+        }
+        dst[out++] = (unsigned char) (128 + run - MIN_RUN);
+        dst[out++] = b;
+        i += run;
+        literal_start = i;
+      } else {
+        i += run;
+      }
+    }
+    if (!flush_literals(count)) {
+      return 0;
+    }
+  }
+  return out;
+}
+
+}  // namespace
+
+size_t lossless_compress_bound(size_t count) {
+  return 1 + count * sizeof(DataType);
+}
+
+size_t lossless_compress(const DataType* src, size_t count,
+                         unsigned char* dst) {
+  const size_t raw_bytes = count * sizeof(DataType);
+  const size_t rle_bytes = encode_planes(src, count, dst + 1, raw_bytes);
+  if (rle_bytes > 0 && rle_bytes < raw_bytes) {
+    dst[0] = FORMAT_RLE;
+    return 1 + rle_bytes;
+  }
+  dst[0] = FORMAT_RAW;
+  memcpy(dst + 1, src, raw_bytes);
+  return 1 + raw_bytes;
+}
+
+void lossless_decompress(const unsigned char* src, size_t bytes,
+                         size_t count, DataType* dst) {
+  if (bytes == 0) {
+    throw lbann_exception("lossless_decompress: empty buffer");
+  }
+  if (src[0] == FORMAT_RAW) {
+    if (bytes != 1 + count * sizeof(DataType)) {
+      throw lbann_exception("lossless_decompress: bad raw buffer size");
+    }
+    memcpy(dst, src + 1, count * sizeof(DataType));
+    return;
+  }
+  if (src[0] != FORMAT_RLE) {
+    throw lbann_exception("lossless_decompress: unknown format");
+  }
+  // Scatter each plane's bytes into the deltas, then undo the XOR.
+  std::vector<word_t> deltas(count, 0);
+  size_t in = 1;
+  for (size_t plane = 0; plane < sizeof(word_t); ++plane) {
+    const int shift = 8 * plane;
+    size_t i = 0;
+    while (i < count) {
+      if (in >= bytes) {
+        throw lbann_exception("lossless_decompress: truncated buffer");
+      }
+      const unsigned char control = src[in++];
+      if (control < 128) {
+        const size_t len = control + 1;
+        if (i + len > count || in + len > bytes) {
+          throw lbann_exception("lossless_decompress: corrupt literal run");
+        }
+        for (size_t j = 0; j < len; ++j) {
+          deltas[i++] |= (word_t) src[in++] << shift;
+        }
+      } else {
+        const size_t len = control - 128 + MIN_RUN;
+        if (i + len > count || in >= bytes) {
+          throw lbann_exception("lossless_decompress: corrupt repeat run");
+        }
+        const word_t b = (word_t) src[in++] << shift;
+        for (size_t j = 0; j < len; ++j) {
+          deltas[i++] |= b;
+        }
+      }
+    }
+  }
+  if (in != bytes) {
+    throw lbann_exception("lossless_decompress: trailing bytes");
+  }
+  word_t prev = 0;
+  for (size_t i = 0; i < count; ++i) {
+    prev ^= deltas[i];
+    memcpy(dst + i, &prev, sizeof(prev));
+  }
+}
+
+}  // namespace lbann
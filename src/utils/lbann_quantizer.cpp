@@ -28,8 +28,12 @@
 
 #include <algorithm>
 #include "lbann/utils/lbann_quantizer.hpp"
+#include "lbann/utils/lbann_quantizer_kernels.hpp"
 #include "lbann/utils/lbann_random.hpp"
+#include "lbann/utils/lbann_timer.hpp"
+#include "lbann/utils/lbann_exception.hpp"
 #include <cmath>
+#include <iostream>
 #include <omp.h>
 
 namespace lbann {
@@ -38,14 +42,375 @@ lbann_quantizer::lbann_quantizer() {
   reset_bytes_counters();
   reset_time_counters();
   quantized_count = 0;
+  allreduce_alg = allreduce_algorithm::AUTO;
+  allreduce_tuned_models = 0;
+  ring_segment_bytes = 0;
+  pos_codec = position_codec::AUTO;
+  ring_precision = payload_precision::FP32;
+  qsgd_seed = 0;
+  qsgd_round = 0;
 }
 
 lbann_quantizer::~lbann_quantizer() {
+  // Persistent requests can only be released while MPI is still up.
+  int finalized;
+  MPI_Finalized(&finalized);
+  if (!finalized) {
+    free_ring_requests();
+  }
+}
+
+void lbann_quantizer::free_ring_requests() {
+  for (auto& set : ring_requests) {
+    for (auto& entry : set.second.reqs) {
+      lbann_comm::free_persistent(entry.second);
+    }
+  }
+  ring_requests.clear();
+}
+
+lbann_comm::persistent_request& lbann_quantizer::get_ring_request(
+  const Mat& mat, ring_phase phase, int step) {
+  auto iter = ring_requests.find(mat.LockedBuffer());
+  if (iter == ring_requests.end()) {
+    if (ring_requests.size() >= MAX_RING_REQUEST_MATS) {
+      // Collectives wait on all their requests before returning, so only
+      // the requests of the matrix being reduced can be active.
+      auto lru = std::min_element(
+        ring_requests.begin(), ring_requests.end(),
+        [] (const std::pair<const DataType* const, ring_request_set>& a,
+            const std::pair<const DataType* const, ring_request_set>& b) {
+          return a.second.last_use < b.second.last_use;
+        });
+      for (auto& entry : lru->second.reqs) {
+        lbann_comm::free_persistent(entry.second);
+      }
+      ring_requests.erase(lru);
+    }
+    iter = ring_requests.emplace(mat.LockedBuffer(), ring_request_set()).first;
+  }
+  iter->second.last_use = ++ring_request_clock;
+  return iter->second.reqs[std::make_pair((int) phase, step)];
+}
+
+namespace {
+
+/** Return the largest power of two <= n. */
+int largest_pof2(int n) {
+  int pof2 = 1;
+  while (pof2 * 2 <= n) {
+    pof2 *= 2;
+  }
+  return pof2;
+}
+
+/**
+ * Return the magnitude key of val: the IEEE bit pattern of |val|, which
+ * orders the same way as |val|.
+ */
+inline uint64_t topk_key(DataType val) {
+  val = std::fabs(val);
+  if (sizeof(DataType) == sizeof(uint32_t)) {
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+  }
+  uint64_t bits = 0;
+  memcpy(&bits, &val, sizeof(val));
+  return bits;
+}
 
+/** Return the offset of block i when count entries are split into nblocks. */
+Int block_offset(Int count, int nblocks, int i) {
+  return (Int) (((long long) count * i) / nblocks);
 }
 
+const char* allreduce_algorithm_name(
+  lbann_quantizer::allreduce_algorithm alg) {
+  switch (alg) {
+  case lbann_quantizer::allreduce_algorithm::RING:
+    return "ring";
+  case lbann_quantizer::allreduce_algorithm::RECURSIVE_DOUBLING:
+    return "recursive doubling";
+  case lbann_quantizer::allreduce_algorithm::RABENSEIFNER:
+    return "Rabenseifner";
+  default:
+    return "auto";
+  }
+}
+
+}  // namespace
+
 void lbann_quantizer::intermodel_sum(lbann_comm* comm, Mat& mat) {
-  Mat rs_recv;
+  intermodel_sum(comm, mat, allreduce_alg);
+}
+
+void lbann_quantizer::intermodel_sum(lbann_comm* comm, Mat& mat,
+                                     allreduce_algorithm alg) {
+  if (comm->get_num_models() == 1) {
+    return;
+  }
+  const Int count = mat.Height() * mat.Width();
+  if (alg == allreduce_algorithm::AUTO) {
+    alg = select_allreduce_algorithm(comm, count);
+    // The ring splits by columns, so it cannot use every model otherwise.
+    if (alg == allreduce_algorithm::RING &&
+        mat.Width() < comm->get_num_models()) {
+      alg = allreduce_algorithm::RABENSEIFNER;
+    }
+  }
+  comm_trace_scope trace(comm->get_tracer(), "quantizer_allreduce",
+                         "intermodel", sizeof(DataType) * count);
+  trace.set_algorithm(allreduce_algorithm_name(alg));
+  // Every algorithm sends whole column blocks or a flat buffer, so work on
+  // a contiguous copy if needed.
+  const bool contiguous = mat.LDim() == mat.Height() || mat.Width() == 1;
+  DataType* buf = mat.Buffer();
+  if (!contiguous) {
+    Copy(mat, allreduce_contig);
+    buf = allreduce_contig.Buffer();
+  }
+  if (alg == allreduce_algorithm::RING) {
+    intermodel_sum_ring(comm, contiguous ? mat : allreduce_contig);
+  } else if (alg == allreduce_algorithm::RECURSIVE_DOUBLING) {
+    intermodel_sum_recursive_doubling(comm, buf, count);
+  } else {
+    intermodel_sum_rabenseifner(comm, buf, count);
+  }
+  if (!contiguous) {
+    Copy(allreduce_contig, mat);
+  }
+}
+
+lbann_quantizer::allreduce_algorithm
+lbann_quantizer::select_allreduce_algorithm(lbann_comm* comm,
+                                            Int count) const {
+  if (!allreduce_crossovers.empty() &&
+      allreduce_tuned_models == comm->get_num_models()) {
+    // Use the choice for the largest tested size not above count.
+    allreduce_algorithm alg = allreduce_crossovers.front().second;
+    for (const auto& crossover : allreduce_crossovers) {
+      if (crossover.first > count) {
+        break;
+      }
+      alg = crossover.second;
+    }
+    return alg;
+  }
+  // Untuned: latency-bound sizes favor the log(p)-step algorithms,
+  // bandwidth-bound sizes the ring.
+  const size_t bytes = count * sizeof(DataType);
+  if (bytes <= 16384) {
+    return allreduce_algorithm::RECURSIVE_DOUBLING;
+  } else if (bytes <= 1048576) {
+    return allreduce_algorithm::RABENSEIFNER;
+  } else {
+    return allreduce_algorithm::RING;
+  }
+}
+
+void lbann_quantizer::autotune_allreduce(lbann_comm* comm, Int min_count,
+                                         Int max_count, int num_trials) {
+  allreduce_crossovers.clear();
+  allreduce_tuned_models = comm->get_num_models();
+  if (comm->get_num_models() == 1) {
+    return;
+  }
+  const int nprocs = comm->get_num_models();
+  const allreduce_algorithm algs[] = {
+    allreduce_algorithm::RING,
+    allreduce_algorithm::RECURSIVE_DOUBLING,
+    allreduce_algorithm::RABENSEIFNER
+  };
+  if (comm->am_world_master()) {
+    std::cout << "Allreduce autotuning (" << nprocs << " models):" <<
+      std::endl;
+  }
+  for (Int count = std::max(min_count, (Int) nprocs); count <= max_count;
+       count *= 4) {
+    // One column block per model, matching how the ring splits gradients.
+    Mat mat;
+    Zeros(mat, std::max((Int) 1, count / nprocs), nprocs);
+    allreduce_algorithm best = allreduce_algorithm::RING;
+    double best_time = 0.0;
+    for (allreduce_algorithm alg : algs) {
+      // Warm up (and allocate scratch buffers).
+      intermodel_sum(comm, mat, alg);
+      comm->intermodel_barrier();
+      double start = get_time();
+      for (int trial = 0; trial < num_trials; ++trial) {
+        intermodel_sum(comm, mat, alg);
+      }
+      double elapsed = (get_time() - start) / num_trials;
+      // Every model must make the same choice.
+      elapsed = comm->intermodel_allreduce(elapsed, mpi::MAX);
+      if (alg == algs[0] || elapsed < best_time) {
+        best = alg;
+        best_time = elapsed;
+      }
+    }
+    allreduce_crossovers.emplace_back(count, best);
+    if (comm->am_world_master()) {
+      std::cout << "  " << count * sizeof(DataType) << " bytes: " <<
+        allreduce_algorithm_name(best) << " (" << best_time << "s)" <<
+        std::endl;
+    }
+  }
+  // Don't report the sweep's traffic as training communication, or keep
+  // requests bound to the sweep's matrices.
+  reset_bytes_counters();
+  reset_time_counters();
+  free_ring_requests();
+}
+
+int lbann_quantizer::allreduce_fold(lbann_comm* comm, DataType* buf,
+                                    Int count, int pof2) {
+  const int rank = comm->get_model_rank();
+  const int rem = comm->get_num_models() - pof2;
+  if (rank >= 2 * rem) {
+    return rank - rem;
+  }
+  if (rank % 2 == 0) {
+    // Hand our data to the next model and sit out.
+    comm->send(buf, count, rank + 1);
+    rs_bytes_sent += count * sizeof(DataType);
+    return -1;
+  }
+  allreduce_recv_buf.resize(count);
+  DataType* recv_buf = allreduce_recv_buf.data();
+  comm->recv(recv_buf, count, rank - 1);
+  rs_bytes_received += count * sizeof(DataType);
+  #pragma omp parallel for schedule(static)
+  for (Int i = 0; i < count; ++i) {
+    buf[i] += recv_buf[i];
+  }
+  return rank / 2;
+}
+
+void lbann_quantizer::allreduce_unfold(lbann_comm* comm, DataType* buf,
+                                       Int count, int pof2) {
+  const int rank = comm->get_model_rank();
+  const int rem = comm->get_num_models() - pof2;
+  if (rank >= 2 * rem) {
+    return;
+  }
+  if (rank % 2 == 0) {
+    comm->recv(buf, count, rank + 1);
+    ag_bytes_received += count * sizeof(DataType);
+  } else {
+    comm->send(buf, count, rank - 1);
+    ag_bytes_sent += count * sizeof(DataType);
+  }
+}
+
+void lbann_quantizer::intermodel_sum_recursive_doubling(
+  lbann_comm* comm, DataType* buf, Int count) {
+  double rs_start = get_time();
+  const int pof2 = largest_pof2(comm->get_num_models());
+  const int rem = comm->get_num_models() - pof2;
+  const int new_rank = allreduce_fold(comm, buf, count, pof2);
+  if (new_rank != -1) {
+    allreduce_recv_buf.resize(count);
+    DataType* recv_buf = allreduce_recv_buf.data();
+    for (int mask = 1; mask < pof2; mask <<= 1) {
+      const int partner = allreduce_unfolded_rank(new_rank ^ mask, rem);
+      mpi::Request<DataType> req;
+      comm->nb_send(buf, count, partner, req);
+      comm->recv(recv_buf, count, partner);
+      comm->wait<DataType>(req);
+      rs_bytes_sent += count * sizeof(DataType);
+      rs_bytes_received += count * sizeof(DataType);
+      // Both partners add the same two values, so every model ends up with
+      // bitwise-identical sums.
+      #pragma omp parallel for schedule(static)
+      for (Int i = 0; i < count; ++i) {
+        buf[i] += recv_buf[i];
+      }
+    }
+  }
+  rs_time += get_time() - rs_start;
+  double ag_start = get_time();
+  allreduce_unfold(comm, buf, count, pof2);
+  ag_time += get_time() - ag_start;
+}
+
+void lbann_quantizer::intermodel_sum_rabenseifner(
+  lbann_comm* comm, DataType* buf, Int count) {
+  double rs_start = get_time();
+  const int pof2 = largest_pof2(comm->get_num_models());
+  const int rem = comm->get_num_models() - pof2;
+  const int new_rank = allreduce_fold(comm, buf, count, pof2);
+  // Blocks [lo, hi) are the part of the buffer this model is responsible for.
+  int lo = 0;
+  int hi = pof2;
+  if (new_rank != -1) {
+    allreduce_recv_buf.resize(count);
+    DataType* recv_buf = allreduce_recv_buf.data();
+    // Reduce-scatter by recursive halving: keep half, send the other half.
+    for (int mask = pof2 / 2; mask >= 1; mask >>= 1) {
+      const int partner = allreduce_unfolded_rank(new_rank ^ mask, rem);
+      const int mid = lo + (hi - lo) / 2;
+      int send_lo = mid, send_hi = hi;
+      if (new_rank & mask) {
+        send_lo = lo;
+        send_hi = mid;
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+      const Int send_off = block_offset(count, pof2, send_lo);
+      const Int send_count = block_offset(count, pof2, send_hi) - send_off;
+      const Int keep_off = block_offset(count, pof2, lo);
+      const Int keep_count = block_offset(count, pof2, hi) - keep_off;
+      mpi::Request<DataType> req;
+      comm->nb_send(buf + send_off, send_count, partner, req);
+      comm->recv(recv_buf, keep_count, partner);
+      comm->wait<DataType>(req);
+      rs_bytes_sent += send_count * sizeof(DataType);
+      rs_bytes_received += keep_count * sizeof(DataType);
+      DataType* keep_buf = buf + keep_off;
+      #pragma omp parallel for schedule(static)
+      for (Int i = 0; i < keep_count; ++i) {
+        keep_buf[i] += recv_buf[i];
+      }
+    }
+  }
+  rs_time += get_time() - rs_start;
+  double ag_start = get_time();
+  if (new_rank != -1) {
+    // Allgather by recursive doubling: exchange reduced blocks with partners
+    // holding the sibling range.
+    for (int mask = 1; mask < pof2; mask <<= 1) {
+      const int partner = allreduce_unfolded_rank(new_rank ^ mask, rem);
+      int recv_lo = hi, recv_hi = hi + mask;
+      if (new_rank & mask) {
+        recv_lo = lo - mask;
+        recv_hi = lo;
+      }
+      const Int send_off = block_offset(count, pof2, lo);
+      const Int send_count = block_offset(count, pof2, hi) - send_off;
+      const Int recv_off = block_offset(count, pof2, recv_lo);
+      const Int recv_count = block_offset(count, pof2, recv_hi) - recv_off;
+      mpi::Request<DataType> req;
+      comm->nb_send(buf + send_off, send_count, partner, req);
+      comm->recv(buf + recv_off, recv_count, partner);
+      comm->wait<DataType>(req);
+      ag_bytes_sent += send_count * sizeof(DataType);
+      ag_bytes_received += recv_count * sizeof(DataType);
+      lo = std::min(lo, recv_lo);
+      hi = std::max(hi, recv_hi);
+    }
+  }
+  allreduce_unfold(comm, buf, count, pof2);
+  ag_time += get_time() - ag_start;
+}
+
+void lbann_quantizer::intermodel_sum_ring(lbann_comm* comm, Mat& mat) {
+  if (ring_precision != payload_precision::FP32) {
+    intermodel_sum_ring_reduced(comm, mat);
+    return;
+  }
+  Mat& rs_recv = ring_rs_recv;
   auto rs_send_trans = 
     [] (Mat& mat, IR h, IR w, int& count) {
       // Assumes h is the full height of the matrix and column-major order
@@ -55,11 +420,13 @@ void lbann_quantizer::intermodel_sum(lbann_comm* comm, Mat& mat) {
       return to_send.Buffer();
     };
   auto rs_get_recv_buf =
-    [&rs_recv] (Mat& mat, int& count) {
-      if (rs_recv.Width() != mat.Width()) {
-        rs_recv.Resize(mat.Height(), mat.Width());
+    [&rs_recv, this] (Mat& mat, int& count) {
+      count = mat.Height() * mat.Width();
+      if (ring_recv_buf.size() < (size_t) count) {
+        ring_recv_buf.resize(count);
       }
-      count = rs_recv.Height() * rs_recv.Width();
+      rs_recv.Attach(mat.Height(), mat.Width(), ring_recv_buf.data(),
+                     std::max(mat.Height(), (Int) 1));
       return rs_recv.Buffer();
     };
   auto rs_recv_trans =
@@ -99,6 +466,79 @@ void lbann_quantizer::intermodel_sum(lbann_comm* comm, Mat& mat) {
                                       ag_recv_trans, ag_swap_bufs);
 }
 
+void lbann_quantizer::intermodel_sum_ring_reduced(lbann_comm* comm,
+                                                  Mat& mat) {
+  // Payloads go out as bytes (two per value) since MPI has no 16-bit float.
+  const payload_precision prec = ring_precision;
+  const int nprocs = comm->get_num_models();
+  const Int max_count =
+    mat.Height() * (mat.Width() / nprocs + mat.Width() % nprocs);
+  if (ring_payload_send.size() < (size_t) max_count) {
+    ring_payload_send.resize(max_count);
+  }
+  if (ring_payload_recv.size() < (size_t) max_count) {
+    ring_payload_recv.resize(max_count);
+  }
+  auto rs_send_trans =
+    [prec, this] (Mat& mat, IR h, IR w, int& count) {
+      auto to_send = mat(h, w);
+      pack_payload(prec, to_send.LockedBuffer(), to_send.Height(),
+                   to_send.Width(), to_send.LDim(), ring_payload_send.data());
+      count = to_send.Height() * to_send.Width() * sizeof(uint16_t);
+      return (unsigned char*) ring_payload_send.data();
+    };
+  auto rs_get_recv_buf =
+    [this] (Mat& mat, int& count) {
+      count = mat.Height() * mat.Width() * sizeof(uint16_t);
+      return (unsigned char*) ring_payload_recv.data();
+    };
+  auto rs_recv_trans =
+    [prec] (unsigned char* buf, Mat& accum) {
+      unpack_payload(prec, (const uint16_t*) buf, accum.Height(),
+                     accum.Width(), accum.LDim(), accum.Buffer(), true);
+    };
+  intermodel_ring_reduce_scatter<unsigned char>(comm, mat, false,
+                                                rs_send_trans, rs_get_recv_buf,
+                                                rs_recv_trans);
+  // Forward the reduced chunks without re-encoding; the buffers alternate.
+  unsigned char* ag_send = (unsigned char*) ring_payload_send.data();
+  unsigned char* ag_recv = (unsigned char*) ring_payload_recv.data();
+  int ag_send_count = 0;
+  auto ag_reduced_trans =
+    [prec, ag_send, &ag_send_count] (Mat& reduced) {
+      uint16_t* buf = (uint16_t*) ag_send;
+      pack_payload(prec, reduced.LockedBuffer(), reduced.Height(),
+                   reduced.Width(), reduced.LDim(), buf);
+      // Keep the rounded values locally too, so models stay identical.
+      unpack_payload(prec, buf, reduced.Height(), reduced.Width(),
+                     reduced.LDim(), reduced.Buffer());
+      ag_send_count = reduced.Height() * reduced.Width() * sizeof(uint16_t);
+    };
+  auto ag_get_send_buf =
+    [&ag_send, &ag_send_count] (int& count) {
+      count = ag_send_count;
+      return ag_send;
+    };
+  auto ag_get_recv_buf =
+    [&ag_recv] (Mat& recv_view, int& count) {
+      count = recv_view.Height() * recv_view.Width() * sizeof(uint16_t);
+      return ag_recv;
+    };
+  auto ag_recv_trans =
+    [prec, &ag_send_count] (unsigned char* buf, Mat& accum) {
+      unpack_payload(prec, (const uint16_t*) buf, accum.Height(),
+                     accum.Width(), accum.LDim(), accum.Buffer());
+      ag_send_count = accum.Height() * accum.Width() * sizeof(uint16_t);
+    };
+  auto ag_swap_bufs =
+    [&ag_send, &ag_recv] (unsigned char*, unsigned char*) {
+      std::swap(ag_send, ag_recv);
+    };
+  intermodel_ring_allgather<unsigned char>(comm, mat, false, ag_reduced_trans,
+                                           ag_get_send_buf, ag_get_recv_buf,
+                                           ag_recv_trans, ag_swap_bufs);
+}
+
 void lbann_quantizer::intermodel_sum(lbann_comm* comm, DistMat& mat) {
   intermodel_sum(comm, mat.Matrix());
 }
@@ -125,17 +565,9 @@ void lbann_quantizer::quantize(
     Unsigned num_pos = 0;
     Unsigned num_neg = 0;
     if (height <= NUM_ONEBIT_SAMPLES || !sample) {
-      for (Int row = 0; row < height; ++row) {
-        const Int pos = row + col * ldim;
-        const DataType val = mat_buf[pos] + qerror_buf[pos];
-        if (val >= 0.0f) {
-          pos_sum += val;
-          ++num_pos;
-        } else {
-          neg_sum += val;
-          ++num_neg;
-        }
-      }
+      quantizer_kernels::onebit_column_sums(
+        &mat_buf[col * ldim], &qerror_buf[col * ldim], height,
+        pos_sum, neg_sum, num_pos, num_neg);
     } else {
       // Randomly sample NUM_ONEBIT_SAMPLES to approximate.
       std::uniform_int_distribution<int> row_dist(0, height - 1);
@@ -171,6 +603,14 @@ void lbann_quantizer::quantize(
     qmat.Set(1, col, tmp);
 
     // Now quantize the column, NUM_BITS entries at a time.
+    if (sizeof(qtype) == sizeof(uint32_t)) {
+      // qtype and uint32_t differ only in signedness, so this may alias.
+      quantizer_kernels::onebit_quantize_column(
+        &mat_buf[col * ldim], &qerror_buf[col * ldim], height, avg_pos,
+        avg_neg, reinterpret_cast<uint32_t*>(&qmat_buf[2 + col * qmat_ldim]),
+        qheight - 2);
+      continue;
+    }
     Int qrow = 2;
     for (Int row_chunk = 0; row_chunk < height; row_chunk += NUM_BITS) {
       uqtype q = 0;
@@ -217,6 +657,12 @@ void lbann_quantizer::unquantize(const QuantizedMatrix& qmat, Mat& mat) {
     DataType avg_neg;
     memcpy(&avg_neg, &tmp, sizeof(avg_neg));
     // Unquantize this column.
+    if (sizeof(qtype) == sizeof(uint32_t)) {
+      quantizer_kernels::onebit_unquantize_column(
+        reinterpret_cast<const uint32_t*>(&qmat_buf[2 + col * qmat_ldim]),
+        &mat_buf[col * ldim], height, avg_pos, avg_neg, false);
+      continue;
+    }
     for (Int row_chunk = 0; row_chunk < height; row_chunk += NUM_BITS) {
       uqtype q = (uqtype) qmat_buf[qrow + col * qmat_ldim];
       for (size_t bit = 0; bit < NUM_BITS; ++bit) {
@@ -253,6 +699,12 @@ void lbann_quantizer::unquantize_add(const QuantizedMatrix& qmat, Mat& mat) {
     DataType avg_neg;
     memcpy(&avg_neg, &tmp, sizeof(avg_neg));
     // Unquantize this column.
+    if (sizeof(qtype) == sizeof(uint32_t)) {
+      quantizer_kernels::onebit_unquantize_column(
+        reinterpret_cast<const uint32_t*>(&qmat_buf[2 + col * qmat_ldim]),
+        &mat_buf[col * ldim], height, avg_pos, avg_neg, true);
+      continue;
+    }
     for (Int row_chunk = 0; row_chunk < height; row_chunk += NUM_BITS) {
       uqtype q = (uqtype) qmat_buf[qrow + col * qmat_ldim];
       for (size_t bit = 0; bit < NUM_BITS; ++bit) {
@@ -270,37 +722,68 @@ void lbann_quantizer::unquantize_add(const QuantizedMatrix& qmat, Mat& mat) {
 void lbann_quantizer::intermodel_sum_quantized(
   lbann_comm* comm, Mat& mat, Mat& qerror, Mat& im_qerror,
   bool do_adagrad, Mat* gradhist) {
+  comm_trace_scope trace(comm->get_tracer(), "quantized_allreduce",
+                         "intermodel",
+                         sizeof(DataType) * mat.Height() * mat.Width());
+  trace.set_algorithm("onebit");
   // Initialize qerror.
   if (qerror.Height() == 0) {
     qerror.Resize(mat.Height(), mat.Width(), mat.LDim());
     Zero(qerror);
   }
-  QuantizedMatrix to_send_quant;
-  QuantizedMatrix rs_recv;
-  auto rs_send_trans =
-    [&qerror, &to_send_quant, this] (Mat& mat, IR h, IR w, int& count) {
-      auto to_send = mat(h, w);
-      auto to_send_qerr = qerror(h, w);
-      quantize(to_send, to_send_quant, to_send_qerr);
-      count = to_send_quant.Height() * to_send_quant.Width();
-      return to_send_quant.Buffer();
-    };
-  auto rs_get_recv_buf = 
-    [&rs_recv, this] (Mat& mat, int& count) {
-      if (rs_recv.Width() != mat.Width()) {
-        rs_recv.Resize(get_quantized_matrix_height(mat), mat.Width());
-      }
-      count = rs_recv.Height() * rs_recv.Width();
-      return rs_recv.Buffer();
-    };
-  auto rs_recv_trans = 
-    [&rs_recv, this] (qtype*, Mat& accum) {
-      unquantize_add(rs_recv, accum);
-    };
-  intermodel_ring_reduce_scatter<qtype>(comm, mat, false, rs_send_trans,
-                                        rs_get_recv_buf, rs_recv_trans);
-  QuantizedMatrix ag_send;
-  QuantizedMatrix ag_recv;
+  if (ring_segment_bytes > 0) {
+    auto seg_send_trans =
+      [&qerror, this] (Mat& mat, IR h, IR w, int slot, int& count) {
+        auto to_send = mat(h, w);
+        auto to_send_qerr = qerror(h, w);
+        quantize(to_send, onebit_seg_send[slot], to_send_qerr);
+        count = onebit_seg_send[slot].Height() * onebit_seg_send[slot].Width();
+        return onebit_seg_send[slot].Buffer();
+      };
+    auto seg_get_recv_buf =
+      [this] (Mat& seg, int slot, int& count) {
+        onebit_seg_recv[slot].Resize(get_quantized_matrix_height(seg),
+                                     seg.Width());
+        count = onebit_seg_recv[slot].Height() * onebit_seg_recv[slot].Width();
+        return onebit_seg_recv[slot].Buffer();
+      };
+    auto seg_recv_trans =
+      [this] (qtype*, Mat& accum, int slot) {
+        unquantize_add(onebit_seg_recv[slot], accum);
+      };
+    intermodel_ring_reduce_scatter_pipelined<qtype>(
+      comm, mat, get_segment_cols(mat), seg_send_trans, seg_get_recv_buf,
+      seg_recv_trans);
+  } else {
+    QuantizedMatrix& to_send_quant = onebit_to_send;
+    QuantizedMatrix& rs_recv = onebit_rs_recv;
+    auto rs_send_trans =
+      [&qerror, &to_send_quant, this] (Mat& mat, IR h, IR w, int& count) {
+        auto to_send = mat(h, w);
+        auto to_send_qerr = qerror(h, w);
+        quantize(to_send, to_send_quant, to_send_qerr);
+        count = to_send_quant.Height() * to_send_quant.Width();
+        return to_send_quant.Buffer();
+      };
+    auto rs_get_recv_buf = 
+      [&rs_recv, this] (Mat& mat, int& count) {
+        const Int qheight = get_quantized_matrix_height(mat);
+        count = qheight * mat.Width();
+        if (onebit_recv_buf.size() < (size_t) count) {
+          onebit_recv_buf.resize(count);
+        }
+        rs_recv.Attach(qheight, mat.Width(), onebit_recv_buf.data(), qheight);
+        return rs_recv.Buffer();
+      };
+    auto rs_recv_trans = 
+      [&rs_recv, this] (qtype*, Mat& accum) {
+        unquantize_add(rs_recv, accum);
+      };
+    intermodel_ring_reduce_scatter<qtype>(comm, mat, false, rs_send_trans,
+                                          rs_get_recv_buf, rs_recv_trans);
+  }
+  QuantizedMatrix& ag_send = onebit_ag_send;
+  QuantizedMatrix& ag_recv = onebit_ag_recv;
   std::function<DataType(const DataType&)> _sq = [](const DataType& x) { return x*x; };
   std::function<DataType(const DataType&)> _sqrt =
     [](const DataType& x) { return 1.0f / (std::sqrt(x) + 1e-8f); };
@@ -349,6 +832,11 @@ void lbann_quantizer::intermodel_sum_quantized(
   intermodel_ring_allgather<qtype>(comm, mat, false, ag_reduced_trans,
                                    ag_get_send_buf, ag_get_recv_buf,
                                    ag_recv_trans, ag_swap_bufs);
+  // Undo an odd number of swaps so each ring step keeps its buffers (and
+  // persistent requests) across calls.
+  if ((comm->get_num_models() - 1) % 2 != 0) {
+    std::swap(ag_send, ag_recv);
+  }
 }
 
 void lbann_quantizer::intermodel_sum_quantized(
@@ -371,6 +859,11 @@ void lbann_quantizer::threshold_quantize(const Mat& mat, ThreshQuantized& quant,
   if (delta) {
     Unsigned prev_pos = 0;
     for (Int col = 0; col < width; ++col) {
+      if (sizeof(uqtype) == sizeof(uint32_t)) {
+        threshold_scan_column(mat_buf, qerror_buf, col * ldim, height,
+                              pos_thresh, neg_thresh, quant, &prev_pos);
+        continue;
+      }
       for (Int row = 0; row < height; ++row) {
         const Unsigned pos = row + col * ldim;
         const DataType val = mat_buf[pos] + qerror_buf[pos];
@@ -394,6 +887,12 @@ void lbann_quantizer::threshold_quantize(const Mat& mat, ThreshQuantized& quant,
       const int tid = omp_get_thread_num();
       #pragma omp for schedule(static)
       for (Int col = 0; col < width; ++col) {
+        if (sizeof(uqtype) == sizeof(uint32_t)) {
+          threshold_scan_column(mat_buf, qerror_buf, col * ldim, height,
+                                pos_thresh, neg_thresh, thread_qs[tid],
+                                nullptr);
+          continue;
+        }
         for (Int row = 0; row < height; ++row) {
           const Unsigned pos = row + col * ldim;
           const DataType val = mat_buf[pos] + qerror_buf[pos];
@@ -416,6 +915,31 @@ void lbann_quantizer::threshold_quantize(const Mat& mat, ThreshQuantized& quant,
   }
 }
 
+void lbann_quantizer::threshold_scan_column(
+  const DataType* mat_buf, DataType* qerror_buf, Unsigned start, Int height,
+  DataType pos_thresh, DataType neg_thresh, ThreshQuantized& quant,
+  Unsigned* prev_pos) {
+  // Scan in blocks so the kernel can write to a fixed buffer and only the
+  // entries that pass the threshold are appended.
+  uint32_t block[THRESHOLD_SCAN_BLOCK];
+  for (Int row = 0; row < height; row += THRESHOLD_SCAN_BLOCK) {
+    const Int rows = std::min(height - row, (Int) THRESHOLD_SCAN_BLOCK);
+    const Unsigned pos = start + row;
+    const size_t n = quantizer_kernels::threshold_scan(
+      &mat_buf[pos], &qerror_buf[pos], rows, pos, pos_thresh, neg_thresh,
+      block);
+    if (prev_pos != nullptr) {
+      // Convert absolute positions to deltas.
+      for (size_t i = 0; i < n; ++i) {
+        const Unsigned p = block[i] >> 1;
+        block[i] = ((p - *prev_pos) << 1) | (block[i] & 1);
+        *prev_pos = p;
+      }
+    }
+    quant.insert(quant.end(), block, block + n);
+  }
+}
+
 void lbann_quantizer::threshold_quantize(
   const DistMat& mat, ThreshQuantized& q, Mat& qerror, DataType pos_thresh,
   DataType neg_thresh, bool delta) {
@@ -465,24 +989,29 @@ void lbann_quantizer::threshold_unquantize_apply(
   // the final unquantize is not an _apply, and so will just set that entry to
   // the same value multiple times. We send some extra data, but the overhead
   // is small.
+  // The scattered (and possibly duplicated) updates to buf have to stay
+  // scalar, but the positions can be decoded in bulk.
   DataType* __restrict__ buf = mat.Buffer();
+  const size_t first = positions.size();
+  positions.resize(first + quant.size());
+  Unsigned* __restrict__ pos_buf = positions.data() + first;
+  const uqtype* __restrict__ quant_buf = quant.data();
   if (delta) {
     Unsigned prev_pos = 0;
     for (Unsigned i = 0; i < quant.size(); ++i) {
-      const uqtype q = quant[i];
+      const uqtype q = quant_buf[i];
       const Unsigned pos = (q >> 1) + prev_pos;
       prev_pos = pos;
-      positions.emplace_back(pos);
+      pos_buf[i] = pos;
       if (q & 1) buf[pos] += pos_thresh;
       else buf[pos] += neg_thresh;
     }
   } else {
     for (Unsigned i = 0; i < quant.size(); ++i) {
-      const uqtype q = quant[i];
-      const Unsigned pos = q >> 1;
-      positions.emplace_back(pos);
-      if (q & 1) buf[pos] += pos_thresh;
-      else buf[pos] += neg_thresh;
+      pos_buf[i] = quant_buf[i] >> 1;
+    }
+    for (Unsigned i = 0; i < quant.size(); ++i) {
+      buf[pos_buf[i]] += quant_buf[i] & 1 ? pos_thresh : neg_thresh;
     }
   }
 }
@@ -492,6 +1021,9 @@ void lbann_quantizer::threshold_quantize_apply(
   DataType neg_thresh, std::vector<Unsigned>& positions, bool delta) {
   const DataType* __restrict__ mat_buf = mat.LockedBuffer();
   DataType* __restrict__ qerror_buf = qerror.Buffer();
+  // Entries are visited in position order and may repeat, so this cannot use
+  // the vectorized threshold scan; at least avoid regrowing quant.
+  quant.reserve(quant.size() + positions.size());
   if (delta) {
     // Need to sort so positions are in order, otherwise our delta encoding
     // doesn't work. (Could be solved by adding stops, but maybe not worth it.)
@@ -530,6 +1062,10 @@ void lbann_quantizer::threshold_quantize_apply(
 void lbann_quantizer::intermodel_sum_threshold_quantized(
   lbann_comm* comm, Mat& mat, Mat& qerror, DataType pos_thresh,
   DataType neg_thresh, Mat& im_qerror, bool compress) {
+  comm_trace_scope trace(comm->get_tracer(), "quantized_allreduce",
+                         "intermodel",
+                         sizeof(DataType) * mat.Height() * mat.Width());
+  trace.set_algorithm("threshold");
   if (qerror.Height() == 0) {
     qerror.Resize(mat.Height(), mat.Width(), mat.LDim());
     Zero(qerror);
@@ -627,18 +1163,20 @@ void lbann_quantizer::intermodel_sum_threshold_quantized(
 
 void lbann_quantizer::intermodel_sum_adaptive_threshold_quantized(
   lbann_comm* comm, Mat& mat, Mat& qerror, int proportion, Mat& im_qerror) {
+  comm_trace_scope trace(comm->get_tracer(), "quantized_allreduce",
+                         "intermodel",
+                         sizeof(DataType) * mat.Height() * mat.Width());
+  trace.set_algorithm("adaptive threshold");
   // Select which algorithm to use based on the size of mat.
   // Multiply at 64 bits to avoid overflows.
   size_t mat_size = ((size_t) mat.Height()) * ((size_t) mat.Width());
   // Check signed version because we need one bit for the quantized value.
   if (mat_size > std::numeric_limits<int32_t>::max()) {
     intermodel_sum_adaptive_threshold_quantized_impl<uint64_t>(
-      comm, mat, qerror, proportion, im_qerror, adaptive_recv64_bufs1,
-      adaptive_recv64_bufs2);
+      comm, mat, qerror, proportion, im_qerror, adaptive_bufs64);
   } else {
     intermodel_sum_adaptive_threshold_quantized_impl<uint32_t>(
-      comm, mat, qerror, proportion, im_qerror, adaptive_recv32_bufs1,
-      adaptive_recv32_bufs2);
+      comm, mat, qerror, proportion, im_qerror, adaptive_bufs32);
   }
 }
 
@@ -648,6 +1186,475 @@ void lbann_quantizer::intermodel_sum_adaptive_threshold_quantized(
                                               proportion, im_qerror);
 }
 
+void lbann_quantizer::topk_quantize(const Mat& mat, TopKQuantized& q,
+                                    Mat& qerror, Int k) {
+  const Int height = mat.Height();
+  const Int width = mat.Width();
+  const Int ldim = mat.LDim();
+  if (ldim != qerror.LDim()) std::cout << "ldims don't match!" << std::endl;
+  const DataType* __restrict__ mat_buf = mat.LockedBuffer();
+  DataType* __restrict__ qerror_buf = qerror.Buffer();
+  q.clear();
+  // Fold the new values into the error feedback; whatever is not selected
+  // stays there for the next round.
+  #pragma omp parallel for schedule(static)
+  for (Int col = 0; col < width; ++col) {
+    for (Int row = 0; row < height; ++row) {
+      qerror_buf[row + col * ldim] += mat_buf[row + col * ldim];
+    }
+  }
+  k = std::min(k, height * width);
+  quantized_count = std::max(k, (Int) 0);
+  if (k <= 0) {
+    return;
+  }
+  Int num_equal;
+  const uint64_t kth_key = topk_select_key(qerror_buf, height, width, ldim, k,
+                                           num_equal);
+  // Collect everything above the k-th key, and the entries equal to it. The
+  // static schedule gives each thread one contiguous range of columns, in
+  // thread order, so concatenating the per-thread lists keeps them sorted.
+  const int nthreads = omp_get_max_threads();
+  std::vector<TopKQuantized> thread_above(nthreads);
+  std::vector<TopKQuantized> thread_equal(nthreads);
+  #pragma omp parallel
+  {
+    const int tid = omp_get_thread_num();
+    #pragma omp for schedule(static)
+    for (Int col = 0; col < width; ++col) {
+      for (Int row = 0; row < height; ++row) {
+        const uqtype pos = row + col * ldim;
+        const uint64_t key = topk_key(qerror_buf[pos]);
+        if (key > kth_key) {
+          thread_above[tid].push_back({pos, qerror_buf[pos]});
+        } else if (key == kth_key) {
+          thread_equal[tid].push_back({pos, qerror_buf[pos]});
+        }
+      }
+    }
+  }
+  TopKQuantized above;
+  TopKQuantized equal;
+  above.reserve(k);
+  equal.reserve(num_equal);
+  for (int t = 0; t < nthreads; ++t) {
+    above.insert(above.end(), thread_above[t].begin(), thread_above[t].end());
+    for (size_t i = 0; i < thread_equal[t].size() &&
+           (Int) equal.size() < num_equal; ++i) {
+      equal.push_back(thread_equal[t][i]);
+    }
+  }
+  q.resize(above.size() + equal.size());
+  std::merge(above.begin(), above.end(), equal.begin(), equal.end(), q.begin(),
+             [] (const topk_entry& a, const topk_entry& b) {
+               return a.pos < b.pos;
+             });
+  // The selected entries are sent, so they leave the error feedback.
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < q.size(); ++i) {
+    qerror_buf[q[i].pos] = 0.0f;
+  }
+}
+
+void lbann_quantizer::topk_quantize(const DistMat& mat, TopKQuantized& q,
+                                    Mat& qerror, Int k) {
+  topk_quantize(mat.LockedMatrix(), q, qerror, k);
+}
+
+uint64_t lbann_quantizer::topk_select_key(const DataType* buf, Int height,
+                                          Int width, Int ldim, Int k,
+                                          Int& num_equal) {
+  // Radix selection, most significant digit first: each pass histograms the
+  // next digit of the entries that match the digits found so far, then picks
+  // the digit that holds the k-th largest key.
+  const int key_bits = sizeof(DataType) * 8;
+  const int num_bins = 1 << TOPK_RADIX_BITS;
+  const int nthreads = omp_get_max_threads();
+  std::vector<Int> hist(nthreads * num_bins);
+  uint64_t prefix = 0;
+  uint64_t prefix_mask = 0;
+  // Rank of the target among the matching entries, counting from the top.
+  Int remaining = k;
+  for (int shift = key_bits; shift > 0;) {
+    const int digit_bits = std::min((int) TOPK_RADIX_BITS, shift);
+    shift -= digit_bits;
+    const uint64_t digit_mask = (uint64_t(1) << digit_bits) - 1;
+    std::fill(hist.begin(), hist.end(), 0);
+    #pragma omp parallel
+    {
+      Int* __restrict__ thread_hist = &hist[omp_get_thread_num() * num_bins];
+      #pragma omp for schedule(static)
+      for (Int col = 0; col < width; ++col) {
+        for (Int row = 0; row < height; ++row) {
+          const uint64_t key = topk_key(buf[row + col * ldim]);
+          if ((key & prefix_mask) == prefix) {
+            ++thread_hist[(key >> shift) & digit_mask];
+          }
+        }
+      }
+    }
+    uint64_t digit = digit_mask;
+    while (true) {
+      Int bin_count = 0;
+      for (int t = 0; t < nthreads; ++t) {
+        bin_count += hist[t * num_bins + digit];
+      }
+      if (bin_count >= remaining || digit == 0) {
+        break;
+      }
+      remaining -= bin_count;
+      --digit;
+    }
+    prefix |= digit << shift;
+    prefix_mask |= digit_mask << shift;
+  }
+  num_equal = remaining;
+  return prefix;
+}
+
+void lbann_quantizer::topk_unquantize(const TopKQuantized& q, Mat& mat) {
+  Zero(mat);
+  topk_unquantize_add(q, mat);
+}
+
+void lbann_quantizer::topk_unquantize(const TopKQuantized& q, DistMat& mat) {
+  topk_unquantize(q, mat.Matrix());
+}
+
+void lbann_quantizer::topk_unquantize_add(const TopKQuantized& q, Mat& mat) {
+  DataType* __restrict__ buf = mat.Buffer();
+  // Positions are unique, so this can be done in parallel.
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < q.size(); ++i) {
+    buf[q[i].pos] += q[i].value;
+  }
+}
+
+void lbann_quantizer::topk_merge(const TopKQuantized& a,
+                                 const TopKQuantized& b, TopKQuantized& out) {
+  out.clear();
+  out.reserve(a.size() + b.size());
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (a[i].pos < b[j].pos) {
+      out.push_back(a[i++]);
+    } else if (b[j].pos < a[i].pos) {
+      out.push_back(b[j++]);
+    } else {
+      // Addition commutes, so both partners compute the same value.
+      out.push_back({a[i].pos, a[i].value + b[j].value});
+      ++i;
+      ++j;
+    }
+  }
+  out.insert(out.end(), a.begin() + i, a.end());
+  out.insert(out.end(), b.begin() + j, b.end());
+}
+
+void lbann_quantizer::intermodel_sum_topk(lbann_comm* comm, Mat& mat,
+                                          Mat& qerror, int proportion) {
+  comm_trace_scope trace(comm->get_tracer(), "quantized_allreduce",
+                         "intermodel",
+                         sizeof(DataType) * mat.Height() * mat.Width());
+  trace.set_algorithm("top-k");
+  static_assert(sizeof(topk_entry) % sizeof(uqtype) == 0,
+                "top-k entries must be a whole number of words");
+  const int entry_words = sizeof(topk_entry) / sizeof(uqtype);
+  if (qerror.Height() == 0) {
+    qerror.Resize(mat.Height(), mat.Width(), mat.LDim());
+    Zero(qerror);
+  }
+  double start = get_time();
+  const Int count = mat.Height() * mat.Width();
+  topk_quantize(mat, topk_send, qerror, std::max(count / proportion, (Int) 1));
+  rs_send_trans_time += get_time() - start;
+  const int num_models = comm->get_num_models();
+  if (num_models == largest_pof2(num_models)) {
+    // Recursive doubling, merging the sparse vectors at each step. They only
+    // grow where the models selected different positions.
+    start = get_time();
+    const int rank = comm->get_model_rank();
+    for (int mask = 1; mask < num_models; mask <<= 1) {
+      const int partner = rank ^ mask;
+      const int send_words = topk_send.size() * entry_words;
+      mpi::Request<uqtype> req;
+      comm->nb_send(reinterpret_cast<uqtype*>(topk_send.data()), send_words,
+                    partner, req);
+      const int recv_words = comm->get_count<uqtype>(partner);
+      topk_recv.resize(recv_words / entry_words);
+      comm->recv(reinterpret_cast<uqtype*>(topk_recv.data()), recv_words,
+                 partner);
+      comm->wait<uqtype>(req);
+      rs_bytes_sent += send_words * sizeof(uqtype);
+      rs_bytes_received += recv_words * sizeof(uqtype);
+      topk_merge(topk_send, topk_recv, topk_merged);
+      std::swap(topk_send, topk_merged);
+    }
+    rs_time += get_time() - start;
+    start = get_time();
+    topk_unquantize(topk_send, mat);
+    rs_recv_trans_time += get_time() - start;
+  } else {
+    // Every model sends exactly the same number of entries.
+    start = get_time();
+    const int send_words = topk_send.size() * entry_words;
+    topk_recv.resize(topk_send.size() * num_models);
+    comm->intermodel_allgather(reinterpret_cast<uqtype*>(topk_send.data()),
+                               reinterpret_cast<uqtype*>(topk_recv.data()),
+                               send_words);
+    ag_bytes_sent += send_words * sizeof(uqtype) * (num_models - 1);
+    ag_bytes_received += send_words * sizeof(uqtype) * (num_models - 1);
+    ag_time += get_time() - start;
+    // Sum in model order so every model gets bitwise-identical results.
+    start = get_time();
+    Zero(mat);
+    for (int m = 0; m < num_models; ++m) {
+      TopKQuantized::const_iterator first =
+        topk_recv.begin() + m * topk_send.size();
+      DataType* __restrict__ buf = mat.Buffer();
+      #pragma omp parallel for schedule(static)
+      for (size_t i = 0; i < topk_send.size(); ++i) {
+        buf[first[i].pos] += first[i].value;
+      }
+    }
+    ag_recv_trans_time += get_time() - start;
+  }
+}
+
+void lbann_quantizer::intermodel_sum_topk(lbann_comm* comm, DistMat& mat,
+                                          Mat& qerror, int proportion) {
+  intermodel_sum_topk(comm, mat.Matrix(), qerror, proportion);
+}
+
+void lbann_quantizer::get_qsgd_layout(Int height, int bits, Int& bucket_rows,
+                                      Int& num_buckets,
+                                      Int& bucket_words) const {
+  if (bits != 2 && bits != 4 && bits != 8) {
+    throw lbann_exception("lbann_quantizer: QSGD supports 2, 4 or 8 bits, not " +
+                          std::to_string(bits));
+  }
+  const Int codes_per_word = NUM_BITS / bits;
+  bucket_rows = std::max(std::min(height, (Int) QSGD_BUCKET_SIZE), (Int) 1);
+  num_buckets = (height + bucket_rows - 1) / bucket_rows;
+  bucket_words = 1 + (bucket_rows + codes_per_word - 1) / codes_per_word;
+}
+
+Int lbann_quantizer::get_qsgd_matrix_height(const Mat& mat, int bits) const {
+  Int bucket_rows, num_buckets, bucket_words;
+  get_qsgd_layout(mat.Height(), bits, bucket_rows, num_buckets, bucket_words);
+  return num_buckets * bucket_words;
+}
+
+void lbann_quantizer::qsgd_quantize(const Mat& mat, QuantizedMatrix& qmat,
+                                    int bits, uint64_t key) {
+  Int bucket_rows, num_buckets, bucket_words;
+  get_qsgd_layout(mat.Height(), bits, bucket_rows, num_buckets, bucket_words);
+  const Int width = mat.Width();
+  const Int height = mat.Height();
+  const Int ldim = mat.LDim();
+  qmat.Resize(num_buckets * bucket_words, width);
+  const Int qmat_ldim = qmat.LDim();
+  const DataType* __restrict__ mat_buf = mat.LockedBuffer();
+  qtype* __restrict__ qmat_buf = qmat.Buffer();
+  const Int codes_per_word = NUM_BITS / bits;
+  const uqtype sign_bit = uqtype(1) << (bits - 1);
+  const DataType levels = (DataType) (sign_bit - 1);
+  #pragma omp parallel for schedule(static)
+  for (Int col = 0; col < width; ++col) {
+    const DataType* __restrict__ col_buf = &mat_buf[col * ldim];
+    qtype* __restrict__ qcol_buf = &qmat_buf[col * qmat_ldim];
+    for (Int bucket = 0; bucket < num_buckets; ++bucket) {
+      const Int start = bucket * bucket_rows;
+      const Int end = std::min(start + bucket_rows, height);
+      DataType norm = 0.0f;
+      for (Int row = start; row < end; ++row) {
+        norm = std::max(norm, std::fabs(col_buf[row]));
+      }
+      // Store the norm first.
+      // Use memcpy so that we don't violate aliasing rules.
+      qtype* __restrict__ bucket_buf = &qcol_buf[bucket * bucket_words];
+      qtype tmp = 0;
+      memcpy(&tmp, &norm, sizeof(norm));
+      bucket_buf[0] = tmp;
+      const DataType scale = norm > 0.0f ? levels / norm : 0.0f;
+      for (Int word = 0; word < bucket_words - 1; ++word) {
+        uqtype q = 0;
+        const Int word_start = start + word * codes_per_word;
+        const Int word_end = std::min(word_start + codes_per_word, end);
+        for (Int row = word_start; row < word_end; ++row) {
+          const DataType val = col_buf[row];
+          const DataType level = std::fabs(val) * scale;
+          uqtype code = (uqtype) level;
+          const uint64_t counter = (uint64_t) row + (uint64_t) col * height;
+          if (counter_uniform(key, counter) < level - (DataType) code) {
+            ++code;
+          }
+          code = std::min(code, sign_bit - 1);
+          if (val < 0.0f) {
+            code |= sign_bit;
+          }
+          q |= code << ((row - word_start) * bits);
+        }
+        bucket_buf[1 + word] = (qtype) q;
+      }
+    }
+  }
+}
+
+void lbann_quantizer::qsgd_unquantize_impl(const QuantizedMatrix& qmat,
+                                           Mat& mat, int bits, bool add) {
+  Int bucket_rows, num_buckets, bucket_words;
+  get_qsgd_layout(mat.Height(), bits, bucket_rows, num_buckets, bucket_words);
+  const Int width = mat.Width();
+  const Int height = mat.Height();
+  const Int ldim = mat.LDim();
+  const Int qmat_ldim = qmat.LDim();
+  const qtype* __restrict__ qmat_buf = qmat.LockedBuffer();
+  DataType* __restrict__ mat_buf = mat.Buffer();
+  const Int codes_per_word = NUM_BITS / bits;
+  const uqtype sign_bit = uqtype(1) << (bits - 1);
+  const uqtype code_mask = (uqtype(1) << bits) - 1;
+  const DataType levels = (DataType) (sign_bit - 1);
+  #pragma omp parallel for schedule(static)
+  for (Int col = 0; col < width; ++col) {
+    DataType* __restrict__ col_buf = &mat_buf[col * ldim];
+    const qtype* __restrict__ qcol_buf = &qmat_buf[col * qmat_ldim];
+    for (Int bucket = 0; bucket < num_buckets; ++bucket) {
+      const Int start = bucket * bucket_rows;
+      const Int end = std::min(start + bucket_rows, height);
+      const qtype* __restrict__ bucket_buf = &qcol_buf[bucket * bucket_words];
+      qtype tmp = bucket_buf[0];
+      DataType norm;
+      memcpy(&norm, &tmp, sizeof(norm));
+      const DataType step = norm / levels;
+      for (Int row = start; row < end; ++row) {
+        const Int i = row - start;
+        const uqtype code =
+          ((uqtype) bucket_buf[1 + i / codes_per_word] >>
+           ((i % codes_per_word) * bits)) & code_mask;
+        DataType val = (DataType) (code & (sign_bit - 1)) * step;
+        if (code & sign_bit) {
+          val = -val;
+        }
+        if (add) {
+          col_buf[row] += val;
+        } else {
+          col_buf[row] = val;
+        }
+      }
+    }
+  }
+}
+
+void lbann_quantizer::qsgd_unquantize(const QuantizedMatrix& qmat, Mat& mat,
+                                      int bits) {
+  qsgd_unquantize_impl(qmat, mat, bits, false);
+}
+
+void lbann_quantizer::qsgd_unquantize_add(const QuantizedMatrix& qmat,
+                                          Mat& mat, int bits) {
+  qsgd_unquantize_impl(qmat, mat, bits, true);
+}
+
+uint64_t lbann_quantizer::next_qsgd_key(lbann_comm* comm) {
+  // Distinct per process and per call, but reproducible from the seed.
+  return counter_random(counter_random(qsgd_seed, comm->get_rank_in_world()),
+                        qsgd_round++);
+}
+
+void lbann_quantizer::intermodel_sum_qsgd(lbann_comm* comm, Mat& mat,
+                                          int bits) {
+  comm_trace_scope trace(comm->get_tracer(), "quantized_allreduce",
+                         "intermodel",
+                         sizeof(DataType) * mat.Height() * mat.Width());
+  trace.set_algorithm("qsgd");
+  if (ring_segment_bytes > 0) {
+    auto seg_send_trans =
+      [comm, bits, this] (Mat& mat, IR h, IR w, int slot, int& count) {
+        auto to_send = mat(h, w);
+        qsgd_quantize(to_send, qsgd_seg_send[slot], bits, next_qsgd_key(comm));
+        count = qsgd_seg_send[slot].Height() * qsgd_seg_send[slot].Width();
+        return qsgd_seg_send[slot].Buffer();
+      };
+    auto seg_get_recv_buf =
+      [bits, this] (Mat& seg, int slot, int& count) {
+        qsgd_seg_recv[slot].Resize(get_qsgd_matrix_height(seg, bits),
+                                   seg.Width());
+        count = qsgd_seg_recv[slot].Height() * qsgd_seg_recv[slot].Width();
+        return qsgd_seg_recv[slot].Buffer();
+      };
+    auto seg_recv_trans =
+      [bits, this] (qtype*, Mat& accum, int slot) {
+        qsgd_unquantize_add(qsgd_seg_recv[slot], accum, bits);
+      };
+    intermodel_ring_reduce_scatter_pipelined<qtype>(
+      comm, mat, get_segment_cols(mat), seg_send_trans, seg_get_recv_buf,
+      seg_recv_trans);
+  } else {
+    auto rs_send_trans =
+      [comm, bits, this] (Mat& mat, IR h, IR w, int& count) {
+        auto to_send = mat(h, w);
+        qsgd_quantize(to_send, qsgd_to_send, bits, next_qsgd_key(comm));
+        count = qsgd_to_send.Height() * qsgd_to_send.Width();
+        return qsgd_to_send.Buffer();
+      };
+    auto rs_get_recv_buf =
+      [bits, this] (Mat& mat, int& count) {
+        qsgd_rs_recv.Resize(get_qsgd_matrix_height(mat, bits), mat.Width());
+        count = qsgd_rs_recv.Height() * qsgd_rs_recv.Width();
+        return qsgd_rs_recv.Buffer();
+      };
+    auto rs_recv_trans =
+      [bits, this] (qtype*, Mat& accum) {
+        qsgd_unquantize_add(qsgd_rs_recv, accum, bits);
+      };
+    intermodel_ring_reduce_scatter<qtype>(comm, mat, false, rs_send_trans,
+                                          rs_get_recv_buf, rs_recv_trans);
+  }
+  QuantizedMatrix& ag_send = qsgd_ag_send;
+  QuantizedMatrix& ag_recv = qsgd_ag_recv;
+  auto ag_reduced_trans =
+    [comm, bits, &ag_send, this] (Mat& reduced) {
+      // Replace our own block with its quantized value too, so every model
+      // ends up with the same sum.
+      qsgd_quantize(reduced, ag_send, bits, next_qsgd_key(comm));
+      qsgd_unquantize(ag_send, reduced, bits);
+    };
+  auto ag_get_send_buf = [&ag_send] (int& count) {
+      count = ag_send.Height() * ag_send.Width();
+      return ag_send.Buffer();
+    };
+  auto ag_get_recv_buf =
+    [&ag_recv, bits, this] (Mat& recv_view, int& count) {
+      ag_recv.Resize(get_qsgd_matrix_height(recv_view, bits),
+                     recv_view.Width());
+      count = ag_recv.Height() * ag_recv.Width();
+      return ag_recv.Buffer();
+    };
+  auto ag_recv_trans =
+    [&ag_recv, bits, this] (qtype*, Mat& accum) {
+      qsgd_unquantize(ag_recv, accum, bits);
+    };
+  auto ag_swap_bufs =
+    [&ag_send, &ag_recv] (qtype*, qtype*) {
+      std::swap(ag_send, ag_recv);
+    };
+  intermodel_ring_allgather<qtype>(comm, mat, false, ag_reduced_trans,
+                                   ag_get_send_buf, ag_get_recv_buf,
+                                   ag_recv_trans, ag_swap_bufs);
+  // Undo an odd number of swaps so each ring step keeps its buffers (and
+  // persistent requests) across calls.
+  if ((comm->get_num_models() - 1) % 2 != 0) {
+    std::swap(ag_send, ag_recv);
+  }
+}
+
+void lbann_quantizer::intermodel_sum_qsgd(lbann_comm* comm, DistMat& mat,
+                                          int bits) {
+  intermodel_sum_qsgd(comm, mat.Matrix(), bits);
+}
+
 void lbann_quantizer::compress_thresholds(const ThreshQuantized& q,
                                           ThreshQuantized& cq) {
   compress_thresholds(q, q.begin(), q.end(), cq);
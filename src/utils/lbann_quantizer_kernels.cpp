@@ -0,0 +1,576 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_quantizer_kernels .hpp .cpp - Vectorized quantization kernels
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/utils/lbann_quantizer_kernels.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#if LBANN_QUANTIZER_SIMD
+#include <immintrin.h>
+#endif
+
+namespace lbann {
+namespace quantizer_kernels {
+
+namespace {
+
+/** Whether the SIMD kernels apply to this DataType at all. */
+const bool simd_datatype = std::is_same<DataType, float>::value;
+
+template <typename T>
+void scalar_column_sums(const T* __restrict__ mat,
+                        const T* __restrict__ qerror, Int height,
+                        T& pos_sum, T& neg_sum,
+                        Unsigned& num_pos, Unsigned& num_neg) {
+  for (Int row = 0; row < height; ++row) {
+    const T val = mat[row] + qerror[row];
+    if (val >= 0.0f) {
+      pos_sum += val;
+      ++num_pos;
+    } else {
+      neg_sum += val;
+      ++num_neg;
+    }
+  }
+}
+
+/** Quantize rows [start, start + count) into a single word, count <= 32. */
+template <typename T>
+uint32_t scalar_quantize_word(const T* __restrict__ mat,
+                              T* __restrict__ qerror, Int start,
+                              Int count, T avg_pos, T avg_neg) {
+  uint32_t q = 0;
+  for (Int bit = 0; bit < count; ++bit) {
+    const Int row = start + bit;
+    const T val = mat[row] + qerror[row];
+    if (val >= 0.0f) {
+      q |= uint32_t(1) << bit;
+      qerror[row] = val - avg_pos;
+    } else {
+      qerror[row] = val - avg_neg;
+    }
+  }
+  return q;
+}
+
+/** Finish a column from row onward, then zero the remaining words. */
+template <typename T>
+void scalar_quantize_tail(const T* __restrict__ mat,
+                          T* __restrict__ qerror, Int row, Int height,
+                          T avg_pos, T avg_neg,
+                          uint32_t* __restrict__ q, Int word, Int num_words) {
+  for (; row < height; row += 32, ++word) {
+    q[word] = scalar_quantize_word(mat, qerror, row,
+                                   std::min(Int(32), height - row),
+                                   avg_pos, avg_neg);
+  }
+  for (; word < num_words; ++word) {
+    q[word] = 0;
+  }
+}
+
+template <typename T>
+void scalar_unquantize_tail(const uint32_t* __restrict__ q,
+                            T* __restrict__ mat, Int row, Int height,
+                            T avg_pos, T avg_neg, bool add) {
+  for (; row < height; ++row) {
+    const T v = (q[row / 32] >> (row % 32)) & 0x1 ? avg_pos : avg_neg;
+    if (add) {
+      mat[row] += v;
+    } else {
+      mat[row] = v;
+    }
+  }
+}
+
+template <typename T>
+size_t scalar_threshold_scan(const T* __restrict__ mat,
+                             T* __restrict__ qerror, Int start,
+                             Int height, uint32_t base_pos,
+                             T pos_thresh, T neg_thresh,
+                             uint32_t* __restrict__ out) {
+  size_t n = 0;
+  for (Int row = start; row < height; ++row) {
+    const T val = mat[row] + qerror[row];
+    const uint32_t pos = base_pos + row;
+    if (val >= pos_thresh) {
+      qerror[row] = val - pos_thresh;
+      out[n++] = (pos << 1) | 1;
+    } else if (val <= neg_thresh) {
+      qerror[row] = val - neg_thresh;
+      out[n++] = pos << 1;
+    } else {
+      qerror[row] = val;
+    }
+  }
+  return n;
+}
+
+#if LBANN_QUANTIZER_SIMD
+
+__attribute__((target("avx2")))
+inline float hsum_avx2(__m256 v) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v),
+                        _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+  return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2")))
+void avx2_column_sums(const float* __restrict__ mat,
+                      const float* __restrict__ qerror, Int height,
+                      float& pos_sum, float& neg_sum,
+                      Unsigned& num_pos, Unsigned& num_neg) {
+  const __m256 zero = _mm256_setzero_ps();
+  __m256 pos_acc = zero;
+  __m256 neg_acc = zero;
+  Unsigned pos_count = 0;
+  Int row = 0;
+  for (; row + 8 <= height; row += 8) {
+    const __m256 val = _mm256_add_ps(_mm256_loadu_ps(mat + row),
+                                     _mm256_loadu_ps(qerror + row));
+    const __m256 ge = _mm256_cmp_ps(val, zero, _CMP_GE_OQ);
+    pos_acc = _mm256_add_ps(pos_acc, _mm256_and_ps(ge, val));
+    neg_acc = _mm256_add_ps(neg_acc, _mm256_andnot_ps(ge, val));
+    pos_count += __builtin_popcount(_mm256_movemask_ps(ge));
+  }
+  pos_sum += hsum_avx2(pos_acc);
+  neg_sum += hsum_avx2(neg_acc);
+  num_pos += pos_count;
+  num_neg += row - pos_count;
+  scalar_column_sums(mat + row, qerror + row, height - row,
+                     pos_sum, neg_sum, num_pos, num_neg);
+}
+
+__attribute__((target("avx2")))
+void avx2_quantize_column(const float* __restrict__ mat,
+                          float* __restrict__ qerror, Int height,
+                          float avg_pos, float avg_neg,
+                          uint32_t* __restrict__ q, Int num_words) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 vpos = _mm256_set1_ps(avg_pos);
+  const __m256 vneg = _mm256_set1_ps(avg_neg);
+  Int row = 0;
+  Int word = 0;
+  for (; row + 32 <= height; row += 32, ++word) {
+    uint32_t bits = 0;
+    for (int k = 0; k < 4; ++k) {
+      const Int r = row + 8*k;
+      const __m256 val = _mm256_add_ps(_mm256_loadu_ps(mat + r),
+                                       _mm256_loadu_ps(qerror + r));
+      const __m256 ge = _mm256_cmp_ps(val, zero, _CMP_GE_OQ);
+      const __m256 recon = _mm256_blendv_ps(vneg, vpos, ge);
+      _mm256_storeu_ps(qerror + r, _mm256_sub_ps(val, recon));
+      bits |= uint32_t(_mm256_movemask_ps(ge)) << (8*k);
+    }
+    q[word] = bits;
+  }
+  scalar_quantize_tail(mat, qerror, row, height, avg_pos, avg_neg,
+                       q, word, num_words);
+}
+
+__attribute__((target("avx2")))
+void avx2_unquantize_column(const uint32_t* __restrict__ q,
+                            float* __restrict__ mat, Int height,
+                            float avg_pos, float avg_neg, bool add) {
+  const __m256 vpos = _mm256_set1_ps(avg_pos);
+  const __m256 vneg = _mm256_set1_ps(avg_neg);
+  // Lane i tests bit i of a byte.
+  const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  Int row = 0;
+  for (; row + 32 <= height; row += 32) {
+    const uint32_t bits = q[row / 32];
+    for (int k = 0; k < 4; ++k) {
+      const __m256i byte = _mm256_set1_epi32((bits >> (8*k)) & 0xFF);
+      const __m256i set = _mm256_cmpeq_epi32(
+        _mm256_and_si256(byte, lane_bits), lane_bits);
+      __m256 v = _mm256_blendv_ps(vneg, vpos, _mm256_castsi256_ps(set));
+      float* dst = mat + row + 8*k;
+      if (add) {
+        v = _mm256_add_ps(_mm256_loadu_ps(dst), v);
+      }
+      _mm256_storeu_ps(dst, v);
+    }
+  }
+  scalar_unquantize_tail(q, mat, row, height, avg_pos, avg_neg, add);
+}
+
+__attribute__((target("avx2")))
+size_t avx2_threshold_scan(const float* __restrict__ mat,
+                           float* __restrict__ qerror, Int height,
+                           uint32_t base_pos, float pos_thresh,
+                           float neg_thresh, uint32_t* __restrict__ out) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 vpos = _mm256_set1_ps(pos_thresh);
+  const __m256 vneg = _mm256_set1_ps(neg_thresh);
+  size_t n = 0;
+  Int row = 0;
+  for (; row + 8 <= height; row += 8) {
+    const __m256 val = _mm256_add_ps(_mm256_loadu_ps(mat + row),
+                                     _mm256_loadu_ps(qerror + row));
+    const __m256 ge = _mm256_cmp_ps(val, vpos, _CMP_GE_OQ);
+    // Positive takes precedence, as in the scalar version.
+    const __m256 le = _mm256_andnot_ps(ge,
+                                       _mm256_cmp_ps(val, vneg, _CMP_LE_OQ));
+    __m256 recon = _mm256_blendv_ps(zero, vpos, ge);
+    recon = _mm256_blendv_ps(recon, vneg, le);
+    _mm256_storeu_ps(qerror + row, _mm256_sub_ps(val, recon));
+    const unsigned ge_mask = _mm256_movemask_ps(ge);
+    unsigned any_mask = ge_mask | _mm256_movemask_ps(le);
+    while (any_mask) {
+      const unsigned j = __builtin_ctz(any_mask);
+      out[n++] = ((base_pos + row + j) << 1) | ((ge_mask >> j) & 1);
+      any_mask &= any_mask - 1;
+    }
+  }
+  return n + scalar_threshold_scan(mat, qerror, row, height, base_pos,
+                                   pos_thresh, neg_thresh, out + n);
+}
+
+__attribute__((target("avx512f")))
+void avx512_column_sums(const float* __restrict__ mat,
+                        const float* __restrict__ qerror, Int height,
+                        float& pos_sum, float& neg_sum,
+                        Unsigned& num_pos, Unsigned& num_neg) {
+  const __m512 zero = _mm512_setzero_ps();
+  __m512 pos_acc = zero;
+  __m512 neg_acc = zero;
+  Unsigned pos_count = 0;
+  Int row = 0;
+  for (; row + 16 <= height; row += 16) {
+    const __m512 val = _mm512_add_ps(_mm512_loadu_ps(mat + row),
+                                     _mm512_loadu_ps(qerror + row));
+    const __mmask16 ge = _mm512_cmp_ps_mask(val, zero, _CMP_GE_OQ);
+    pos_acc = _mm512_mask_add_ps(pos_acc, ge, pos_acc, val);
+    neg_acc = _mm512_mask_add_ps(neg_acc, (__mmask16) ~ge, neg_acc, val);
+    pos_count += __builtin_popcount(ge);
+  }
+  pos_sum += _mm512_reduce_add_ps(pos_acc);
+  neg_sum += _mm512_reduce_add_ps(neg_acc);
+  num_pos += pos_count;
+  num_neg += row - pos_count;
+  scalar_column_sums(mat + row, qerror + row, height - row,
+                     pos_sum, neg_sum, num_pos, num_neg);
+}
+
+__attribute__((target("avx512f")))
+void avx512_quantize_column(const float* __restrict__ mat,
+                            float* __restrict__ qerror, Int height,
+                            float avg_pos, float avg_neg,
+                            uint32_t* __restrict__ q, Int num_words) {
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 vpos = _mm512_set1_ps(avg_pos);
+  const __m512 vneg = _mm512_set1_ps(avg_neg);
+  Int row = 0;
+  Int word = 0;
+  for (; row + 32 <= height; row += 32, ++word) {
+    uint32_t bits = 0;
+    for (int k = 0; k < 2; ++k) {
+      const Int r = row + 16*k;
+      const __m512 val = _mm512_add_ps(_mm512_loadu_ps(mat + r),
+                                       _mm512_loadu_ps(qerror + r));
+      const __mmask16 ge = _mm512_cmp_ps_mask(val, zero, _CMP_GE_OQ);
+      const __m512 recon = _mm512_mask_blend_ps(ge, vneg, vpos);
+      _mm512_storeu_ps(qerror + r, _mm512_sub_ps(val, recon));
+      bits |= uint32_t(ge) << (16*k);
+    }
+    q[word] = bits;
+  }
+  scalar_quantize_tail(mat, qerror, row, height, avg_pos, avg_neg,
+                       q, word, num_words);
+}
+
+__attribute__((target("avx512f")))
+void avx512_unquantize_column(const uint32_t* __restrict__ q,
+                              float* __restrict__ mat, Int height,
+                              float avg_pos, float avg_neg, bool add) {
+  const __m512 vpos = _mm512_set1_ps(avg_pos);
+  const __m512 vneg = _mm512_set1_ps(avg_neg);
+  Int row = 0;
+  for (; row + 32 <= height; row += 32) {
+    const uint32_t bits = q[row / 32];
+    for (int k = 0; k < 2; ++k) {
+      const __mmask16 set = (__mmask16) (bits >> (16*k));
+      __m512 v = _mm512_mask_blend_ps(set, vneg, vpos);
+      float* dst = mat + row + 16*k;
+      if (add) {
+        v = _mm512_add_ps(_mm512_loadu_ps(dst), v);
+      }
+      _mm512_storeu_ps(dst, v);
+    }
+  }
+  scalar_unquantize_tail(q, mat, row, height, avg_pos, avg_neg, add);
+}
+
+__attribute__((target("avx512f")))
+size_t avx512_threshold_scan(const float* __restrict__ mat,
+                             float* __restrict__ qerror, Int height,
+                             uint32_t base_pos, float pos_thresh,
+                             float neg_thresh, uint32_t* __restrict__ out) {
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 vpos = _mm512_set1_ps(pos_thresh);
+  const __m512 vneg = _mm512_set1_ps(neg_thresh);
+  const __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                         8, 9, 10, 11, 12, 13, 14, 15);
+  const __m512i one = _mm512_set1_epi32(1);
+  size_t n = 0;
+  Int row = 0;
+  for (; row + 16 <= height; row += 16) {
+    const __m512 val = _mm512_add_ps(_mm512_loadu_ps(mat + row),
+                                     _mm512_loadu_ps(qerror + row));
+    const __mmask16 ge = _mm512_cmp_ps_mask(val, vpos, _CMP_GE_OQ);
+    const __mmask16 le = _mm512_mask_cmp_ps_mask((__mmask16) ~ge, val, vneg,
+                                                 _CMP_LE_OQ);
+    __m512 recon = _mm512_mask_blend_ps(ge, zero, vpos);
+    recon = _mm512_mask_blend_ps(le, recon, vneg);
+    _mm512_storeu_ps(qerror + row, _mm512_sub_ps(val, recon));
+    const __mmask16 any = ge | le;
+    if (any) {
+      // Encode (pos << 1) | sign for every lane and compress out the rest.
+      const __m512i pos = _mm512_add_epi32(
+        _mm512_set1_epi32((int) (base_pos + row)), iota);
+      __m512i enc = _mm512_slli_epi32(pos, 1);
+      enc = _mm512_mask_or_epi32(enc, ge, enc, one);
+      _mm512_mask_compressstoreu_epi32(out + n, any, enc);
+      n += __builtin_popcount(any);
+    }
+  }
+  return n + scalar_threshold_scan(mat, qerror, row, height, base_pos,
+                                   pos_thresh, neg_thresh, out + n);
+}
+
+#endif  // LBANN_QUANTIZER_SIMD
+
+/** pshufb masks and data lengths for every group varint control byte. */
+struct varint_tables {
+  unsigned char shuffle[256][16];
+  unsigned char length[256];
+  varint_tables() {
+    for (int ctrl = 0; ctrl < 256; ++ctrl) {
+      int src = 0;
+      for (int i = 0; i < 4; ++i) {
+        const int len = ((ctrl >> (2*i)) & 0x3) + 1;
+        for (int b = 0; b < 4; ++b) {
+          shuffle[ctrl][4*i + b] = b < len ? src + b : 0x80;
+        }
+        src += len;
+      }
+      length[ctrl] = src;
+    }
+  }
+};
+const varint_tables varint_table;
+
+const unsigned char* scalar_varint_decode_group(const unsigned char* in,
+                                                uint32_t* out) {
+  const unsigned ctrl = *in++;
+  for (int i = 0; i < 4; ++i) {
+    const int len = ((ctrl >> (2*i)) & 0x3) + 1;
+    uint32_t v = 0;
+    for (int b = 0; b < len; ++b) {
+      v |= uint32_t(in[b]) << (8*b);
+    }
+    out[i] = v;
+    in += len;
+  }
+  return in;
+}
+
+#if LBANN_QUANTIZER_SIMD
+
+__attribute__((target("ssse3")))
+const unsigned char* ssse3_varint_decode_group(const unsigned char* in,
+                                               uint32_t* out) {
+  const unsigned ctrl = in[0];
+  const __m128i data = _mm_loadu_si128((const __m128i*) (in + 1));
+  const __m128i mask = _mm_loadu_si128(
+    (const __m128i*) varint_table.shuffle[ctrl]);
+  _mm_storeu_si128((__m128i*) out, _mm_shuffle_epi8(data, mask));
+  return in + 1 + varint_table.length[ctrl];
+}
+
+#endif  // LBANN_QUANTIZER_SIMD
+
+simd_level level_from_env(simd_level best) {
+  const char* env = getenv("LBANN_QUANTIZER_SIMD");
+  if (env == nullptr) {
+    return best;
+  }
+  simd_level requested = best;
+  if (strcmp(env, "scalar") == 0) {
+    requested = simd_level::SCALAR;
+  } else if (strcmp(env, "avx2") == 0) {
+    requested = simd_level::AVX2;
+  } else if (strcmp(env, "avx512") == 0) {
+    requested = simd_level::AVX512;
+  }
+  return requested < best ? requested : best;
+}
+
+simd_level current_level = level_from_env(detect_simd_level());
+
+}  // namespace
+
+simd_level detect_simd_level() {
+#if LBANN_QUANTIZER_SIMD
+  if (!simd_datatype) {
+    return simd_level::SCALAR;
+  }
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return simd_level::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return simd_level::AVX2;
+  }
+#endif
+  return simd_level::SCALAR;
+}
+
+simd_level get_simd_level() {
+  return current_level;
+}
+
+simd_level set_simd_level(simd_level level) {
+  const simd_level best = detect_simd_level();
+  current_level = level < best ? level : best;
+  return current_level;
+}
+
+const char* simd_level_name(simd_level level) {
+  switch (level) {
+  case simd_level::AVX512: return "avx512";
+  case simd_level::AVX2: return "avx2";
+  default: return "scalar";
+  }
+}
+
+void onebit_column_sums(const DataType* mat, const DataType* qerror,
+                        Int height, DataType& pos_sum, DataType& neg_sum,
+                        Unsigned& num_pos, Unsigned& num_neg) {
+#if LBANN_QUANTIZER_SIMD
+  // The SIMD levels are only ever selected when DataType is float, so the
+  // casts below are no-ops whenever they run.
+  switch (current_level) {
+  case simd_level::AVX512:
+    avx512_column_sums((const float*) mat, (const float*) qerror, height,
+                       (float&) pos_sum, (float&) neg_sum, num_pos, num_neg);
+    return;
+  case simd_level::AVX2:
+    avx2_column_sums((const float*) mat, (const float*) qerror, height,
+                     (float&) pos_sum, (float&) neg_sum, num_pos, num_neg);
+    return;
+  default: break;
+  }
+#endif
+  scalar_column_sums(mat, qerror, height, pos_sum, neg_sum, num_pos, num_neg);
+}
+
+void onebit_quantize_column(const DataType* mat, DataType* qerror, Int height,
+                            DataType avg_pos, DataType avg_neg, uint32_t* q,
+                            Int num_words) {
+#if LBANN_QUANTIZER_SIMD
+  switch (current_level) {
+  case simd_level::AVX512:
+    avx512_quantize_column((const float*) mat, (float*) qerror, height,
+                           avg_pos, avg_neg, q, num_words);
+    return;
+  case simd_level::AVX2:
+    avx2_quantize_column((const float*) mat, (float*) qerror, height,
+                         avg_pos, avg_neg, q, num_words);
+    return;
+  default: break;
+  }
+#endif
+  scalar_quantize_tail(mat, qerror, 0, height, avg_pos, avg_neg,
+                       q, 0, num_words);
+}
+
+void onebit_unquantize_column(const uint32_t* q, DataType* mat, Int height,
+                              DataType avg_pos, DataType avg_neg, bool add) {
+#if LBANN_QUANTIZER_SIMD
+  switch (current_level) {
+  case simd_level::AVX512:
+    avx512_unquantize_column(q, (float*) mat, height, avg_pos, avg_neg, add);
+    return;
+  case simd_level::AVX2:
+    avx2_unquantize_column(q, (float*) mat, height, avg_pos, avg_neg, add);
+    return;
+  default: break;
+  }
+#endif
+  scalar_unquantize_tail(q, mat, 0, height, avg_pos, avg_neg, add);
+}
+
+size_t threshold_scan(const DataType* mat, DataType* qerror, Int height,
+                      uint32_t base_pos, DataType pos_thresh,
+                      DataType neg_thresh, uint32_t* out) {
+#if LBANN_QUANTIZER_SIMD
+  switch (current_level) {
+  case simd_level::AVX512:
+    return avx512_threshold_scan((const float*) mat, (float*) qerror, height,
+                                 base_pos, pos_thresh, neg_thresh, out);
+  case simd_level::AVX2:
+    return avx2_threshold_scan((const float*) mat, (float*) qerror, height,
+                               base_pos, pos_thresh, neg_thresh, out);
+  default: break;
+  }
+#endif
+  return scalar_threshold_scan(mat, qerror, 0, height, base_pos,
+                               pos_thresh, neg_thresh, out);
+}
+
+size_t varint_encode_group(const uint32_t* in, unsigned char* out) {
+  unsigned char* p = out + 1;
+  unsigned ctrl = 0;
+  for (int i = 0; i < 4; ++i) {
+    const size_t len = varint_bytes(in[i]);
+    ctrl |= (len - 1) << (2*i);
+    for (size_t b = 0; b < len; ++b) {
+      *p++ = (unsigned char) (in[i] >> (8*b));
+    }
+  }
+  out[0] = (unsigned char) ctrl;
+  return p - out;
+}
+
+const unsigned char* varint_decode_group(const unsigned char* in,
+                                         uint32_t* out) {
+#if LBANN_QUANTIZER_SIMD
+  // Every level above scalar implies SSSE3.
+  if (current_level != simd_level::SCALAR) {
+    return ssse3_varint_decode_group(in, out);
+  }
+#endif
+  return scalar_varint_decode_group(in, out);
+}
+
+}  // namespace quantizer_kernels
+}  // namespace lbann
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_rma_window .hpp .cpp - MPI-3 one-sided (RMA) windows
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/utils/lbann_rma_window.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+
+namespace lbann {
+
+#if LBANN_HAS_RMA_WINDOWS
+
+rma_window::rma_window(MPI_Comm comm, size_t count) :
+  m_comm(comm), m_count(count) {
+  MPI_Comm_rank(comm, &m_rank);
+  MPI_Comm_size(comm, &m_size);
+  if (MPI_Win_allocate(count * sizeof(DataType), sizeof(DataType),
+                       MPI_INFO_NULL, comm, &m_base, &m_win) != MPI_SUCCESS) {
+    throw lbann_exception("rma_window: MPI_Win_allocate failed");
+  }
+  MPI_Win_lock_all(0, m_win);
+}
+
+rma_window::~rma_window() {
+  MPI_Win_unlock_all(m_win);
+  MPI_Win_free(&m_win);
+}
+
+void rma_window::put(const DataType* data, int count, int target,
+                     size_t offset) {
+  MPI_Put(data, count, DataTypeMPI, target, offset, count, DataTypeMPI,
+          m_win);
+}
+
+void rma_window::replace(const DataType* data, int count, int target,
+                         size_t offset) {
+  MPI_Accumulate(data, count, DataTypeMPI, target, offset, count,
+                 DataTypeMPI, MPI_REPLACE, m_win);
+}
+
+void rma_window::accumulate(const DataType* data, int count, int target,
+                            size_t offset) {
+  MPI_Accumulate(data, count, DataTypeMPI, target, offset, count,
+                 DataTypeMPI, MPI_SUM, m_win);
+}
+
+void rma_window::get(DataType* data, int count, int target, size_t offset) {
+  // A no-op accumulate, so the read is atomic against concurrent updates.
+  MPI_Get_accumulate(nullptr, 0, DataTypeMPI, data, count, DataTypeMPI,
+                     target, offset, count, DataTypeMPI, MPI_NO_OP, m_win);
+}
+
+void rma_window::fetch_and_replace(const DataType* data, DataType* result,
+                                   int count, int target, size_t offset) {
+  MPI_Get_accumulate(data, count, DataTypeMPI, result, count, DataTypeMPI,
+                     target, offset, count, DataTypeMPI, MPI_REPLACE, m_win);
+}
+
+void rma_window::flush(int target) {
+  MPI_Win_flush(target, m_win);
+}
+
+void rma_window::flush_all() {
+  MPI_Win_flush_all(m_win);
+}
+
+void rma_window::sync() {
+  MPI_Win_sync(m_win);
+}
+
+void rma_window::fence() {
+  MPI_Win_flush_all(m_win);
+  MPI_Win_sync(m_win);
+  MPI_Barrier(m_comm);
+  MPI_Win_sync(m_win);
+}
+
+#endif  // LBANN_HAS_RMA_WINDOWS
+
+}  // namespace lbann
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014-2016, Lawrence Livermore National Security, LLC.
+// Produced at the Lawrence Livermore National Laboratory.
+// Written by the LBANN Research Team (B. Van Essen, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-697807.
+// All rights reserved.
+//
+// This file is part of LBANN: Livermore Big Artificial Neural Network
+// Toolkit. For details, see http://software.llnl.gov/LBANN or
+// https://github.com/LLNL/LBANN.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+//
+// lbann_shared_memory .hpp .cpp - MPI-3 shared-memory windows within a node
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lbann/utils/lbann_shared_memory.hpp"
+#include "lbann/utils/lbann_exception.hpp"
+
+namespace lbann {
+
+#if LBANN_HAS_SHARED_MEMORY_WINDOWS
+
+shared_memory_window::shared_memory_window(MPI_Comm comm, size_t local_bytes) :
+  m_comm(comm) {
+  int size;
+  MPI_Comm_rank(comm, &m_rank);
+  MPI_Comm_size(comm, &size);
+  void* base;
+  if (MPI_Win_allocate_shared(local_bytes, 1, MPI_INFO_NULL, comm, &base,
+                              &m_win) != MPI_SUCCESS) {
+    throw lbann_exception(
+      "shared_memory_window: MPI_Win_allocate_shared failed");
+  }
+  // Look up where every peer's segment is mapped in this process.
+  m_segments.resize(size);
+  m_segment_bytes.resize(size);
+  for (int rank = 0; rank < size; ++rank) {
+    MPI_Aint bytes;
+    int disp_unit;
+    MPI_Win_shared_query(m_win, rank, &bytes, &disp_unit, &(m_segments[rank]));
+    m_segment_bytes[rank] = bytes;
+  }
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, m_win);
+}
+
+shared_memory_window::~shared_memory_window() {
+  MPI_Win_unlock_all(m_win);
+  MPI_Win_free(&m_win);
+}
+
+void shared_memory_window::fence() {
+  MPI_Win_sync(m_win);
+  MPI_Barrier(m_comm);
+  MPI_Win_sync(m_win);
+}
+
+#endif  // LBANN_HAS_SHARED_MEMORY_WINDOWS
+
+}  // namespace lbann